@@ -33,6 +33,7 @@
 #include "libswscale/swscale.h"
 #include "libavutil/opt.h"
 #include "libavcodec/audioconvert.h"
+#include "libavcodec/audioroute.h"
 #include "libavutil/audioconvert.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/samplefmt.h"
@@ -206,6 +207,7 @@ static int64_t input_ts_offset = 0;
 static int file_overwrite = 0;
 static AVDictionary *metadata;
 static int do_benchmark = 0;
+static int mem_arena = -1;
 static int do_hex_dump = 0;
 static int do_pkt_dump = 0;
 static int do_psnr = 0;
@@ -269,15 +271,6 @@ static AVBitStreamFilterContext *subtitle_bitstream_filters=NULL;
 
 struct InputStream;
 
-typedef struct {
-    uint8_t *buf;
-    unsigned buf_size;
-    unsigned last_sample_pos; /* last valid sample pos in buf */
-    unsigned buf_index[MAX_AUDIO_CHANNEL_MAPS];
-    unsigned sample_size; /* size of one sample */
-    unsigned out_channels;
-} AudioMergeContext;
-
 typedef struct OutputStream {
     int file_index;          /* file index */
     int index;               /* stream index in the output file */
@@ -319,7 +312,8 @@ typedef struct OutputStream {
     AudioChannelMap *audio_channel_maps[MAX_AUDIO_CHANNEL_MAPS];
     int nb_audio_channel_maps;
     uint8_t *audio_merge_buf;
-    AudioMergeContext audiomerge;
+    AVAudioRoute *audiomerge;
+    int audiomerge_channels;
 
     int audio_resample;
     ReSampleContext *resample; /* for audio resampling */
@@ -364,7 +358,7 @@ typedef struct InputStream {
     int showed_multi_packet_warning;
     int is_past_recording_time;
     AVDictionary *opts;
-    uint8_t *pkt_data_to_free;
+    AVPacket last_pkt;       /* holds the data of the last decoded rawvideo picture */
     AVRational frame_rate;
 } InputStream;
 
@@ -598,8 +592,10 @@ static int ffmpeg_exit(int ret)
     for(i=0;i<nb_input_files;i++) {
         av_close_input_file(input_files[i].ctx);
     }
-    for (i = 0; i < nb_input_streams; i++)
+    for (i = 0; i < nb_input_streams; i++) {
         av_dict_free(&input_streams[i].opts);
+        av_free_packet(&input_streams[i].last_pkt);
+    }
 
     av_free(intra_matrix);
     av_free(inter_matrix);
@@ -814,6 +810,9 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
                                           pkt->data, pkt->size,
                                           pkt->flags & AV_PKT_FLAG_KEY);
         if(a>0){
+            /* the side data now belongs to new_pkt */
+            pkt->side_data       = NULL;
+            pkt->side_data_elems = 0;
             av_free_packet(pkt);
             new_pkt.destruct= av_destruct_packet;
         } else if(a<0){
@@ -836,105 +835,48 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
     }
 }
 
-static int audiomerge_init(AudioMergeContext *a, int out_channels, int sample_size)
+static int audiomerge_init(OutputStream *ost, int sample_size)
 {
-    int i;
-
-    if (sample_size <= 0 || out_channels <= 0)
-        return -1;
-
-    a->out_channels = out_channels;
-    a->sample_size = sample_size;
+    int i, ret;
 
-    a->buf_size = out_channels*sample_size*48000; // 1 sec at 48khz
-    a->buf = av_malloc(a->buf_size);
-    if (!a->buf)
+    ost->audiomerge = av_audio_route_alloc(ost->audiomerge_channels, sample_size,
+                                           48000); // 1 sec at 48khz
+    if (!ost->audiomerge)
         return AVERROR(ENOMEM);
 
-    for (i = 0; i < out_channels; i++)
-        a->buf_index[i] = i*sample_size;
-
-    return 0;
-}
-
-static int audiomerge_add_channel(AudioMergeContext *a, uint8_t *input,
-                                  unsigned in_channel, unsigned out_channel,
-                                  unsigned in_channels, unsigned samples)
-{
-    if (out_channel >= a->out_channels)
-        return -1;
-
-    //fprintf(stderr, "in channel %d out channel %d samples %d\n", in_channel, out_channel, samples);
-
-    if (a->buf_index[out_channel] +
-        (int64_t)samples*a->sample_size*a->out_channels >= a->buf_size) {
-        uint8_t *buf;
-        if (a->buf_size + (int64_t)samples*a->sample_size*a->out_channels >= UINT_MAX)
-            goto error;
-        a->buf_size += (int64_t)samples*a->sample_size*a->out_channels;
-        buf = av_realloc(a->buf, a->buf_size);
-        if (!buf) {
-        error:
-            av_log(NULL, AV_LOG_ERROR, "error reallocating audiomerge buffer\n");
-            return -1;
-        }
-        a->buf = buf;
-    }
-
-    input += a->sample_size*in_channel;
-    while (samples--) {
-        memcpy(a->buf + a->buf_index[out_channel], input, a->sample_size);
-        a->buf_index[out_channel] += a->sample_size*a->out_channels;
-        input += a->sample_size*in_channels;
+    for (i = 0; i < ost->nb_audio_channel_maps; i++) {
+        AudioChannelMap *m = ost->audio_channel_maps[i];
+        ret = av_audio_route_map(ost->audiomerge,
+                                 input_files[m->file_index].ist_index + m->stream_index,
+                                 m->channel_index, m->out_channel_index);
+        if (ret < 0)
+            return ret;
     }
-
-    a->last_sample_pos = FFMAX(a->buf_index[out_channel], a->last_sample_pos);
-
     return 0;
 }
 
-
-static unsigned audiomerge_complete_size(AudioMergeContext *a)
-{
-    int i, min = INT_MAX;
-    int align = a->out_channels*a->sample_size;
-
-    for (i = 0; i < a->out_channels; i++)
-        min = FFMIN(a->buf_index[i], min);
-    return (min / align) * align;
-}
-
-static unsigned audiomerge_get_buffered_samples(const OutputStream *ost, const InputStream *ist)
+static int audiomerge_is_mapped(const OutputStream *ost, const InputStream *ist)
 {
     int i;
 
-    if (!ost->nb_audio_channel_maps)
-        return 0;
-
     for (i = 0; i < ost->nb_audio_channel_maps; i++) {
         if (ost->audio_channel_maps[i]->file_index == ist->file_index &&
-            ost->audio_channel_maps[i]->stream_index == ist->st->index) {
-            return ost->audiomerge.buf_index[ost->audio_channel_maps[i]->out_channel_index] /
-                (ost->audiomerge.sample_size*ost->audiomerge.out_channels);
-        }
+            ost->audio_channel_maps[i]->stream_index == ist->st->index)
+            return 1;
     }
-    av_log(NULL, AV_LOG_ERROR, "error, could not find corresponding channel mapping\n");
     return 0;
 }
 
-static void audiomerge_drain_complete_size(AudioMergeContext *a)
+static unsigned audiomerge_get_buffered_samples(const OutputStream *ost, const InputStream *ist)
 {
-    int i;
-    unsigned complete_size = audiomerge_complete_size(a);
-
-    if (!complete_size)
-        return;
+    if (!ost->nb_audio_channel_maps)
+        return 0;
 
-    memmove(a->buf, a->buf + complete_size,
-            a->last_sample_pos - complete_size);
-    a->last_sample_pos -= complete_size;
-    for (i = 0; i < a->out_channels; i++)
-        a->buf_index[i] -= complete_size;
+    if (!audiomerge_is_mapped(ost, ist)) {
+        av_log(NULL, AV_LOG_ERROR, "error, could not find corresponding channel mapping\n");
+        return 0;
+    }
+    return av_audio_route_buffered(ost->audiomerge, ist - input_streams);
 }
 
 #define MAX_AUDIO_PACKET_SIZE (128 * 1024)
@@ -946,7 +888,8 @@ static void do_audio_out(AVFormatContext *s,
 {
     uint8_t *buftmp;
     int64_t audio_out_size, audio_buf_size;
-    int size_out, frame_bytes, ret, resample_changed, i, in_channels;
+    int size_out, frame_bytes, ret, resample_changed, in_channels;
+    int merged_samples = 0;
     AVCodecContext *enc= ost->st->codec;
     AVCodecContext *dec= ist->st->codec;
     int osize = av_get_bytes_per_sample(enc->sample_fmt);
@@ -991,7 +934,8 @@ static void do_audio_out(AVFormatContext *s,
             ost->audio_resample = 0;
         } else {
             ost->audio_resample = 1;
-            if (dec->sample_fmt != AV_SAMPLE_FMT_S16 && enc->sample_fmt != AV_SAMPLE_FMT_S16)
+            if (dec->sample_fmt != AV_SAMPLE_FMT_S16 && enc->sample_fmt != AV_SAMPLE_FMT_S16 &&
+                enc->channels != in_channels)
                 av_log(NULL, AV_LOG_ERROR, "Warning, using s16 intermediate sample format for resampling\n");
             ost->resample = av_audio_resample_init(enc->channels,    in_channels,
                                                    enc->sample_rate, dec->sample_rate,
@@ -1104,21 +1048,14 @@ static void do_audio_out(AVFormatContext *s,
     }
 
     if (ost->nb_audio_channel_maps > 0) {
-        for (i = 0; i < ost->nb_audio_channel_maps; i++) {
-            if (ost->audio_channel_maps[i]->file_index == ist->file_index &&
-                ost->audio_channel_maps[i]->stream_index == ist->st->index) {
-                if (audiomerge_add_channel(&ost->audiomerge, buf,
-                                           ost->audio_channel_maps[i]->channel_index,
-                                           ost->audio_channel_maps[i]->out_channel_index,
-                                           dec->channels,
-                                           size/(isize*dec->channels)) < 0) {
-                    av_log(NULL, AV_LOG_ERROR, "audiomerge failed\n");
-                    ffmpeg_exit(1);
-                }
-            }
+        if (audiomerge_is_mapped(ost, ist) &&
+            av_audio_route_write(ost->audiomerge, ist - input_streams, buf,
+                                 dec->channels, size/(isize*dec->channels)) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "audiomerge failed\n");
+            ffmpeg_exit(1);
         }
-        buftmp = ost->audiomerge.buf;
-        size_out = audiomerge_complete_size(&ost->audiomerge);
+        buftmp = av_audio_route_peek(ost->audiomerge, &merged_samples);
+        size_out = merged_samples * isize * ost->audiomerge_channels;
         if (!size_out)
             return; // no complete frame
     } else {
@@ -1221,7 +1158,7 @@ static void do_audio_out(AVFormatContext *s,
     }
 
     if (ost->nb_audio_channel_maps > 0)
-        audiomerge_drain_complete_size(&ost->audiomerge);
+        av_audio_route_drain(ost->audiomerge, merged_samples);
 
     ost->is_start = 0;
 }
@@ -1715,6 +1652,8 @@ static int output_packet(InputStream *ist, int ist_index,
     int frame_available;
 #endif
     float quality = 0;
+    uint8_t *data_buf = NULL;
+    int data_size = 0;
 
     AVPacket avpkt;
     int bps = av_get_bytes_per_sample(ist->st->codec->sample_fmt);
@@ -1742,8 +1681,8 @@ static int output_packet(InputStream *ist, int ist_index,
 
     //while we have more to decode or while the decoder did output something on EOF
     while (avpkt.size > 0 || (!pkt && got_output)) {
-        uint8_t *data_buf, *decoded_data_buf;
-        int data_size, decoded_data_size;
+        uint8_t *decoded_data_buf;
+        int decoded_data_size;
     handle_eof:
         ist->pts= ist->next_pts;
 
@@ -1942,12 +1881,10 @@ static int output_packet(InputStream *ist, int ist_index,
                             abort();
                         }
                     } else {
-                        AVPacket opkt;
+                        AVPacket opkt, pict_pkt;
                         AVPicture pict;
                         int64_t ost_tb_start_time= av_rescale_q(start_time, AV_TIME_BASE_Q, ost->st->time_base);
 
-                        av_init_packet(&opkt);
-
                         if ((!ost->frame_number && !(pkt->flags & AV_PKT_FLAG_KEY)) &&
                             !copy_initial_nonkeyframes &&
                             ost->st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
@@ -1966,6 +1903,16 @@ static int output_packet(InputStream *ist, int ist_index,
                         }
 
                         /* no reencoding needed : output the packet directly */
+                        /* the payload is shared with the input packet when it is refcounted,
+                           opkt only covers the chunk consumed by this pass */
+                        if (av_packet_ref(&opkt, pkt) < 0) {
+                            av_log(NULL, AV_LOG_FATAL, "Could not allocate output packet\n");
+                            ffmpeg_exit(1);
+                        }
+                        opkt.data += data_buf - pkt->data;
+                        opkt.size  = data_size;
+                        opkt.pos   = -1;
+
                         /* force the input stream PTS */
 
                         if(ost->st->codec->codec_type == AVMEDIA_TYPE_AUDIO)
@@ -2008,17 +1955,25 @@ static int output_packet(InputStream *ist, int ist_index,
                            && ost->st->codec->codec_id != CODEC_ID_MPEG1VIDEO
                            && ost->st->codec->codec_id != CODEC_ID_MPEG2VIDEO
                            ) {
-                            if(av_parser_change(ist->st->parser, ost->st->codec, &opkt.data, &opkt.size, data_buf, data_size, pkt->flags & AV_PKT_FLAG_KEY))
+                            uint8_t *data;
+                            int size;
+                            if(av_parser_change(ist->st->parser, ost->st->codec, &data, &size, opkt.data, opkt.size, pkt->flags & AV_PKT_FLAG_KEY)) {
+                                av_free_packet(&opkt);
                                 opkt.destruct= av_destruct_packet;
-                        } else {
-                            opkt.data = data_buf;
-                            opkt.size = data_size;
+                            }
+                            opkt.data = data;
+                            opkt.size = size;
                         }
 
+                        av_init_packet(&pict_pkt);
                         if (os->oformat->flags & AVFMT_RAWPICTURE) {
                             /* store AVPicture in AVPacket, as expected by the output format */
                             avpicture_fill(&pict, opkt.data, ost->st->codec->pix_fmt, ost->st->codec->width, ost->st->codec->height);
+                            /* pict points into the opkt payload, which is kept
+                               referenced by pict_pkt until it has been written */
+                            pict_pkt = opkt;
                             opkt.data = (uint8_t *)&pict;
+                            opkt.destruct = NULL;
                             opkt.size = sizeof(AVPicture);
                             opkt.flags |= AV_PKT_FLAG_KEY;
                         }
@@ -2026,6 +1981,7 @@ static int output_packet(InputStream *ist, int ist_index,
                         ost->st->codec->frame_number++;
                         ost->frame_number++;
                         av_free_packet(&opkt);
+                        av_free_packet(&pict_pkt);
                     }
 #if CONFIG_AVFILTER
                     cont:
@@ -2733,16 +2689,16 @@ static int transcode(AVFormatContext **output_files,
                         }
                         ost->audio_channel_maps[ost->nb_audio_channel_maps++] = m;
                         if (m->out_channel_index == -1)
-                            m->out_channel_index = ost->audiomerge.out_channels;
-                        ost->audiomerge.out_channels++;
+                            m->out_channel_index = ost->audiomerge_channels;
+                        ost->audiomerge_channels++;
                     }
                 }
                 /* Sanity check out audio channel number */
                 for(j=0;j<ost->nb_audio_channel_maps;j++) {
                     AudioChannelMap *m = ost->audio_channel_maps[j];
-                    if (m->out_channel_index >= ost->audiomerge.out_channels) {
+                    if (m->out_channel_index >= ost->audiomerge_channels) {
                         av_log(NULL, AV_LOG_ERROR, "Channel number %d does not exist: channels %d\n",
-                                m->out_channel_index, ost->audiomerge.out_channels);
+                                m->out_channel_index, ost->audiomerge_channels);
                         ffmpeg_exit(1);
                     }
                 }
@@ -2962,10 +2918,9 @@ static int transcode(AVFormatContext **output_files,
                 ost->resample_sample_rate = icodec->sample_rate;
                 ost->resample_channels    = icodec->channels;
 
-                if (ost->audiomerge.out_channels > 0) {
-                    codec->channels = ost->audiomerge.out_channels; // update channels to merged channels
-                    if (audiomerge_init(&ost->audiomerge, ost->audiomerge.out_channels,
-                                        av_get_bytes_per_sample(icodec->sample_fmt)) < 0) {
+                if (ost->audiomerge_channels > 0) {
+                    codec->channels = ost->audiomerge_channels; // update channels to merged channels
+                    if (audiomerge_init(ost, av_get_bytes_per_sample(icodec->sample_fmt)) < 0) {
                         av_log(NULL, AV_LOG_ERROR, "Audiomerge initialization failed\n");
                         ffmpeg_exit(1);
                     }
@@ -3499,6 +3454,11 @@ static int transcode(AVFormatContext **output_files,
         }
         ist->dts = pkt.dts;
 
+        /* let the decoder threads and the muxers share the payload
+           instead of copying it; it stays a plain packet on failure */
+        if (pkt.destruct)
+            av_packet_make_refcounted(&pkt);
+
         //fprintf(stderr,"read #%d.%d size=%d\n", ist->file_index, ist->index, pkt.size);
         if (output_packet(ist, ist_index, ost_table, nb_ostreams, &pkt) < 0) {
             if (verbose >= 0)
@@ -3514,9 +3474,8 @@ static int transcode(AVFormatContext **output_files,
 
     discard_packet:
         if (ist && ist->st->codec->codec_id == CODEC_ID_RAWVIDEO) {
-            if (ist->pkt_data_to_free)
-                av_free(ist->pkt_data_to_free);
-            ist->pkt_data_to_free = pkt.data;
+            av_free_packet(&ist->last_pkt);
+            ist->last_pkt = pkt;
             pkt.destruct = NULL;
         }
         av_free_packet(&pkt);
@@ -3590,7 +3549,7 @@ static int transcode(AVFormatContext **output_files,
                 if (ost->free_prev_frame)
                     av_free(ost->prev_frame.data[0]);
                 av_free(ost->forced_kf_pts);
-                av_free(ost->audiomerge.buf);
+                av_audio_route_free(&ost->audiomerge);
                 if (ost->video_resample)
                     sws_freeContext(ost->img_resample_ctx);
                 if (ost->resample)
@@ -4181,6 +4140,8 @@ static int opt_input_file(const char *opt, const char *filename)
         av_close_input_file(ic);
         ffmpeg_exit(1);
     }
+    av_log(NULL, AV_LOG_VERBOSE, "%s: %"PRId64" bytes read while probing\n",
+           filename, ic->probe_bytes);
 
     if (ic->nb_programs > 1 && !opt_programid) {
         av_log(NULL, AV_LOG_WARNING, "Multiple programs detected, "
@@ -5011,7 +4972,7 @@ static int opt_vf(const char *opt, const char *arg)
         strcat(vfilters, ",");
         strcat(vfilters, arg);
     } else {
-        vfilters = strdup(arg);
+        vfilters = av_strdup(arg);
     }
     return 0;
 }
@@ -5346,6 +5307,8 @@ static const OptionDef options[] = {
     { "coverfile", HAS_ARG, {(void*)opt_cover_file}, "add cover artwork", "coverfilepath" },
     { "benchmark", OPT_BOOL | OPT_EXPERT, {(void*)&do_benchmark},
       "add timings for benchmarking" },
+    { "mem_arena", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&mem_arena},
+      "enable or disable the size class allocator", "0/1" },
     { "timelimit", HAS_ARG, {(void*)opt_timelimit}, "set max runtime in seconds", "limit" },
     { "dump", OPT_BOOL | OPT_EXPERT, {(void*)&do_pkt_dump},
       "dump each input packet" },
@@ -5512,6 +5475,9 @@ int main(int argc, char **argv)
         ffmpeg_exit(1);
     }
 
+    if (mem_arena >= 0 && av_mem_arena_enable(mem_arena) < 0)
+        av_log(NULL, AV_LOG_WARNING, "memory arena not compiled in\n");
+
     ti = getutime();
     if (transcode(output_files, nb_output_files, input_files, nb_input_files,
                   stream_maps, nb_stream_maps) < 0)
@@ -5520,6 +5486,7 @@ int main(int argc, char **argv)
     if (do_benchmark) {
         int maxrss = getmaxrss() / 1024;
         av_log(NULL, AV_LOG_INFO, "bench: utime=%0.3fs maxrss=%ikB\n", ti / 1000000.0, maxrss);
+        av_mem_arena_log(NULL, AV_LOG_INFO);
     }
 
     return ffmpeg_exit(0);
@@ -0,0 +1,301 @@
+/*
+ * audio channel routing
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * audio channel routing
+ *
+ * Mapped channels are grouped into runs of channels which are consecutive
+ * both in the input and in the output, so that a stereo pair or a 16
+ * channel block moving as a whole is copied with one fixed size move per
+ * sample instead of one per channel.
+ * Output samples live in a preallocated linear buffer, so that
+ * av_audio_route_peek() can return them contiguously. When a write does not
+ * fit at the end, the samples not consumed yet are moved back to its start;
+ * the buffer is only grown, by doubling, when they still do not fit.
+ */
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "audioroute.h"
+#include "audioroutedsp.h"
+
+typedef struct AudioRouteRun {
+    int in_channel;
+    int out_channel;
+    int nb_channels;
+} AudioRouteRun;
+
+typedef struct AudioRouteInput {
+    int id;
+    int min_in_channels;  ///< number of input channels the mapping requires
+    int nb_runs;
+    AudioRouteRun runs[AV_AUDIO_ROUTE_MAX_CHANNELS];
+} AudioRouteInput;
+
+struct AVAudioRoute {
+    AudioRouteDSPContext dsp;
+    int out_channels;
+    int sample_size;
+    int frame_size;       ///< size of one interleaved output sample
+    uint8_t *buf;
+    int buf_samples;      ///< capacity of buf in samples per channel
+    int read_pos;         ///< first sample not consumed
+    int write_pos[AV_AUDIO_ROUTE_MAX_CHANNELS]; ///< next sample of each channel
+    AudioRouteInput *inputs;
+    int nb_inputs;
+};
+
+#define COPY_FUNC(width)                                                \
+static void copy_ ## width ## _c(uint8_t *dst, const uint8_t *src, int len, \
+                                 int dst_stride, int src_stride)       \
+{                                                                       \
+    while (len--) {                                                     \
+        memcpy(dst, src, width);                                        \
+        dst += dst_stride;                                              \
+        src += src_stride;                                              \
+    }                                                                   \
+}
+
+COPY_FUNC(2)
+COPY_FUNC(4)
+COPY_FUNC(8)
+COPY_FUNC(16)
+COPY_FUNC(32)
+COPY_FUNC(64)
+
+void ff_audio_route_dsp_init(AudioRouteDSPContext *c)
+{
+    c->copy[0] = copy_2_c;
+    c->copy[1] = copy_4_c;
+    c->copy[2] = copy_8_c;
+    c->copy[3] = copy_16_c;
+    c->copy[4] = copy_32_c;
+    c->copy[5] = copy_64_c;
+
+    if (HAVE_MMX) ff_audio_route_dsp_init_x86(c);
+}
+
+AVAudioRoute *av_audio_route_alloc(int out_channels, int sample_size,
+                                   int nb_samples)
+{
+    AVAudioRoute *route;
+
+    if (out_channels <= 0 || out_channels > AV_AUDIO_ROUTE_MAX_CHANNELS ||
+        sample_size <= 0 || nb_samples <= 0 ||
+        nb_samples > INT_MAX / (out_channels * sample_size))
+        return NULL;
+
+    route = av_mallocz(sizeof(*route));
+    if (!route)
+        return NULL;
+    route->out_channels = out_channels;
+    route->sample_size  = sample_size;
+    route->frame_size   = out_channels * sample_size;
+    route->buf_samples  = nb_samples;
+    route->buf = av_malloc(nb_samples * route->frame_size);
+    if (!route->buf) {
+        av_free(route);
+        return NULL;
+    }
+    ff_audio_route_dsp_init(&route->dsp);
+    return route;
+}
+
+void av_audio_route_free(AVAudioRoute **route)
+{
+    if (!*route)
+        return;
+    av_free((*route)->buf);
+    av_free((*route)->inputs);
+    av_freep(route);
+}
+
+static AudioRouteInput *get_input(const AVAudioRoute *route, int id)
+{
+    int i;
+
+    for (i = 0; i < route->nb_inputs; i++)
+        if (route->inputs[i].id == id)
+            return &route->inputs[i];
+    return NULL;
+}
+
+int av_audio_route_map(AVAudioRoute *route, int input,
+                       int in_channel, int out_channel)
+{
+    AudioRouteInput *in;
+    AudioRouteRun *run;
+    int i;
+
+    if (input < 0 || in_channel < 0 || in_channel >= AV_AUDIO_ROUTE_MAX_CHANNELS ||
+        out_channel < 0 || out_channel >= route->out_channels)
+        return AVERROR(EINVAL);
+
+    in = get_input(route, input);
+    if (!in) {
+        in = av_realloc(route->inputs, (route->nb_inputs + 1) * sizeof(*in));
+        if (!in)
+            return AVERROR(ENOMEM);
+        route->inputs = in;
+        in = &route->inputs[route->nb_inputs++];
+        memset(in, 0, sizeof(*in));
+        in->id = input;
+    }
+    if (in->nb_runs == AV_AUDIO_ROUTE_MAX_CHANNELS)
+        return AVERROR(EINVAL);
+    in->min_in_channels = FFMAX(in->min_in_channels, in_channel + 1);
+
+    /* extend a run if the channel follows it in the input and the output */
+    for (i = 0; i < in->nb_runs; i++) {
+        run = &in->runs[i];
+        if (in_channel  == run->in_channel  + run->nb_channels &&
+            out_channel == run->out_channel + run->nb_channels) {
+            run->nb_channels++;
+            return 0;
+        }
+    }
+    run = &in->runs[in->nb_runs++];
+    run->in_channel  = in_channel;
+    run->out_channel = out_channel;
+    run->nb_channels = 1;
+    return 0;
+}
+
+static void copy_block(AVAudioRoute *route, uint8_t *dst, const uint8_t *src,
+                       int width, int len, int dst_stride, int src_stride)
+{
+    if (dst_stride == width && src_stride == width) {
+        memcpy(dst, src, width * len);
+    } else if (width >= 2 && width <= 64 && !(width & (width - 1))) {
+        route->dsp.copy[av_log2(width) - 1](dst, src, len, dst_stride, src_stride);
+    } else {
+        while (len--) {
+            memcpy(dst, src, width);
+            dst += dst_stride;
+            src += src_stride;
+        }
+    }
+}
+
+/* make room for nb_samples more samples after position pos */
+static int make_room(AVAudioRoute *route, int pos, int nb_samples)
+{
+    int i, last = 0;
+
+    if (nb_samples > route->buf_samples - pos && route->read_pos > 0) {
+        for (i = 0; i < route->out_channels; i++)
+            last = FFMAX(last, route->write_pos[i]);
+        memmove(route->buf, route->buf + route->read_pos * route->frame_size,
+                (last - route->read_pos) * route->frame_size);
+        for (i = 0; i < route->out_channels; i++)
+            route->write_pos[i] -= route->read_pos;
+        pos -= route->read_pos;
+        route->read_pos = 0;
+    }
+    if (nb_samples > route->buf_samples - pos) {
+        int64_t size = FFMAX(2LL * route->buf_samples, (int64_t)pos + nb_samples);
+        uint8_t *buf;
+        if (size * route->frame_size > INT_MAX)
+            return AVERROR(EINVAL);
+        buf = av_realloc(route->buf, size * route->frame_size);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        route->buf = buf;
+        route->buf_samples = size;
+    }
+    return 0;
+}
+
+int av_audio_route_write(AVAudioRoute *route, int input, const uint8_t *buf,
+                         int in_channels, int nb_samples)
+{
+    AudioRouteInput *in = get_input(route, input);
+    int ss = route->sample_size;
+    int i, c, ret, pos = 0;
+
+    if (!in || in_channels < in->min_in_channels || nb_samples < 0)
+        return AVERROR(EINVAL);
+
+    for (i = 0; i < in->nb_runs; i++)
+        for (c = 0; c < in->runs[i].nb_channels; c++)
+            pos = FFMAX(pos, route->write_pos[in->runs[i].out_channel + c]);
+    if ((ret = make_room(route, pos, nb_samples)) < 0)
+        return ret;
+
+    for (i = 0; i < in->nb_runs; i++) {
+        const AudioRouteRun *run = &in->runs[i];
+        int *write_pos = route->write_pos + run->out_channel;
+        int n = run->nb_channels;
+
+        for (c = 1; c < n && write_pos[c] == write_pos[0]; c++)
+            ;
+        if (c == n) {
+            copy_block(route, route->buf + write_pos[0] * route->frame_size +
+                       run->out_channel * ss, buf + run->in_channel * ss,
+                       n * ss, nb_samples, route->frame_size, in_channels * ss);
+        } else {
+            /* channels of the run are not in sync, copy them one by one */
+            for (c = 0; c < n; c++)
+                copy_block(route, route->buf + write_pos[c] * route->frame_size +
+                           (run->out_channel + c) * ss,
+                           buf + (run->in_channel + c) * ss,
+                           ss, nb_samples, route->frame_size, in_channels * ss);
+        }
+        for (c = 0; c < n; c++)
+            write_pos[c] += nb_samples;
+    }
+    return 0;
+}
+
+int av_audio_route_buffered(const AVAudioRoute *route, int input)
+{
+    const AudioRouteInput *in = get_input(route, input);
+
+    if (!in || !in->nb_runs)
+        return 0;
+    return route->write_pos[in->runs[0].out_channel] - route->read_pos;
+}
+
+uint8_t *av_audio_route_peek(const AVAudioRoute *route, int *nb_samples)
+{
+    int i, min = INT_MAX;
+
+    for (i = 0; i < route->out_channels; i++)
+        min = FFMIN(min, route->write_pos[i]);
+    *nb_samples = min - route->read_pos;
+    return route->buf + route->read_pos * route->frame_size;
+}
+
+void av_audio_route_drain(AVAudioRoute *route, int nb_samples)
+{
+    int i, last = 0;
+
+    route->read_pos += nb_samples;
+    for (i = 0; i < route->out_channels; i++)
+        last = FFMAX(last, route->write_pos[i]);
+    if (route->read_pos >= last) {
+        /* everything consumed, restart at the beginning for free */
+        memset(route->write_pos, 0, sizeof(route->write_pos));
+        route->read_pos = 0;
+    }
+}
@@ -0,0 +1,93 @@
+/*
+ * audio channel routing
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_AUDIOROUTE_H
+#define AVCODEC_AUDIOROUTE_H
+
+/**
+ * @file
+ * Route channels of several interleaved audio inputs into one interleaved
+ * output, according to a channel matrix.
+ */
+
+#include <stdint.h>
+
+#define AV_AUDIO_ROUTE_MAX_CHANNELS 64
+
+struct AVAudioRoute;
+typedef struct AVAudioRoute AVAudioRoute;
+
+/**
+ * Allocate an audio channel router.
+ * @param out_channels number of channels of the interleaved output
+ * @param sample_size size of one sample in bytes, identical for all inputs
+ * @param nb_samples number of samples per channel to preallocate, the buffer
+ *                   grows if more are written before being drained
+ * @return NULL on error
+ */
+AVAudioRoute *av_audio_route_alloc(int out_channels, int sample_size,
+                                   int nb_samples);
+
+/**
+ * Free an audio channel router and set the pointer to NULL.
+ */
+void av_audio_route_free(AVAudioRoute **route);
+
+/**
+ * Route a channel of an input to an output channel.
+ * @param input arbitrary identifier of the input, >= 0
+ * @param in_channel channel index in the input
+ * @param out_channel channel index in the output
+ * @return 0 on success, a negative AVERROR on error
+ */
+int av_audio_route_map(AVAudioRoute *route, int input,
+                       int in_channel, int out_channel);
+
+/**
+ * Scatter the mapped channels of interleaved input samples into the output.
+ * @param input identifier of the input given to av_audio_route_map()
+ * @param buf interleaved input samples
+ * @param in_channels number of channels of the input
+ * @param nb_samples number of samples per channel
+ * @return 0 on success, a negative AVERROR on error
+ */
+int av_audio_route_write(AVAudioRoute *route, int input, const uint8_t *buf,
+                         int in_channels, int nb_samples);
+
+/**
+ * Get the number of samples per channel buffered for an input, that is
+ * the samples written by this input which cannot be read yet.
+ */
+int av_audio_route_buffered(const AVAudioRoute *route, int input);
+
+/**
+ * Get the interleaved output samples which are complete for all channels.
+ * @param[out] nb_samples number of samples per channel available
+ * @return pointer to the samples, valid until the next call to
+ *         av_audio_route_write() or av_audio_route_drain()
+ */
+uint8_t *av_audio_route_peek(const AVAudioRoute *route, int *nb_samples);
+
+/**
+ * Discard output samples returned by av_audio_route_peek().
+ */
+void av_audio_route_drain(AVAudioRoute *route, int nb_samples);
+
+#endif /* AVCODEC_AUDIOROUTE_H */
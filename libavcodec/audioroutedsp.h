@@ -0,0 +1,46 @@
+/*
+ * audio channel routing
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_AUDIOROUTEDSP_H
+#define AVCODEC_AUDIOROUTEDSP_H
+
+#include <stdint.h>
+
+/** widths handled by AudioRouteDSPContext.copy, 2 << index bytes */
+#define AUDIO_ROUTE_COPY_WIDTHS 6
+
+typedef struct AudioRouteDSPContext {
+    /**
+     * Copy len blocks of (2 << index) bytes from src to dst, moving by
+     * src_stride and dst_stride bytes after each block.
+     * A block is one channel or a run of consecutive channels of one
+     * sample, so this interleaves, deinterleaves or shuffles depending on
+     * the strides.
+     * @param dst destination, no alignment constraint
+     * @param src source, no alignment constraint
+     */
+    void (*copy[AUDIO_ROUTE_COPY_WIDTHS])(uint8_t *dst, const uint8_t *src, int len,
+                                          int dst_stride, int src_stride);
+} AudioRouteDSPContext;
+
+void ff_audio_route_dsp_init(AudioRouteDSPContext *c);
+void ff_audio_route_dsp_init_x86(AudioRouteDSPContext *c);
+
+#endif /* AVCODEC_AUDIOROUTEDSP_H */
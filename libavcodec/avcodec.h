@@ -1154,6 +1154,12 @@ typedef struct AVFrame {
     int repeat_first_field;
 } AVFrame;
 
+/**
+ * Pool of frame buffers used by avcodec_default_get_buffer(), it can be
+ * shared by several codec contexts, see AVCodecContext.frame_pool.
+ */
+typedef struct AVFramePool AVFramePool;
+
 /**
  * main external API structure.
  * New fields can be added to the end with minor version bumps.
@@ -2950,6 +2956,18 @@ typedef struct AVCodecContext {
      * - decoding: Set by libavcodec.
      */
     AVDictionary *metadata;
+
+    /**
+     * Pool the video buffers of avcodec_default_get_buffer() come from.
+     * Picture size and format can change without freeing the buffers, and
+     * decoders sharing a pool reuse each other's buffers.
+     * If NULL, avcodec_open2() allocates a pool for the context.
+     * avcodec_open2() takes a reference to the pool and avcodec_close()
+     * drops it and resets the field to NULL.
+     * - encoding: Set by user or libavcodec.
+     * - decoding: Set by user or libavcodec.
+     */
+    AVFramePool *frame_pool;
 } AVCodecContext;
 
 /**
@@ -3258,6 +3276,33 @@ int av_grow_packet(AVPacket *pkt, int grow_by);
  */
 int av_dup_packet(AVPacket *pkt);
 
+/**
+ * Make the payload of a packet refcounted, so that references to it can
+ * be created with av_packet_ref() without copying it.
+ * A payload the packet owns is taken over as is, one it does not own
+ * (pkt->destruct == NULL) is copied first.
+ *
+ * @param pkt packet
+ * @return 0 if OK, AVERROR_xxx otherwise
+ */
+int av_packet_make_refcounted(AVPacket *pkt);
+
+/**
+ * Setup a new reference to the payload of src in dst.
+ * The payload is shared if src is refcounted and copied otherwise.
+ * All the other fields are copied from src, the side data is duplicated.
+ * The reference is released with av_free_packet(); the payload is freed
+ * along with the last reference.
+ *
+ * @note The payload of a refcounted packet may be shared with other
+ *       packets and must not be modified in place.
+ *
+ * @param dst packet to set up, its previous content is overwritten
+ * @param src source packet
+ * @return 0 if OK, AVERROR_xxx otherwise
+ */
+int av_packet_ref(AVPacket *dst, const AVPacket *src);
+
 /**
  * Free a packet.
  *
@@ -3711,6 +3756,25 @@ int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic);
 void avcodec_default_release_buffer(AVCodecContext *s, AVFrame *pic);
 int avcodec_default_reget_buffer(AVCodecContext *s, AVFrame *pic);
 
+/**
+ * Allocate a frame buffer pool, to be shared by setting
+ * AVCodecContext.frame_pool before opening the codecs.
+ * A pool can be used from several threads at once if libavcodec was
+ * built with pthreads.
+ *
+ * @param max_buffers maximum number of unused buffers kept, 0 for no limit
+ * @param max_bytes   maximum total size of the unused buffers kept,
+ *                    0 for no limit
+ * @return the pool or NULL on failure
+ */
+AVFramePool *av_frame_pool_alloc(int max_buffers, int64_t max_bytes);
+
+/**
+ * Drop the reference of the caller to the pool and set *pool to NULL.
+ * The pool is freed once no codec context uses it anymore.
+ */
+void av_frame_pool_free(AVFramePool **pool);
+
 /**
  * Return the amount of padding in pixels which the get_buffer callback must
  * provide around the edge of the image for codecs which do not have the
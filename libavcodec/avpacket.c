@@ -19,10 +19,111 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+#if !HAVE_ATOMICS_GCC && HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "avcodec.h"
+#include "internal.h"
 #include "libavutil/avassert.h"
 #include "bytestream.h"
 
+/**
+ * Payload shared by refcounted packets.
+ * It takes over the data and the destructor of the packet it was created
+ * from, and calls that destructor when the last reference is gone.
+ */
+typedef struct PacketBuffer {
+    volatile int refcount;
+    uint8_t *data;
+    int      size;
+    void   (*destruct)(AVPacket *);
+    void    *priv;
+} PacketBuffer;
+
+#if !HAVE_ATOMICS_GCC && HAVE_PTHREADS
+static pthread_mutex_t refcount_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static int buffer_refcount_add(PacketBuffer *buf, int add)
+{
+#if HAVE_ATOMICS_GCC
+    return __sync_add_and_fetch(&buf->refcount, add);
+#elif HAVE_PTHREADS
+    int ret;
+    pthread_mutex_lock(&refcount_mutex);
+    ret = buf->refcount += add;
+    pthread_mutex_unlock(&refcount_mutex);
+    return ret;
+#else
+    return buf->refcount += add;
+#endif
+}
+
+static void free_side_data(AVPacket *pkt)
+{
+    int i;
+
+    for (i = 0; i < pkt->side_data_elems; i++)
+        av_free(pkt->side_data[i].data);
+    av_freep(&pkt->side_data);
+    pkt->side_data_elems = 0;
+}
+
+static void destruct_packet_ref(AVPacket *pkt)
+{
+    PacketBuffer *buf = pkt->priv;
+
+    free_side_data(pkt);
+    pkt->data = NULL; pkt->size = 0;
+    pkt->destruct = NULL;
+    pkt->priv     = NULL;
+
+    if (!buffer_refcount_add(buf, -1)) {
+        AVPacket owner;
+
+        av_init_packet(&owner);
+        owner.data     = buf->data;
+        owner.size     = buf->size;
+        owner.destruct = buf->destruct;
+        owner.priv     = buf->priv;
+        if (owner.destruct)
+            owner.destruct(&owner);
+        av_free(buf);
+    }
+}
+
+int ff_packet_is_refcounted(const AVPacket *pkt)
+{
+    return pkt->destruct == destruct_packet_ref;
+}
+
+/**
+ * Give a refcounted packet a private copy of its payload.
+ * The side data is left untouched.
+ */
+static int packet_unshare(AVPacket *pkt)
+{
+    AVPacket tmp = *pkt;
+    uint8_t *data;
+
+    data = av_malloc(pkt->size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!data)
+        return AVERROR(ENOMEM);
+    memcpy(data, pkt->data, pkt->size);
+    memset(data + pkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+    tmp.side_data       = NULL;
+    tmp.side_data_elems = 0;
+    destruct_packet_ref(&tmp);
+
+    pkt->data     = data;
+    pkt->destruct = av_destruct_packet;
+    pkt->priv     = NULL;
+    return 0;
+}
+
 void av_destruct_packet_nofree(AVPacket *pkt)
 {
     pkt->data = NULL; pkt->size = 0;
@@ -32,15 +133,10 @@ void av_destruct_packet_nofree(AVPacket *pkt)
 
 void av_destruct_packet(AVPacket *pkt)
 {
-    int i;
-
     av_free(pkt->data);
     pkt->data = NULL; pkt->size = 0;
 
-    for (i = 0; i < pkt->side_data_elems; i++)
-        av_free(pkt->side_data[i].data);
-    av_freep(&pkt->side_data);
-    pkt->side_data_elems = 0;
+    free_side_data(pkt);
 }
 
 void av_init_packet(AVPacket *pkt)
@@ -79,6 +175,12 @@ int av_new_packet(AVPacket *pkt, int size)
 void av_shrink_packet(AVPacket *pkt, int size)
 {
     if (pkt->size <= size) return;
+    /* the padding must not be written into a payload other packets use */
+    if (ff_packet_is_refcounted(pkt) && ((PacketBuffer *)pkt->priv)->refcount > 1 &&
+        packet_unshare(pkt) < 0) {
+        pkt->size = size;
+        return;
+    }
     pkt->size = size;
     memset(pkt->data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
 }
@@ -91,6 +193,8 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
         return av_new_packet(pkt, grow_by);
     if ((unsigned)grow_by > INT_MAX - (pkt->size + FF_INPUT_BUFFER_PADDING_SIZE))
         return -1;
+    if (ff_packet_is_refcounted(pkt) && packet_unshare(pkt) < 0)
+        return AVERROR(ENOMEM);
     new_ptr = av_realloc(pkt->data, pkt->size + grow_by + FF_INPUT_BUFFER_PADDING_SIZE);
     if (!new_ptr)
         return AVERROR(ENOMEM);
@@ -148,6 +252,64 @@ failed_alloc:
     return AVERROR(ENOMEM);
 }
 
+int av_packet_make_refcounted(AVPacket *pkt)
+{
+    PacketBuffer *buf;
+    int ret;
+
+    if (ff_packet_is_refcounted(pkt))
+        return 0;
+    if ((ret = av_dup_packet(pkt)) < 0)
+        return ret;
+
+    buf = av_malloc(sizeof(*buf));
+    if (!buf)
+        return AVERROR(ENOMEM);
+    buf->refcount = 1;
+    buf->data     = pkt->data;
+    buf->size     = pkt->size;
+    buf->destruct = pkt->destruct;
+    buf->priv     = pkt->priv;
+
+    pkt->destruct = destruct_packet_ref;
+    pkt->priv     = buf;
+    return 0;
+}
+
+int av_packet_ref(AVPacket *dst, const AVPacket *src)
+{
+    int i;
+
+    *dst = *src;
+    if (!ff_packet_is_refcounted(src)) {
+        int ret;
+        dst->destruct = NULL;
+        if ((ret = av_packet_make_refcounted(dst)) < 0)
+            av_free_packet(dst);
+        return ret;
+    }
+
+    buffer_refcount_add(src->priv, 1);
+    dst->side_data       = NULL;
+    dst->side_data_elems = 0;
+    if (src->side_data_elems) {
+        DUP_DATA(dst->side_data, src->side_data,
+                 src->side_data_elems * sizeof(*src->side_data), 0);
+        memset(dst->side_data, 0, src->side_data_elems * sizeof(*src->side_data));
+        dst->side_data_elems = src->side_data_elems;
+        for (i = 0; i < src->side_data_elems; i++) {
+            DUP_DATA(dst->side_data[i].data, src->side_data[i].data,
+                     src->side_data[i].size, 1);
+            dst->side_data[i].size = src->side_data[i].size;
+            dst->side_data[i].type = src->side_data[i].type;
+        }
+    }
+    return 0;
+failed_alloc:
+    destruct_packet_ref(dst);
+    return AVERROR(ENOMEM);
+}
+
 void av_free_packet(AVPacket *pkt)
 {
     if (pkt) {
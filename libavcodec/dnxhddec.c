@@ -105,6 +105,7 @@ static int dnxhd_init_vlc(DNXHDContext *ctx, int cid)
                  ctx->cid_table->run_codes, 2, 2, 0);
 
         ctx->cid = cid;
+        ctx->last_qscale = -1; // scale tables depend on the weights of the cid
     }
     return 0;
 }
@@ -23,9 +23,12 @@
 #include "libavutil/imgutils.h"
 #include "bytestream.h"
 #include "avcodec.h"
+#include "dpxdsp.h"
+#include "thread.h"
 
 typedef struct DPXContext {
     AVFrame picture;
+    DPXDSPContext dsp;
 } DPXContext;
 
 
@@ -41,12 +44,16 @@ static unsigned int read32(const uint8_t **ptr, int is_big)
     return temp;
 }
 
-static inline unsigned make_16bit(unsigned value)
+static unsigned int read16(const uint8_t **ptr, int is_big)
 {
-    // mask away invalid bits
-    value &= 0xFFC0;
-    // correctly expand to 16 bits
-    return value + (value >> 10);
+    unsigned int temp;
+    if (is_big) {
+        temp = AV_RB16(*ptr);
+    } else {
+        temp = AV_RL16(*ptr);
+    }
+    *ptr += 2;
+    return temp;
 }
 
 static int decode_frame(AVCodecContext *avctx,
@@ -65,8 +72,7 @@ static int decode_frame(AVCodecContext *avctx,
     int magic_num, offset, endian;
     int x, y;
     int w, h, stride, bits_per_color, descriptor, elements, target_packet_size, source_packet_size;
-
-    unsigned int rgbBuffer;
+    int packing;
 
     if (avpkt->size <= 1634) {
         av_log(avctx, AV_LOG_ERROR, "Packet too small for DPX header\n");
@@ -105,8 +111,10 @@ static int decode_frame(AVCodecContext *avctx,
     buf += 3;
     avctx->bits_per_raw_sample =
     bits_per_color = buf[0];
+    buf++;
+    packing = read16(&buf, endian);
 
-    buf += 825;
+    buf += 822;
     avctx->sample_aspect_ratio.num = read32(&buf, endian);
     avctx->sample_aspect_ratio.den = read32(&buf, endian);
 
@@ -153,12 +161,12 @@ static int decode_frame(AVCodecContext *avctx,
     }
 
     if (s->picture.data[0])
-        avctx->release_buffer(avctx, &s->picture);
+        ff_thread_release_buffer(avctx, &s->picture);
     if (av_image_check_size(w, h, 0, avctx))
         return -1;
     if (w != avctx->width || h != avctx->height)
         avcodec_set_dimensions(avctx, w, h);
-    if (avctx->get_buffer(avctx, p) < 0) {
+    if (ff_thread_get_buffer(avctx, p) < 0) {
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return -1;
     }
@@ -175,16 +183,11 @@ static int decode_frame(AVCodecContext *avctx,
     }
     switch (bits_per_color) {
         case 10:
+            // packing 2 is method B, anything else is taken as method A
             for (x = 0; x < avctx->height; x++) {
-               uint16_t *dst = (uint16_t*)ptr;
-               for (y = 0; y < avctx->width; y++) {
-                   rgbBuffer = read32(&buf, endian);
-                   // Read out the 10-bit colors and convert to 16-bit
-                   *dst++ = make_16bit(rgbBuffer >> 16);
-                   *dst++ = make_16bit(rgbBuffer >>  6);
-                   *dst++ = make_16bit(rgbBuffer <<  4);
-               }
-               ptr += stride;
+                s->dsp.unpack_rgb10[endian][packing == 2]((uint16_t*)ptr, buf, avctx->width);
+                buf += 4 * avctx->width;
+                ptr += stride;
             }
             break;
         case 8:
@@ -221,6 +224,7 @@ static av_cold int decode_init(AVCodecContext *avctx)
     DPXContext *s = avctx->priv_data;
     avcodec_get_frame_defaults(&s->picture);
     avctx->coded_frame = &s->picture;
+    ff_dpx_dsp_init(&s->dsp);
     return 0;
 }
 
@@ -228,7 +232,7 @@ static av_cold int decode_end(AVCodecContext *avctx)
 {
     DPXContext *s = avctx->priv_data;
     if (s->picture.data[0])
-        avctx->release_buffer(avctx, &s->picture);
+        ff_thread_release_buffer(avctx, &s->picture);
 
     return 0;
 }
@@ -242,7 +246,7 @@ AVCodec ff_dpx_decoder = {
     NULL,
     decode_end,
     decode_frame,
-    0,
+    CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS,
     NULL,
     .long_name = NULL_IF_CONFIG_SMALL("DPX image"),
 };
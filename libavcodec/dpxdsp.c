@@ -0,0 +1,44 @@
+/*
+ * DPX DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "dpxdsp.h"
+
+#define UNPACK_RGB10(name, big_endian, method_b)                            \
+static void unpack_rgb10_ ## name ## _c(uint16_t *dst, const uint8_t *src, \
+                                        int width)                          \
+{                                                                           \
+    dpx_unpack_rgb10(dst, src, width, big_endian, method_b);                \
+}
+
+UNPACK_RGB10(le_a, 0, 0)
+UNPACK_RGB10(le_b, 0, 1)
+UNPACK_RGB10(be_a, 1, 0)
+UNPACK_RGB10(be_b, 1, 1)
+
+void ff_dpx_dsp_init(DPXDSPContext *c)
+{
+    c->unpack_rgb10[0][0] = unpack_rgb10_le_a_c;
+    c->unpack_rgb10[0][1] = unpack_rgb10_le_b_c;
+    c->unpack_rgb10[1][0] = unpack_rgb10_be_a_c;
+    c->unpack_rgb10[1][1] = unpack_rgb10_be_b_c;
+
+    if (HAVE_MMX) ff_dpx_dsp_init_x86(c);
+}
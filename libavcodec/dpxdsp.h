@@ -0,0 +1,68 @@
+/*
+ * DPX DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_DPXDSP_H
+#define AVCODEC_DPXDSP_H
+
+#include <stdint.h>
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+
+typedef struct DPXDSPContext {
+    /**
+     * Unpack 10-bit RGB filled into 32-bit words to native endian RGB48.
+     * Indexed by [big endian][method B]: method A leaves the 2 padding
+     * bits at the bottom of each word, method B at the top.
+     * @param dst  output, 3 * width samples
+     * @param src  input, 4 * width bytes, no alignment constraint
+     */
+    void (*unpack_rgb10[2][2])(uint16_t *dst, const uint8_t *src, int width);
+} DPXDSPContext;
+
+static inline unsigned dpx_make_16bit(unsigned value)
+{
+    // mask away invalid bits
+    value &= 0xFFC0;
+    // correctly expand to 16 bits
+    return value + (value >> 10);
+}
+
+static av_always_inline void dpx_unpack_rgb10(uint16_t *dst, const uint8_t *src,
+                                              int width, int big_endian, int method_b)
+{
+    int x;
+
+    for (x = 0; x < width; x++) {
+        unsigned rgb = big_endian ? AV_RB32(src) : AV_RL32(src);
+
+        if (method_b)
+            rgb <<= 2;
+        // Read out the 10-bit colors and convert to 16-bit
+        *dst++ = dpx_make_16bit(rgb >> 16);
+        *dst++ = dpx_make_16bit(rgb >>  6);
+        *dst++ = dpx_make_16bit(rgb <<  4);
+        src += 4;
+    }
+}
+
+void ff_dpx_dsp_init(DPXDSPContext *c);
+void ff_dpx_dsp_init_x86(DPXDSPContext *c);
+
+#endif /* AVCODEC_DPXDSP_H */
@@ -55,6 +55,8 @@ void ff_fdct_mmx(DCTELEM *block);
 void ff_fdct_mmx2(DCTELEM *block);
 void ff_fdct_sse2(DCTELEM *block);
 void ff_fdct_10_sse2(DCTELEM *block);
+void ff_jpeg_fdct_islow_avx2(DCTELEM *block);
+void ff_fdct248_islow_avx2(DCTELEM *block);
 
 #define H264_IDCT(depth) \
 void ff_h264_idct8_add_ ## depth ## _c(uint8_t *dst, DCTELEM *block, int stride);\
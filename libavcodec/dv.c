@@ -42,7 +42,6 @@
 #include "avcodec.h"
 #include "get_bits.h"
 #include "put_bits.h"
-#include "simple_idct.h"
 #include "dvdata.h"
 
 //#undef NDEBUG
@@ -66,6 +65,7 @@ static av_cold int dvvideo_init(AVCodecContext *avctx)
     /* Generic DSP setup */
     dsputil_init(&s->dsp, avctx);
     ff_set_cmp(&s->dsp, s->dsp.ildct_cmp, avctx->ildct_cmp);
+    ff_dv_dsp_init(&s->dvdsp);
 
     /* 88DCT setup */
     s->fdct[0]     = s->dsp.fdct;
@@ -75,7 +75,7 @@ static av_cold int dvvideo_init(AVCodecContext *avctx)
 
     /* 248DCT setup */
     s->fdct[1]     = s->dsp.fdct248;
-    s->idct_put[1] = ff_simple_idct248_put;  // FIXME: need to add it to DSP
+    s->idct_put[1] = s->dvdsp.idct248_put;
     if (avctx->lowres){
         for (i = 0; i < 64; i++){
             int j = ff_zigzag248_direct[i];
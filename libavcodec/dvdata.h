@@ -30,6 +30,7 @@
 #include "libavutil/rational.h"
 #include "avcodec.h"
 #include "dsputil.h"
+#include "dvdsp.h"
 #include "get_bits.h"
 
 typedef struct DVwork_chunk {
@@ -76,6 +77,7 @@ typedef struct DVVideoContext {
     uint8_t  dv_zigzag[2][64];
 
     DSPContext dsp;
+    DVDSPContext dvdsp;
     void (*fdct[2])(DCTELEM *block);
     void (*idct_put[2])(uint8_t *dest, int line_size, DCTELEM *block);
 } DVVideoContext;
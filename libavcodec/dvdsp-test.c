@@ -0,0 +1,401 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DV DSP test: checks that the optimized islow forward DCTs and the DV
+ * DSP functions give the same result as the C versions, and with -b
+ * reports their speed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "dsputil.h"
+#include "dvdsp.h"
+
+#undef printf
+#undef fprintf
+
+#define NB_BLOCKS 1024
+
+static const struct {
+    const char *name;
+    void (*ref)(DCTELEM *block);
+    void (*func)(DCTELEM *block);
+    int cpu_flag;
+} fdcts[] = {
+#if HAVE_AVX2
+    { "fdct islow AVX2",    ff_jpeg_fdct_islow_8, ff_jpeg_fdct_islow_avx2, AV_CPU_FLAG_AVX2 },
+    { "fdct248 islow AVX2", ff_fdct248_islow_8,   ff_fdct248_islow_avx2,   AV_CPU_FLAG_AVX2 },
+#endif
+    { NULL }
+};
+
+static volatile int sink;
+
+static int64_t gettime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void print_speed(const char *name, const char *impl, int64_t nb, int64_t ti)
+{
+    printf("%-18s %-4s: %7.1f kblocks/s\n", name, impl, nb * 1000.0 / ti);
+}
+
+/* intra blocks of pixels and inter blocks of differences */
+static void init_pixels(DCTELEM (*src)[64], AVLFG *lfg)
+{
+    int b, i;
+
+    for (b = 0; b < NB_BLOCKS; b++) {
+        int range = 1 << (1 + av_lfg_get(lfg) % 8);
+        int inter = b & 1;
+
+        for (i = 0; i < 64; i++) {
+            if (inter)
+                src[b][i] = (int)(av_lfg_get(lfg) % (2 * range)) - range;
+            else
+                src[b][i] = av_lfg_get(lfg) % range;
+        }
+        if (b < 4)
+            for (i = 0; i < 64; i++)
+                src[b][i] = b & 2 ? (inter ? -255 : 0) : 255;
+    }
+}
+
+static int check_fdct(DCTELEM (*src)[64], int bench)
+{
+    DECLARE_ALIGNED(16, DCTELEM, ref)[64];
+    DECLARE_ALIGNED(16, DCTELEM, block)[64];
+    int f, b, ret = 0;
+
+    for (f = 0; fdcts[f].name; f++) {
+        int64_t ti, nb = 0;
+
+        if (!(av_get_cpu_flags() & fdcts[f].cpu_flag))
+            continue;
+        for (b = 0; b < NB_BLOCKS; b++) {
+            memcpy(ref,   src[b], sizeof(ref));
+            memcpy(block, src[b], sizeof(block));
+            fdcts[f].ref(ref);
+            fdcts[f].func(block);
+            if (memcmp(block, ref, sizeof(block))) {
+                fprintf(stderr, "%s: mismatch in block %d\n", fdcts[f].name, b);
+                ret = 1;
+                break;
+            }
+        }
+        if (!bench || ret)
+            continue;
+        ti = gettime();
+        do {
+            for (b = 0; b < NB_BLOCKS; b++) {
+                memcpy(ref, src[b], sizeof(ref));
+                fdcts[f].ref(ref);
+            }
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed(fdcts[f].name, "C", nb, gettime() - ti);
+        ti = gettime();
+        nb = 0;
+        do {
+            for (b = 0; b < NB_BLOCKS; b++) {
+                memcpy(block, src[b], sizeof(block));
+                fdcts[f].func(block);
+            }
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed(fdcts[f].name, "opt", nb, gettime() - ti);
+    }
+    return ret;
+}
+
+/* coefficients of real blocks, scaled like the decoder dequantizes them,
+ * and of blocks with some of them dropped so that rows with only a DC
+ * coefficient happen */
+static void init_coefs(DCTELEM (*coefs)[64], DCTELEM (*src)[64], AVLFG *lfg)
+{
+    int b, i;
+
+    for (b = 0; b < NB_BLOCKS; b++) {
+        int keep = av_lfg_get(lfg) % 64;
+
+        memcpy(coefs[b], src[b & ~1], sizeof(coefs[b]));
+        ff_fdct248_islow_8(coefs[b]);
+        for (i = 0; i < 64; i++)
+            coefs[b][i] = av_lfg_get(lfg) % 64 < keep || !(i & 7) || !(b & 1) ? coefs[b][i] / 8 : 0;
+    }
+}
+
+static int check_idct248(const DVDSPContext *ref, const DVDSPContext *opt,
+                         DCTELEM (*coefs)[64], int bench)
+{
+    DECLARE_ALIGNED(16, DCTELEM, block)[64];
+    uint8_t ref_pix[16 * 8], pix[16 * 8];
+    int64_t ti, nb = 0;
+    int b, ret = 0;
+
+    for (b = 0; b < NB_BLOCKS; b++) {
+        memset(ref_pix, 0x5a, sizeof(ref_pix));
+        memset(pix,     0x5a, sizeof(pix));
+        memcpy(block, coefs[b], sizeof(block));
+        ref->idct248_put(ref_pix, 16, block);
+        memcpy(block, coefs[b], sizeof(block));
+        opt->idct248_put(pix, 16, block);
+        if (memcmp(pix, ref_pix, sizeof(pix))) {
+            fprintf(stderr, "idct248_put: mismatch in block %d\n", b);
+            return 1;
+        }
+    }
+    if (!bench)
+        return ret;
+    ti = gettime();
+    do {
+        for (b = 0; b < NB_BLOCKS; b++) {
+            memcpy(block, coefs[b], sizeof(block));
+            ref->idct248_put(ref_pix, 16, block);
+        }
+        nb += NB_BLOCKS;
+    } while (gettime() - ti < 200000);
+    print_speed("idct248_put", "C", nb, gettime() - ti);
+    ti = gettime();
+    nb = 0;
+    do {
+        for (b = 0; b < NB_BLOCKS; b++) {
+            memcpy(block, coefs[b], sizeof(block));
+            opt->idct248_put(pix, 16, block);
+        }
+        nb += NB_BLOCKS;
+    } while (gettime() - ti < 200000);
+    print_speed("idct248_put", "opt", nb, gettime() - ti);
+    return ret;
+}
+
+/* the DV25/50 and the DV100 weighing */
+static const struct {
+    const char *name;
+    int max_weight, max_level, bias, shift, threshold;
+} weighs[] = {
+    { "weigh SD",  1 << 18, 8000, 1 << 21,        22, 15 },
+    { "weigh HD",  1 << 16, 16320, 4096 + (1 << 17), 18, -1 },
+};
+
+static int check_weigh(const DVDSPContext *ref, const DVDSPContext *opt,
+                       DCTELEM (*coefs)[64], int bench, AVLFG *lfg)
+{
+    uint8_t zigzag[64];
+    int weight[64];
+    int w, i, b, ret = 0;
+
+    for (i = 0; i < 64; i++)
+        zigzag[i] = i;
+    for (i = 63; i > 0; i--)
+        FFSWAP(uint8_t, zigzag[i], zigzag[av_lfg_get(lfg) % (i + 1)]);
+
+    for (w = 0; w < FF_ARRAY_ELEMS(weighs); w++) {
+        DECLARE_ALIGNED(16, DCTELEM, ref_dst)[64];
+        DECLARE_ALIGNED(16, DCTELEM, dst)[64];
+        uint8_t ref_sign[64], sign[64];
+        int64_t ti, nb = 0;
+
+        for (i = 0; i < 64; i++)
+            weight[i] = 1 + av_lfg_get(lfg) % weighs[w].max_weight;
+        for (b = 0; b < NB_BLOCKS; b++) {
+            int ref_max, max;
+            uint64_t ref_mask, mask;
+
+            for (i = 0; i < 64; i++)
+                coefs[b][i] = av_clip(coefs[b][i], -weighs[w].max_level, weighs[w].max_level);
+            ref_mask = ref->weigh(ref_dst, ref_sign, coefs[b], zigzag, weight,
+                                  weighs[w].bias, weighs[w].shift, weighs[w].threshold, &ref_max);
+            mask = opt->weigh(dst, sign, coefs[b], zigzag, weight,
+                              weighs[w].bias, weighs[w].shift, weighs[w].threshold, &max);
+            if (mask != ref_mask || max != ref_max ||
+                memcmp(dst, ref_dst, sizeof(dst)) || memcmp(sign, ref_sign, sizeof(sign))) {
+                fprintf(stderr, "%s: mismatch in block %d\n", weighs[w].name, b);
+                ret = 1;
+                break;
+            }
+        }
+        if (!bench || ret)
+            continue;
+        ti = gettime();
+        do {
+            for (b = 0; b < NB_BLOCKS; b++)
+                sink = ref->weigh(ref_dst, ref_sign, coefs[b], zigzag, weight, weighs[w].bias,
+                                  weighs[w].shift, weighs[w].threshold, &i);
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed(weighs[w].name, "C", nb, gettime() - ti);
+        ti = gettime();
+        nb = 0;
+        do {
+            for (b = 0; b < NB_BLOCKS; b++)
+                sink = opt->weigh(dst, sign, coefs[b], zigzag, weight, weighs[w].bias,
+                                  weighs[w].shift, weighs[w].threshold, &i);
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed(weighs[w].name, "opt", nb, gettime() - ti);
+    }
+    return ret;
+}
+
+static int check_quantize_hd(const DVDSPContext *ref, const DVDSPContext *opt,
+                             int bench, AVLFG *lfg)
+{
+    static const int qsinvs[] = { 65536, 32768, 21845, 13107, 8192, 3641, 2341, 1260 };
+    DCTELEM (*save)[64] = av_malloc(NB_BLOCKS * sizeof(*save));
+    DECLARE_ALIGNED(16, DCTELEM, ref_dst)[64];
+    DECLARE_ALIGNED(16, DCTELEM, dst)[64];
+    int params[NB_BLOCKS][2];
+    int64_t ti, nb = 0;
+    int b, i, ret = 0;
+
+    for (b = 0; b < NB_BLOCKS; b++) {
+        int range = 1 << (av_lfg_get(lfg) % 13);
+
+        for (i = 0; i < 64; i++)
+            save[b][i] = av_lfg_get(lfg) % range;
+        params[b][0] = qsinvs[av_lfg_get(lfg) % FF_ARRAY_ELEMS(qsinvs)];
+        params[b][1] = av_lfg_get(lfg) % 4;
+    }
+    for (b = 0; b < NB_BLOCKS; b++) {
+        uint64_t ref_mask, mask;
+
+        ref_dst[0] = dst[0] = -b;
+        ref_mask = ref->quantize_hd(ref_dst, save[b], params[b][0], params[b][1]);
+        mask     = opt->quantize_hd(dst,     save[b], params[b][0], params[b][1]);
+        for (i = 1; i < 64; i++)
+            if (!(ref_mask >> i & 1))
+                ref_dst[i] = dst[i] = 0;
+        if (mask != ref_mask || memcmp(dst, ref_dst, sizeof(dst))) {
+            fprintf(stderr, "quantize_hd: mismatch in block %d\n", b);
+            ret = 1;
+            break;
+        }
+    }
+    if (bench && !ret) {
+        ti = gettime();
+        do {
+            for (b = 0; b < NB_BLOCKS; b++)
+                sink = ref->quantize_hd(ref_dst, save[b], params[b][0], params[b][1]);
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed("quantize_hd", "C", nb, gettime() - ti);
+        ti = gettime();
+        nb = 0;
+        do {
+            for (b = 0; b < NB_BLOCKS; b++)
+                sink = opt->quantize_hd(dst, save[b], params[b][0], params[b][1]);
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed("quantize_hd", "opt", nb, gettime() - ti);
+    }
+    av_free(save);
+    return ret;
+}
+
+/* the interlaced DCT decision of the encoder, on rows of frame blocks */
+static int check_vsad(const DSPContext *ref, const DSPContext *opt,
+                      int bench, AVLFG *lfg)
+{
+    uint8_t *pix = av_malloc(NB_BLOCKS * 64 * 2);
+    int64_t ti, nb = 0;
+    int b, ret = 0;
+
+    for (b = 0; b < NB_BLOCKS * 64 * 2; b++)
+        pix[b] = b < 2 * 16 * 16 ? (b >> 4 & 1) * 255 : av_lfg_get(lfg);
+    for (b = 0; b < NB_BLOCKS; b++) {
+        uint8_t *data = pix + b * 64 * 2;
+        if (ref->vsad[5](NULL, data, NULL, 16, 8) != opt->vsad[5](NULL, data, NULL, 16, 8) ||
+            ref->vsad[5](NULL, data, NULL, 32, 4) != opt->vsad[5](NULL, data, NULL, 32, 4)) {
+            fprintf(stderr, "vsad_intra8: mismatch in block %d\n", b);
+            ret = 1;
+            break;
+        }
+    }
+    if (bench && !ret) {
+        ti = gettime();
+        do {
+            for (b = 0; b < NB_BLOCKS; b++)
+                sink = ref->vsad[5](NULL, pix + b * 64 * 2, NULL, 16, 8);
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed("vsad_intra8", "C", nb, gettime() - ti);
+        ti = gettime();
+        nb = 0;
+        do {
+            for (b = 0; b < NB_BLOCKS; b++)
+                sink = opt->vsad[5](NULL, pix + b * 64 * 2, NULL, 16, 8);
+            nb += NB_BLOCKS;
+        } while (gettime() - ti < 200000);
+        print_speed("vsad_intra8", "opt", nb, gettime() - ti);
+    }
+    av_free(pix);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    DCTELEM (*src)[64]   = av_malloc(NB_BLOCKS * sizeof(*src));
+    DCTELEM (*coefs)[64] = av_malloc(NB_BLOCKS * sizeof(*coefs));
+    int bench = argc > 1 && !strcmp(argv[1], "-b");
+    int cpu_flags = av_get_cpu_flags();
+    AVCodecContext *avctx = avcodec_alloc_context3(NULL);
+    DVDSPContext ref, opt;
+    DSPContext dsp_ref, dsp_opt;
+    int ret, r;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 1);
+    dsputil_static_init(); /* crop table of ff_simple_idct248_put() */
+    av_force_cpu_flags(0);
+    ff_dv_dsp_init(&ref);
+    dsputil_init(&dsp_ref, avctx);
+    av_force_cpu_flags(cpu_flags);
+    ff_dv_dsp_init(&opt);
+    dsputil_init(&dsp_opt, avctx);
+
+    init_pixels(src, &lfg);
+    ret = check_fdct(src, bench);
+    printf("islow forward DCTs: %s\n", ret ? "failed" : "ok");
+    init_coefs(coefs, src, &lfg);
+    ret |= r = check_idct248(&ref, &opt, coefs, bench);
+    printf("2-4-8 inverse DCT: %s\n", r ? "failed" : "ok");
+    ret |= r = check_weigh(&ref, &opt, coefs, bench, &lfg);
+    printf("weighing: %s\n", r ? "failed" : "ok");
+    ret |= r = check_quantize_hd(&ref, &opt, bench, &lfg);
+    printf("DV100 quantization: %s\n", r ? "failed" : "ok");
+    ret |= r = check_vsad(&dsp_ref, &dsp_opt, bench, &lfg);
+    printf("interlaced DCT decision: %s\n", r ? "failed" : "ok");
+
+    av_free(src);
+    av_free(coefs);
+    av_free(avctx);
+    return ret;
+}
@@ -0,0 +1,72 @@
+/*
+ * DV DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "simple_idct.h"
+#include "dvdsp.h"
+
+static uint64_t weigh_c(DCTELEM *dst, uint8_t *sign, const DCTELEM *blk,
+                        const uint8_t *zigzag, const int *weight,
+                        int bias, int shift, int threshold, int *max)
+{
+    uint64_t mask = 0;
+    int i, m = 0;
+
+    for (i = 0; i < 64; i++) {
+        int level = blk[zigzag[i]];
+
+        sign[i] = (level >> 31) & 1;
+        level   = FFABS(level);
+        dst[i]  = (level * weight[i] + bias) >> shift;
+        if (i && level > threshold) {
+            mask |= 1ULL << i;
+            m = FFMAX(m, dst[i]);
+        }
+    }
+    *max = m;
+    return mask;
+}
+
+static uint64_t quantize_hd_c(DCTELEM *dst, const DCTELEM *src, int qsinv, int cno)
+{
+    uint64_t mask = 0;
+    int i;
+
+    for (i = 1; i < 64; i++) {
+        int ac = ((src[i] * qsinv + 1024 + (1 << 15)) >> 16) >> cno;
+
+        if (ac) {
+            mask |= 1ULL << i;
+            ac = FFMIN(ac, 255);
+        }
+        dst[i] = ac;
+    }
+    return mask;
+}
+
+void ff_dv_dsp_init(DVDSPContext *c)
+{
+    c->idct248_put = ff_simple_idct248_put;
+    c->weigh       = weigh_c;
+    c->quantize_hd = quantize_hd_c;
+
+    if (HAVE_MMX) ff_dv_dsp_init_x86(c);
+}
@@ -0,0 +1,60 @@
+/*
+ * DV DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_DVDSP_H
+#define AVCODEC_DVDSP_H
+
+#include <stdint.h>
+#include "dsputil.h"
+
+typedef struct DVDSPContext {
+    /**
+     * 2-4-8 inverse DCT, bitexact with ff_simple_idct248_put().
+     * @param block input, clobbered
+     */
+    void (*idct248_put)(uint8_t *dest, int line_size, DCTELEM *block);
+
+    /**
+     * Weigh the 64 coefficients of a block in zigzag order:
+     * dst[i] = (|blk[zigzag[i]]| * weight[i] + bias) >> shift,
+     * sign[i] = 1 if blk[zigzag[i]] is negative, 0 otherwise.
+     * The weighted values must fit in 15 bits.
+     * @param max largest dst[i] of the AC coefficients set in the
+     *            returned mask, 0 if there are none
+     * @return mask with bit i set for the AC coefficients whose absolute
+     *         value is above threshold
+     */
+    uint64_t (*weigh)(DCTELEM *dst, uint8_t *sign, const DCTELEM *blk,
+                      const uint8_t *zigzag, const int *weight,
+                      int bias, int shift, int threshold, int *max);
+
+    /**
+     * DV100 quantization of the AC coefficients, dst[0] is left untouched:
+     * dst[i] = FFMIN((src[i] * qsinv + 1024 + 32768) >> 16 >> cno, 255).
+     * @param src nonnegative weighted coefficients
+     * @return mask with bit i set for the nonzero dst[i]
+     */
+    uint64_t (*quantize_hd)(DCTELEM *dst, const DCTELEM *src, int qsinv, int cno);
+} DVDSPContext;
+
+void ff_dv_dsp_init(DVDSPContext *c);
+void ff_dv_dsp_init_x86(DVDSPContext *c);
+
+#endif /* AVCODEC_DVDSP_H */
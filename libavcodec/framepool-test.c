@@ -0,0 +1,301 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Frame pool test: decodes a DNxHD stream switching between 1080p and 720p
+ * with frame threads, and with two decoders sharing one pool, and checks
+ * that the pictures match single threaded decoding.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/mem.h"
+#include "avcodec.h"
+
+#undef printf
+#undef fprintf
+
+#define NB_FRAMES 8
+
+/* 1080p frames use cid 1253, 720p frames cid 1252 */
+static const struct {
+    int width, height, bit_rate;
+} sizes[2] = {
+    { 1920, 1080, 36000000 },
+    { 1280,  720, 60000000 },
+};
+
+static const int frame_sizes[NB_FRAMES] = { 0, 1, 1, 0, 1, 0, 0, 1 };
+
+static AVPacket packets[NB_FRAMES];
+
+typedef struct FrameSum {
+    int width, height;
+    unsigned long sum;
+} FrameSum;
+
+static void fill_picture(AVFrame *pic, int w, int h, int n)
+{
+    int x, y;
+
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w; x++)
+            pic->data[0][y * pic->linesize[0] + x] = 16 + (x * 3 + y * 5 + n * 17) % 220;
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w / 2; x++) {
+            pic->data[1][y * pic->linesize[1] + x] = 16 + (x * 7 + n * 29) % 224;
+            pic->data[2][y * pic->linesize[2] + x] = 16 + (y * 2 + x + n * 41) % 224;
+        }
+}
+
+static int encode_stream(void)
+{
+    AVCodec *codec = avcodec_find_encoder(CODEC_ID_DNXHD);
+    AVFrame *pic = avcodec_alloc_frame();
+    int n, ret = -1;
+
+    if (!codec || !pic)
+        goto end;
+    for (n = 0; n < NB_FRAMES; n++) {
+        const int s = frame_sizes[n];
+        AVCodecContext *avctx = avcodec_alloc_context3(codec);
+        int size;
+
+        if (!avctx)
+            goto end;
+        avctx->width     = sizes[s].width;
+        avctx->height    = sizes[s].height;
+        avctx->bit_rate  = sizes[s].bit_rate;
+        avctx->pix_fmt   = PIX_FMT_YUV422P;
+        avctx->time_base = (AVRational){ 1, 25 };
+        avctx->flags    |= CODEC_FLAG_BITEXACT;
+        if (avcodec_open2(avctx, codec, NULL) < 0 ||
+            avpicture_alloc((AVPicture *)pic, PIX_FMT_YUV422P,
+                            avctx->width, avctx->height) < 0) {
+            av_free(avctx);
+            goto end;
+        }
+        fill_picture(pic, avctx->width, avctx->height, n);
+
+        av_new_packet(&packets[n], avctx->width * avctx->height * 4);
+        size = avcodec_encode_video(avctx, packets[n].data, packets[n].size, pic);
+        avpicture_free((AVPicture *)pic);
+        avcodec_close(avctx);
+        av_free(avctx);
+        if (size <= 0)
+            goto end;
+        packets[n].size   = size;
+        packets[n].flags |= AV_PKT_FLAG_KEY;
+    }
+    ret = 0;
+end:
+    av_free(pic);
+    return ret;
+}
+
+static AVCodecContext *open_decoder(int threads, AVFramePool *pool)
+{
+    AVCodec *codec = avcodec_find_decoder(CODEC_ID_DNXHD);
+    AVCodecContext *avctx = avcodec_alloc_context3(codec);
+
+    if (!avctx)
+        return NULL;
+    avctx->thread_count = threads;
+    avctx->thread_type  = FF_THREAD_FRAME;
+    avctx->frame_pool   = pool;
+    if (avcodec_open2(avctx, codec, NULL) < 0) {
+        av_free(avctx);
+        return NULL;
+    }
+    return avctx;
+}
+
+static void close_decoder(AVCodecContext *avctx)
+{
+    avcodec_close(avctx);
+    av_free(avctx);
+}
+
+static void sum_frame(FrameSum *sum, AVCodecContext *avctx, AVFrame *pic)
+{
+    int p, y;
+
+    sum->width  = avctx->width;
+    sum->height = avctx->height;
+    sum->sum    = 1;
+    for (p = 0; p < 3; p++) {
+        int w = p ? avctx->width / 2 : avctx->width;
+        for (y = 0; y < avctx->height; y++)
+            sum->sum = av_adler32_update(sum->sum, pic->data[p] + y * pic->linesize[p], w);
+    }
+}
+
+/**
+ * Feed one packet, or flush with NULL.
+ * @return 1 if a picture was output, 0 if not, < 0 on error
+ */
+static int decode(AVCodecContext *avctx, AVPacket *pkt, FrameSum *sum)
+{
+    AVFrame pic;
+    AVPacket flush;
+    int got_picture = 0;
+
+    if (!pkt) {
+        av_init_packet(&flush);
+        flush.data = NULL;
+        flush.size = 0;
+        pkt = &flush;
+    }
+    avcodec_get_frame_defaults(&pic);
+    if (avcodec_decode_video2(avctx, &pic, &got_picture, pkt) < 0)
+        return -1;
+    if (got_picture)
+        sum_frame(sum, avctx, &pic);
+    return !!got_picture;
+}
+
+/**
+ * Decode the packets in the order given by step, flushing at the end.
+ * @return the number of pictures output, < 0 on error
+ */
+static int decode_all(AVCodecContext *avctx, FrameSum *sums, int first, int step)
+{
+    int n, i = 0, ret;
+
+    for (n = 0; n < NB_FRAMES; n++) {
+        ret = decode(avctx, &packets[(first + n * step + NB_FRAMES) % NB_FRAMES], &sums[i]);
+        if (ret < 0)
+            return ret;
+        i += ret;
+    }
+    while (i < NB_FRAMES && (ret = decode(avctx, NULL, &sums[i])) > 0)
+        i++;
+    return ret < 0 ? ret : i;
+}
+
+static int compare(const FrameSum *ref, const FrameSum *sums, int first, int step)
+{
+    int n;
+
+    for (n = 0; n < NB_FRAMES; n++) {
+        const FrameSum *r = &ref[(first + n * step + NB_FRAMES) % NB_FRAMES];
+        if (sums[n].width != r->width || sums[n].height != r->height ||
+            sums[n].sum != r->sum) {
+            fprintf(stderr, "picture %d: %dx%d %08lx instead of %dx%d %08lx\n", n,
+                    sums[n].width, sums[n].height, sums[n].sum,
+                    r->width, r->height, r->sum);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int test_frame_threads(const FrameSum *ref)
+{
+    FrameSum sums[NB_FRAMES];
+    AVCodecContext *avctx = open_decoder(4, NULL);
+    int ret = -1;
+
+    if (avctx && decode_all(avctx, sums, 0, 1) == NB_FRAMES)
+        ret = compare(ref, sums, 0, 1);
+    if (avctx)
+        close_decoder(avctx);
+    return ret;
+}
+
+/* one frame threaded decoder reads the stream forward, a single threaded
+ * one backward, alternately, both taking their buffers from one pool */
+static int test_shared_pool(const FrameSum *ref)
+{
+    FrameSum sums[2][NB_FRAMES];
+    AVFramePool *pool = av_frame_pool_alloc(4, 0);
+    AVCodecContext *avctx[2] = { NULL };
+    int out[2] = { 0 }, n, k, ret = -1;
+
+    if (!pool)
+        return -1;
+    avctx[0] = open_decoder(3, pool);
+    avctx[1] = open_decoder(1, pool);
+    /* the contexts hold their own references */
+    av_frame_pool_free(&pool);
+    if (!avctx[0] || !avctx[1])
+        goto end;
+
+    for (n = 0; n < NB_FRAMES; n++) {
+        for (k = 0; k < 2; k++) {
+            AVPacket *pkt = &packets[k ? NB_FRAMES - 1 - n : n];
+            int got = decode(avctx[k], pkt, &sums[k][out[k]]);
+            if (got < 0)
+                goto end;
+            out[k] += got;
+        }
+    }
+    for (k = 0; k < 2; k++) {
+        int got;
+        while (out[k] < NB_FRAMES && (got = decode(avctx[k], NULL, &sums[k][out[k]])) > 0)
+            out[k]++;
+    }
+    if (out[0] == NB_FRAMES && out[1] == NB_FRAMES &&
+        !compare(ref, sums[0], 0, 1) && !compare(ref, sums[1], NB_FRAMES - 1, -1))
+        ret = 0;
+end:
+    for (k = 0; k < 2; k++)
+        if (avctx[k])
+            close_decoder(avctx[k]);
+    return ret;
+}
+
+int main(void)
+{
+    FrameSum ref[NB_FRAMES];
+    AVCodecContext *avctx;
+    int n, ret = 0;
+
+    avcodec_register_all();
+
+    if (encode_stream() < 0) {
+        fprintf(stderr, "encoding failed\n");
+        return 1;
+    }
+
+    avctx = open_decoder(1, NULL);
+    if (!avctx || decode_all(avctx, ref, 0, 1) != NB_FRAMES) {
+        fprintf(stderr, "decoding failed\n");
+        return 1;
+    }
+    close_decoder(avctx);
+
+    if (test_frame_threads(ref) < 0) {
+        printf("resolution change with frame threads: failed\n");
+        ret = 1;
+    } else
+        printf("resolution change with frame threads: ok\n");
+
+    if (test_shared_pool(ref) < 0) {
+        printf("decoders sharing a pool: failed\n");
+        ret = 1;
+    } else
+        printf("decoders sharing a pool: ok\n");
+
+    for (n = 0; n < NB_FRAMES; n++)
+        av_free_packet(&packets[n]);
+    return ret;
+}
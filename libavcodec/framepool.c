@@ -0,0 +1,216 @@
+/*
+ * frame buffer pool
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Pool of frame buffers shared by the default get_buffer() of one or
+ * more codec contexts.
+ *
+ * Buffers are rounded up to a size class, so that a buffer released by a
+ * decoder can be used again for any picture of about the same size, and
+ * kept in a list of unused buffers, most recently released first.
+ */
+
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "avcodec.h"
+#include "internal.h"
+
+struct AVFramePool {
+#if HAVE_PTHREADS
+    pthread_mutex_t mutex;
+#endif
+    int refcount;
+    int max_buffers;            ///< maximum number of unused buffers, 0 for no limit
+    int64_t max_bytes;          ///< maximum size of the unused buffers, 0 for no limit
+    int nb_unused;
+    int64_t unused_bytes;
+    FramePoolBuffer *first;     ///< most recently released unused buffer
+    FramePoolBuffer *last;      ///< least recently released unused buffer
+};
+
+static void pool_lock(AVFramePool *pool)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&pool->mutex);
+#endif
+}
+
+static void pool_unlock(AVFramePool *pool)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+/**
+ * Round size up to a multiple of 1/8 of its power of two, so that
+ * no more than 12.5% is wasted.
+ */
+static int size_class(int size)
+{
+    int step = 1 << FFMAX(av_log2(size) - 3, 12);
+    return FFALIGN(size, step);
+}
+
+static void unlink_buffer(AVFramePool *pool, FramePoolBuffer *buf)
+{
+    if (buf->prev) buf->prev->next = buf->next;
+    else           pool->first     = buf->next;
+    if (buf->next) buf->next->prev = buf->prev;
+    else           pool->last      = buf->prev;
+    buf->prev = buf->next = NULL;
+    pool->nb_unused--;
+    pool->unused_bytes -= buf->size;
+}
+
+void ff_frame_pool_free_buffer(FramePoolBuffer *buf)
+{
+    if (!buf)
+        return;
+    av_free(buf->data);
+    av_free(buf);
+}
+
+AVFramePool *av_frame_pool_alloc(int max_buffers, int64_t max_bytes)
+{
+    AVFramePool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool)
+        return NULL;
+#if HAVE_PTHREADS
+    if (pthread_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
+#endif
+    pool->refcount    = 1;
+    pool->max_buffers = FFMAX(max_buffers, 0);
+    pool->max_bytes   = FFMAX(max_bytes, 0);
+    return pool;
+}
+
+AVFramePool *ff_frame_pool_ref(AVFramePool *pool)
+{
+    pool_lock(pool);
+    pool->refcount++;
+    pool_unlock(pool);
+    return pool;
+}
+
+void ff_frame_pool_unref(AVFramePool **ppool, const void *owner)
+{
+    AVFramePool *pool = *ppool;
+    FramePoolBuffer *buf;
+    int refcount;
+
+    if (!pool)
+        return;
+    *ppool = NULL;
+
+    pool_lock(pool);
+    /* a later owner allocated at the same address must not
+       trust the content of the buffers */
+    if (owner)
+        for (buf = pool->first; buf; buf = buf->next)
+            if (buf->owner == owner)
+                buf->owner = NULL;
+    refcount = --pool->refcount;
+    pool_unlock(pool);
+
+    if (refcount)
+        return;
+    while ((buf = pool->first)) {
+        unlink_buffer(pool, buf);
+        ff_frame_pool_free_buffer(buf);
+    }
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    av_free(pool);
+}
+
+void av_frame_pool_free(AVFramePool **pool)
+{
+    ff_frame_pool_unref(pool, NULL);
+}
+
+FramePoolBuffer *ff_frame_pool_get(AVFramePool *pool, int size)
+{
+    FramePoolBuffer *buf;
+
+    size = size_class(size);
+
+    pool_lock(pool);
+    for (buf = pool->first; buf; buf = buf->next)
+        if (buf->size == size)
+            break;
+    if (buf)
+        unlink_buffer(pool, buf);
+    pool_unlock(pool);
+    if (buf)
+        return buf;
+
+    buf = av_mallocz(sizeof(*buf));
+    if (!buf)
+        return NULL;
+    buf->data = av_malloc(size);
+    if (!buf->data) {
+        av_free(buf);
+        return NULL;
+    }
+    buf->size = size;
+    buf->pool = pool;
+    return buf;
+}
+
+void ff_frame_pool_put(FramePoolBuffer *buf)
+{
+    AVFramePool *pool = buf->pool;
+    FramePoolBuffer *evicted = NULL;
+
+    pool_lock(pool);
+    buf->next = pool->first;
+    if (pool->first) pool->first->prev = buf;
+    else             pool->last        = buf;
+    pool->first = buf;
+    pool->nb_unused++;
+    pool->unused_bytes += buf->size;
+
+    while ((pool->max_buffers && pool->nb_unused    > pool->max_buffers) ||
+           (pool->max_bytes   && pool->unused_bytes > pool->max_bytes)) {
+        FramePoolBuffer *old = pool->last;
+        unlink_buffer(pool, old);
+        old->next = evicted;
+        evicted   = old;
+    }
+    pool_unlock(pool);
+
+    while (evicted) {
+        buf     = evicted;
+        evicted = buf->next;
+        ff_frame_pool_free_buffer(buf);
+    }
+}
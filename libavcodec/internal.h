@@ -55,4 +55,50 @@ int ff_match_2uint16(const uint16_t (*tab)[2], int size, int a, int b);
 
 unsigned int ff_toupper4(unsigned int x);
 
+typedef struct FramePoolBuffer {
+    uint8_t *data;
+    int size;                   ///< allocated size, a size class of the pool
+    AVFramePool *pool;
+    struct FramePoolBuffer *prev, *next;
+
+    /* Set by the user of the buffer to describe its content. */
+    const void *owner;          ///< reset by the pool when the owner goes away
+    int last_pic_num;
+    int width, height;
+    enum PixelFormat pix_fmt;
+    int linesize[4];
+    uint8_t *frame_data;        ///< data[0] of the last picture in the buffer
+} FramePoolBuffer;
+
+AVFramePool *ff_frame_pool_ref(AVFramePool *pool);
+
+/**
+ * Drop a reference to the pool, free it with its unused buffers if it was
+ * the last one, and forget owner in the buffers it kept.
+ */
+void ff_frame_pool_unref(AVFramePool **pool, const void *owner);
+
+/**
+ * Take an unused buffer of at least size bytes from the pool, or allocate
+ * one if there is none. The owner of a new buffer is NULL.
+ */
+FramePoolBuffer *ff_frame_pool_get(AVFramePool *pool, int size);
+
+/**
+ * Give a buffer back to its pool, the least recently released buffers are
+ * freed if the pool is then above its limits.
+ */
+void ff_frame_pool_put(FramePoolBuffer *buf);
+
+/**
+ * Free a buffer instead of giving it back to its pool.
+ */
+void ff_frame_pool_free_buffer(FramePoolBuffer *buf);
+
+/**
+ * Return 1 if the payload of pkt is refcounted, so that av_packet_ref()
+ * shares it instead of copying it.
+ */
+int ff_packet_is_refcounted(const AVPacket *pkt);
+
 #endif /* AVCODEC_INTERNAL_H */
@@ -390,3 +390,55 @@ void ff_j2k_cleanup(J2kComponent *comp, J2kCodingStyle *codsty)
     av_freep(&comp->reslevel);
     av_freep(&comp->data);
 }
+
+int ff_j2k_list_cblks(J2kCblkJob *jobs, J2kComponent *comp, J2kCodingStyle *codsty, int compno)
+{
+    int reslevelno, bandno, n = 0;
+
+    for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
+        J2kResLevel *rlevel = comp->reslevel + reslevelno;
+
+        for (bandno = 0; bandno < rlevel->nbands; bandno++){
+            J2kBand *band = rlevel->band + bandno;
+            int cblkx, cblky, cblkno = 0, xx0, x0, xx1, y0, yy0, yy1;
+
+            if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
+                continue;
+
+            yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
+            y0 = yy0;
+            yy1 = FFMIN(ff_j2k_ceildiv(band->coord[1][0] + 1, band->codeblock_height) * band->codeblock_height,
+                        band->coord[1][1]) - band->coord[1][0] + yy0;
+
+            for (cblky = 0; cblky < band->cblkny; cblky++){
+                if (reslevelno == 0 || bandno == 1)
+                    xx0 = 0;
+                else
+                    xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
+                x0 = xx0;
+                xx1 = FFMIN(ff_j2k_ceildiv(band->coord[0][0] + 1, band->codeblock_width) * band->codeblock_width,
+                            band->coord[0][1]) - band->coord[0][0] + xx0;
+
+                for (cblkx = 0; cblkx < band->cblknx; cblkx++, cblkno++, n++){
+                    if (jobs){
+                        J2kCblkJob *job = jobs + n;
+                        job->comp    = comp;
+                        job->codsty  = codsty;
+                        job->band    = band;
+                        job->cblk    = band->cblk + cblkno;
+                        job->compno  = compno;
+                        job->bandpos = bandno + (reslevelno > 0);
+                        job->lev     = codsty->nreslevels - reslevelno - 1;
+                        job->x0 = xx0; job->x1 = xx1;
+                        job->y0 = yy0; job->y1 = yy1;
+                    }
+                    xx0 = xx1;
+                    xx1 = FFMIN(xx1 + band->codeblock_width, band->coord[0][1] - band->coord[0][0] + x0);
+                }
+                yy0 = yy1;
+                yy1 = FFMIN(yy1 + band->codeblock_height, band->coord[1][1] - band->coord[1][0] + y0);
+            }
+        }
+    }
+    return n;
+}
@@ -179,6 +179,17 @@ typedef struct {
    uint16_t coord[2][2]; ///< border coordinates {{x0, x1}, {y0, y1}}
 } J2kComponent;
 
+typedef struct {
+    J2kComponent *comp;
+    J2kCodingStyle *codsty;
+    J2kBand *band;
+    J2kCblk *cblk;
+    int compno;
+    int bandpos;
+    int lev;            ///< decomposition level of the band
+    int x0, x1, y0, y1; ///< codeblock area in the component data
+} J2kCblkJob; ///< code block to be processed by tier-1
+
 /* debug routines */
 #if 0
 #undef fprintf
@@ -231,4 +242,12 @@ int ff_j2k_init_component(J2kComponent *comp, J2kCodingStyle *codsty, J2kQuantSt
 void ff_j2k_reinit(J2kComponent *comp, J2kCodingStyle *codsty);
 void ff_j2k_cleanup(J2kComponent *comp, J2kCodingStyle *codsty);
 
+/**
+ * List the codeblocks of a tile-component with their area in the component
+ * data, so that tier-1 can process them independently of each other.
+ * @param jobs array receiving the codeblocks, or NULL to only count them
+ * @return the number of codeblocks
+ */
+int ff_j2k_list_cblks(J2kCblkJob *jobs, J2kComponent *comp, J2kCodingStyle *codsty, int compno);
+
 #endif /* AVCODEC_J2K_H */
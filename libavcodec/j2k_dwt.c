@@ -25,10 +25,23 @@
  * @author Kamil Nowosad
  */
 
+#include <string.h>
+#include "config.h"
 #include "j2k_dwt.h"
 
+#define S FF_DWT_STRIP
+
 const static float scale97[] = {1.625786, 1.230174};
 
+/* lifting coefficients of the 9/7 wavelet */
+#define ALPHA 1.586134f
+#define BETA  0.052980f
+#define GAMMA 0.882911f
+#define DELTA 0.443506f
+
+/* row i of a strip of S interleaved columns */
+#define COPY_ROW(p, dst, src) memcpy((p) + (dst) * S, (p) + (src) * S, S * sizeof(*(p)))
+
 static inline void extend53(int *p, int i0, int i1)
 {
     p[i0 - 1] = p[i0 + 1];
@@ -37,6 +50,14 @@ static inline void extend53(int *p, int i0, int i1)
     p[i1 + 1] = p[i1 - 3];
 }
 
+static inline void extend53_strip(int *p, int i0, int i1)
+{
+    COPY_ROW(p, i0 - 1, i0 + 1);
+    COPY_ROW(p, i1    , i1 - 2);
+    COPY_ROW(p, i0 - 2, i0 + 2);
+    COPY_ROW(p, i1 + 1, i1 - 3);
+}
+
 static inline void extend97(float *p, int i0, int i1)
 {
     int i;
@@ -47,6 +68,16 @@ static inline void extend97(float *p, int i0, int i1)
     }
 }
 
+static inline void extend97_strip(float *p, int i0, int i1)
+{
+    int i;
+
+    for (i = 1; i <= 4; i++){
+        COPY_ROW(p, i0 - i, i0 + i);
+        COPY_ROW(p, i1 + i - 1, i1 - i - 1);
+    }
+}
+
 static void sd_1d53(int *p, int i0, int i1)
 {
     int i;
@@ -62,12 +93,29 @@ static void sd_1d53(int *p, int i0, int i1)
         p[2*i] += (p[2*i-1] + p[2*i+1] + 2) >> 2;
 }
 
+/* same as sd_1d53() on S columns at once */
+static void sd_strip53(DWTDSPContext *dsp, int *p, int i0, int i1)
+{
+    int a;
+
+    if (i1 == i0 + 1)
+        return;
+
+    extend53_strip(p, i0, i1);
+
+    a = (i0+1)/2 - 1;
+    dsp->lift53_sub(p + 2*a*S, (i1+1)/2 - a, 0, 1);
+    a = (i0+1)/2;
+    dsp->lift53_add(p + (2*a-1)*S, (i1+1)/2 - a, 2, 2);
+}
+
 static void dwt_encode53(DWTContext *s, int *t)
 {
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
-    int *line = s->linebuf;
-    line += 3;
+    int *line = s->linebuf, *strip = s->stripbuf;
+    line  += 3;
+    strip += 3*S;
 
     for (lev = s->ndeclevels-1; lev >= 0; lev--){
         int lh = s->linelen[lev][0],
@@ -77,6 +125,23 @@ static void dwt_encode53(DWTContext *s, int *t)
             lp;
         int *l;
 
+        // VER_SD
+        l = strip + mv*S;
+        for (lp = 0; lp < lh; lp += S) {
+            int i, j = 0, n = FFMIN(S, lh - lp);
+
+            for (i = 0; i < lv; i++)
+                memcpy(l + i*S, t + w*i + lp, n * sizeof(*t));
+
+            sd_strip53(&s->dsp, strip, mv, mv + lv);
+
+            // copy back and deinterleave
+            for (i =   mv; i < lv; i+=2, j++)
+                memcpy(t + w*j + lp, l + i*S, n * sizeof(*t));
+            for (i = 1-mv; i < lv; i+=2, j++)
+                memcpy(t + w*j + lp, l + i*S, n * sizeof(*t));
+        }
+
         // HOR_SD
         l = line + mh;
         for (lp = 0; lp < lv; lp++){
@@ -93,23 +158,6 @@ static void dwt_encode53(DWTContext *s, int *t)
             for (i = 1-mh; i < lh; i+=2, j++)
                 t[w*lp + j] = l[i];
         }
-
-        // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-
-            for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
-
-            sd_1d53(line, mv, mv + lv);
-
-            // copy back and deinterleave
-            for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
-            for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
-        }
     }
 }
 
@@ -124,21 +172,42 @@ static void sd_1d97(float *p, int i0, int i1)
     i0++; i1++;
 
     for (i = i0/2 - 2; i < i1/2 + 1; i++)
-        p[2*i+1] -= 1.586134 * (p[2*i] + p[2*i+2]);
+        p[2*i+1] += -ALPHA * (p[2*i] + p[2*i+2]);
     for (i = i0/2 - 1; i < i1/2 + 1; i++)
-        p[2*i] -= 0.052980 * (p[2*i-1] + p[2*i+1]);
+        p[2*i]   += -BETA  * (p[2*i-1] + p[2*i+1]);
     for (i = i0/2 - 1; i < i1/2; i++)
-        p[2*i+1] += 0.882911 * (p[2*i] + p[2*i+2]);
+        p[2*i+1] +=  GAMMA * (p[2*i] + p[2*i+2]);
     for (i = i0/2; i < i1/2; i++)
-        p[2*i] += 0.443506 * (p[2*i-1] + p[2*i+1]);
+        p[2*i]   +=  DELTA * (p[2*i-1] + p[2*i+1]);
+}
+
+/* same as sd_1d97() on S columns at once */
+static void sd_strip97(DWTDSPContext *dsp, float *p, int i0, int i1)
+{
+    int a;
+
+    if (i1 == i0 + 1)
+        return;
+
+    extend97_strip(p, i0, i1);
+    i0++; i1++;
+
+    a = i0/2 - 2;
+    dsp->lift97(p + 2*a*S,     i1/2 + 1 - a, -ALPHA);
+    a = i0/2 - 1;
+    dsp->lift97(p + (2*a-1)*S, i1/2 + 1 - a, -BETA);
+    dsp->lift97(p + 2*a*S,     i1/2     - a,  GAMMA);
+    a = i0/2;
+    dsp->lift97(p + (2*a-1)*S, i1/2     - a,  DELTA);
 }
 
 static void dwt_encode97(DWTContext *s, int *t)
 {
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
-    float *line = s->linebuf;
-    line += 5;
+    float *line = s->linebuf, *strip = s->stripbuf;
+    line  += 5;
+    strip += 5*S;
 
     for (lev = s->ndeclevels-1; lev >= 0; lev--){
         int lh = s->linelen[lev][0],
@@ -148,6 +217,26 @@ static void dwt_encode97(DWTContext *s, int *t)
             lp;
         float *l;
 
+        // VER_SD
+        l = strip + mv*S;
+        for (lp = 0; lp < lh; lp += S) {
+            int i, j = 0, k, n = FFMIN(S, lh - lp);
+
+            for (i = 0; i < lv; i++)
+                for (k = 0; k < n; k++)
+                    l[i*S + k] = t[w*i + lp + k];
+
+            sd_strip97(&s->dsp, strip, mv, mv + lv);
+
+            // copy back and deinterleave
+            for (i =   mv; i < lv; i+=2, j++)
+                for (k = 0; k < n; k++)
+                    t[w*j + lp + k] = scale97[mv] * l[i*S + k] / 2;
+            for (i = 1-mv; i < lv; i+=2, j++)
+                for (k = 0; k < n; k++)
+                    t[w*j + lp + k] = scale97[mv] * l[i*S + k] / 2;
+        }
+
         // HOR_SD
         l = line + mh;
         for (lp = 0; lp < lv; lp++){
@@ -164,23 +253,6 @@ static void dwt_encode97(DWTContext *s, int *t)
             for (i = 1-mh; i < lh; i+=2, j++)
                 t[w*lp + j] = scale97[mh] * l[i] / 2;
         }
-
-        // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
-
-            for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
-
-            sd_1d97(line, mv, mv + lv);
-
-            // copy back and deinterleave
-            for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = scale97[mv] * l[i] / 2;
-            for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = scale97[mv] * l[i] / 2;
-        }
     }
 }
 
@@ -199,12 +271,27 @@ static void sr_1d53(int *p, int i0, int i1)
         p[2*i+1] += (p[2*i] + p[2*i+2]) >> 1;
 }
 
+/* same as sr_1d53() on S columns at once */
+static void sr_strip53(DWTDSPContext *dsp, int *p, int i0, int i1)
+{
+    int a = i0/2;
+
+    if (i1 == i0 + 1)
+        return;
+
+    extend53_strip(p, i0, i1);
+
+    dsp->lift53_sub(p + (2*a-1)*S, i1/2 + 1 - a, 2, 2);
+    dsp->lift53_add(p + 2*a*S,     i1/2     - a, 0, 1);
+}
+
 static void dwt_decode53(DWTContext *s, int *t)
 {
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
-    int *line = s->linebuf;
-    line += 3;
+    int *line = s->linebuf, *strip = s->stripbuf;
+    line  += 3;
+    strip += 3*S;
 
     for (lev = 0; lev < s->ndeclevels; lev++){
         int lh = s->linelen[lev][0],
@@ -231,19 +318,19 @@ static void dwt_decode53(DWTContext *s, int *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++){
-            int i, j = 0;
+        l = strip + mv*S;
+        for (lp = 0; lp < lh; lp += S){
+            int i, j = 0, n = FFMIN(S, lh - lp);
             // copy with interleaving
             for (i =   mv; i < lv; i+=2, j++)
-                l[i] = t[w*j + lp];
+                memcpy(l + i*S, t + w*j + lp, n * sizeof(*t));
             for (i = 1-mv; i < lv; i+=2, j++)
-                l[i] = t[w*j + lp];
+                memcpy(l + i*S, t + w*j + lp, n * sizeof(*t));
 
-            sr_1d53(line, mv, mv + lv);
+            sr_strip53(&s->dsp, strip, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                t[w*i + lp] = l[i];
+                memcpy(t + w*i + lp, l + i*S, n * sizeof(*t));
         }
     }
 }
@@ -258,21 +345,40 @@ static void sr_1d97(float *p, int i0, int i1)
     extend97(p, i0, i1);
 
     for (i = i0/2 - 1; i < i1/2 + 2; i++)
-        p[2*i] -= 0.443506 * (p[2*i-1] + p[2*i+1]);
+        p[2*i]   += -DELTA * (p[2*i-1] + p[2*i+1]);
     for (i = i0/2 - 1; i < i1/2 + 1; i++)
-        p[2*i+1] -= 0.882911 * (p[2*i] + p[2*i+2]);
+        p[2*i+1] += -GAMMA * (p[2*i] + p[2*i+2]);
     for (i = i0/2; i < i1/2 + 1; i++)
-        p[2*i] += 0.052980 * (p[2*i-1] + p[2*i+1]);
+        p[2*i]   +=  BETA  * (p[2*i-1] + p[2*i+1]);
     for (i = i0/2; i < i1/2; i++)
-        p[2*i+1] += 1.586134 * (p[2*i] + p[2*i+2]);
+        p[2*i+1] +=  ALPHA * (p[2*i] + p[2*i+2]);
+}
+
+/* same as sr_1d97() on S columns at once */
+static void sr_strip97(DWTDSPContext *dsp, float *p, int i0, int i1)
+{
+    int a;
+
+    if (i1 == i0 + 1)
+        return;
+
+    extend97_strip(p, i0, i1);
+
+    a = i0/2 - 1;
+    dsp->lift97(p + (2*a-1)*S, i1/2 + 2 - a, -DELTA);
+    dsp->lift97(p + 2*a*S,     i1/2 + 1 - a, -GAMMA);
+    a = i0/2;
+    dsp->lift97(p + (2*a-1)*S, i1/2 + 1 - a,  BETA);
+    dsp->lift97(p + 2*a*S,     i1/2     - a,  ALPHA);
 }
 
 static void dwt_decode97(DWTContext *s, int *t)
 {
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
-    float *line = s->linebuf;
-    line += 5;
+    float *line = s->linebuf, *strip = s->stripbuf;
+    line  += 5;
+    strip += 5*S;
 
     for (lev = 0; lev < s->ndeclevels; lev++){
         int lh = s->linelen[lev][0],
@@ -299,23 +405,62 @@ static void dwt_decode97(DWTContext *s, int *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++){
-            int i, j = 0;
+        l = strip + mv*S;
+        for (lp = 0; lp < lh; lp += S){
+            int i, j = 0, k, n = FFMIN(S, lh - lp);
             // copy with interleaving
             for (i =   mv; i < lv; i+=2, j++)
-                l[i] = scale97[1-mv] * t[w*j + lp];
+                for (k = 0; k < n; k++)
+                    l[i*S + k] = scale97[1-mv] * t[w*j + lp + k];
             for (i = 1-mv; i < lv; i+=2, j++)
-                l[i] = scale97[1-mv] * t[w*j + lp];
+                for (k = 0; k < n; k++)
+                    l[i*S + k] = scale97[1-mv] * t[w*j + lp + k];
 
-            sr_1d97(line, mv, mv + lv);
+            sr_strip97(&s->dsp, strip, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                t[w*i + lp] = l[i];
+                for (k = 0; k < n; k++)
+                    t[w*i + lp + k] = l[i*S + k];
         }
     }
 }
 
+static void lift53_add_c(int *p, int n, int rnd, int shift)
+{
+    int i, k;
+
+    for (i = 0; i < n; i++, p += 2*S)
+        for (k = 0; k < S; k++)
+            p[S + k] += (p[k] + p[2*S + k] + rnd) >> shift;
+}
+
+static void lift53_sub_c(int *p, int n, int rnd, int shift)
+{
+    int i, k;
+
+    for (i = 0; i < n; i++, p += 2*S)
+        for (k = 0; k < S; k++)
+            p[S + k] -= (p[k] + p[2*S + k] + rnd) >> shift;
+}
+
+static void lift97_c(float *p, int n, float c)
+{
+    int i, k;
+
+    for (i = 0; i < n; i++, p += 2*S)
+        for (k = 0; k < S; k++)
+            p[S + k] += c * (p[k] + p[2*S + k]);
+}
+
+void ff_j2k_dwt_dsp_init(DWTDSPContext *c)
+{
+    c->lift53_add = lift53_add_c;
+    c->lift53_sub = lift53_sub_c;
+    c->lift97     = lift97_c;
+
+    if (HAVE_MMX) ff_j2k_dwt_dsp_init_x86(c);
+}
+
 int ff_j2k_dwt_init(DWTContext *s, uint16_t border[2][2], int decomp_levels, int type)
 {
     int i, j, lev = decomp_levels, maxlen,
@@ -339,16 +484,19 @@ int ff_j2k_dwt_init(DWTContext *s, uint16_t border[2][2], int decomp_levels, int
                 b[i][j] = (b[i][j] + 1) >> 1;
         }
     }
-    if (type == FF_DWT97)
-        s->linebuf = av_malloc((maxlen + 12) * sizeof(float));
-    else if (type == FF_DWT53)
-        s->linebuf = av_malloc((maxlen + 6) * sizeof(int));
-    else
+    if (type == FF_DWT97) {
+        s->linebuf  = av_malloc ((maxlen + 12)     * sizeof(float));
+        s->stripbuf = av_mallocz((maxlen + 12) * S * sizeof(float));
+    } else if (type == FF_DWT53) {
+        s->linebuf  = av_malloc ((maxlen + 6)      * sizeof(int));
+        s->stripbuf = av_mallocz((maxlen + 6)  * S * sizeof(int));
+    } else
         return -1;
 
-    if (!s->linebuf)
+    if (!s->linebuf || !s->stripbuf)
         return AVERROR(ENOMEM);
 
+    ff_j2k_dwt_dsp_init(&s->dsp);
     return 0;
 }
 
@@ -381,4 +529,5 @@ int ff_j2k_dwt_decode(DWTContext *s, int *t)
 void ff_j2k_dwt_destroy(DWTContext *s)
 {
     av_freep(&s->linebuf);
+    av_freep(&s->stripbuf);
 }
@@ -32,20 +32,40 @@
 
 #define FF_DWT_MAX_DECLVLS 32 ///< max number of decomposition levels
 
+/** number of columns transformed together by the vertical pass */
+#define FF_DWT_STRIP 8
+
 enum DWTType{
     FF_DWT97,
     FF_DWT53
 };
 
 typedef struct {
+    /**
+     * Lifting steps on FF_DWT_STRIP interleaved columns, p points to the
+     * first neighbour row of the first updated row, for i in [0, n):
+     * row[2i+1] +=/-= (row[2i] + row[2i+2] + rnd) >> shift
+     */
+    void (*lift53_add)(int *p, int n, int rnd, int shift);
+    void (*lift53_sub)(int *p, int n, int rnd, int shift);
+    /** row[2i+1] += c * (row[2i] + row[2i+2]) */
+    void (*lift97)(float *p, int n, float c);
+} DWTDSPContext;
+
+typedef struct {
+    DWTDSPContext dsp;
     ///line lengths {horizontal, vertical} in consecutive decomposition levels
     uint16_t linelen[FF_DWT_MAX_DECLVLS][2];
     uint8_t  mod[FF_DWT_MAX_DECLVLS][2]; ///< coordinates (x0, y0) of decomp. levels mod 2
     uint8_t  ndeclevels;                 ///< number of decomposition levels
     uint8_t  type;                       ///< 0 for 9/7; 1 for 5/3
     void     *linebuf;                   ///< buffer used by transform (int or float)
+    void     *stripbuf;                  ///< FF_DWT_STRIP columns used by the vertical pass
 } DWTContext;
 
+void ff_j2k_dwt_dsp_init(DWTDSPContext *c);
+void ff_j2k_dwt_dsp_init_x86(DWTDSPContext *c);
+
 /**
  * initialize DWT
  * @param s DWT context
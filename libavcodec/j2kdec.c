@@ -72,6 +72,10 @@ typedef struct {
     int16_t curtileno;
 
     J2kTile *tile;
+
+    J2kT1Context *t1;      ///< tier-1 state, one per thread
+    J2kCblkJob *cblk_jobs; ///< codeblocks of all tiles
+    unsigned int cblk_jobs_size;
 } J2kDecoderContext;
 
 static int get_bits(J2kDecoderContext *s, int n)
@@ -701,9 +705,9 @@ static int decode_cblk(J2kDecoderContext *s, J2kCodingStyle *codsty, J2kT1Contex
     for (y = 0; y < height; y++)
         memset(t1->data[y], 0, width*sizeof(int));
 
-    ff_mqc_initdec(&t1->mqc, cblk->data);
     cblk->data[cblk->length] = 0xff;
     cblk->data[cblk->length+1] = 0xff;
+    ff_mqc_initdec(&t1->mqc, cblk->data);
 
     while(passno--){
         switch(pass_t){
@@ -762,73 +766,53 @@ static void mct_decode(J2kDecoderContext *s, J2kTile *tile)
     }
 }
 
-static int decode_tile(J2kDecoderContext *s, J2kTile *tile)
+static int decode_cblk_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
-    int compno, reslevelno, bandno;
-    int x, y, *src[4];
-    uint8_t *line;
-    J2kT1Context t1;
-
-    for (compno = 0; compno < s->ncomponents; compno++){
-        J2kComponent *comp = tile->comp + compno;
-        J2kCodingStyle *codsty = tile->codsty + compno;
+    J2kDecoderContext *s = avctx->priv_data;
+    J2kCblkJob *job = s->cblk_jobs + jobnr;
+    J2kT1Context *t1 = s->t1 + threadnr;
+    J2kComponent *comp = job->comp;
+    int compno = job->compno, w = comp->coord[0][1] - comp->coord[0][0], x, y;
+
+    decode_cblk(s, job->codsty, t1, job->cblk, job->x1 - job->x0, job->y1 - job->y0, job->bandpos);
+    if (job->codsty->transform == FF_DWT53){
+        for (y = job->y0; y < job->y1; y+=s->cdy[compno]){
+            int *ptr = t1->data[y - job->y0];
+            for (x = job->x0; x < job->x1; x+=s->cdx[compno]){
+                comp->data[w * y + x] = *ptr++ / 2;
+            }
+        }
+    } else{
+        for (y = job->y0; y < job->y1; y+=s->cdy[compno]){
+            int *ptr = t1->data[y - job->y0];
+            for (x = job->x0; x < job->x1; x+=s->cdx[compno]){
+                int tmp = ((int64_t)*ptr++) * ((int64_t)job->band->stepsize) >> 13, tmp2;
+                tmp2 = FFABS(tmp>>1) + FFABS(tmp&1);
+                comp->data[w * y + x] = tmp < 0 ? -tmp2 : tmp2;
+            }
+        }
+    }
+    return 0;
+}
 
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            J2kResLevel *rlevel = comp->reslevel + reslevelno;
-            for (bandno = 0; bandno < rlevel->nbands; bandno++){
-                J2kBand *band = rlevel->band + bandno;
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
+static int dwt_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    J2kDecoderContext *s = avctx->priv_data;
+    J2kComponent *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
 
-                bandpos = bandno + (reslevelno > 0);
+    return ff_j2k_dwt_decode(&comp->dwt, comp->data);
+}
 
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_j2k_ceildiv(band->coord[1][0] + 1, band->codeblock_height) * band->codeblock_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+static int write_tile_thread(AVCodecContext *avctx, void *arg, int tileno, int threadnr)
+{
+    J2kDecoderContext *s = avctx->priv_data;
+    J2kTile *tile = s->tile + tileno;
+    int compno, x, y, *src[4];
+    uint8_t *line;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
+    for (compno = 0; compno < s->ncomponents; compno++)
+        src[compno] = tile->comp[compno].data;
 
-                for (cblky = 0; cblky < band->cblkny; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_j2k_ceildiv(band->coord[0][0] + 1, band->codeblock_width) * band->codeblock_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < band->cblknx; cblkx++, cblkno++){
-                        int y, x;
-                        decode_cblk(s, codsty, &t1, band->cblk + cblkno, xx1 - xx0, yy1 - yy0, bandpos);
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y+=s->cdy[compno]){
-                                int *ptr = t1.data[y-yy0];
-                                for (x = xx0; x < xx1; x+=s->cdx[compno]){
-                                    comp->data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] = *ptr++ >> 1;
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y+=s->cdy[compno]){
-                                int *ptr = t1.data[y-yy0];
-                                for (x = xx0; x < xx1; x+=s->cdx[compno]){
-                                    int tmp = ((int64_t)*ptr++) * ((int64_t)band->stepsize) >> 13, tmp2;
-                                    tmp2 = FFABS(tmp>>1) + FFABS(tmp&1);
-                                    comp->data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] = tmp < 0 ? -tmp2 : tmp2;
-                                }
-                            }
-                        }
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + band->codeblock_width, band->coord[0][1] - band->coord[0][0] + x0);
-                    }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + band->codeblock_height, band->coord[1][1] - band->coord[1][0] + y0);
-                }
-            }
-        }
-        ff_j2k_dwt_decode(&comp->dwt, comp->data);
-        src[compno] = comp->data;
-    }
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
 
@@ -880,6 +864,34 @@ static int decode_tile(J2kDecoderContext *s, J2kTile *tile)
     return 0;
 }
 
+/**
+ * Decode the codeblocks of all tiles, then the wavelet transforms of all
+ * tile-components, then write the tiles into the picture, each step being
+ * split among the threads.
+ */
+static int decode_tiles(J2kDecoderContext *s)
+{
+    int tileno, compno, njobs = 0, ntiles = s->numXtiles * s->numYtiles;
+
+    for (tileno = 0; tileno < ntiles; tileno++)
+        for (compno = 0; compno < s->ncomponents; compno++)
+            njobs += ff_j2k_list_cblks(NULL, s->tile[tileno].comp + compno,
+                                       s->tile[tileno].codsty + compno, compno);
+    av_fast_malloc(&s->cblk_jobs, &s->cblk_jobs_size, njobs * sizeof(*s->cblk_jobs));
+    if (!s->cblk_jobs)
+        return AVERROR(ENOMEM);
+    njobs = 0;
+    for (tileno = 0; tileno < ntiles; tileno++)
+        for (compno = 0; compno < s->ncomponents; compno++)
+            njobs += ff_j2k_list_cblks(s->cblk_jobs + njobs, s->tile[tileno].comp + compno,
+                                       s->tile[tileno].codsty + compno, compno);
+
+    s->avctx->execute2(s->avctx, decode_cblk_thread, NULL, NULL, njobs);
+    s->avctx->execute2(s->avctx, dwt_thread, NULL, NULL, ntiles * s->ncomponents);
+    s->avctx->execute2(s->avctx, write_tile_thread, NULL, NULL, ntiles);
+    return 0;
+}
+
 static void cleanup(J2kDecoderContext *s)
 {
     int tileno, compno;
@@ -989,7 +1001,7 @@ static int decode_frame(AVCodecContext *avctx,
 {
     J2kDecoderContext *s = avctx->priv_data;
     AVFrame *picture = data;
-    int tileno, ret;
+    int ret;
 
     s->avctx = avctx;
     av_log(s->avctx, AV_LOG_DEBUG, "start\n");
@@ -1020,9 +1032,8 @@ static int decode_frame(AVCodecContext *avctx,
     if (ret = decode_codestream(s))
         return ret;
 
-    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
-        if (ret = decode_tile(s, s->tile + tileno))
-            return ret;
+    if (ret = decode_tiles(s))
+        return ret;
 
     cleanup(s);
     av_log(s->avctx, AV_LOG_DEBUG, "end\n");
@@ -1039,6 +1050,10 @@ static av_cold int j2kdec_init(AVCodecContext *avctx)
 
     avcodec_get_frame_defaults((AVFrame*)&s->picture);
     avctx->coded_frame = (AVFrame*)&s->picture;
+
+    s->t1 = av_malloc(FFMAX(avctx->thread_count, 1) * sizeof(*s->t1));
+    if (!s->t1)
+        return AVERROR(ENOMEM);
     return 0;
 }
 
@@ -1049,6 +1064,8 @@ static av_cold int decode_end(AVCodecContext *avctx)
     if (s->picture.data[0])
         avctx->release_buffer(avctx, &s->picture);
 
+    av_freep(&s->t1);
+    av_freep(&s->cblk_jobs);
     return 0;
 }
 
@@ -1061,7 +1078,7 @@ AVCodec ff_jpeg2000_decoder = {
     NULL,
     decode_end,
     decode_frame,
-    .capabilities = CODEC_CAP_EXPERIMENTAL,
+    .capabilities = CODEC_CAP_EXPERIMENTAL | CODEC_CAP_SLICE_THREADS,
     .pix_fmts =
         (enum PixelFormat[]) {PIX_FMT_GRAY8, PIX_FMT_RGB24, -1}
 };
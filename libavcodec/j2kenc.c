@@ -30,6 +30,7 @@
 #include "bytestream.h"
 #include "j2k.h"
 #include "libavutil/common.h"
+#include "libavutil/opt.h"
 
 #define NMSEDEC_BITS 7
 #define NMSEDEC_FRACBITS (NMSEDEC_BITS-1)
@@ -58,6 +59,7 @@ typedef struct {
 } J2kTile;
 
 typedef struct {
+    AVClass *class;
     AVCodecContext *avctx;
     AVFrame *picture;
 
@@ -80,6 +82,13 @@ typedef struct {
     J2kQuantStyle  qntsty;
 
     J2kTile *tile;
+
+    J2kT1Context *t1;      ///< tier-1 state, one per thread
+    J2kCblkJob *cblk_jobs; ///< codeblocks of all tiles
+    int ncblk_jobs;
+    int *job_ret;          ///< return values of the threaded jobs
+
+    int dwt;               ///< wavelet transform, FF_DWT97 or FF_DWT53
 } J2kEncoderContext;
 
 
@@ -326,7 +335,7 @@ static uint8_t *put_sot(J2kEncoderContext *s, int tileno)
     uint8_t *psotptr;
 
     if (s->buf_end - s->buf < 12)
-        return -1;
+        return NULL;
 
     bytestream_put_be16(&s->buf, J2K_SOT);
     bytestream_put_be16(&s->buf, 10); // Lsot
@@ -377,7 +386,7 @@ static int init_tiles(J2kEncoderContext *s)
                         for (j = 0; j < 2; j++)
                             comp->coord[i][j] = ff_j2k_ceildivpow2(comp->coord[i][j], s->chroma_shift[i]);
 
-                if (ret = ff_j2k_init_component(comp, codsty, qntsty, s->cbps[compno]))
+                if (ret = ff_j2k_init_component(comp, codsty, qntsty, s->cbps[compno], 1, 1))
                     return ret;
             }
         }
@@ -491,7 +500,7 @@ static void encode_sigpass(J2kT1Context *t1, int width, int height, int bandno,
         for (x = 0; x < width; x++)
             for (y = y0; y < height && y < y0+4; y++){
                 if (!(t1->flags[y+1][x+1] & J2K_T1_SIG) && (t1->flags[y+1][x+1] & J2K_T1_SIG_NB)){
-                    int ctxno = ff_j2k_getnbctxno(t1->flags[y+1][x+1], bandno),
+                    int ctxno = ff_j2k_getnbctxno(t1->flags[y+1][x+1], bandno, 0),
                         bit = t1->data[y][x] & mask ? 1 : 0;
                     ff_mqc_encode(&t1->mqc, t1->mqc.cx_states + ctxno, bit);
                     if (bit){
@@ -543,7 +552,7 @@ static void encode_clnpass(J2kT1Context *t1, int width, int height, int bandno,
                 ff_mqc_encode(&t1->mqc, t1->mqc.cx_states + MQC_CX_UNI, rlen & 1);
                 for (y = y0 + rlen; y < y0 + 4; y++){
                     if (!(t1->flags[y+1][x+1] & (J2K_T1_SIG | J2K_T1_VIS))){
-                        int ctxno = ff_j2k_getnbctxno(t1->flags[y+1][x+1], bandno);
+                        int ctxno = ff_j2k_getnbctxno(t1->flags[y+1][x+1], bandno, 0);
                         if (y > y0 + rlen)
                             ff_mqc_encode(&t1->mqc, t1->mqc.cx_states + ctxno, t1->data[y][x] & mask ? 1:0);
                         if (t1->data[y][x] & mask){ // newly significant
@@ -559,7 +568,7 @@ static void encode_clnpass(J2kT1Context *t1, int width, int height, int bandno,
             } else{
                 for (y = y0; y < y0 + 4 && y < height; y++){
                     if (!(t1->flags[y+1][x+1] & (J2K_T1_SIG | J2K_T1_VIS))){
-                        int ctxno = ff_j2k_getnbctxno(t1->flags[y+1][x+1], bandno);
+                        int ctxno = ff_j2k_getnbctxno(t1->flags[y+1][x+1], bandno, 0);
                         ff_mqc_encode(&t1->mqc, t1->mqc.cx_states + ctxno, t1->data[y][x] & mask ? 1:0);
                         if (t1->data[y][x] & mask){ // newly significant
                             int xorbit;
@@ -575,7 +584,7 @@ static void encode_clnpass(J2kT1Context *t1, int width, int height, int bandno,
         }
 }
 
-static void encode_cblk(J2kEncoderContext *s, J2kT1Context *t1, J2kCblk *cblk, J2kTile *tile,
+static void encode_cblk(J2kEncoderContext *s, J2kT1Context *t1, J2kCblk *cblk,
                         int width, int height, int bandpos, int lev)
 {
     int pass_t = 2, passno, x, y, max=0, nmsedec, bpno;
@@ -811,74 +820,44 @@ static void truncpasses(J2kEncoderContext *s, J2kTile *tile)
     }
 }
 
-static int encode_tile(J2kEncoderContext *s, J2kTile *tile, int tileno)
+static int dwt_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
-    int compno, reslevelno, bandno, ret;
-    J2kT1Context t1;
-    J2kCodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        J2kComponent *comp = s->tile[tileno].comp + compno;
-
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if (ret = ff_dwt_encode(&comp->dwt, comp->data))
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
-
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            J2kResLevel *reslevel = comp->reslevel + reslevelno;
-
-            for (bandno = 0; bandno < reslevel->nbands ; bandno++){
-                J2kBand *band = reslevel->band + bandno;
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_j2k_ceildiv(band->coord[1][0] + 1, band->codeblock_height) * band->codeblock_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+    J2kEncoderContext *s = avctx->priv_data;
+    J2kComponent *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
+    return ff_j2k_dwt_encode(&comp->dwt, comp->data);
+}
 
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < band->cblkny; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_j2k_ceildiv(band->coord[0][0] + 1, band->codeblock_width) * band->codeblock_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < band->cblknx; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data[y-yy0];
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] << NMSEDEC_FRACBITS;
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data[y-yy0];
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr++ = (int64_t)*ptr * (int64_t)(8192 * 8192 / band->stepsize) >> 13 - NMSEDEC_FRACBITS;
-                                }
-                            }
-                        }
-                        encode_cblk(s, &t1, band->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + band->codeblock_width, band->coord[0][1] - band->coord[0][0] + x0);
-                    }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + band->codeblock_height, band->coord[1][1] - band->coord[1][0] + y0);
-                }
-            }
+static int encode_cblk_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    J2kEncoderContext *s = avctx->priv_data;
+    J2kCblkJob *job = s->cblk_jobs + jobnr;
+    J2kT1Context *t1 = s->t1 + threadnr;
+    J2kComponent *comp = job->comp;
+    int w = comp->coord[0][1] - comp->coord[0][0], x, y;
+
+    if (s->codsty.transform == FF_DWT53){
+        for (y = job->y0; y < job->y1; y++){
+            int *ptr = t1->data[y - job->y0];
+            for (x = job->x0; x < job->x1; x++)
+                *ptr++ = comp->data[w * y + x] << NMSEDEC_FRACBITS;
+        }
+    } else{
+        int64_t scale = 8192 * 8192 / job->band->stepsize;
+        for (y = job->y0; y < job->y1; y++){
+            int *ptr = t1->data[y - job->y0];
+            for (x = job->x0; x < job->x1; x++)
+                *ptr++ = comp->data[w * y + x] * scale >> 13 - NMSEDEC_FRACBITS;
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
     }
+    encode_cblk(s, t1, job->cblk, job->x1 - job->x0, job->y1 - job->y0,
+                job->bandpos, job->lev);
+    return 0;
+}
+
+static int encode_tile(J2kEncoderContext *s, J2kTile *tile, int tileno)
+{
+    int ret;
 
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     truncpasses(s, tile);
@@ -888,7 +867,7 @@ static int encode_tile(J2kEncoderContext *s, J2kTile *tile, int tileno)
     return 0;
 }
 
-void cleanup(J2kEncoderContext *s)
+static void cleanup(J2kEncoderContext *s)
 {
     int tileno, compno;
     J2kCodingStyle *codsty = &s->codsty;
@@ -913,6 +892,20 @@ static void reinit(J2kEncoderContext *s)
     }
 }
 
+static int execute_jobs(AVCodecContext *avctx,
+                        int (*func)(AVCodecContext *, void *, int, int), int count)
+{
+    J2kEncoderContext *s = avctx->priv_data;
+    int i;
+
+    memset(s->job_ret, 0, count * sizeof(*s->job_ret));
+    avctx->execute2(avctx, func, NULL, s->job_ret, count);
+    for (i = 0; i < count; i++)
+        if (s->job_ret[i] < 0)
+            return s->job_ret[i];
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx,
                         uint8_t *buf, int buf_size,
                         void *data)
@@ -931,6 +924,11 @@ static int encode_frame(AVCodecContext *avctx,
     copy_frame(s);
     reinit(s);
 
+    // the wavelet transforms and tier-1 coding of all tiles are split among the threads
+    if ((ret = execute_jobs(avctx, dwt_thread, s->numXtiles * s->numYtiles * s->ncomponents)) < 0 ||
+        (ret = execute_jobs(avctx, encode_cblk_thread, s->ncblk_jobs)) < 0)
+        return ret;
+
     if (s->buf_end - s->buf < 2)
         return -1;
     bytestream_put_be16(&s->buf, J2K_SOC);
@@ -943,8 +941,8 @@ static int encode_frame(AVCodecContext *avctx,
 
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
         uint8_t *psotptr;
-        if ((psotptr = put_sot(s, tileno)) < 0)
-            return psotptr;
+        if (!(psotptr = put_sot(s, tileno)))
+            return -1;
         if (s->buf_end - s->buf < 2)
             return -1;
         bytestream_put_be16(&s->buf, J2K_SOD);
@@ -977,7 +975,7 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
     codsty->nreslevels       = 7;
     codsty->log2_cblk_width  = 4;
     codsty->log2_cblk_height = 4;
-    codsty->transform        = 1;
+    codsty->transform        = s->dwt;
 
     qntsty->nguardbits       = 1;
 
@@ -1014,6 +1012,28 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
     if (ret=init_tiles(s))
         return ret;
 
+    s->t1 = av_malloc(FFMAX(avctx->thread_count, 1) * sizeof(*s->t1));
+    avctx->coded_frame = avcodec_alloc_frame();
+    if (!s->t1 || !avctx->coded_frame)
+        return AVERROR(ENOMEM);
+    avctx->coded_frame->key_frame = 1;
+    avctx->coded_frame->pict_type = FF_I_TYPE;
+    for (i = 0; i < s->numXtiles * s->numYtiles * s->ncomponents; i++)
+        s->ncblk_jobs += ff_j2k_list_cblks(NULL, s->tile[i / s->ncomponents].comp + i % s->ncomponents,
+                                           codsty, i % s->ncomponents);
+    s->cblk_jobs = av_malloc(s->ncblk_jobs * sizeof(*s->cblk_jobs));
+    if (!s->cblk_jobs)
+        return AVERROR(ENOMEM);
+    s->ncblk_jobs = 0;
+    for (i = 0; i < s->numXtiles * s->numYtiles * s->ncomponents; i++)
+        s->ncblk_jobs += ff_j2k_list_cblks(s->cblk_jobs + s->ncblk_jobs,
+                                           s->tile[i / s->ncomponents].comp + i % s->ncomponents,
+                                           codsty, i % s->ncomponents);
+    s->job_ret = av_malloc(FFMAX(s->ncblk_jobs, s->numXtiles * s->numYtiles * s->ncomponents) *
+                           sizeof(*s->job_ret));
+    if (!s->job_ret)
+        return AVERROR(ENOMEM);
+
     av_log(s->avctx, AV_LOG_DEBUG, "after init\n");
 
     return 0;
@@ -1024,22 +1044,42 @@ static int j2kenc_destroy(AVCodecContext *avctx)
     J2kEncoderContext *s = avctx->priv_data;
 
     cleanup(s);
+    av_freep(&s->t1);
+    av_freep(&s->cblk_jobs);
+    av_freep(&s->job_ret);
+    av_freep(&avctx->coded_frame);
     return 0;
 }
 
-AVCodec jpeg2000_encoder = {
+#define VE AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    {"dwt", "wavelet transform", offsetof(J2kEncoderContext, dwt), FF_OPT_TYPE_INT, {.dbl = FF_DWT53}, FF_DWT97, FF_DWT53, VE, "dwt"},
+    {"97", "irreversible 9/7, lossy", 0, FF_OPT_TYPE_CONST, {.dbl = FF_DWT97}, 0, 0, VE, "dwt"},
+    {"53", "reversible 5/3, lossless", 0, FF_OPT_TYPE_CONST, {.dbl = FF_DWT53}, 0, 0, VE, "dwt"},
+    {NULL}
+};
+
+static const AVClass j2k_class = {
+    "j2k encoder",
+    av_default_item_name,
+    options,
+    LIBAVUTIL_VERSION_INT,
+};
+
+AVCodec ff_jpeg2000_encoder = {
     "j2k",
-    CODEC_TYPE_VIDEO,
+    AVMEDIA_TYPE_VIDEO,
     CODEC_ID_JPEG2000,
     sizeof(J2kEncoderContext),
     j2kenc_init,
     encode_frame,
     j2kenc_destroy,
     NULL,
-    0,
+    .capabilities = CODEC_CAP_EXPERIMENTAL | CODEC_CAP_SLICE_THREADS,
     .pix_fmts =
         (enum PixelFormat[]) {PIX_FMT_GRAY8, PIX_FMT_RGB24,
                               PIX_FMT_YUV422P, PIX_FMT_YUV444P,
                               PIX_FMT_YUV410P, PIX_FMT_YUV411P,
-                              -1}
+                              -1},
+    .priv_class = &j2k_class,
 };
@@ -1181,6 +1181,16 @@ static av_cold int mpeg_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+static av_cold int mpeg_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    Mpeg1Context *s = avctx->priv_data;
+
+    /* copied from the first thread, whose codec context a thread which
+     * initializes itself on a sequence header must not use */
+    s->mpeg_enc_ctx.avctx = avctx;
+    return 0;
+}
+
 static int mpeg_decode_update_thread_context(AVCodecContext *avctx, const AVCodecContext *avctx_from)
 {
     Mpeg1Context *ctx = avctx->priv_data, *ctx_from = avctx_from->priv_data;
@@ -1193,8 +1203,27 @@ static int mpeg_decode_update_thread_context(AVCodecContext *avctx, const AVCode
     err = ff_mpeg_update_thread_context(avctx, avctx_from);
     if(err) return err;
 
-    if(!ctx->mpeg_enc_ctx_allocated)
-        memcpy(s + 1, s1 + 1, sizeof(Mpeg1Context) - sizeof(MpegEncContext));
+    memcpy(s + 1, s1 + 1, sizeof(Mpeg1Context) - sizeof(MpegEncContext));
+
+    /* headers which are not repeated in every picture */
+    memcpy(s->intra_matrix,        s1->intra_matrix,        sizeof(s->intra_matrix));
+    memcpy(s->inter_matrix,        s1->inter_matrix,        sizeof(s->inter_matrix));
+    memcpy(s->chroma_intra_matrix, s1->chroma_intra_matrix, sizeof(s->chroma_intra_matrix));
+    memcpy(s->chroma_inter_matrix, s1->chroma_inter_matrix, sizeof(s->chroma_inter_matrix));
+    s->closed_gop = s1->closed_gop;
+
+    /* The current picture of the source thread is not finished, a packet
+     * whose picture is skipped must not end it a second time. */
+    s->current_picture_ptr = NULL;
+
+    /* Setup is finished on the first field of a field picture, the second
+     * one is in the same packet and does not concern the next thread. */
+    if(s1->first_field){
+        s->first_field    = 0;
+        s->last_pict_type = s1->pict_type;
+        if(s1->pict_type != AV_PICTURE_TYPE_B)
+            s->last_non_b_pict_type = s1->pict_type;
+    }
 
     if(!(s->pict_type == AV_PICTURE_TYPE_B || s->low_delay))
         s->picture_number++;
@@ -1287,6 +1316,11 @@ static int mpeg_decode_postinit(AVCodecContext *avctx){
         0)
     {
 
+        if (s1->mpeg_enc_ctx_allocated && (avctx->active_thread_type & FF_THREAD_FRAME)) {
+            av_log_missing_feature(avctx, "Changing the sequence parameters with frame threads is", 0);
+            return -1;
+        }
+
         if (s1->mpeg_enc_ctx_allocated) {
             ParseContext pc= s->parse_context;
             s->parse_context.buffer=0;
@@ -2006,6 +2040,8 @@ static int slice_end(AVCodecContext *avctx, AVFrame *pict)
             /* latency of 1 frame for I- and P-frames */
             /* XXX: use another variable than picture_number */
             if (s->last_picture_ptr != NULL) {
+                /* it may still be decoded by another thread */
+                ff_thread_await_progress((AVFrame*)s->last_picture_ptr, s->mb_height-1, 0);
                 *pict= *(AVFrame*)s->last_picture_ptr;
                  ff_print_debug_info(s, pict);
             }
@@ -2195,7 +2231,9 @@ static void mpeg_decode_gop(AVCodecContext *avctx,
     broken_link = get_bits1(&s->gb);
 
     snprintf(timecode, 16, "%02d:%02d:%02d%c%02d", hours, mins, secs, drop ? ';' : ':', frames);
-    if (!av_dict_get(avctx->metadata, "video_timecode", NULL, 0))
+    /* frame thread contexts share the dictionary of the user context */
+    if (!(avctx->active_thread_type & FF_THREAD_FRAME) &&
+        !av_dict_get(avctx->metadata, "video_timecode", NULL, 0))
         av_dict_set(&avctx->metadata, "video_timecode", timecode, 0);
 
     if(s->avctx->debug & FF_DEBUG_PICT_INFO)
@@ -2277,11 +2315,14 @@ static int mpeg_decode_frame(AVCodecContext *avctx,
     Mpeg1Context *s = avctx->priv_data;
     AVFrame *picture = data;
     MpegEncContext *s2 = &s->mpeg_enc_ctx;
+    Picture *last_current_picture = s2->current_picture_ptr;
+    int ret;
     av_dlog(avctx, "fill_buffer\n");
 
     if (buf_size == 0 || (buf_size == 4 && AV_RB32(buf) == SEQ_END_CODE)) {
         /* special case for last picture */
         if (s2->low_delay==0 && s2->next_picture_ptr) {
+            ff_thread_await_progress((AVFrame*)s2->next_picture_ptr, s2->mb_height-1, 0);
             *picture= *(AVFrame*)s2->next_picture_ptr;
             s2->next_picture_ptr= NULL;
 
@@ -2317,7 +2358,15 @@ static int mpeg_decode_frame(AVCodecContext *avctx,
     if(avctx->extradata && !avctx->frame_number)
         decode_chunks(avctx, picture, data_size, avctx->extradata, avctx->extradata_size);
 
-    return decode_chunks(avctx, picture, data_size, buf, buf_size);
+    ret = decode_chunks(avctx, picture, data_size, buf, buf_size);
+
+    /* Do not leave the other threads waiting on a picture which could not
+     * be completed, because of an error or a missing second field. */
+    if (HAVE_PTHREADS && (avctx->active_thread_type & FF_THREAD_FRAME) &&
+        s2->current_picture_ptr && s2->current_picture_ptr != last_current_picture)
+        ff_thread_report_progress((AVFrame*)s2->current_picture_ptr, INT_MAX, 0);
+
+    return ret;
 }
 
 static int decode_chunks(AVCodecContext *avctx,
@@ -2603,11 +2652,14 @@ AVCodec ff_mpeg2video_decoder = {
     NULL,
     mpeg_decode_end,
     mpeg_decode_frame,
-    CODEC_CAP_DRAW_HORIZ_BAND | CODEC_CAP_DR1 | CODEC_CAP_TRUNCATED | CODEC_CAP_DELAY | CODEC_CAP_SLICE_THREADS,
+    CODEC_CAP_DRAW_HORIZ_BAND | CODEC_CAP_DR1 | CODEC_CAP_TRUNCATED | CODEC_CAP_DELAY | CODEC_CAP_SLICE_THREADS |
+    CODEC_CAP_FRAME_THREADS,
     .flush= flush,
     .max_lowres= 3,
     .long_name= NULL_IF_CONFIG_SMALL("MPEG-2 video"),
     .profiles = NULL_IF_CONFIG_SMALL(mpeg2_video_profiles),
+    .init_thread_copy= ONLY_IF_THREADS_ENABLED(mpeg_decode_init_thread_copy),
+    .update_thread_context= ONLY_IF_THREADS_ENABLED(mpeg_decode_update_thread_context)
 };
 
 //legacy decoder
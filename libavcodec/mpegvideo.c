@@ -298,7 +298,9 @@ int ff_alloc_picture(MpegEncContext *s, Picture *pic, int shared){
                 FF_ALLOCZ_OR_GOTO(s->avctx, pic->f.ref_index[i], 4*mb_array_size * sizeof(uint8_t), fail)
             }
             pic->f.motion_subsample_log2 = 2;
-        }else if(s->out_format == FMT_H263 || s->encoding || (s->avctx->debug&FF_DEBUG_MV) || (s->avctx->debug_mv)){
+        }else if(s->out_format == FMT_H263 || s->encoding || (s->avctx->debug&FF_DEBUG_MV) || (s->avctx->debug_mv) ||
+                 /* error concealment would allocate them once the picture is shared with the other threads */
+                 (s->avctx->active_thread_type&FF_THREAD_FRAME)){
             for(i=0; i<2; i++){
                 FF_ALLOCZ_OR_GOTO(s->avctx, pic->motion_val_base[i], 2 * (b8_array_size+4) * sizeof(int16_t), fail)
                 pic->f.motion_val[i] = pic->motion_val_base[i] + 4;
@@ -476,6 +478,11 @@ int ff_mpeg_update_thread_context(AVCodecContext *dst, const AVCodecContext *src
         s->avctx                 = dst;
         s->picture_range_start  += MAX_PICTURE_COUNT;
         s->picture_range_end    += MAX_PICTURE_COUNT;
+        /* the first thread to be initialized is not necessarily the first one */
+        if (s->picture_range_end > s->picture_count) {
+            s->picture_range_start -= s->picture_count;
+            s->picture_range_end   -= s->picture_count;
+        }
         s->bitstream_buffer      = NULL;
         s->bitstream_buffer_size = s->allocated_bitstream_buffer_size = 0;
 
@@ -1930,10 +1937,9 @@ static inline void MPV_motion_lowres(MpegEncContext *s,
 int MPV_lowest_referenced_row(MpegEncContext *s, int dir)
 {
     int my_max = INT_MIN, my_min = INT_MAX, qpel_shift = !s->quarter_sample;
+    int field_pic = s->picture_structure != PICT_FRAME;
     int my, off, i, mvs;
 
-    if (s->picture_structure != PICT_FRAME) goto unhandled;
-
     switch (s->mv_type) {
         case MV_TYPE_16X16:
             mvs = 1;
@@ -1942,8 +1948,13 @@ int MPV_lowest_referenced_row(MpegEncContext *s, int dir)
             mvs = 2;
             break;
         case MV_TYPE_8X8:
+            if (field_pic) goto unhandled;
             mvs = 4;
             break;
+        case MV_TYPE_FIELD:
+            if (s->quarter_sample) goto unhandled;
+            mvs = field_pic ? 1 : 2;
+            break;
         default:
             goto unhandled;
     }
@@ -1954,7 +1965,14 @@ int MPV_lowest_referenced_row(MpegEncContext *s, int dir)
         my_min = FFMIN(my_min, my);
     }
 
-    off = (FFMAX(-my_min, my_max) + 63) >> 6;
+    if (field_pic || s->mv_type == MV_TYPE_FIELD) {
+        /* vectors are in field lines, which are two lines apart in the
+         * reference frame, and the bottom field ends one line lower */
+        off = (2*((FFMAX(-my_min, my_max) + 3) >> 2) + 15) >> 4;
+        if (field_pic)
+            return FFMIN(FFMAX((s->mb_y | 1) + off, 0), s->mb_height-1);
+    } else
+        off = (FFMAX(-my_min, my_max) + 63) >> 6;
 
     return FFMIN(FFMAX(s->mb_y + off, 0), s->mb_height-1);
 unhandled:
@@ -2661,6 +2679,12 @@ void ff_set_qscale(MpegEncContext * s, int qscale)
 
 void MPV_report_decode_progress(MpegEncContext *s)
 {
-    if (s->pict_type != FF_B_TYPE && !s->partitioned_frame && !s->error_occurred)
+    if (s->pict_type == FF_B_TYPE || s->partitioned_frame || s->error_occurred)
+        return;
+
+    if (s->picture_structure == PICT_FRAME)
         ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y, 0);
+    else if (!s->first_field)
+        /* a row of the second field completes two rows of the frame */
+        ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y | 1, 0);
 }
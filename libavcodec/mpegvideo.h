@@ -691,6 +691,9 @@ typedef struct MpegEncContext {
     int (*dct_quantize)(struct MpegEncContext *s, DCTELEM *block/*align 16*/, int n, int qscale, int *overflow);
     int (*fast_dct_quantize)(struct MpegEncContext *s, DCTELEM *block/*align 16*/, int n, int qscale, int *overflow);
     void (*denoise_dct)(struct MpegEncContext *s, DCTELEM *block);
+    int (*trellis_best_survivor)(const int *survivor, const int *survivor_score, int survivor_count,
+                                 const uint8_t *length, int level, int i, int distortion, int lambda,
+                                 int *best_score);
 } MpegEncContext;
 
 #define REBASE_PICTURE(pic, new_ctx, old_ctx) (pic ? \
@@ -708,6 +711,20 @@ int MPV_encode_init(AVCodecContext *avctx);
 int MPV_encode_end(AVCodecContext *avctx);
 int MPV_encode_picture(AVCodecContext *avctx, unsigned char *buf, int buf_size, void *data);
 void MPV_common_init_mmx(MpegEncContext *s);
+/**
+ * Find the survivor of the trellis search from which coding level at
+ * position i is the cheapest. The score of survivor k is distortion +
+ * length[UNI_AC_ENC_INDEX(i - survivor[k], level)] * lambda + survivor_score[k],
+ * ties go to the highest k.
+ * @param best_score score to beat, updated if a survivor beats it
+ * @return the index of that survivor, or -1 if none beats best_score
+ */
+int ff_trellis_best_survivor_c(const int *survivor, const int *survivor_score, int survivor_count,
+                               const uint8_t *length, int level, int i, int distortion, int lambda,
+                               int *best_score);
+int ff_trellis_best_survivor_avx2(const int *survivor, const int *survivor_score, int survivor_count,
+                                  const uint8_t *length, int level, int i, int distortion, int lambda,
+                                  int *best_score);
 void MPV_common_init_axp(MpegEncContext *s);
 void MPV_common_init_mlib(MpegEncContext *s);
 void MPV_common_init_mmi(MpegEncContext *s);
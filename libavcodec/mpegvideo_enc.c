@@ -702,6 +702,8 @@ av_cold int MPV_encode_init(AVCodecContext *avctx)
         s->dct_quantize = dct_quantize_c;
     if(!s->denoise_dct)
         s->denoise_dct = denoise_dct_c;
+    if(!s->trellis_best_survivor)
+        s->trellis_best_survivor = ff_trellis_best_survivor_c;
     s->fast_dct_quantize = s->dct_quantize;
     if(avctx->trellis)
         s->dct_quantize = dct_quantize_trellis_c;
@@ -966,14 +968,73 @@ static int skip_check(MpegEncContext *s, Picture *p, Picture *ref){
     return 0;
 }
 
+static int b_frame_score_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr){
+    MpegEncContext *s= arg;
+    int i= jobnr + 1;
+
+    if(s->input_picture[i] && s->input_picture[i]->b_frame_score==0){
+        s->input_picture[i]->b_frame_score=
+            get_intra_count(s, s->input_picture[i  ]->f.data[0],
+                               s->input_picture[i-1]->f.data[0], s->linesize) + 1;
+    }
+    return 0;
+}
+
+typedef struct BCountTrial {
+    AVCodecContext *c;
+    AVFrame input[FF_MAX_B_FRAMES+2];
+    uint8_t *outbuf;
+    int outbuf_size;
+    int max_b_frames;
+    int p_lambda, b_lambda, lambda2;
+    int64_t rd;
+} BCountTrial;
+
+/**
+ * Encode the downscaled pictures with b_count B-frames between the P-frames.
+ * Every candidate count has its own encoder so that the trials can run in
+ * parallel and do not depend on each other.
+ */
+static int b_count_trial_thread(AVCodecContext *avctx, void *arg, int b_count, int threadnr){
+    BCountTrial *t= (BCountTrial*)arg + b_count;
+    AVCodecContext *c= t->c;
+    int64_t rd=0;
+    int i, out_size;
+
+    t->input[0].pict_type= AV_PICTURE_TYPE_I;
+    t->input[0].quality= 1 * FF_QP2LAMBDA;
+    out_size = avcodec_encode_video(c, t->outbuf, t->outbuf_size, &t->input[0]);
+//    rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
+
+    for(i=0; i<t->max_b_frames+1; i++){
+        int is_p= i % (b_count+1) == b_count || i==t->max_b_frames;
+
+        t->input[i+1].pict_type= is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
+        t->input[i+1].quality= is_p ? t->p_lambda : t->b_lambda;
+        out_size = avcodec_encode_video(c, t->outbuf, t->outbuf_size, &t->input[i+1]);
+        rd += (out_size * t->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
+
+    /* get the delayed frames */
+    while(out_size){
+        out_size = avcodec_encode_video(c, t->outbuf, t->outbuf_size, NULL);
+        rd += (out_size * t->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
+
+    rd += c->error[0] + c->error[1] + c->error[2];
+    t->rd= rd;
+
+    return 0;
+}
+
 static int estimate_best_b_count(MpegEncContext *s){
     AVCodec *codec= avcodec_find_encoder(s->avctx->codec_id);
-    AVCodecContext *c = avcodec_alloc_context3(NULL);
-    AVFrame input[FF_MAX_B_FRAMES+2];
+    BCountTrial *trial;
+    AVFrame *input;
     const int scale= s->avctx->brd_scale;
-    int i, j, out_size, p_lambda, b_lambda, lambda2;
-    int outbuf_size= s->width * s->height; //FIXME
-    uint8_t *outbuf= av_malloc(outbuf_size);
+    const int width = s->width >> scale;
+    const int height= s->height>> scale;
+    int i, j, p_lambda, b_lambda, lambda2, nb_trials;
     int64_t best_rd= INT64_MAX;
     int best_b_count= -1;
 
@@ -985,33 +1046,28 @@ static int estimate_best_b_count(MpegEncContext *s){
     if(!b_lambda) b_lambda= p_lambda; //FIXME we should do this somewhere else
     lambda2= (b_lambda*b_lambda + (1<<FF_LAMBDA_SHIFT)/2 ) >> FF_LAMBDA_SHIFT;
 
-    c->width = s->width >> scale;
-    c->height= s->height>> scale;
-    c->flags= CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR | CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
-    c->flags|= s->avctx->flags & CODEC_FLAG_QPEL;
-    c->mb_decision= s->avctx->mb_decision;
-    c->me_cmp= s->avctx->me_cmp;
-    c->mb_cmp= s->avctx->mb_cmp;
-    c->me_sub_cmp= s->avctx->me_sub_cmp;
-    c->pix_fmt = PIX_FMT_YUV420P;
-    c->time_base= s->avctx->time_base;
-    c->max_b_frames= s->max_b_frames;
-
-    if (avcodec_open2(c, codec, NULL) < 0)
+    for(nb_trials=0; nb_trials<s->max_b_frames+1 && s->input_picture[nb_trials]; nb_trials++);
+
+    trial= av_mallocz(nb_trials * sizeof(*trial));
+    if(!trial)
         return -1;
+    input= trial[0].input;
 
     for(i=0; i<s->max_b_frames+2; i++){
-        int ysize= c->width*c->height;
-        int csize= (c->width/2)*(c->height/2);
+        int ysize= width*height;
+        int csize= (width/2)*(height/2);
         Picture pre_input, *pre_input_ptr= i ? s->input_picture[i-1] : s->next_picture_ptr;
 
         avcodec_get_frame_defaults(&input[i]);
-        input[i].data[0]= av_malloc(ysize + 2*csize);
+        /* zeroed, the pictures after the end of the stream are encoded too */
+        input[i].data[0]= av_mallocz(ysize + 2*csize);
+        if(!input[i].data[0])
+            goto fail;
         input[i].data[1]= input[i].data[0] + ysize;
         input[i].data[2]= input[i].data[1] + csize;
-        input[i].linesize[0]= c->width;
+        input[i].linesize[0]= width;
         input[i].linesize[1]=
-        input[i].linesize[2]= c->width/2;
+        input[i].linesize[2]= width/2;
 
         if(pre_input_ptr && (!i || s->input_picture[i-1])) {
             pre_input= *pre_input_ptr;
@@ -1022,55 +1078,69 @@ static int estimate_best_b_count(MpegEncContext *s){
                 pre_input.f.data[2] += INPLACE_OFFSET;
             }
 
-            s->dsp.shrink[scale](input[i].data[0], input[i].linesize[0], pre_input.f.data[0], pre_input.f.linesize[0], c->width,      c->height);
-            s->dsp.shrink[scale](input[i].data[1], input[i].linesize[1], pre_input.f.data[1], pre_input.f.linesize[1], c->width >> 1, c->height >> 1);
-            s->dsp.shrink[scale](input[i].data[2], input[i].linesize[2], pre_input.f.data[2], pre_input.f.linesize[2], c->width >> 1, c->height >> 1);
-        }
-    }
-
-    for(j=0; j<s->max_b_frames+1; j++){
-        int64_t rd=0;
-
-        if(!s->input_picture[j])
-            break;
-
-        c->error[0]= c->error[1]= c->error[2]= 0;
-
-        input[0].pict_type= AV_PICTURE_TYPE_I;
-        input[0].quality= 1 * FF_QP2LAMBDA;
-        out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[0]);
-//        rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
-
-        for(i=0; i<s->max_b_frames+1; i++){
-            int is_p= i % (j+1) == j || i==s->max_b_frames;
-
-            input[i+1].pict_type= is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
-            input[i+1].quality= is_p ? p_lambda : b_lambda;
-            out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[i+1]);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
-
-        /* get the delayed frames */
-        while(out_size){
-            out_size = avcodec_encode_video(c, outbuf, outbuf_size, NULL);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
-
-        rd += c->error[0] + c->error[1] + c->error[2];
-
-        if(rd < best_rd){
-            best_rd= rd;
+            s->dsp.shrink[scale](input[i].data[0], input[i].linesize[0], pre_input.f.data[0], pre_input.f.linesize[0], width,      height);
+            s->dsp.shrink[scale](input[i].data[1], input[i].linesize[1], pre_input.f.data[1], pre_input.f.linesize[1], width >> 1, height >> 1);
+            s->dsp.shrink[scale](input[i].data[2], input[i].linesize[2], pre_input.f.data[2], pre_input.f.linesize[2], width >> 1, height >> 1);
+        }
+    }
+
+    for(j=0; j<nb_trials; j++){
+        BCountTrial *t= &trial[j];
+        AVCodecContext *c= avcodec_alloc_context3(NULL);
+
+        t->c= c;
+        if(!c)
+            goto fail;
+        c->width = width;
+        c->height= height;
+        c->flags= CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR | CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
+        c->flags|= s->avctx->flags & CODEC_FLAG_QPEL;
+        c->mb_decision= s->avctx->mb_decision;
+        c->me_cmp= s->avctx->me_cmp;
+        c->mb_cmp= s->avctx->mb_cmp;
+        c->me_sub_cmp= s->avctx->me_sub_cmp;
+        c->pix_fmt = PIX_FMT_YUV420P;
+        c->time_base= s->avctx->time_base;
+        c->max_b_frames= s->max_b_frames;
+
+        if (avcodec_open2(c, codec, NULL) < 0)
+            goto fail;
+
+        t->outbuf_size= s->width * s->height; //FIXME
+        t->outbuf= av_malloc(t->outbuf_size);
+        if(!t->outbuf)
+            goto fail;
+        /* the downscaled pictures are only read, but each trial sets its own
+         * type and quality in them */
+        if(j)
+            memcpy(t->input, input, sizeof(t->input));
+        t->max_b_frames= s->max_b_frames;
+        t->p_lambda= p_lambda;
+        t->b_lambda= b_lambda;
+        t->lambda2= lambda2;
+    }
+
+    s->avctx->execute2(s->avctx, b_count_trial_thread, trial, NULL, nb_trials);
+
+    for(j=0; j<nb_trials; j++){
+        if(trial[j].rd < best_rd){
+            best_rd= trial[j].rd;
             best_b_count= j;
         }
     }
 
-    av_freep(&outbuf);
-    avcodec_close(c);
-    av_freep(&c);
+fail:
+    for(j=0; j<nb_trials; j++){
+        if(trial[j].c && trial[j].c->codec)
+            avcodec_close(trial[j].c);
+        av_freep(&trial[j].c);
+        av_freep(&trial[j].outbuf);
+    }
 
     for(i=0; i<s->max_b_frames+2; i++){
         av_freep(&input[i].data[0]);
     }
+    av_freep(&trial);
 
     return best_b_count;
 }
@@ -1141,13 +1211,7 @@ static int select_input_picture(MpegEncContext *s, AVFrame *pic_arg){
                 b_frames= s->max_b_frames;
                 while(b_frames && !s->input_picture[b_frames]) b_frames--;
             }else if(s->avctx->b_frame_strategy==1){
-                for(i=1; i<s->max_b_frames+1; i++){
-                    if(s->input_picture[i] && s->input_picture[i]->b_frame_score==0){
-                        s->input_picture[i]->b_frame_score=
-                            get_intra_count(s, s->input_picture[i  ]->f.data[0],
-                                               s->input_picture[i-1]->f.data[0], s->linesize) + 1;
-                    }
-                }
+                s->avctx->execute2(s->avctx, b_frame_score_thread, s, NULL, s->max_b_frames);
                 for(i=0; i<s->max_b_frames+1; i++){
                     if(s->input_picture[i]==NULL || s->input_picture[i]->b_frame_score - 1 > s->mb_num/s->avctx->b_sensitivity) break;
                 }
@@ -1160,6 +1224,8 @@ static int select_input_picture(MpegEncContext *s, AVFrame *pic_arg){
                 }
             }else if(s->avctx->b_frame_strategy==2){
                 b_frames= estimate_best_b_count(s);
+                if(b_frames < 0)
+                    return -1;
             }else{
                 av_log(s->avctx, AV_LOG_ERROR, "illegal b frame strategy\n");
                 b_frames=0;
@@ -3021,6 +3087,44 @@ static void denoise_dct_c(MpegEncContext *s, DCTELEM *block){
     }
 }
 
+static av_always_inline int best_survivor(const int *survivor, const int *survivor_score, int survivor_count,
+                                          const uint8_t *length, int level, int i, int distortion, int lambda,
+                                          int *best_score)
+{
+    int k, best= -1;
+
+    for(k=survivor_count-1; k>=0; k--){
+        int run= i - survivor[k];
+        int score= distortion + length[UNI_AC_ENC_INDEX(run, level)]*lambda;
+        score += survivor_score[k];
+
+        if(score < *best_score){
+            *best_score= score;
+            best= k;
+        }
+    }
+    return best;
+}
+
+int ff_trellis_best_survivor_c(const int *survivor, const int *survivor_score, int survivor_count,
+                               const uint8_t *length, int level, int i, int distortion, int lambda,
+                               int *best_score)
+{
+    return best_survivor(survivor, survivor_score, survivor_count, length, level, i, distortion, lambda, best_score);
+}
+
+/* below this many survivors the scalar search is faster than the SIMD ones */
+#define SIMD_SURVIVORS 12
+
+static av_always_inline int find_best_survivor(MpegEncContext *s, const int *survivor, const int *survivor_score,
+                                               int survivor_count, const uint8_t *length, int level, int i,
+                                               int distortion, int lambda, int *best_score)
+{
+    if(survivor_count < SIMD_SURVIVORS)
+        return best_survivor(survivor, survivor_score, survivor_count, length, level, i, distortion, lambda, best_score);
+    return s->trellis_best_survivor(survivor, survivor_score, survivor_count, length, level, i, distortion, lambda, best_score);
+}
+
 static int dct_quantize_trellis_c(MpegEncContext *s,
                                   DCTELEM *block, int n,
                                   int qscale, int *overflow){
@@ -3034,6 +3138,7 @@ static int dct_quantize_trellis_c(MpegEncContext *s,
     int level_tab[65];
     int score_tab[65];
     int survivor[65];
+    int survivor_score[65];
     int survivor_count;
     int last_run=0;
     int last_level=0;
@@ -3135,6 +3240,7 @@ static int dct_quantize_trellis_c(MpegEncContext *s,
 
     score_tab[start_i]= 0;
     survivor[0]= start_i;
+    survivor_score[0]= 0;
     survivor_count= 1;
 
     for(i=start_i; i<=last_non_zero; i++){
@@ -3175,29 +3281,20 @@ static int dct_quantize_trellis_c(MpegEncContext *s,
             distortion= (unquant_coeff - dct_coeff) * (unquant_coeff - dct_coeff) - zero_distortion;
             level+=64;
             if((level&(~127)) == 0){
-                for(j=survivor_count-1; j>=0; j--){
-                    int run= i - survivor[j];
-                    int score= distortion + length[UNI_AC_ENC_INDEX(run, level)]*lambda;
-                    score += score_tab[i-run];
-
-                    if(score < best_score){
-                        best_score= score;
-                        run_tab[i+1]= run;
-                        level_tab[i+1]= level-64;
-                    }
+                j= find_best_survivor(s, survivor, survivor_score, survivor_count,
+                                      length, level, i, distortion, lambda, &best_score);
+                if(j >= 0){
+                    run_tab[i+1]= i - survivor[j];
+                    level_tab[i+1]= level-64;
                 }
 
                 if(s->out_format == FMT_H263){
-                    for(j=survivor_count-1; j>=0; j--){
-                        int run= i - survivor[j];
-                        int score= distortion + last_length[UNI_AC_ENC_INDEX(run, level)]*lambda;
-                        score += score_tab[i-run];
-                        if(score < last_score){
-                            last_score= score;
-                            last_run= run;
-                            last_level= level-64;
-                            last_i= i+1;
-                        }
+                    j= find_best_survivor(s, survivor, survivor_score, survivor_count,
+                                          last_length, level, i, distortion, lambda, &last_score);
+                    if(j >= 0){
+                        last_run= i - survivor[j];
+                        last_level= level-64;
+                        last_i= i+1;
                     }
                 }
             }else{
@@ -3243,6 +3340,7 @@ static int dct_quantize_trellis_c(MpegEncContext *s,
             }
         }
 
+        survivor_score[ survivor_count ]= best_score;
         survivor[ survivor_count++ ]= i+1;
     }
 
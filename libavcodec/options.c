@@ -556,6 +556,7 @@ int avcodec_copy_context(AVCodecContext *dest, const AVCodecContext *src)
     dest->palctrl         = NULL;
     dest->slice_offset    = NULL;
     dest->internal_buffer = NULL;
+    dest->frame_pool      = NULL;
     dest->hwaccel         = NULL;
     dest->thread_opaque   = NULL;
 
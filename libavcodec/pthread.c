@@ -32,6 +32,7 @@
 #include <pthread.h>
 
 #include "avcodec.h"
+#include "internal.h"
 #include "thread.h"
 
 typedef int (action_func)(AVCodecContext *c, void *arg);
@@ -74,7 +75,8 @@ typedef struct PerThreadContext {
     AVCodecContext *avctx;          ///< Context used to decode packets passed to this thread.
 
     AVPacket       avpkt;           ///< Input packet (for decoding) or output (for encoding).
-    int            allocated_buf_size; ///< Size allocated for avpkt.data
+    uint8_t       *buf;             ///< Copy of the input packet data, if it is not refcounted.
+    int            allocated_buf_size; ///< Size allocated for buf
 
     AVFrame frame;                  ///< Output frame (for decoding) or input (for encoding).
     int     got_frame;              ///< The output of got_picture_ptr from the last avcodec_decode_video() call.
@@ -424,7 +426,7 @@ static int submit_packet(PerThreadContext *p, AVPacket *avpkt)
     FrameThreadContext *fctx = p->parent;
     PerThreadContext *prev_thread = fctx->prev_thread;
     AVCodec *codec = p->avctx->codec;
-    uint8_t *buf = p->avpkt.data;
+    int err;
 
     if (!avpkt->size && !(codec->capabilities & CODEC_CAP_DELAY)) return 0;
 
@@ -433,7 +435,6 @@ static int submit_packet(PerThreadContext *p, AVPacket *avpkt)
     release_delayed_buffers(p);
 
     if (prev_thread) {
-        int err;
         if (prev_thread->state == STATE_SETTING_UP) {
             pthread_mutex_lock(&prev_thread->progress_mutex);
             while (prev_thread->state == STATE_SETTING_UP)
@@ -448,11 +449,26 @@ static int submit_packet(PerThreadContext *p, AVPacket *avpkt)
         }
     }
 
-    av_fast_malloc(&buf, &p->allocated_buf_size, avpkt->size + FF_INPUT_BUFFER_PADDING_SIZE);
-    p->avpkt = *avpkt;
-    p->avpkt.data = buf;
-    memcpy(buf, avpkt->data, avpkt->size);
-    memset(buf + avpkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    /* a refcounted payload is shared with the thread, anything else is copied */
+    av_free_packet(&p->avpkt);
+    if (ff_packet_is_refcounted(avpkt)) {
+        err = av_packet_ref(&p->avpkt, avpkt);
+    } else {
+        err = 0;
+        av_fast_malloc(&p->buf, &p->allocated_buf_size, avpkt->size + FF_INPUT_BUFFER_PADDING_SIZE);
+        if (p->buf) {
+            p->avpkt          = *avpkt;
+            p->avpkt.data     = p->buf;
+            p->avpkt.destruct = NULL;
+            memcpy(p->buf, avpkt->data, avpkt->size);
+            memset(p->buf + avpkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+        } else
+            err = AVERROR(ENOMEM);
+    }
+    if (err) {
+        pthread_mutex_unlock(&p->mutex);
+        return err;
+    }
 
     p->state = STATE_SETTING_UP;
     pthread_cond_signal(&p->input_cond);
@@ -535,7 +551,9 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
 
         *picture = p->frame;
         *got_picture_ptr = p->got_frame;
-        picture->pkt_dts = p->avpkt.dts;
+        /* a frame flushed out of the decoder belongs to the current packet,
+         * like without threads, not to the first empty packet */
+        picture->pkt_dts = p->avpkt.size ? p->avpkt.dts : avpkt->dts;
 
         /*
          * A later call with avkpt->size == 0 may loop over all threads,
@@ -661,7 +679,8 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
         pthread_cond_destroy(&p->input_cond);
         pthread_cond_destroy(&p->progress_cond);
         pthread_cond_destroy(&p->output_cond);
-        av_freep(&p->avpkt.data);
+        av_free_packet(&p->avpkt);
+        av_freep(&p->buf);
 
         if (i)
             av_freep(&p->avctx->priv_data);
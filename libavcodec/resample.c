@@ -26,6 +26,7 @@
 
 #include "avcodec.h"
 #include "audioconvert.h"
+#include "resample2.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
 
@@ -55,6 +56,13 @@ struct ReSampleContext {
     unsigned sample_size[2];           ///< size of one sample in sample_fmt
     short *buffer[2];                  ///< buffers used for conversion to S16
     unsigned buffer_size[2];           ///< sizes of allocated buffers
+    /* planar float resampling, used instead of S16 when the input or the
+       output has more than 16 bits and the channel count is unchanged */
+    int use_flt;
+    float *flt_in[MAX_CHANNELS];       ///< unconsumed input followed by new input
+    float *flt_out[MAX_CHANNELS];
+    int flt_in_size, flt_out_size;     ///< allocated samples per channel
+    int flt_temp_len;                  ///< unconsumed input samples
 };
 
 /* n1: number of samples */
@@ -252,7 +260,13 @@ ReSampleContext *av_audio_resample_init(int output_channels, int input_channels,
     s->sample_size[0] = av_get_bytes_per_sample(s->sample_fmt[0]);
     s->sample_size[1] = av_get_bytes_per_sample(s->sample_fmt[1]);
 
-    if (s->sample_fmt[0] != AV_SAMPLE_FMT_S16) {
+    s->use_flt = input_channels == output_channels &&
+                 (sample_fmt_in  != AV_SAMPLE_FMT_S16 ||
+                  sample_fmt_out != AV_SAMPLE_FMT_S16) &&
+                 sample_fmt_in  != AV_SAMPLE_FMT_U8 &&
+                 sample_fmt_out != AV_SAMPLE_FMT_U8;
+
+    if (s->sample_fmt[0] != AV_SAMPLE_FMT_S16 && !s->use_flt) {
         if (!(s->convert_ctx[0] = av_audio_convert_alloc(AV_SAMPLE_FMT_S16, 1,
                                                          s->sample_fmt[0], 1, NULL, 0))) {
             av_log(s, AV_LOG_ERROR,
@@ -263,7 +277,7 @@ ReSampleContext *av_audio_resample_init(int output_channels, int input_channels,
         }
     }
 
-    if (s->sample_fmt[1] != AV_SAMPLE_FMT_S16) {
+    if (s->sample_fmt[1] != AV_SAMPLE_FMT_S16 && !s->use_flt) {
         if (!(s->convert_ctx[1] = av_audio_convert_alloc(s->sample_fmt[1], 1,
                                                          AV_SAMPLE_FMT_S16, 1, NULL, 0))) {
             av_log(s, AV_LOG_ERROR,
@@ -285,6 +299,104 @@ ReSampleContext *av_audio_resample_init(int output_channels, int input_channels,
     return s;
 }
 
+static int realloc_planes(float **planes, int nb_planes, int *size, int new_size)
+{
+    int i;
+
+    if (new_size <= *size)
+        return 0;
+    if (new_size > INT_MAX / sizeof(float))
+        return AVERROR(EINVAL);
+    for (i = 0; i < nb_planes; i++) {
+        float *p = av_realloc(planes[i], new_size * sizeof(float));
+        if (!p)
+            return AVERROR(ENOMEM);
+        planes[i] = p;
+    }
+    *size = new_size;
+    return 0;
+}
+
+static void deinterleave_to_flt(float **out, const void *input, enum AVSampleFormat fmt,
+                                int channels, int samples)
+{
+    int i, ch;
+
+#define DEINTERLEAVE(type, expr)                                \
+    {                                                           \
+        const type *in = input;                                 \
+        for (i = 0; i < samples; i++)                           \
+            for (ch = 0; ch < channels; ch++, in++)             \
+                out[ch][i] = expr;                              \
+    }
+
+    switch (fmt) {
+    case AV_SAMPLE_FMT_S16: DEINTERLEAVE(int16_t, *in * (1.0f / (1 << 15))); break;
+    case AV_SAMPLE_FMT_S32: DEINTERLEAVE(int32_t, *in * (1.0f / (1U << 31))); break;
+    case AV_SAMPLE_FMT_FLT: DEINTERLEAVE(float,   *in);                       break;
+    case AV_SAMPLE_FMT_DBL: DEINTERLEAVE(double,  *in);                       break;
+    default: break;
+    }
+}
+
+static void interleave_from_flt(void *output, float **in, enum AVSampleFormat fmt,
+                                int channels, int samples)
+{
+    int i, ch;
+
+#define INTERLEAVE(type, expr)                                  \
+    {                                                           \
+        type *out = output;                                     \
+        for (i = 0; i < samples; i++)                           \
+            for (ch = 0; ch < channels; ch++, out++) {          \
+                float v = in[ch][i];                            \
+                *out = expr;                                    \
+            }                                                   \
+    }
+
+    switch (fmt) {
+    case AV_SAMPLE_FMT_S16: INTERLEAVE(int16_t, av_clip_int16(lrintf(v * (1 << 15))));         break;
+    case AV_SAMPLE_FMT_S32: INTERLEAVE(int32_t, av_clipl_int32(llrint(v * (double)(1U << 31)))); break;
+    case AV_SAMPLE_FMT_FLT: INTERLEAVE(float,   v);                                           break;
+    case AV_SAMPLE_FMT_DBL: INTERLEAVE(double,  v);                                           break;
+    default: break;
+    }
+}
+
+/* resample in planar float, all channels at once, without going through
+   S16, so that 24 bits samples keep their precision */
+static int audio_resample_flt(ReSampleContext *s, void *output, const void *input,
+                              int nb_samples)
+{
+    float *in[MAX_CHANNELS];
+    int i, consumed, nb_out, lenout;
+    int channels = s->input_channels;
+
+    lenout = nb_samples * s->ratio + 16;
+    if (realloc_planes(s->flt_in, channels, &s->flt_in_size,
+                       s->flt_temp_len + nb_samples) < 0 ||
+        realloc_planes(s->flt_out, channels, &s->flt_out_size, lenout) < 0) {
+        av_log(s->resample_context, AV_LOG_ERROR, "Could not allocate buffer\n");
+        return 0;
+    }
+
+    for (i = 0; i < channels; i++)
+        in[i] = s->flt_in[i] + s->flt_temp_len;
+    deinterleave_to_flt(in, input, s->sample_fmt[0], channels, nb_samples);
+    nb_samples += s->flt_temp_len;
+
+    nb_out = ff_resample_flt(s->resample_context, s->flt_out, s->flt_in,
+                             channels, &consumed, nb_samples, lenout, 1);
+
+    s->flt_temp_len = nb_samples - consumed;
+    for (i = 0; i < channels; i++)
+        memmove(s->flt_in[i], s->flt_in[i] + consumed,
+                s->flt_temp_len * sizeof(float));
+
+    interleave_from_flt(output, s->flt_out, s->sample_fmt[1], channels, nb_out);
+    return nb_out;
+}
+
 /* resample audio. 'nb_samples' is the number of input samples */
 /* XXX: optimize it ! */
 int audio_resample(ReSampleContext *s, short *output, short *input, int nb_samples)
@@ -296,6 +408,9 @@ int audio_resample(ReSampleContext *s, short *output, short *input, int nb_sampl
     short *output_bak = NULL;
     int lenout;
 
+    if (s->use_flt)
+        return audio_resample_flt(s, output, input, nb_samples);
+
     if (s->input_channels == s->output_channels && s->ratio == 1.0 && 0) {
         /* nothing to do */
         memcpy(output, input, nb_samples * s->input_channels * sizeof(short));
@@ -427,8 +542,11 @@ void audio_resample_close(ReSampleContext *s)
 {
     int i;
     av_resample_close(s->resample_context);
-    for (i = 0; i < s->filter_channels; i++)
+    for (i = 0; i < s->filter_channels; i++) {
         av_freep(&s->temp[i]);
+        av_freep(&s->flt_in[i]);
+        av_freep(&s->flt_out[i]);
+    }
     av_freep(&s->buffer[0]);
     av_freep(&s->buffer[1]);
     av_audio_convert_free(s->convert_ctx[0]);
@@ -27,6 +27,7 @@
 
 #include "avcodec.h"
 #include "dsputil.h"
+#include "resample2.h"
 
 #ifndef CONFIG_RESAMPLE_HP
 #define FILTER_SHIFT 15
@@ -69,6 +70,9 @@ typedef struct AVResampleContext{
     int phase_shift;
     int phase_mask;
     int linear;
+    float *filter_bank_flt;   ///< float filters, filter_stride_flt taps each
+    int filter_stride_flt;
+    ResampleDSPContext dsp;
 }AVResampleContext;
 
 /**
@@ -94,9 +98,12 @@ static double bessel(double x){
  * @param factor resampling factor
  * @param scale wanted sum of coefficients for each filter
  * @param type 0->cubic, 1->blackman nuttall windowed sinc, 2..16->kaiser windowed sinc beta=2..16
+ * @param filter_flt if not NULL, also store the filters as float, with a sum of 1
+ * @param stride_flt distance between 2 filters in filter_flt
  * @return 0 on success, negative on error
  */
-static int build_filter(FELEM *filter, double factor, int tap_count, int phase_count, int scale, int type){
+static int build_filter(FELEM *filter, double factor, int tap_count, int phase_count, int scale, int type,
+                        float *filter_flt, int stride_flt){
     int ph, i;
     double x, y, w;
     double *tab = av_malloc(tap_count * sizeof(*tab));
@@ -143,6 +150,8 @@ static int build_filter(FELEM *filter, double factor, int tap_count, int phase_c
 #else
             filter[ph * tap_count + i] = av_clip(lrintf(tab[i] * scale / norm), FELEM_MIN, FELEM_MAX);
 #endif
+            if (filter_flt)
+                filter_flt[ph * stride_flt + i] = tab[i] / norm;
         }
     }
 #if 0
@@ -202,10 +211,18 @@ AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size,
     c->filter_bank= av_mallocz(c->filter_length*(phase_count+1)*sizeof(FELEM));
     if (!c->filter_bank)
         goto error;
-    if (build_filter(c->filter_bank, factor, c->filter_length, phase_count, 1<<FILTER_SHIFT, WINDOW_TYPE))
+    c->filter_stride_flt= FFALIGN(c->filter_length, RESAMPLE_FLT_ALIGN);
+    c->filter_bank_flt= av_mallocz(c->filter_stride_flt*(phase_count+1)*sizeof(float));
+    if (!c->filter_bank_flt)
+        goto error;
+    if (build_filter(c->filter_bank, factor, c->filter_length, phase_count, 1<<FILTER_SHIFT, WINDOW_TYPE,
+                     c->filter_bank_flt, c->filter_stride_flt))
         goto error;
     memcpy(&c->filter_bank[c->filter_length*phase_count+1], c->filter_bank, (c->filter_length-1)*sizeof(FELEM));
     c->filter_bank[c->filter_length*phase_count]= c->filter_bank[c->filter_length - 1];
+    memcpy(&c->filter_bank_flt[c->filter_stride_flt*phase_count+1], c->filter_bank_flt, (c->filter_length-1)*sizeof(float));
+    c->filter_bank_flt[c->filter_stride_flt*phase_count]= c->filter_bank_flt[c->filter_length - 1];
+    ff_resample_dsp_init(&c->dsp);
 
     c->src_incr= out_rate;
     c->ideal_dst_incr= c->dst_incr= in_rate * phase_count;
@@ -214,12 +231,14 @@ AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size,
     return c;
 error:
     av_free(c->filter_bank);
+    av_free(c->filter_bank_flt);
     av_free(c);
     return NULL;
 }
 
 void av_resample_close(AVResampleContext *c){
     av_freep(&c->filter_bank);
+    av_freep(&c->filter_bank_flt);
     av_freep(&c);
 }
 
@@ -318,3 +337,89 @@ av_log(NULL, AV_LOG_DEBUG, "%d %d %d\n", c->dst_incr, c->ideal_dst_incr, c->comp
 
     return dst_index;
 }
+
+static float dot_flt_c(const float *src, const float *filter, int len){
+    float sum[8]= {0};
+    int i, j;
+
+    /* 8 partial sums, added up in the same order as the SIMD versions so
+     * that all of them give the same output */
+    for(i=0; i<len; i+=8)
+        for(j=0; j<8; j++)
+            sum[j] += src[i+j] * filter[i+j];
+    for(j=0; j<4; j++)
+        sum[j] += sum[j+4];
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+}
+
+void ff_resample_dsp_init(ResampleDSPContext *c){
+    c->dot_flt= dot_flt_c;
+
+    if (HAVE_MMX) ff_resample_dsp_init_x86(c);
+}
+
+int ff_resample_flt(AVResampleContext *c, float **dst, float **src, int nb_channels,
+                    int *consumed, int src_size, int dst_size, int update_ctx){
+    int dst_index, i, ch;
+    int index= c->index;
+    int frac= c->frac;
+    int dst_incr_frac= c->dst_incr % c->src_incr;
+    int dst_incr=      c->dst_incr / c->src_incr;
+    int compensation_distance= c->compensation_distance;
+    int stride= c->filter_stride_flt;
+
+    for(dst_index=0; dst_index < dst_size; dst_index++){
+        const float *filter= c->filter_bank_flt + stride*(index & c->phase_mask);
+        int sample_index= index >> c->phase_shift;
+
+        if(sample_index < 0){
+            for(ch=0; ch<nb_channels; ch++){
+                float val=0;
+                for(i=0; i<c->filter_length; i++)
+                    val += src[ch][FFABS(sample_index + i) % src_size] * filter[i];
+                dst[ch][dst_index]= val;
+            }
+        }else if(sample_index + stride > src_size){
+            /* the dot product reads the zero padded taps too */
+            break;
+        }else if(c->linear){
+            float f= frac / (float)c->src_incr;
+            for(ch=0; ch<nb_channels; ch++){
+                float v1= c->dsp.dot_flt(src[ch] + sample_index, filter, stride);
+                float v2= c->dsp.dot_flt(src[ch] + sample_index, filter + stride, stride);
+                dst[ch][dst_index]= v1 + (v2 - v1) * f;
+            }
+        }else{
+            for(ch=0; ch<nb_channels; ch++)
+                dst[ch][dst_index]= c->dsp.dot_flt(src[ch] + sample_index, filter, stride);
+        }
+
+        frac += dst_incr_frac;
+        index += dst_incr;
+        if(frac >= c->src_incr){
+            frac -= c->src_incr;
+            index++;
+        }
+
+        if(dst_index + 1 == compensation_distance){
+            compensation_distance= 0;
+            dst_incr_frac= c->ideal_dst_incr % c->src_incr;
+            dst_incr=      c->ideal_dst_incr / c->src_incr;
+        }
+    }
+    *consumed= FFMAX(index, 0) >> c->phase_shift;
+    if(index>=0) index &= c->phase_mask;
+
+    if(compensation_distance){
+        compensation_distance -= dst_index;
+        assert(compensation_distance > 0);
+    }
+    if(update_ctx){
+        c->frac= frac;
+        c->index= index;
+        c->dst_incr= dst_incr_frac + c->src_incr*dst_incr;
+        c->compensation_distance= compensation_distance;
+    }
+
+    return dst_index;
+}
@@ -0,0 +1,59 @@
+/*
+ * audio resampling
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_RESAMPLE2_H
+#define AVCODEC_RESAMPLE2_H
+
+#include "avcodec.h"
+
+/** float filters are zero padded to a multiple of this many taps */
+#define RESAMPLE_FLT_ALIGN 8
+
+typedef struct ResampleDSPContext {
+    /**
+     * Compute the dot product of a float filter and float samples.
+     * @param src samples, no alignment constraint
+     * @param filter filter taps, no alignment constraint
+     * @param len number of taps, multiple of RESAMPLE_FLT_ALIGN
+     */
+    float (*dot_flt)(const float *src, const float *filter, int len);
+} ResampleDSPContext;
+
+void ff_resample_dsp_init(ResampleDSPContext *c);
+void ff_resample_dsp_init_x86(ResampleDSPContext *c);
+
+/**
+ * Resample planar float audio, several channels at once.
+ * All channels share the same filter phase for each output sample, so the
+ * phase is computed once and applied to every channel.
+ * @param dst array of nb_channels output buffers
+ * @param src array of nb_channels input buffers
+ * @param consumed the number of samples of src which have been consumed are
+ *                 returned here
+ * @param src_size the number of unconsumed samples available in each src
+ * @param dst_size the amount of space in samples available in each dst
+ * @param update_ctx if 0 the context is not modified
+ * @return the number of samples written to each dst
+ */
+int ff_resample_flt(struct AVResampleContext *c, float **dst, float **src,
+                    int nb_channels, int *consumed, int src_size, int dst_size,
+                    int update_ctx);
+
+#endif /* AVCODEC_RESAMPLE2_H */
@@ -22,8 +22,21 @@
 
 #include "libavutil/intreadwrite.h"
 #include "avcodec.h"
+#include "s302mdsp.h"
 
-#define AES3_HEADER_LEN 4
+typedef struct S302MDecContext {
+    S302MDSPContext dsp;
+    uint8_t *buf;           ///< bit reversed payload, padded by 8 bytes
+    unsigned int buf_size;
+} S302MDecContext;
+
+static av_cold int s302m_decode_init(AVCodecContext *avctx)
+{
+    S302MDecContext *s = avctx->priv_data;
+
+    ff_s302m_dsp_init(&s->dsp);
+    return 0;
+}
 
 static int s302m_parse_frame_header(AVCodecContext *avctx, const uint8_t *buf,
                                     int buf_size)
@@ -91,8 +104,10 @@ static int s302m_parse_frame_header(AVCodecContext *avctx, const uint8_t *buf,
 static int s302m_decode_frame(AVCodecContext *avctx, void *data,
                               int *data_size, AVPacket *avpkt)
 {
+    S302MDecContext *s = avctx->priv_data;
     const uint8_t *buf = avpkt->data;
     int buf_size       = avpkt->size;
+    const uint8_t *p;
 
     int frame_size = s302m_parse_frame_header(avctx, buf, buf_size);
     if (frame_size < 0)
@@ -104,40 +119,40 @@ static int s302m_decode_frame(AVCodecContext *avctx, void *data,
     if (*data_size < 4 * buf_size * 8 / (avctx->bits_per_coded_sample + 4))
         return -1;
 
+    /* reverse the bits of the whole payload at once, the subframes are
+       then extracted from little endian words with plain shifts */
+    av_fast_malloc(&s->buf, &s->buf_size, buf_size + 8);
+    if (!s->buf)
+        return AVERROR(ENOMEM);
+    s->dsp.reverse_bits(s->buf, buf, buf_size);
+    buf += buf_size;
+    p    = s->buf;
+
     if (avctx->bits_per_coded_sample == 24) {
         uint32_t *o = data;
         for (; buf_size > 6; buf_size -= 7) {
-            *o++ = (av_reverse[buf[2]]        << 24) |
-                   (av_reverse[buf[1]]        << 16) |
-                   (av_reverse[buf[0]]        <<  8);
-            *o++ = (av_reverse[buf[6] & 0xf0] << 28) |
-                   (av_reverse[buf[5]]        << 20) |
-                   (av_reverse[buf[4]]        << 12) |
-                   (av_reverse[buf[3] & 0x0f] <<  4);
-            buf += 7;
+            uint64_t w = AV_RL64(p);
+            *o++ =  (w        & 0xffffff) << 8;
+            *o++ = ((w >> 28) & 0xffffff) << 8;
+            p += 7;
         }
         *data_size = (uint8_t*) o - (uint8_t*) data;
     } else if (avctx->bits_per_coded_sample == 20) {
         uint32_t *o = data;
         for (; buf_size > 5; buf_size -= 6) {
-            *o++ = (av_reverse[buf[2] & 0xf0] << 28) |
-                   (av_reverse[buf[1]]        << 20) |
-                   (av_reverse[buf[0]]        << 12);
-            *o++ = (av_reverse[buf[5] & 0xf0] << 28) |
-                   (av_reverse[buf[4]]        << 20) |
-                   (av_reverse[buf[3]]        << 12);
-            buf += 6;
+            uint64_t w = AV_RL64(p);
+            *o++ =  (w        & 0xfffff) << 12;
+            *o++ = ((w >> 24) & 0xfffff) << 12;
+            p += 6;
         }
         *data_size = (uint8_t*) o - (uint8_t*) data;
     } else {
         uint16_t *o = data;
         for (; buf_size > 4; buf_size -= 5) {
-            *o++ = (av_reverse[buf[1]]        <<  8) |
-                    av_reverse[buf[0]];
-            *o++ = (av_reverse[buf[4] & 0xf0] << 12) |
-                   (av_reverse[buf[3]]        <<  4) |
-                   (av_reverse[buf[2]]        >>  4);
-            buf += 5;
+            uint64_t w = AV_RL64(p);
+            *o++ =  w        & 0xffff;
+            *o++ = (w >> 20) & 0xffff;
+            p += 5;
         }
         *data_size = (uint8_t*) o - (uint8_t*) data;
     }
@@ -145,12 +160,22 @@ static int s302m_decode_frame(AVCodecContext *avctx, void *data,
     return buf - avpkt->data;
 }
 
+static av_cold int s302m_decode_close(AVCodecContext *avctx)
+{
+    S302MDecContext *s = avctx->priv_data;
+
+    av_freep(&s->buf);
+    return 0;
+}
+
 
 AVCodec ff_s302m_decoder = {
     .name           = "s302m",
     .type           = AVMEDIA_TYPE_AUDIO,
     .id             = CODEC_ID_S302M,
-    .priv_data_size = 0,
+    .priv_data_size = sizeof(S302MDecContext),
+    .init           = s302m_decode_init,
     .decode         = s302m_decode_frame,
+    .close          = s302m_decode_close,
     .long_name      = NULL_IF_CONFIG_SMALL("SMPTE 302M"),
 };
@@ -0,0 +1,38 @@
+/*
+ * SMPTE 302M DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "s302mdsp.h"
+
+static void reverse_bits_c(uint8_t *dst, const uint8_t *src, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        dst[i] = av_reverse[src[i]];
+}
+
+void ff_s302m_dsp_init(S302MDSPContext *c)
+{
+    c->reverse_bits = reverse_bits_c;
+
+    if (HAVE_MMX) ff_s302m_dsp_init_x86(c);
+}
@@ -0,0 +1,40 @@
+/*
+ * SMPTE 302M DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_S302MDSP_H
+#define AVCODEC_S302MDSP_H
+
+#include <stdint.h>
+
+#define AES3_HEADER_LEN 4
+
+typedef struct S302MDSPContext {
+    /**
+     * Reverse the bit order of each byte.
+     * @param dst output, may be equal to src
+     * @param src input, no alignment constraint
+     */
+    void (*reverse_bits)(uint8_t *dst, const uint8_t *src, int len);
+} S302MDSPContext;
+
+void ff_s302m_dsp_init(S302MDSPContext *c);
+void ff_s302m_dsp_init_x86(S302MDSPContext *c);
+
+#endif /* AVCODEC_S302MDSP_H */
@@ -0,0 +1,195 @@
+/*
+ * SMPTE 302M encoder
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "avcodec.h"
+#include "s302mdsp.h"
+
+/* one PES per frame, 40 ms at 48kHz */
+#define S302M_FRAME_SIZE 1920
+
+/* AES3 block start flag F of a VUCF nibble, given with bits reversed since
+   the whole payload is bit reversed after packing */
+#define F_HI 0x08 /* VUCF in the high nibble of a byte */
+#define F_LO 0x80 /* VUCF in the low nibble of a byte */
+
+typedef struct S302MEncContext {
+    AVClass *av_class;
+    int bits;           ///< requested bits per sample, 0 for automatic
+    S302MDSPContext dsp;
+    uint8_t *buf;       ///< payload before bit reversal, padded by 8 bytes
+    int pair_size;      ///< bytes per channel pair and sample
+    int framing_index;  ///< position in the 192 frames AES3 block
+} S302MEncContext;
+
+static av_cold int s302m_encode_init(AVCodecContext *avctx)
+{
+    S302MEncContext *s = avctx->priv_data;
+    int bits;
+
+    if (avctx->channels < 2 || avctx->channels > 8 || avctx->channels & 1) {
+        av_log(avctx, AV_LOG_ERROR, "encoding %d channels is not allowed, "
+               "only 2, 4, 6 and 8 channels are supported\n", avctx->channels);
+        return AVERROR(EINVAL);
+    }
+    if (avctx->sample_rate != 48000) {
+        av_log(avctx, AV_LOG_ERROR, "sample rate must be 48000\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (avctx->sample_fmt == AV_SAMPLE_FMT_S16) {
+        bits = 16;
+    } else if (s->bits) {
+        bits = s->bits;
+    } else if (avctx->bits_per_raw_sample && avctx->bits_per_raw_sample <= 20) {
+        bits = 20;
+    } else
+        bits = 24;
+    /* 16 bits are read from s16 samples, 20 and 24 bits from s32 ones */
+    if ((s->bits && s->bits != bits) ||
+        (bits == 16 ? avctx->sample_fmt != AV_SAMPLE_FMT_S16 :
+                      avctx->sample_fmt != AV_SAMPLE_FMT_S32 || (bits != 20 && bits != 24))) {
+        av_log(avctx, AV_LOG_ERROR, "%d bits per sample are not supported with "
+               "sample format %s\n", s->bits ? s->bits : bits,
+               av_get_sample_fmt_name(avctx->sample_fmt));
+        return AVERROR(EINVAL);
+    }
+
+    avctx->bits_per_coded_sample = bits;
+    avctx->frame_size  = S302M_FRAME_SIZE;
+    avctx->bit_rate    = (AES3_HEADER_LEN * 8 * 48000 / S302M_FRAME_SIZE) +
+                         48000 * avctx->channels * (bits + 4);
+    s->pair_size       = (2 * (bits + 4)) >> 3;
+
+    s->buf = av_malloc(S302M_FRAME_SIZE * avctx->channels / 2 * s->pair_size + 8);
+    avctx->coded_frame = avcodec_alloc_frame();
+    if (!s->buf || !avctx->coded_frame)
+        return AVERROR(ENOMEM);
+    avctx->coded_frame->key_frame = 1;
+
+    ff_s302m_dsp_init(&s->dsp);
+    return 0;
+}
+
+/**
+ * Pack the channel pairs of one frame as little endian words whose bytes
+ * are the bit reversed bytes of the stream, subframe bits are then simple
+ * shifts, the byte order of the 302M payload is restored by reverse_bits().
+ */
+static int s302m_encode_frame(AVCodecContext *avctx, uint8_t *buf,
+                              int buf_size, void *data)
+{
+    S302MEncContext *s = avctx->priv_data;
+    int nb_pairs = avctx->frame_size * avctx->channels / 2;
+    int pairs_per_sample = avctx->channels / 2;
+    int payload_size = nb_pairs * s->pair_size;
+    uint8_t *o = s->buf;
+    int i, c;
+
+    if (buf_size < AES3_HEADER_LEN + payload_size) {
+        av_log(avctx, AV_LOG_ERROR, "output buffer too small\n");
+        return AVERROR(EINVAL);
+    }
+
+    /* size, channels, channel id, bits per sample, alignment */
+    AV_WB32(buf, (payload_size << 16) |
+                 ((avctx->channels - 2) << 13) |
+                 ((avctx->bits_per_coded_sample - 16) << 2));
+
+    if (avctx->bits_per_coded_sample == 24) {
+        const uint32_t *samples = data;
+        for (i = 0; i < avctx->frame_size; i++) {
+            uint64_t f = s->framing_index ? 0 : (F_HI << 24) | ((uint64_t)F_LO << 48);
+            for (c = 0; c < pairs_per_sample; c++) {
+                AV_WL64(o, (samples[0] >> 8) | ((uint64_t)(samples[1] >> 8) << 28) | f);
+                samples += 2;
+                o += 7;
+            }
+            if (++s->framing_index >= 192)
+                s->framing_index = 0;
+        }
+    } else if (avctx->bits_per_coded_sample == 20) {
+        const uint32_t *samples = data;
+        for (i = 0; i < avctx->frame_size; i++) {
+            uint64_t f = s->framing_index ? 0 : (F_LO << 16) | ((uint64_t)F_LO << 40);
+            for (c = 0; c < pairs_per_sample; c++) {
+                AV_WL64(o, (samples[0] >> 12) | ((uint64_t)(samples[1] >> 12) << 24) | f);
+                samples += 2;
+                o += 6;
+            }
+            if (++s->framing_index >= 192)
+                s->framing_index = 0;
+        }
+    } else {
+        const uint16_t *samples = data;
+        for (i = 0; i < avctx->frame_size; i++) {
+            uint64_t f = s->framing_index ? 0 : (F_HI << 16) | ((uint64_t)F_LO << 32);
+            for (c = 0; c < pairs_per_sample; c++) {
+                AV_WL64(o, samples[0] | ((uint64_t)samples[1] << 20) | f);
+                samples += 2;
+                o += 5;
+            }
+            if (++s->framing_index >= 192)
+                s->framing_index = 0;
+        }
+    }
+
+    s->dsp.reverse_bits(buf + AES3_HEADER_LEN, s->buf, payload_size);
+
+    return AES3_HEADER_LEN + payload_size;
+}
+
+static av_cold int s302m_encode_close(AVCodecContext *avctx)
+{
+    S302MEncContext *s = avctx->priv_data;
+
+    av_freep(&s->buf);
+    av_freep(&avctx->coded_frame);
+    return 0;
+}
+
+#define S302M_FLAGS AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_AUDIO_PARAM
+static const AVOption s302m_options[] = {
+    {"bits", "Bits per sample, 20 or 24 with s32 samples", offsetof(S302MEncContext, bits), FF_OPT_TYPE_INT, {.dbl = 0}, 0, 24, S302M_FLAGS},
+    {NULL}
+};
+
+static const AVClass s302m_class = {
+    "SMPTE 302M encoder",
+    av_default_item_name,
+    s302m_options,
+    LIBAVUTIL_VERSION_INT,
+};
+
+AVCodec ff_s302m_encoder = {
+    .name           = "s302m",
+    .type           = AVMEDIA_TYPE_AUDIO,
+    .id             = CODEC_ID_S302M,
+    .priv_data_size = sizeof(S302MEncContext),
+    .init           = s302m_encode_init,
+    .encode         = s302m_encode_frame,
+    .close          = s302m_encode_close,
+    .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S32,
+                                                     AV_SAMPLE_FMT_S16,
+                                                     AV_SAMPLE_FMT_NONE },
+    .long_name      = NULL_IF_CONFIG_SMALL("SMPTE 302M"),
+    .priv_class     = &s302m_class,
+};
@@ -0,0 +1,261 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Trellis quantization test: checks that the optimized survivor searches
+ * and the trellis quantizer using them give the same result as the C
+ * version, and with -b reports their speed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "avcodec.h"
+#include "mpegvideo.h"
+
+#undef printf
+#undef fprintf
+
+typedef int (*best_survivor_func)(const int *survivor, const int *survivor_score, int survivor_count,
+                                  const uint8_t *length, int level, int i, int distortion, int lambda,
+                                  int *best_score);
+
+static const struct {
+    const char *name;
+    best_survivor_func func;
+    int cpu_flag;
+} funcs[] = {
+    { "C",    ff_trellis_best_survivor_c,    0                },
+#if HAVE_AVX2 && ARCH_X86_64
+    { "AVX2", ff_trellis_best_survivor_avx2, AV_CPU_FLAG_AVX2 },
+#endif
+    { NULL }
+};
+
+#define NB_SETS 256
+
+static volatile int sink;
+
+typedef struct SurvivorSet {
+    int survivor[64];
+    int survivor_score[64];
+    int count, level, i, distortion, lambda, best_score;
+} SurvivorSet;
+
+static int64_t gettime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* survivors are increasing positions before i, their scores are drawn from
+ * a small range so that ties happen */
+static void init_set(SurvivorSet *set, int count, AVLFG *lfg)
+{
+    int k, pos = 0;
+
+    set->i = count - 1 + av_lfg_get(lfg) % (64 - count + 1);
+    for (k = 0; k < count; k++) {
+        int left = set->i - pos - (count - 1 - k);
+        pos += av_lfg_get(lfg) % (left / 2 + 1);
+        set->survivor[k]       = pos++;
+        set->survivor_score[k] = (int)(av_lfg_get(lfg) % 4096) - 2048;
+    }
+    set->count      = count;
+    set->level      = av_lfg_get(lfg) & 127;
+    set->distortion = (int)(av_lfg_get(lfg) % 65536) - 32768;
+    set->lambda     = av_lfg_get(lfg) % 64;
+    set->best_score = av_lfg_get(lfg) & 1 ? 256*256*256*120 : (int)(av_lfg_get(lfg) % 4096);
+}
+
+static int check_survivors(const uint8_t *length, AVLFG *lfg)
+{
+    SurvivorSet set;
+    int f, count, n, ret = 0;
+
+    for (count = 1; count <= 64; count++) {
+        for (n = 0; n < NB_SETS; n++) {
+            int ref_score, ref;
+
+            init_set(&set, count, lfg);
+            ref_score = set.best_score;
+            ref = ff_trellis_best_survivor_c(set.survivor, set.survivor_score, count, length,
+                                             set.level, set.i, set.distortion, set.lambda,
+                                             &ref_score);
+            for (f = 1; funcs[f].name; f++) {
+                int score = set.best_score, best;
+
+                if (!(av_get_cpu_flags() & funcs[f].cpu_flag))
+                    continue;
+                best = funcs[f].func(set.survivor, set.survivor_score, count, length,
+                                     set.level, set.i, set.distortion, set.lambda, &score);
+                if (best != ref || score != ref_score) {
+                    fprintf(stderr, "%s: %d survivors, level %d: got %d (%d), expected %d (%d)\n",
+                            funcs[f].name, count, set.level, best, score, ref, ref_score);
+                    ret = 1;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+static void bench_survivors(const uint8_t *length, AVLFG *lfg)
+{
+    static const int counts[] = { 1, 2, 3, 4, 6, 8, 12, 16, 32, 64 };
+    SurvivorSet *sets = av_malloc(NB_SETS * sizeof(*sets));
+    int c, f, n;
+
+    for (c = 0; c < FF_ARRAY_ELEMS(counts); c++) {
+        for (n = 0; n < NB_SETS; n++)
+            init_set(&sets[n], counts[c], lfg);
+        for (f = 0; funcs[f].name; f++) {
+            int64_t ti, calls = 0;
+
+            if (funcs[f].cpu_flag && !(av_get_cpu_flags() & funcs[f].cpu_flag))
+                continue;
+            ti = gettime();
+            do {
+                for (n = 0; n < NB_SETS; n++) {
+                    SurvivorSet *set = &sets[n];
+                    int score = set->best_score;
+                    sink = funcs[f].func(set->survivor, set->survivor_score, set->count, length,
+                                          set->level, set->i, set->distortion, set->lambda, &score);
+                }
+                calls += NB_SETS;
+            } while (gettime() - ti < 200000);
+            ti = gettime() - ti;
+            printf("survivors %2d %-4s: %6.1f Mcalls/s\n", counts[c], funcs[f].name,
+                   (double)calls / ti);
+        }
+    }
+    av_free(sets);
+}
+
+#define NB_BLOCKS 1024
+
+/* run the trellis quantizer of an MPEG-2 encoder on random residual blocks */
+static int check_trellis(int bench, AVLFG *lfg)
+{
+    AVCodec *codec = avcodec_find_encoder(CODEC_ID_MPEG2VIDEO);
+    AVCodecContext *avctx = avcodec_alloc_context3(codec);
+    DCTELEM (*src)[64] = av_malloc(NB_BLOCKS * sizeof(*src));
+    DCTELEM (*ref)[64] = av_malloc(NB_BLOCKS * sizeof(*ref));
+    DECLARE_ALIGNED(16, DCTELEM, block)[64];
+    int params[NB_BLOCKS][3];
+    int ref_last[NB_BLOCKS];
+    MpegEncContext *s;
+    int f, b, k, ret = 0;
+
+    avctx->width    = 64;
+    avctx->height   = 64;
+    avctx->pix_fmt  = PIX_FMT_YUV420P;
+    avctx->time_base= (AVRational){ 1, 25 };
+    avctx->trellis  = 1;
+    if (avcodec_open2(avctx, codec, NULL) < 0) {
+        fprintf(stderr, "could not open the MPEG-2 encoder\n");
+        return 1;
+    }
+    s = avctx->priv_data;
+
+    for (b = 0; b < NB_BLOCKS; b++) {
+        int intra = b & 1;
+        int range = 1 << (2 + av_lfg_get(lfg) % 7);
+
+        params[b][0] = intra;
+        params[b][1] = 1 + av_lfg_get(lfg) % 31;
+        params[b][2] = b % 6;
+        for (k = 0; k < 64; k++)
+            src[b][k] = intra ? av_lfg_get(lfg) % 256
+                              : (int)(av_lfg_get(lfg) % (2 * range + 1)) - range;
+    }
+
+    for (f = 0; funcs[f].name; f++) {
+        int64_t ti, nb = 0;
+
+        if (funcs[f].cpu_flag && !(av_get_cpu_flags() & funcs[f].cpu_flag))
+            continue;
+        s->trellis_best_survivor = funcs[f].func;
+        ti = gettime();
+        do {
+            for (b = 0; b < NB_BLOCKS; b++) {
+                int qscale = params[b][1], overflow, last;
+                int lambda = qscale * FF_QP2LAMBDA;
+
+                s->mb_intra = params[b][0];
+                s->lambda2  = (lambda * lambda + FF_LAMBDA_SCALE / 2) >> FF_LAMBDA_SHIFT;
+                ff_set_qscale(s, qscale);
+                memcpy(block, src[b], sizeof(block));
+                last = s->dct_quantize(s, block, params[b][2], s->qscale, &overflow);
+
+                if (!f) {
+                    memcpy(ref[b], block, sizeof(block));
+                    ref_last[b] = last;
+                } else if (last != ref_last[b] || memcmp(block, ref[b], sizeof(block))) {
+                    fprintf(stderr, "%s: trellis mismatch in block %d\n", funcs[f].name, b);
+                    ret = 1;
+                    bench = 0;
+                    break;
+                }
+            }
+            nb += NB_BLOCKS;
+        } while (bench && gettime() - ti < 500000);
+        ti = gettime() - ti;
+        if (bench)
+            printf("trellis MPEG-2 %-4s: %6.1f kblocks/s\n", funcs[f].name, nb * 1000.0 / ti);
+    }
+
+    avcodec_close(avctx);
+    av_free(avctx);
+    av_free(src);
+    av_free(ref);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t *length = av_malloc(64 * 128);
+    int bench = argc > 1 && !strcmp(argv[1], "-b");
+    int i, ret;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 1);
+    avcodec_register_all();
+
+    /* exactly the size of a table, so that reads past its end are caught */
+    for (i = 0; i < 64 * 128; i++)
+        length[i] = 2 + av_lfg_get(&lfg) % 24;
+
+    ret = check_survivors(length, &lfg);
+    printf("survivor search: %s\n", ret ? "failed" : "ok");
+    ret |= i = check_trellis(bench, &lfg);
+    printf("trellis quantization: %s\n", i ? "failed" : "ok");
+    if (bench && !ret)
+        bench_survivors(length, &lfg);
+
+    av_free(length);
+    return ret;
+}
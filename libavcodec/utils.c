@@ -107,16 +107,18 @@ void avcodec_set_dimensions(AVCodecContext *s, int width, int height){
     s->height= -((-height)>>s->lowres);
 }
 
+#define INTERNAL_BUFFER_SIZE (32+1)
+
 typedef struct InternalBuffer{
-    int last_pic_num;
-    uint8_t *base[4];
-    uint8_t *data[4];
-    int linesize[4];
-    int width, height;
-    enum PixelFormat pix_fmt;
+    FramePoolBuffer *buf;
+    uint8_t *data;              ///< data[0] of the picture using buf
 }InternalBuffer;
 
-#define INTERNAL_BUFFER_SIZE (32+1)
+typedef struct InternalBufferList{
+    AVFramePool *pool;
+    InternalBuffer used[INTERNAL_BUFFER_SIZE];
+    int last_pic_num;
+}InternalBufferList;
 
 void avcodec_align_dimensions2(AVCodecContext *s, int *width, int *height, int linesize_align[4]){
     int w_align= 1;
@@ -228,8 +230,16 @@ int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic){
     int i;
     int w= s->width;
     int h= s->height;
-    InternalBuffer *buf;
-    int *picture_number;
+    InternalBufferList *list;
+    FramePoolBuffer *buf;
+    int h_chroma_shift, v_chroma_shift;
+    int size[4] = {0};
+    int offset[4];
+    int tmpsize, total_size;
+    int unaligned;
+    AVPicture picture;
+    int stride_align[4];
+    const int pixel_size = av_pix_fmt_descriptors[s->pix_fmt].comp[0].step_minus1+1;
 
     if(pic->data[0]!=NULL) {
         av_log(s, AV_LOG_ERROR, "pic->data[0]!=NULL in avcodec_default_get_buffer\n");
@@ -244,108 +254,102 @@ int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic){
         return -1;
 
     if(s->internal_buffer==NULL){
-        s->internal_buffer= av_mallocz((INTERNAL_BUFFER_SIZE+1)*sizeof(InternalBuffer));
+        list= av_mallocz(sizeof(InternalBufferList));
+        if(!list)
+            return AVERROR(ENOMEM);
+        /* frame thread contexts share the pool of the user context */
+        list->pool= s->frame_pool ? ff_frame_pool_ref(s->frame_pool) : av_frame_pool_alloc(0, 0);
+        if(!list->pool){
+            av_free(list);
+            return AVERROR(ENOMEM);
+        }
+        s->internal_buffer= list;
     }
-#if 0
-    s->internal_buffer= av_fast_realloc(
-        s->internal_buffer,
-        &s->internal_buffer_size,
-        sizeof(InternalBuffer)*FFMAX(99,  s->internal_buffer_count+1)/*FIXME*/
-        );
-#endif
+    list= s->internal_buffer;
+    list->last_pic_num++;
 
-    buf= &((InternalBuffer*)s->internal_buffer)[s->internal_buffer_count];
-    picture_number= &(((InternalBuffer*)s->internal_buffer)[INTERNAL_BUFFER_SIZE]).last_pic_num; //FIXME ugly hack
-    (*picture_number)++;
+    avcodec_get_chroma_sub_sample(s->pix_fmt, &h_chroma_shift, &v_chroma_shift);
 
-    if(buf->base[0] && (buf->width != w || buf->height != h || buf->pix_fmt != s->pix_fmt)){
-        if(s->active_thread_type&FF_THREAD_FRAME) {
-            av_log_missing_feature(s, "Width/height changing with frame threads is", 0);
-            return -1;
-        }
+    avcodec_align_dimensions2(s, &w, &h, stride_align);
 
-        for(i=0; i<4; i++){
-            av_freep(&buf->base[i]);
-            buf->data[i]= NULL;
-        }
+    if(!(s->flags&CODEC_FLAG_EMU_EDGE)){
+        w+= EDGE_WIDTH*2;
+        h+= EDGE_WIDTH*2;
     }
 
-    if(buf->base[0]){
-        pic->age= *picture_number - buf->last_pic_num;
-        buf->last_pic_num= *picture_number;
-    }else{
-        int h_chroma_shift, v_chroma_shift;
-        int size[4] = {0};
-        int tmpsize;
-        int unaligned;
-        AVPicture picture;
-        int stride_align[4];
-        const int pixel_size = av_pix_fmt_descriptors[s->pix_fmt].comp[0].step_minus1+1;
-
-        avcodec_get_chroma_sub_sample(s->pix_fmt, &h_chroma_shift, &v_chroma_shift);
-
-        avcodec_align_dimensions2(s, &w, &h, stride_align);
+    do {
+        // NOTE: do not align linesizes individually, this breaks e.g. assumptions
+        // that linesize[0] == 2*linesize[1] in the MPEG-encoder for 4:2:2
+        av_image_fill_linesizes(picture.linesize, s->pix_fmt, w);
+        // increase alignment of w for next try (rhs gives the lowest bit set in w)
+        w += w & ~(w-1);
 
-        if(!(s->flags&CODEC_FLAG_EMU_EDGE)){
-            w+= EDGE_WIDTH*2;
-            h+= EDGE_WIDTH*2;
+        unaligned = 0;
+        for (i=0; i<4; i++){
+            unaligned |= picture.linesize[i] % stride_align[i];
         }
+    } while (unaligned);
 
-        do {
-            // NOTE: do not align linesizes individually, this breaks e.g. assumptions
-            // that linesize[0] == 2*linesize[1] in the MPEG-encoder for 4:2:2
-            av_image_fill_linesizes(picture.linesize, s->pix_fmt, w);
-            // increase alignment of w for next try (rhs gives the lowest bit set in w)
-            w += w & ~(w-1);
-
-            unaligned = 0;
-            for (i=0; i<4; i++){
-                unaligned |= picture.linesize[i] % stride_align[i];
-            }
-        } while (unaligned);
-
-        tmpsize = av_image_fill_pointers(picture.data, s->pix_fmt, h, NULL, picture.linesize);
-        if (tmpsize < 0)
-            return -1;
-
-        for (i=0; i<3 && picture.data[i+1]; i++)
-            size[i] = picture.data[i+1] - picture.data[i];
-        size[i] = tmpsize - (picture.data[i] - picture.data[0]);
-
-        buf->last_pic_num= -256*256*256*64;
-        memset(buf->base, 0, sizeof(buf->base));
-        memset(buf->data, 0, sizeof(buf->data));
+    tmpsize = av_image_fill_pointers(picture.data, s->pix_fmt, h, NULL, picture.linesize);
+    if (tmpsize < 0)
+        return -1;
 
-        for(i=0; i<4 && size[i]; i++){
-            const int h_shift= i==0 ? 0 : h_chroma_shift;
-            const int v_shift= i==0 ? 0 : v_chroma_shift;
+    for (i=0; i<3 && picture.data[i+1]; i++)
+        size[i] = picture.data[i+1] - picture.data[i];
+    size[i] = tmpsize - (picture.data[i] - picture.data[0]);
 
-            buf->linesize[i]= picture.linesize[i];
+    /* all planes in one buffer, each one followed by 16 bytes of padding */
+    total_size = 0;
+    for(i=0; i<4 && size[i]; i++){
+        offset[i] = total_size;
+        total_size += FFALIGN(size[i] + 16, 32);
+    }
 
-            buf->base[i]= av_malloc(size[i]+16); //FIXME 16
-            if(buf->base[i]==NULL) return -1;
-            memset(buf->base[i], 128, size[i]);
+    buf= ff_frame_pool_get(list->pool, total_size);
+    if(!buf)
+        return AVERROR(ENOMEM);
+    memset(pic->base, 0, sizeof(pic->base));
+    memset(pic->data, 0, sizeof(pic->data));
+    memset(pic->linesize, 0, sizeof(pic->linesize));
+    for(i=0; i<4 && size[i]; i++){
+        const int h_shift= i==0 ? 0 : h_chroma_shift;
+        const int v_shift= i==0 ? 0 : v_chroma_shift;
+
+        pic->linesize[i]= picture.linesize[i];
+        pic->base[i]= buf->data + offset[i];
+
+        // no edge if EDGE EMU or not planar YUV
+        if((s->flags&CODEC_FLAG_EMU_EDGE) || !size[2])
+            pic->data[i] = pic->base[i];
+        else
+            pic->data[i] = pic->base[i] + FFALIGN((pic->linesize[i]*EDGE_WIDTH>>v_shift) + (pixel_size*EDGE_WIDTH>>h_shift), stride_align[i]);
+    }
 
-            // no edge if EDGE EMU or not planar YUV
-            if((s->flags&CODEC_FLAG_EMU_EDGE) || !size[2])
-                buf->data[i] = buf->base[i];
-            else
-                buf->data[i] = buf->base[i] + FFALIGN((buf->linesize[i]*EDGE_WIDTH>>v_shift) + (pixel_size*EDGE_WIDTH>>h_shift), stride_align[i]);
-        }
-        if(size[1] && !size[2])
-            ff_set_systematic_pal2((uint32_t*)buf->data[1], s->pix_fmt);
-        buf->width  = s->width;
-        buf->height = s->height;
-        buf->pix_fmt= s->pix_fmt;
+    /* the buffer still holds our last picture with the same layout,
+       a new one only starts counting once it is used again */
+    if(buf->owner == list && buf->frame_data == pic->data[0] &&
+       buf->width == s->width && buf->height == s->height && buf->pix_fmt == s->pix_fmt &&
+       !memcmp(buf->linesize, pic->linesize, sizeof(buf->linesize))){
+        pic->age= list->last_pic_num - buf->last_pic_num;
+        buf->last_pic_num= list->last_pic_num;
+    }else{
+        memset(buf->data, 128, total_size);
         pic->age= 256*256*256*64;
+        buf->last_pic_num= -256*256*256*64;
     }
+    if(size[1] && !size[2])
+        ff_set_systematic_pal2((uint32_t*)pic->data[1], s->pix_fmt);
+    buf->owner       = list;
+    buf->width       = s->width;
+    buf->height      = s->height;
+    buf->pix_fmt     = s->pix_fmt;
+    buf->frame_data  = pic->data[0];
+    memcpy(buf->linesize, pic->linesize, sizeof(buf->linesize));
+
     pic->type= FF_BUFFER_TYPE_INTERNAL;
 
-    for(i=0; i<4; i++){
-        pic->base[i]= buf->base[i];
-        pic->data[i]= buf->data[i];
-        pic->linesize[i]= buf->linesize[i];
-    }
+    list->used[s->internal_buffer_count].buf = buf;
+    list->used[s->internal_buffer_count].data= pic->data[0];
     s->internal_buffer_count++;
 
     if (s->pkt) {
@@ -369,23 +373,20 @@ int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic){
 
 void avcodec_default_release_buffer(AVCodecContext *s, AVFrame *pic){
     int i;
-    InternalBuffer *buf, *last;
+    InternalBufferList *list= s->internal_buffer;
 
     assert(pic->type==FF_BUFFER_TYPE_INTERNAL);
     assert(s->internal_buffer_count);
 
-    if(s->internal_buffer){
-    buf = NULL; /* avoids warning */
+    if(list){
     for(i=0; i<s->internal_buffer_count; i++){ //just 3-5 checks so is not worth to optimize
-        buf= &((InternalBuffer*)s->internal_buffer)[i];
-        if(buf->data[0] == pic->data[0])
+        if(list->used[i].data == pic->data[0])
             break;
     }
     assert(i < s->internal_buffer_count);
     s->internal_buffer_count--;
-    last = &((InternalBuffer*)s->internal_buffer)[s->internal_buffer_count];
-
-    FFSWAP(InternalBuffer, *buf, *last);
+    ff_frame_pool_put(list->used[i].buf);
+    list->used[i] = list->used[s->internal_buffer_count];
     }
 
     for(i=0; i<4; i++){
@@ -495,7 +496,7 @@ int attribute_align_arg avcodec_open(AVCodecContext *avctx, AVCodec *codec)
 
 int attribute_align_arg avcodec_open2(AVCodecContext *avctx, AVCodec *codec, AVDictionary **options)
 {
-    int ret = 0;
+    int ret = 0, pool_ref = 0;
     AVDictionary *tmp = NULL;
 
     if (options)
@@ -575,6 +576,16 @@ int attribute_align_arg avcodec_open2(AVCodecContext *avctx, AVCodec *codec, AVD
     }
     avctx->frame_number = 0;
 
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        avctx->frame_pool = avctx->frame_pool ? ff_frame_pool_ref(avctx->frame_pool) :
+                                                av_frame_pool_alloc(0, 0);
+        if (!avctx->frame_pool) {
+            ret = AVERROR(ENOMEM);
+            goto free_and_end;
+        }
+        pool_ref = 1;
+    }
+
     if (HAVE_THREADS && !avctx->thread_opaque) {
         ret = ff_thread_init(avctx);
         if (ret < 0) {
@@ -664,6 +675,8 @@ end:
 free_and_end:
     av_dict_free(&tmp);
     av_freep(&avctx->priv_data);
+    if (pool_ref)
+        ff_frame_pool_unref(&avctx->frame_pool, NULL);
     avctx->codec= NULL;
     goto end;
 }
@@ -873,6 +886,9 @@ void avsubtitle_free(AVSubtitle *sub)
 
 av_cold int avcodec_close(AVCodecContext *avctx)
 {
+    /* ff_thread_free() clears avctx->codec */
+    int pool_ref = avctx->codec && avctx->codec_type == AVMEDIA_TYPE_VIDEO;
+
     /* If there is a user-supplied mutex locking routine, call it. */
     if (ff_lockmgr_cb) {
         if ((*ff_lockmgr_cb)(&codec_mutex, AV_LOCK_OBTAIN))
@@ -891,6 +907,8 @@ av_cold int avcodec_close(AVCodecContext *avctx)
     if (avctx->codec && avctx->codec->close)
         avctx->codec->close(avctx);
     avcodec_default_free_buffers(avctx);
+    if (pool_ref)
+        ff_frame_pool_unref(&avctx->frame_pool, NULL);
     avctx->coded_frame = NULL;
     if (avctx->codec && avctx->codec->priv_class)
         av_opt_free(avctx->priv_data);
@@ -1235,19 +1253,16 @@ void avcodec_flush_buffers(AVCodecContext *avctx)
 }
 
 void avcodec_default_free_buffers(AVCodecContext *s){
-    int i, j;
+    InternalBufferList *list= s->internal_buffer;
+    int i;
 
-    if(s->internal_buffer==NULL) return;
+    if(list==NULL) return;
 
     if (s->internal_buffer_count)
         av_log(s, AV_LOG_WARNING, "Found %i unreleased buffers!\n", s->internal_buffer_count);
-    for(i=0; i<INTERNAL_BUFFER_SIZE; i++){
-        InternalBuffer *buf= &((InternalBuffer*)s->internal_buffer)[i];
-        for(j=0; j<4; j++){
-            av_freep(&buf->base[j]);
-            buf->data[j]= NULL;
-        }
-    }
+    for(i=0; i<s->internal_buffer_count; i++)
+        ff_frame_pool_free_buffer(list->used[i].buf);
+    ff_frame_pool_unref(&list->pool, list);
     av_freep(&s->internal_buffer);
 
     s->internal_buffer_count=0;
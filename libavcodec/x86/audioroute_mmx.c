@@ -0,0 +1,316 @@
+/*
+ * audio channel routing, x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavutil/mem.h"
+#include "libavcodec/audioroutedsp.h"
+
+static av_always_inline void copy_c(uint8_t *dst, const uint8_t *src, int len,
+                                    int dst_stride, int src_stride, int width)
+{
+    while (len-- > 0) {
+        memcpy(dst, src, width);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+/*
+ * Single channels of 16 and 32 bits are only vectorized when one side is
+ * contiguous: a planar source is loaded 16 bytes at a time and stored
+ * from general purpose registers, a planar destination is gathered.
+ */
+#define STORE_2                                 \
+    "movd      %%xmm0, %k3          \n\t"       \
+    "movw      %w3, (%0)            \n\t"       \
+    "shr       $16, %k3             \n\t"       \
+    "movw      %w3, (%0,%4)         \n\t"       \
+    "lea       (%0,%4,2), %0        \n\t"       \
+    "psrldq    $4, %%xmm0           \n\t"
+
+/* mono 16 bit source */
+static void copy_2_sse2(uint8_t *dst, const uint8_t *src, int len,
+                        int dst_stride, int src_stride)
+{
+    if (src_stride == 2 && len >= 8) {
+        x86_reg dstride = dst_stride, n = len >> 3, tmp;
+
+        __asm__ volatile(
+            "1:                             \n\t"
+            "movdqu    (%1), %%xmm0         \n\t"
+            STORE_2
+            STORE_2
+            STORE_2
+            STORE_2
+            "add       $16, %1              \n\t"
+            "dec       %2                   \n\t"
+            "jnz 1b                         \n\t"
+            : "+r"(dst), "+r"(src), "+r"(n), "=&r"(tmp)
+            : "r"(dstride)
+            : XMM_CLOBBERS("%xmm0",) "memory"
+        );
+        len &= 7;
+    }
+    copy_c(dst, src, len, dst_stride, src_stride, 2);
+}
+
+#define STORE_4                                 \
+    "movd      %%xmm0, (%0)         \n\t"       \
+    "add       %3, %0               \n\t"       \
+    "psrldq    $4, %%xmm0           \n\t"
+
+/* mono 32 bit or stereo 16 bit source */
+static void copy_4_sse2(uint8_t *dst, const uint8_t *src, int len,
+                        int dst_stride, int src_stride)
+{
+    if (src_stride == 4 && len >= 4) {
+        x86_reg dstride = dst_stride, n = len >> 2;
+
+        __asm__ volatile(
+            "1:                             \n\t"
+            "movdqu    (%1), %%xmm0         \n\t"
+            STORE_4
+            STORE_4
+            STORE_4
+            STORE_4
+            "add       $16, %1              \n\t"
+            "dec       %2                   \n\t"
+            "jnz 1b                         \n\t"
+            : "+r"(dst), "+r"(src), "+r"(n)
+            : "r"(dstride)
+            : XMM_CLOBBERS("%xmm0",) "memory"
+        );
+        len &= 3;
+    }
+    copy_c(dst, src, len, dst_stride, src_stride, 4);
+}
+
+/* 8 channels of 16 bits, 4 channels of 32 bits */
+static void copy_16_sse2(uint8_t *dst, const uint8_t *src, int len,
+                         int dst_stride, int src_stride)
+{
+    x86_reg dstride = dst_stride, sstride = src_stride;
+
+    if (len <= 0)
+        return;
+    __asm__ volatile(
+        "1:                         \n\t"
+        "movdqu    (%1), %%xmm0     \n\t"
+        "movdqu    %%xmm0, (%0)     \n\t"
+        "add       %4, %1           \n\t"
+        "add       %3, %0           \n\t"
+        "dec       %2               \n\t"
+        "jnz 1b                     \n\t"
+        : "+r"(dst), "+r"(src), "+r"(len)
+        : "r"(dstride), "r"(sstride)
+        : XMM_CLOBBERS("%xmm0",) "memory"
+    );
+}
+
+/* 16 channels of 16 bits, 8 channels of 32 bits */
+static void copy_32_sse2(uint8_t *dst, const uint8_t *src, int len,
+                         int dst_stride, int src_stride)
+{
+    x86_reg dstride = dst_stride, sstride = src_stride;
+
+    if (len <= 0)
+        return;
+    __asm__ volatile(
+        "1:                         \n\t"
+        "movdqu    (%1), %%xmm0     \n\t"
+        "movdqu  16(%1), %%xmm1     \n\t"
+        "movdqu    %%xmm0,   (%0)   \n\t"
+        "movdqu    %%xmm1, 16(%0)   \n\t"
+        "add       %4, %1           \n\t"
+        "add       %3, %0           \n\t"
+        "dec       %2               \n\t"
+        "jnz 1b                     \n\t"
+        : "+r"(dst), "+r"(src), "+r"(len)
+        : "r"(dstride), "r"(sstride)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+}
+
+/* 16 channels of 32 bits */
+static void copy_64_sse2(uint8_t *dst, const uint8_t *src, int len,
+                         int dst_stride, int src_stride)
+{
+    x86_reg dstride = dst_stride, sstride = src_stride;
+
+    if (len <= 0)
+        return;
+    __asm__ volatile(
+        "1:                         \n\t"
+        "movdqu    (%1), %%xmm0     \n\t"
+        "movdqu  16(%1), %%xmm1     \n\t"
+        "movdqu  32(%1), %%xmm2     \n\t"
+        "movdqu  48(%1), %%xmm3     \n\t"
+        "movdqu    %%xmm0,   (%0)   \n\t"
+        "movdqu    %%xmm1, 16(%0)   \n\t"
+        "movdqu    %%xmm2, 32(%0)   \n\t"
+        "movdqu    %%xmm3, 48(%0)   \n\t"
+        "add       %4, %1           \n\t"
+        "add       %3, %0           \n\t"
+        "dec       %2               \n\t"
+        "jnz 1b                     \n\t"
+        : "+r"(dst), "+r"(src), "+r"(len)
+        : "r"(dstride), "r"(sstride)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",) "memory"
+    );
+}
+
+#if HAVE_AVX2
+DECLARE_ALIGNED(32, static const int32_t, gather_index)[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+DECLARE_ALIGNED(32, static const uint8_t, gather_shuf_2)[32] = {
+    0, 1, 4, 5, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0, 1, 4, 5, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+/* mono 16 bit destination */
+static void copy_2_avx2(uint8_t *dst, const uint8_t *src, int len,
+                        int dst_stride, int src_stride)
+{
+    /* the dword gathers read 2 bytes past each sample, so the last sample
+     * is always left to the C loop */
+    if (dst_stride == 2 && len > 8) {
+        x86_reg sstep = 8 * src_stride, n = (len - 1) >> 3;
+
+        __asm__ volatile(
+            "vmovd        %4, %%xmm5                \n\t"
+            "vpbroadcastd %%xmm5, %%ymm5            \n\t"
+            "vpmulld      %5, %%ymm5, %%ymm5        \n\t"
+            "vmovdqa      %6, %%ymm4                \n\t"
+            "1:                                     \n\t"
+            "vpcmpeqd     %%ymm3, %%ymm3, %%ymm3    \n\t"
+            "vpgatherdd   %%ymm3, (%1,%%ymm5,1), %%ymm0 \n\t"
+            "vpshufb      %%ymm4, %%ymm0, %%ymm0    \n\t"
+            "vpermq       $8, %%ymm0, %%ymm0        \n\t"
+            "vmovdqu      %%xmm0, (%0)              \n\t"
+            "add          $16, %0                   \n\t"
+            "add          %3, %1                    \n\t"
+            "dec          %2                        \n\t"
+            "jnz 1b                                 \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(dst), "+r"(src), "+r"(n)
+            : "r"(sstep), "rm"(src_stride), "m"(*gather_index), "m"(*gather_shuf_2)
+            : XMM_CLOBBERS("%xmm0", "%xmm3", "%xmm4", "%xmm5",) "memory"
+        );
+        len = ((len - 1) & 7) + 1;
+    }
+    copy_2_sse2(dst, src, len, dst_stride, src_stride);
+}
+
+/* mono 32 bit or stereo 16 bit destination */
+static void copy_4_avx2(uint8_t *dst, const uint8_t *src, int len,
+                        int dst_stride, int src_stride)
+{
+    if (dst_stride == 4 && len >= 8) {
+        x86_reg sstep = 8 * src_stride, n = len >> 3;
+
+        __asm__ volatile(
+            "vmovd        %4, %%xmm5                \n\t"
+            "vpbroadcastd %%xmm5, %%ymm5            \n\t"
+            "vpmulld      %5, %%ymm5, %%ymm5        \n\t"
+            "1:                                     \n\t"
+            "vpcmpeqd     %%ymm3, %%ymm3, %%ymm3    \n\t"
+            "vpgatherdd   %%ymm3, (%1,%%ymm5,1), %%ymm0 \n\t"
+            "vmovdqu      %%ymm0, (%0)              \n\t"
+            "add          $32, %0                   \n\t"
+            "add          %3, %1                    \n\t"
+            "dec          %2                        \n\t"
+            "jnz 1b                                 \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(dst), "+r"(src), "+r"(n)
+            : "r"(sstep), "rm"(src_stride), "m"(*gather_index)
+            : XMM_CLOBBERS("%xmm0", "%xmm3", "%xmm5",) "memory"
+        );
+        len &= 7;
+    }
+    copy_4_sse2(dst, src, len, dst_stride, src_stride);
+}
+
+static void copy_32_avx2(uint8_t *dst, const uint8_t *src, int len,
+                         int dst_stride, int src_stride)
+{
+    x86_reg dstride = dst_stride, sstride = src_stride;
+
+    if (len <= 0)
+        return;
+    __asm__ volatile(
+        "1:                         \n\t"
+        "vmovdqu   (%1), %%ymm0     \n\t"
+        "vmovdqu   %%ymm0, (%0)     \n\t"
+        "add       %4, %1           \n\t"
+        "add       %3, %0           \n\t"
+        "dec       %2               \n\t"
+        "jnz 1b                     \n\t"
+        "vzeroupper                 \n\t"
+        : "+r"(dst), "+r"(src), "+r"(len)
+        : "r"(dstride), "r"(sstride)
+        : XMM_CLOBBERS("%xmm0",) "memory"
+    );
+}
+
+static void copy_64_avx2(uint8_t *dst, const uint8_t *src, int len,
+                         int dst_stride, int src_stride)
+{
+    x86_reg dstride = dst_stride, sstride = src_stride;
+
+    if (len <= 0)
+        return;
+    __asm__ volatile(
+        "1:                         \n\t"
+        "vmovdqu   (%1), %%ymm0     \n\t"
+        "vmovdqu 32(%1), %%ymm1     \n\t"
+        "vmovdqu   %%ymm0,   (%0)   \n\t"
+        "vmovdqu   %%ymm1, 32(%0)   \n\t"
+        "add       %4, %1           \n\t"
+        "add       %3, %0           \n\t"
+        "dec       %2               \n\t"
+        "jnz 1b                     \n\t"
+        "vzeroupper                 \n\t"
+        : "+r"(dst), "+r"(src), "+r"(len)
+        : "r"(dstride), "r"(sstride)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+}
+#endif /* HAVE_AVX2 */
+
+void ff_audio_route_dsp_init_x86(AudioRouteDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        c->copy[0] = copy_2_sse2;
+        c->copy[1] = copy_4_sse2;
+        c->copy[3] = copy_16_sse2;
+        c->copy[4] = copy_32_sse2;
+        c->copy[5] = copy_64_sse2;
+    }
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+        c->copy[0] = copy_2_avx2;
+        c->copy[1] = copy_4_avx2;
+        c->copy[4] = copy_32_avx2;
+        c->copy[5] = copy_64_avx2;
+    }
+#endif
+}
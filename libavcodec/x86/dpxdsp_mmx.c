@@ -0,0 +1,194 @@
+/*
+ * DPX DSP functions, x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * 10-bit RGB unpacking. Each output sample is the 16-bit word of the two
+ * input bytes holding it, shifted left so that its 10 bits land at the top:
+ * pshufb gathers the words, pmullw does the per component shifts.
+ * 8 pixels make 3 output vectors, loaded from offsets 0, 8 and 16.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/dpxdsp.h"
+
+#if HAVE_SSSE3
+/* bytes of the R, G, B words for the 3 output vectors of 8 pixels, repeated
+ * so that the AVX2 version finds the pairs of lanes it needs; indexed by
+ * big endian */
+DECLARE_ALIGNED(32, static const uint8_t, unpack_shuf)[2][6][16] = {
+    {
+        { 2,  3,  1,  2,  0,  1,  6,  7,  5,  6,  4,  5, 10, 11,  9, 10 },
+        { 0,  1,  6,  7,  5,  6,  4,  5, 10, 11,  9, 10,  8,  9, 14, 15 },
+        { 5,  6,  4,  5, 10, 11,  9, 10,  8,  9, 14, 15, 13, 14, 12, 13 },
+        { 2,  3,  1,  2,  0,  1,  6,  7,  5,  6,  4,  5, 10, 11,  9, 10 },
+        { 0,  1,  6,  7,  5,  6,  4,  5, 10, 11,  9, 10,  8,  9, 14, 15 },
+        { 5,  6,  4,  5, 10, 11,  9, 10,  8,  9, 14, 15, 13, 14, 12, 13 },
+    }, {
+        { 1,  0,  2,  1,  3,  2,  5,  4,  6,  5,  7,  6,  9,  8, 10,  9 },
+        { 3,  2,  5,  4,  6,  5,  7,  6,  9,  8, 10,  9, 11, 10, 13, 12 },
+        { 6,  5,  7,  6,  9,  8, 10,  9, 11, 10, 13, 12, 14, 13, 15, 14 },
+        { 1,  0,  2,  1,  3,  2,  5,  4,  6,  5,  7,  6,  9,  8, 10,  9 },
+        { 3,  2,  5,  4,  6,  5,  7,  6,  9,  8, 10,  9, 11, 10, 13, 12 },
+        { 6,  5,  7,  6,  9,  8, 10,  9, 11, 10, 13, 12, 14, 13, 15, 14 },
+    },
+};
+
+/* left shifts of the R, G, B words, indexed by method B */
+DECLARE_ALIGNED(32, static const int16_t, unpack_mul)[2][6][8] = {
+    {
+        {  1,  4, 16,  1,  4, 16,  1,  4 },
+        { 16,  1,  4, 16,  1,  4, 16,  1 },
+        {  4, 16,  1,  4, 16,  1,  4, 16 },
+        {  1,  4, 16,  1,  4, 16,  1,  4 },
+        { 16,  1,  4, 16,  1,  4, 16,  1 },
+        {  4, 16,  1,  4, 16,  1,  4, 16 },
+    }, {
+        {  4, 16, 64,  4, 16, 64,  4, 16 },
+        { 64,  4, 16, 64,  4, 16, 64,  4 },
+        { 16, 64,  4, 16, 64,  4, 16, 64 },
+        {  4, 16, 64,  4, 16, 64,  4, 16 },
+        { 64,  4, 16, 64,  4, 16, 64,  4 },
+        { 16, 64,  4, 16, 64,  4, 16, 64 },
+    },
+};
+
+static const int32_t mask_10bit = 0xffc0ffc0;
+
+#define UNPACK_SSSE3(in, out)                                       \
+    "movdqu     "#in"(%1), %%xmm0           \n\t"                   \
+    "pshufb     "#out"(%3), %%xmm0          \n\t"                   \
+    "pmullw     "#out"(%4), %%xmm0          \n\t"                   \
+    "pand       %%xmm7, %%xmm0              \n\t"                   \
+    "movdqa     %%xmm0, %%xmm1              \n\t"                   \
+    "psrlw      $10, %%xmm1                 \n\t"                   \
+    "paddw      %%xmm1, %%xmm0              \n\t"                   \
+    "movdqu     %%xmm0, "#out"(%0)          \n\t"
+
+static av_always_inline void unpack_rgb10_ssse3(uint16_t *dst, const uint8_t *src,
+                                                int width, int big_endian, int method_b)
+{
+    x86_reg n = width >> 3;
+
+    if (n) {
+        __asm__ volatile(
+            "movd       %5, %%xmm7              \n\t"
+            "pshufd     $0, %%xmm7, %%xmm7      \n\t"
+            "1:                                 \n\t"
+            UNPACK_SSSE3(0,  0)
+            UNPACK_SSSE3(8,  16)
+            UNPACK_SSSE3(16, 32)
+            "add        $32, %1                 \n\t"
+            "add        $48, %0                 \n\t"
+            "sub        $1, %2                  \n\t"
+            "jnz 1b                             \n\t"
+            : "+r"(dst), "+r"(src), "+r"(n)
+            : "r"(unpack_shuf[big_endian]), "r"(unpack_mul[method_b]),
+              "m"(mask_10bit)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm7",) "memory"
+        );
+    }
+    dpx_unpack_rgb10(dst, src, width & 7, big_endian, method_b);
+}
+#endif /* HAVE_SSSE3 */
+
+#if HAVE_AVX2
+/* output vectors 2k and 2k+1 in the two lanes */
+#define UNPACK_AVX2(in_lo, in_hi, out)                              \
+    "vmovdqu    "#in_lo"(%1), %%xmm0                \n\t"           \
+    "vinserti128 $1, "#in_hi"(%1), %%ymm0, %%ymm0   \n\t"           \
+    "vpshufb    "#out"(%3), %%ymm0, %%ymm0          \n\t"           \
+    "vpmullw    "#out"(%4), %%ymm0, %%ymm0          \n\t"           \
+    "vpand      %%ymm7, %%ymm0, %%ymm0              \n\t"           \
+    "vpsrlw     $10, %%ymm0, %%ymm1                 \n\t"           \
+    "vpaddw     %%ymm1, %%ymm0, %%ymm0              \n\t"           \
+    "vmovdqu    %%ymm0, "#out"(%0)                  \n\t"
+
+static av_always_inline void unpack_rgb10_avx2(uint16_t *dst, const uint8_t *src,
+                                               int width, int big_endian, int method_b)
+{
+    x86_reg n = width >> 4;
+
+    if (n) {
+        __asm__ volatile(
+            "vpbroadcastd %5, %%ymm7            \n\t"
+            "1:                                 \n\t"
+            UNPACK_AVX2(0,  8,  0)
+            UNPACK_AVX2(16, 32, 32)
+            UNPACK_AVX2(40, 48, 64)
+            "add        $64, %1                 \n\t"
+            "add        $96, %0                 \n\t"
+            "sub        $1, %2                  \n\t"
+            "jnz 1b                             \n\t"
+            "vzeroupper                         \n\t"
+            : "+r"(dst), "+r"(src), "+r"(n)
+            : "r"(unpack_shuf[big_endian]), "r"(unpack_mul[method_b]),
+              "m"(mask_10bit)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm7",) "memory"
+        );
+    }
+    dpx_unpack_rgb10(dst, src, width & 15, big_endian, method_b);
+}
+#endif /* HAVE_AVX2 */
+
+#define UNPACK_RGB10(name, opt, big_endian, method_b)                           \
+static void unpack_rgb10_ ## name ## _ ## opt(uint16_t *dst, const uint8_t *src,\
+                                              int width)                        \
+{                                                                               \
+    unpack_rgb10_ ## opt(dst, src, width, big_endian, method_b);                \
+}
+
+#define UNPACK_RGB10_FUNCS(opt)                                                 \
+UNPACK_RGB10(le_a, opt, 0, 0)                                                   \
+UNPACK_RGB10(le_b, opt, 0, 1)                                                   \
+UNPACK_RGB10(be_a, opt, 1, 0)                                                   \
+UNPACK_RGB10(be_b, opt, 1, 1)
+
+#define SET_UNPACK_RGB10_FUNCS(opt)                                             \
+    c->unpack_rgb10[0][0] = unpack_rgb10_le_a_ ## opt;                          \
+    c->unpack_rgb10[0][1] = unpack_rgb10_le_b_ ## opt;                          \
+    c->unpack_rgb10[1][0] = unpack_rgb10_be_a_ ## opt;                          \
+    c->unpack_rgb10[1][1] = unpack_rgb10_be_b_ ## opt;
+
+#if HAVE_SSSE3
+UNPACK_RGB10_FUNCS(ssse3)
+#endif
+#if HAVE_AVX2
+UNPACK_RGB10_FUNCS(avx2)
+#endif
+
+void ff_dpx_dsp_init_x86(DPXDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+#if HAVE_SSSE3
+    if (mm_flags & AV_CPU_FLAG_SSSE3) {
+        SET_UNPACK_RGB10_FUNCS(ssse3)
+    }
+#endif
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+        SET_UNPACK_RGB10_FUNCS(avx2)
+    }
+#endif
+}
@@ -711,6 +711,29 @@ static int vsad_intra16_mmx2(void *v, uint8_t * pix, uint8_t * dummy, int line_s
 }
 #undef SUM
 
+static int vsad_intra8_sse2(void *v, uint8_t * pix, uint8_t * dummy, int line_size, int h) {
+    int tmp;
+
+  __asm__ volatile (
+      "subl $1, %1\n"
+      "pxor %%xmm6, %%xmm6\n"
+      "movq (%0), %%xmm0\n"
+      "add %3, %0\n"
+      "1:\n"
+      "movq (%0), %%xmm1\n"
+      "add %3, %0\n"
+      "psadbw %%xmm1, %%xmm0\n"
+      "paddd %%xmm0, %%xmm6\n"
+      "movdqa %%xmm1, %%xmm0\n"
+      "subl $1, %1\n"
+      "jnz 1b\n"
+      "movd %%xmm6, %2\n"
+      : "+r" (pix), "+r"(h), "=r"(tmp)
+      : "r" ((x86_reg)line_size)
+      : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6",) "memory");
+    return tmp;
+}
+
 static int vsad16_mmx(void *v, uint8_t * pix1, uint8_t * pix2, int line_size, int h) {
     int tmp;
 
@@ -1142,6 +1165,14 @@ void dsputilenc_init_mmx(DSPContext* c, AVCodecContext *avctx)
                 c->fdct = ff_fdct_10_sse2;
             }
         }
+#if HAVE_AVX2
+        if (avctx->bits_per_raw_sample <= 8 && mm_flags & AV_CPU_FLAG_AVX2) {
+            if (dct_algo == FF_DCT_INT)
+                c->fdct = ff_jpeg_fdct_islow_avx2;
+            if (dct_algo != FF_DCT_FASTINT && dct_algo != FF_DCT_FAAN)
+                c->fdct248 = ff_fdct248_islow_avx2;
+        }
+#endif
 
         if (bit_depth <= 8)
             c->get_pixels = get_pixels_mmx;
@@ -1196,6 +1227,7 @@ void dsputilenc_init_mmx(DSPContext* c, AVCodecContext *avctx)
             else if (bit_depth <= 16)
                 c->get_pixels = get_pixels_10_sse2;
             c->sum_abs_dctelem= sum_abs_dctelem_sse2;
+            c->vsad[5] = vsad_intra8_sse2;
 #if HAVE_YASM && HAVE_ALIGNED_STACK
             c->hadamard8_diff[0]= ff_hadamard8_diff16_sse2;
             c->hadamard8_diff[1]= ff_hadamard8_diff_sse2;
@@ -0,0 +1,319 @@
+/*
+ * DV DSP functions, x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/dvdsp.h"
+
+#if HAVE_AVX2
+
+#define LANES(a, b, c, d, e, f, g, h) a, b, c, d, e, f, g, h, a, b, c, d, e, f, g, h
+#define PAIRS(a, b) a, b, a, b, a, b, a, b, a, b, a, b, a, b, a, b
+
+/* idctRowCondDC_8 as a matrix: for each pair of inputs (2p, 2p+1), their
+ * constants for outputs 0-3 then for outputs 4-7 */
+DECLARE_ALIGNED(32, static const int16_t, idct_row)[8][16] = {
+    { LANES( 16383,  22725,  16383,  19266,  16383,  12873,  16383,   4520) },
+    { LANES( 16383,  -4520,  16383, -12873,  16383, -19266,  16383, -22725) },
+    { LANES( 21407,  19266,   8867,  -4520,  -8867, -22725, -21407, -12873) },
+    { LANES(-21407,  12873,  -8867,  22725,   8867,   4520,  21407, -19266) },
+    { LANES( 16383,  12873, -16383, -22725, -16383,   4520,  16383,  19266) },
+    { LANES( 16383, -19266, -16383,  -4520, -16383,  22725,  16383, -12873) },
+    { LANES(  8867,   4520, -21407, -12873,  21407,  19266,  -8867, -22725) },
+    { LANES( -8867,  22725,  21407, -19266, -21407,  12873,   8867,  -4520) },
+};
+
+/* idct4col_put as a matrix: for output line q, the constants of the input
+ * pairs (a0, a1) and (a2, a3) */
+DECLARE_ALIGNED(32, static const int16_t, idct4_col)[8][16] = {
+    { PAIRS(2048,  2676) }, { PAIRS( 2048,  1108) },
+    { PAIRS(2048,  1108) }, { PAIRS(-2048, -2676) },
+    { PAIRS(2048, -1108) }, { PAIRS(-2048,  2676) },
+    { PAIRS(2048, -2676) }, { PAIRS( 2048, -1108) },
+};
+
+DECLARE_ALIGNED(32, static const int16_t, row_ac)[16] = {
+    0, -1, -1, -1, -1, -1, -1, -1, 0, -1, -1, -1, -1, -1, -1, -1,
+};
+DECLARE_ALIGNED(32, static const uint8_t, row_dc)[32] = {
+    0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
+    0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1,
+};
+DECLARE_ALIGNED(32, static const int32_t, rnd_col)[8] = {
+    1 << 16, 1 << 16, 1 << 16, 1 << 16, 1 << 16, 1 << 16, 1 << 16, 1 << 16,
+};
+static const int32_t rnd_row = 1 << 10;
+
+/* rows r and r+1 of the butterfly, one per lane. The outputs are truncated
+ * to 16 bits like the C version stores them, rows with only a DC
+ * coefficient take the shortcut of idctRowCondDC_8. */
+#define IDCT_ROW_PASS(offset)                                       \
+    "vmovdqu     "#offset"(%0), %%ymm0           \n\t"              \
+    "vpermq      $0x4e, %%ymm0, %%ymm1           \n\t"              \
+    "vpaddw      %%ymm1, %%ymm0, %%ymm2          \n\t"              \
+    "vpsubw      %%ymm0, %%ymm1, %%ymm1          \n\t"              \
+    "vpblendd    $0xf0, %%ymm1, %%ymm2, %%ymm0   \n\t"              \
+    "vpshufd     $0x00, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd       (%1), %%ymm1, %%ymm2         \n\t"              \
+    "vpmaddwd     32(%1), %%ymm1, %%ymm3         \n\t"              \
+    "vpshufd     $0x55, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd     64(%1), %%ymm1, %%ymm4         \n\t"              \
+    "vpmaddwd     96(%1), %%ymm1, %%ymm5         \n\t"              \
+    "vpaddd      %%ymm4, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpshufd     $0xaa, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd    128(%1), %%ymm1, %%ymm4         \n\t"              \
+    "vpmaddwd    160(%1), %%ymm1, %%ymm5         \n\t"              \
+    "vpaddd      %%ymm4, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpshufd     $0xff, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd    192(%1), %%ymm1, %%ymm4         \n\t"              \
+    "vpmaddwd    224(%1), %%ymm1, %%ymm5         \n\t"              \
+    "vpaddd      %%ymm4, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpaddd      %%ymm6, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm6, %%ymm3, %%ymm3          \n\t"              \
+    "vpslld      $5, %%ymm2, %%ymm2              \n\t"              \
+    "vpslld      $5, %%ymm3, %%ymm3              \n\t"              \
+    "vpsrad      $16, %%ymm2, %%ymm2             \n\t"              \
+    "vpsrad      $16, %%ymm3, %%ymm3             \n\t"              \
+    "vpackssdw   %%ymm3, %%ymm2, %%ymm2          \n\t"              \
+    "vpand       %2, %%ymm0, %%ymm3              \n\t"              \
+    "vpxor       %%ymm4, %%ymm4, %%ymm4          \n\t"              \
+    "vpcmpeqq    %%ymm4, %%ymm3, %%ymm3          \n\t"              \
+    "vpshufd     $0x4e, %%ymm3, %%ymm4           \n\t"              \
+    "vpand       %%ymm4, %%ymm3, %%ymm3          \n\t"              \
+    "vpsllw      $3, %%ymm0, %%ymm4              \n\t"              \
+    "vpshufb     %3, %%ymm4, %%ymm4              \n\t"              \
+    "vpblendvb   %%ymm3, %%ymm4, %%ymm2, %%ymm2  \n\t"              \
+    "vmovdqu     %%ymm2, "#offset"(%0)           \n\t"
+
+/* output line q of both fields: the even field in the low lane, the odd
+ * one in the high lane */
+#define IDCT4_COL(q, dst)                                           \
+    "vpmaddwd    "#q"*64(%3), %%ymm0, %%"#dst"   \n\t"              \
+    "vpmaddwd    "#q"*64+32(%3), %%ymm2, %%ymm7  \n\t"              \
+    "vpaddd      %%ymm7, %%"#dst", %%"#dst"      \n\t"              \
+    "vpaddd      %4, %%"#dst", %%"#dst"          \n\t"              \
+    "vpsrad      $17, %%"#dst", %%"#dst"         \n\t"              \
+    "vpmaddwd    "#q"*64(%3), %%ymm1, %%ymm6     \n\t"              \
+    "vpmaddwd    "#q"*64+32(%3), %%ymm3, %%ymm7  \n\t"              \
+    "vpaddd      %%ymm7, %%ymm6, %%ymm6          \n\t"              \
+    "vpaddd      %4, %%ymm6, %%ymm6              \n\t"              \
+    "vpsrad      $17, %%ymm6, %%ymm6             \n\t"              \
+    "vpackssdw   %%ymm6, %%"#dst", %%"#dst"      \n\t"
+
+/* lines 2q to 2q+3 */
+#define IDCT4_STORE                                                 \
+    "vpackuswb   %%ymm5, %%ymm4, %%ymm4          \n\t"              \
+    "vpermq      $0xd8, %%ymm4, %%ymm4           \n\t"              \
+    "vmovq       %%xmm4, (%0)                    \n\t"              \
+    "vmovhps     %%xmm4, (%0,%1)                 \n\t"              \
+    "lea         (%0,%1,2), %0                   \n\t"              \
+    "vextracti128 $1, %%ymm4, %%xmm4             \n\t"              \
+    "vmovq       %%xmm4, (%0)                    \n\t"              \
+    "vmovhps     %%xmm4, (%0,%1)                 \n\t"              \
+    "lea         (%0,%1,2), %0                   \n\t"
+
+static void idct248_put_avx2(uint8_t *dest, int line_size, DCTELEM *block)
+{
+    __asm__ volatile(
+        "vpbroadcastd %4, %%ymm6                 \n\t"
+        IDCT_ROW_PASS(0)
+        IDCT_ROW_PASS(32)
+        IDCT_ROW_PASS(64)
+        IDCT_ROW_PASS(96)
+        :
+        : "r"(block), "r"(idct_row), "m"(*row_ac), "m"(*row_dc), "m"(rnd_row)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6",)
+          "memory"
+    );
+    __asm__ volatile(
+        "vmovdqu       (%2), %%ymm4              \n\t"
+        "vmovdqu     32(%2), %%ymm5              \n\t"
+        "vpunpcklwd  %%ymm5, %%ymm4, %%ymm0      \n\t"
+        "vpunpckhwd  %%ymm5, %%ymm4, %%ymm1      \n\t"
+        "vmovdqu     64(%2), %%ymm4              \n\t"
+        "vmovdqu     96(%2), %%ymm5              \n\t"
+        "vpunpcklwd  %%ymm5, %%ymm4, %%ymm2      \n\t"
+        "vpunpckhwd  %%ymm5, %%ymm4, %%ymm3      \n\t"
+        IDCT4_COL(0, ymm4)
+        IDCT4_COL(1, ymm5)
+        IDCT4_STORE
+        IDCT4_COL(2, ymm4)
+        IDCT4_COL(3, ymm5)
+        IDCT4_STORE
+        "vzeroupper                              \n\t"
+        : "+r"(dest)
+        : "r"((x86_reg)line_size), "r"(block), "r"(idct4_col), "m"(*rnd_col)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)
+          "memory"
+    );
+}
+
+DECLARE_ALIGNED(32, static const int16_t, first_ac)[16] = {
+    0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+/* coefficients 16k to 16k+15, sig gets those above the threshold */
+#define WEIGH(k, sig, ac)                                           \
+    "vmovdqu     32*"#k"(%3), %%ymm0             \n\t"              \
+    "vpsrlw      $15, %%ymm0, %%ymm3             \n\t"              \
+    "vpackuswb   %%ymm3, %%ymm3, %%ymm3          \n\t"              \
+    "vpermq      $0x08, %%ymm3, %%ymm3           \n\t"              \
+    "vmovdqu     %%xmm3, 16*"#k"(%4)             \n\t"              \
+    "vpabsw      %%ymm0, %%ymm0                  \n\t"              \
+    "vpcmpgtw    %%ymm6, %%ymm0, %%"#sig"        \n\t"              \
+    ac                                                              \
+    "vpmovzxwd   %%xmm0, %%ymm3                  \n\t"              \
+    "vextracti128 $1, %%ymm0, %%xmm0             \n\t"              \
+    "vpmovzxwd   %%xmm0, %%ymm0                  \n\t"              \
+    "vpmulld     64*"#k"(%5), %%ymm3, %%ymm3     \n\t"              \
+    "vpmulld     64*"#k"+32(%5), %%ymm0, %%ymm0  \n\t"              \
+    "vpaddd      %%ymm7, %%ymm3, %%ymm3          \n\t"              \
+    "vpaddd      %%ymm7, %%ymm0, %%ymm0          \n\t"              \
+    "vpsrad      %%xmm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpsrad      %%xmm5, %%ymm0, %%ymm0          \n\t"              \
+    "vpackssdw   %%ymm0, %%ymm3, %%ymm3          \n\t"              \
+    "vpermq      $0xd8, %%ymm3, %%ymm3           \n\t"              \
+    "vmovdqu     %%ymm3, 32*"#k"(%3)             \n\t"              \
+    "vpand       %%"#sig", %%ymm3, %%ymm3        \n\t"              \
+    "vpmaxsw     %%ymm3, %%ymm4, %%ymm4          \n\t"
+
+/* significance masks of coefficients 16k to 16k+31 */
+#define MASK(dst)                                                   \
+    "vpacksswb   %%ymm2, %%ymm1, %%ymm1          \n\t"              \
+    "vpermq      $0xd8, %%ymm1, %%ymm1           \n\t"              \
+    "vpmovmskb   %%ymm1, %"#dst"                 \n\t"
+
+static uint64_t weigh_avx2(DCTELEM *dst, uint8_t *sign, const DCTELEM *blk,
+                           const uint8_t *zigzag, const int *weight,
+                           int bias, int shift, int threshold, int *max)
+{
+    int16_t thr = threshold;
+    uint32_t lo, hi;
+    uint16_t m;
+    int i;
+
+    for (i = 0; i < 64; i++)
+        dst[i] = blk[zigzag[i]];
+
+    __asm__ volatile(
+        "vpbroadcastw %7, %%ymm6                 \n\t"
+        "vpbroadcastd %8, %%ymm7                 \n\t"
+        "vmovd       %9, %%xmm5                  \n\t"
+        "vpxor       %%ymm4, %%ymm4, %%ymm4      \n\t"
+        WEIGH(0, ymm1, "vpand %6, %%ymm1, %%ymm1 \n\t")
+        WEIGH(1, ymm2, )
+        MASK(0)
+        WEIGH(2, ymm1, )
+        WEIGH(3, ymm2, )
+        MASK(1)
+        "vextracti128 $1, %%ymm4, %%xmm0         \n\t"
+        "vpmaxsw     %%xmm0, %%xmm4, %%xmm4      \n\t"
+        "vpshufd     $0x4e, %%xmm4, %%xmm0       \n\t"
+        "vpmaxsw     %%xmm0, %%xmm4, %%xmm4      \n\t"
+        "vpshufd     $0xb1, %%xmm4, %%xmm0       \n\t"
+        "vpmaxsw     %%xmm0, %%xmm4, %%xmm4      \n\t"
+        "vpsrld      $16, %%xmm4, %%xmm0         \n\t"
+        "vpmaxsw     %%xmm0, %%xmm4, %%xmm4      \n\t"
+        "vpextrw     $0, %%xmm4, %2              \n\t"
+        "vzeroupper                              \n\t"
+        : "=&r"(lo), "=&r"(hi), "=m"(m)
+        : "r"(dst), "r"(sign), "r"(weight), "m"(*first_ac),
+          "m"(thr), "m"(bias), "m"(shift)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)
+          "memory"
+    );
+    *max = m;
+    return (uint64_t)hi << 32 | lo;
+}
+
+/* coefficients 16k to 16k+15, zero gets those quantized to 0 */
+#define QUANTIZE(k, zero)                                           \
+    "vpmovzxwd   32*"#k"(%3), %%ymm0             \n\t"              \
+    "vpmovzxwd   32*"#k"+16(%3), %%ymm1          \n\t"              \
+    "vpmulld     %%ymm5, %%ymm0, %%ymm0          \n\t"              \
+    "vpmulld     %%ymm5, %%ymm1, %%ymm1          \n\t"              \
+    "vpaddd      %%ymm6, %%ymm0, %%ymm0          \n\t"              \
+    "vpaddd      %%ymm6, %%ymm1, %%ymm1          \n\t"              \
+    "vpsrad      %%xmm7, %%ymm0, %%ymm0          \n\t"              \
+    "vpsrad      %%xmm7, %%ymm1, %%ymm1          \n\t"              \
+    "vpackssdw   %%ymm1, %%ymm0, %%ymm0          \n\t"              \
+    "vpermq      $0xd8, %%ymm0, %%ymm0           \n\t"              \
+    "vpminsw     %%ymm4, %%ymm0, %%ymm0          \n\t"              \
+    "vmovdqu     %%ymm0, 32*"#k"(%2)             \n\t"              \
+    "vpcmpeqw    %%ymm3, %%ymm0, %%"#zero"       \n\t"
+
+static const int16_t max_level = 255;
+static const int32_t rnd_quant = 1024 + (1 << 15);
+
+static uint64_t quantize_hd_avx2(DCTELEM *dst, const DCTELEM *src, int qsinv, int cno)
+{
+    int shift = 16 + cno;
+    DCTELEM dc = dst[0];
+    uint32_t lo, hi;
+
+    __asm__ volatile(
+        "vpbroadcastd %4, %%ymm5                 \n\t"
+        "vpbroadcastd %5, %%ymm6                 \n\t"
+        "vmovd       %6, %%xmm7                  \n\t"
+        "vpbroadcastw %7, %%ymm4                 \n\t"
+        "vpxor       %%ymm3, %%ymm3, %%ymm3      \n\t"
+        QUANTIZE(0, ymm2)
+        QUANTIZE(1, ymm1)
+        "vpacksswb   %%ymm1, %%ymm2, %%ymm1      \n\t"
+        "vpermq      $0xd8, %%ymm1, %%ymm1       \n\t"
+        "vpmovmskb   %%ymm1, %0                  \n\t"
+        QUANTIZE(2, ymm2)
+        QUANTIZE(3, ymm1)
+        "vpacksswb   %%ymm1, %%ymm2, %%ymm1      \n\t"
+        "vpermq      $0xd8, %%ymm1, %%ymm1       \n\t"
+        "vpmovmskb   %%ymm1, %1                  \n\t"
+        "vzeroupper                              \n\t"
+        : "=&r"(lo), "=&r"(hi)
+        : "r"(dst), "r"(src), "m"(qsinv), "m"(rnd_quant), "m"(shift),
+          "m"(max_level)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)
+          "memory"
+    );
+    dst[0] = dc;
+    return ~((uint64_t)hi << 32 | lo) & ~1ULL;
+}
+#endif /* HAVE_AVX2 */
+
+void ff_dv_dsp_init_x86(DVDSPContext *c)
+{
+#if HAVE_AVX2
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+        c->idct248_put = idct248_put_avx2;
+        c->weigh       = weigh_avx2;
+        c->quantize_hd = quantize_hd_avx2;
+    }
+#endif
+}
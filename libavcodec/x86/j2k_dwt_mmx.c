@@ -0,0 +1,174 @@
+/*
+ * Discrete wavelet transform, x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/j2k_dwt.h"
+
+/* rows are FF_DWT_STRIP * 4 = 32 bytes, one lifting step per pair of rows */
+
+#define LIFT53_SSE2(name, op)                                           \
+static void lift53_ ## name ## _sse2(int *p, int n, int rnd, int shift) \
+{                                                                       \
+    if (n <= 0)                                                         \
+        return;                                                         \
+    __asm__ volatile(                                                   \
+        "movd      %2, %%xmm6           \n\t"                           \
+        "pshufd    $0, %%xmm6, %%xmm6   \n\t"                           \
+        "movd      %3, %%xmm7           \n\t"                           \
+        "1:                             \n\t"                           \
+        "movdqu      (%0), %%xmm0       \n\t"                           \
+        "movdqu    16(%0), %%xmm1       \n\t"                           \
+        "movdqu    64(%0), %%xmm2       \n\t"                           \
+        "movdqu    80(%0), %%xmm3       \n\t"                           \
+        "paddd     %%xmm2, %%xmm0       \n\t"                           \
+        "paddd     %%xmm3, %%xmm1       \n\t"                           \
+        "paddd     %%xmm6, %%xmm0       \n\t"                           \
+        "paddd     %%xmm6, %%xmm1       \n\t"                           \
+        "psrad     %%xmm7, %%xmm0       \n\t"                           \
+        "psrad     %%xmm7, %%xmm1       \n\t"                           \
+        "movdqu    32(%0), %%xmm2       \n\t"                           \
+        "movdqu    48(%0), %%xmm3       \n\t"                           \
+        op "       %%xmm0, %%xmm2       \n\t"                           \
+        op "       %%xmm1, %%xmm3       \n\t"                           \
+        "movdqu    %%xmm2, 32(%0)       \n\t"                           \
+        "movdqu    %%xmm3, 48(%0)       \n\t"                           \
+        "add       $64, %0              \n\t"                           \
+        "dec       %1                   \n\t"                           \
+        "jnz 1b                         \n\t"                           \
+        : "+r"(p), "+r"(n)                                              \
+        : "r"(rnd), "r"(shift)                                          \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",              \
+                       "%xmm6", "%xmm7",) "memory"                      \
+    );                                                                  \
+}
+
+LIFT53_SSE2(add, "paddd")
+LIFT53_SSE2(sub, "psubd")
+
+static void lift97_sse(float *p, int n, float c)
+{
+    if (n <= 0)
+        return;
+    __asm__ volatile(
+        "movss     %2, %%xmm6           \n\t"
+        "shufps    $0, %%xmm6, %%xmm6   \n\t"
+        "1:                             \n\t"
+        "movups      (%0), %%xmm0       \n\t"
+        "movups    16(%0), %%xmm1       \n\t"
+        "movups    64(%0), %%xmm2       \n\t"
+        "movups    80(%0), %%xmm3       \n\t"
+        "addps     %%xmm2, %%xmm0       \n\t"
+        "addps     %%xmm3, %%xmm1       \n\t"
+        "mulps     %%xmm6, %%xmm0       \n\t"
+        "mulps     %%xmm6, %%xmm1       \n\t"
+        "movups    32(%0), %%xmm2       \n\t"
+        "movups    48(%0), %%xmm3       \n\t"
+        "addps     %%xmm0, %%xmm2       \n\t"
+        "addps     %%xmm1, %%xmm3       \n\t"
+        "movups    %%xmm2, 32(%0)       \n\t"
+        "movups    %%xmm3, 48(%0)       \n\t"
+        "add       $64, %0              \n\t"
+        "dec       %1                   \n\t"
+        "jnz 1b                         \n\t"
+        : "+r"(p), "+r"(n)
+        : "m"(c)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm6",)
+          "memory"
+    );
+}
+
+#if HAVE_AVX
+static void lift97_avx(float *p, int n, float c)
+{
+    if (n <= 0)
+        return;
+    __asm__ volatile(
+        "vbroadcastss %2, %%ymm6                \n\t"
+        "1:                                     \n\t"
+        "vmovups    (%0), %%ymm0                \n\t"
+        "vaddps   64(%0), %%ymm0, %%ymm0        \n\t"
+        "vmulps   %%ymm6, %%ymm0, %%ymm0        \n\t"
+        "vaddps   32(%0), %%ymm0, %%ymm0        \n\t"
+        "vmovups  %%ymm0, 32(%0)                \n\t"
+        "add      $64, %0                       \n\t"
+        "dec      %1                            \n\t"
+        "jnz 1b                                 \n\t"
+        "vzeroupper                             \n\t"
+        : "+r"(p), "+r"(n)
+        : "m"(c)
+        : XMM_CLOBBERS("%xmm0", "%xmm6",) "memory"
+    );
+}
+#endif
+
+#if HAVE_AVX2
+#define LIFT53_AVX2(name, op)                                           \
+static void lift53_ ## name ## _avx2(int *p, int n, int rnd, int shift) \
+{                                                                       \
+    if (n <= 0)                                                         \
+        return;                                                         \
+    __asm__ volatile(                                                   \
+        "vmovd        %2, %%xmm6                \n\t"                   \
+        "vpbroadcastd %%xmm6, %%ymm6            \n\t"                   \
+        "vmovd        %3, %%xmm7                \n\t"                   \
+        "1:                                     \n\t"                   \
+        "vmovdqu    (%0), %%ymm0                \n\t"                   \
+        "vpaddd   64(%0), %%ymm0, %%ymm0        \n\t"                   \
+        "vpaddd   %%ymm6, %%ymm0, %%ymm0        \n\t"                   \
+        "vpsrad   %%xmm7, %%ymm0, %%ymm0        \n\t"                   \
+        "vmovdqu  32(%0), %%ymm1                \n\t"                   \
+        op "      %%ymm0, %%ymm1, %%ymm1        \n\t"                   \
+        "vmovdqu  %%ymm1, 32(%0)                \n\t"                   \
+        "add      $64, %0                       \n\t"                   \
+        "dec      %1                            \n\t"                   \
+        "jnz 1b                                 \n\t"                   \
+        "vzeroupper                             \n\t"                   \
+        : "+r"(p), "+r"(n)                                              \
+        : "r"(rnd), "r"(shift)                                          \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6", "%xmm7",) "memory"    \
+    );                                                                  \
+}
+
+LIFT53_AVX2(add, "vpaddd")
+LIFT53_AVX2(sub, "vpsubd")
+#endif /* HAVE_AVX2 */
+
+void ff_j2k_dwt_dsp_init_x86(DWTDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE)
+        c->lift97 = lift97_sse;
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        c->lift53_add = lift53_add_sse2;
+        c->lift53_sub = lift53_sub_sse2;
+    }
+#if HAVE_AVX
+    if (mm_flags & AV_CPU_FLAG_AVX)
+        c->lift97 = lift97_avx;
+#endif
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+        c->lift53_add = lift53_add_avx2;
+        c->lift53_sub = lift53_sub_avx2;
+    }
+#endif
+}
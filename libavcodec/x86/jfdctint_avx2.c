@@ -0,0 +1,190 @@
+/*
+ * AVX2 version of the Independent JPEG Group's slow & accurate dct
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * AVX2 islow fdct and 2-4-8 fdct, bitexact with the 8-bit C versions.
+ *
+ * Each pass of jfdctint only rounds once, when descaling, so its outputs
+ * are sums of the inputs times constants which all fit in 16 bits: the
+ * passes are done as matrix products with pmaddwd, the 32-bit sums
+ * are exact. The outputs which the C version only shifts use
+ * 1 << CONST_BITS as their constant, so that all outputs of a pass are
+ * descaled by the same amount.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/dsputil.h"
+
+#if HAVE_AVX2
+
+#define LANES(a, b, c, d, e, f, g, h) a, b, c, d, e, f, g, h, a, b, c, d, e, f, g, h
+
+/* row pass: for each pair of inputs (2p, 2p+1), their constants for
+ * outputs 0-3 then for outputs 4-7, descaled by CONST_BITS - PASS1_BITS */
+DECLARE_ALIGNED(32, static const int16_t, fdct_row)[8][16] = {
+    { LANES( 8192,  8192,  11363,   9633,  10703,   4433,   9633,  -2259) },
+    { LANES( 8192, -8192,   6437, -11362,   4433, -10704,   2260,  -6436) },
+    { LANES( 8192,  8192,   6437,   2260,  -4433, -10703, -11362,  -6436) },
+    { LANES(-8192,  8192,   2261,   9633,  10704,  -4433,   9633, -11363) },
+    { LANES( 8192,  8192,  -2260,  -6437, -10703,  -4433,   6436,  11362) },
+    { LANES( 8192, -8192,  -9633,  -2261,  -4433,  10704,  11363,  -9633) },
+    { LANES( 8192,  8192,  -9633, -11363,   4433,  10703,   2259,  -9633) },
+    { LANES(-8192,  8192,  11362,  -6437, -10704,   4433,   6436,  -2260) },
+};
+
+/* column passes: for each output row, the constants of the pairs of input
+ * rows (2p, 2p+1), descaled by CONST_BITS + OUT_SHIFT */
+DECLARE_ALIGNED(16, static const int16_t, fdct_col_88)[8][8] = {
+    {  8192,  8192,   8192,   8192,   8192,   8192,   8192,   8192 },
+    { 11363,  9633,   6437,   2260,  -2260,  -6437,  -9633, -11363 },
+    { 10703,  4433,  -4433, -10703, -10703,  -4433,   4433,  10703 },
+    {  9633, -2259, -11362,  -6436,   6436,  11362,   2259,  -9633 },
+    {  8192, -8192,  -8192,   8192,   8192,  -8192,  -8192,   8192 },
+    {  6437, -11362,  2261,   9633,  -9633,  -2261,  11362,  -6437 },
+    {  4433, -10704, 10704,  -4433,  -4433,  10704, -10704,   4433 },
+    {  2260, -6436,   9633, -11363,  11363,  -9633,   6436,  -2260 },
+};
+
+DECLARE_ALIGNED(16, static const int16_t, fdct_col_248)[8][8] = {
+    {  8192,  8192,   8192,   8192,   8192,   8192,   8192,   8192 },
+    {  8192, -8192,   8192,  -8192,   8192,  -8192,   8192,  -8192 },
+    { 10703, 10703,   4433,   4433,  -4433,  -4433, -10703, -10703 },
+    { 10703, -10703,  4433,  -4433,  -4433,   4433, -10703,  10703 },
+    {  8192,  8192,  -8192,  -8192,  -8192,  -8192,   8192,   8192 },
+    {  8192, -8192,  -8192,   8192,  -8192,   8192,   8192,  -8192 },
+    {  4433,  4433, -10704, -10704,  10704,  10704,  -4433,  -4433 },
+    {  4433, -4433, -10704,  10704,  10704, -10704,  -4433,   4433 },
+};
+
+/* interleaves the words of the two qwords of each lane */
+DECLARE_ALIGNED(32, static const uint8_t, interleave_qwords)[32] = {
+    0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+    0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+};
+
+static const int32_t rnd_row = 1 << 8;
+static const int32_t rnd_col = 1 << 16;
+
+/* rows r and r+1, one per lane: each pair of inputs is broadcast and
+ * multiplied with its constants for the 8 outputs */
+#define ROW_PASS(offset)                                            \
+    "vmovdqu     "#offset"(%0), %%ymm0           \n\t"              \
+    "vpshufd     $0x00, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd       (%1), %%ymm1, %%ymm2         \n\t"              \
+    "vpmaddwd     32(%1), %%ymm1, %%ymm3         \n\t"              \
+    "vpshufd     $0x55, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd     64(%1), %%ymm1, %%ymm4         \n\t"              \
+    "vpmaddwd     96(%1), %%ymm1, %%ymm5         \n\t"              \
+    "vpaddd      %%ymm4, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpshufd     $0xaa, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd    128(%1), %%ymm1, %%ymm4         \n\t"              \
+    "vpmaddwd    160(%1), %%ymm1, %%ymm5         \n\t"              \
+    "vpaddd      %%ymm4, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpshufd     $0xff, %%ymm0, %%ymm1           \n\t"              \
+    "vpmaddwd    192(%1), %%ymm1, %%ymm4         \n\t"              \
+    "vpmaddwd    224(%1), %%ymm1, %%ymm5         \n\t"              \
+    "vpaddd      %%ymm4, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm5, %%ymm3, %%ymm3          \n\t"              \
+    "vpaddd      %%ymm7, %%ymm2, %%ymm2          \n\t"              \
+    "vpaddd      %%ymm7, %%ymm3, %%ymm3          \n\t"              \
+    "vpsrad      $9, %%ymm2, %%ymm2              \n\t"              \
+    "vpsrad      $9, %%ymm3, %%ymm3              \n\t"              \
+    "vpackssdw   %%ymm3, %%ymm2, %%ymm2          \n\t"              \
+    "vmovdqu     %%ymm2, "#offset"(%0)           \n\t"
+
+/* rows 2p and 2p+1 of each column interleaved, columns 0-3 in the low
+ * lane and 4-7 in the high one */
+#define INTERLEAVE(offset, reg)                                     \
+    "vpermq      $0xd8, "#offset"(%0), %%"#reg"  \n\t"              \
+    "vpshufb     %%ymm3, %%"#reg", %%"#reg"      \n\t"
+
+#define COL_OUT(offset, dst)                                        \
+    "vpbroadcastd   "#offset"(%1), %%ymm0        \n\t"              \
+    "vpmaddwd    %%ymm4, %%ymm0, %%"#dst"        \n\t"              \
+    "vpbroadcastd 4+"#offset"(%1), %%ymm0        \n\t"              \
+    "vpmaddwd    %%ymm5, %%ymm0, %%ymm0          \n\t"              \
+    "vpaddd      %%ymm0, %%"#dst", %%"#dst"      \n\t"              \
+    "vpbroadcastd 8+"#offset"(%1), %%ymm0        \n\t"              \
+    "vpmaddwd    %%ymm6, %%ymm0, %%ymm0          \n\t"              \
+    "vpaddd      %%ymm0, %%"#dst", %%"#dst"      \n\t"              \
+    "vpbroadcastd 12+"#offset"(%1), %%ymm0       \n\t"              \
+    "vpmaddwd    %%ymm7, %%ymm0, %%ymm0          \n\t"              \
+    "vpaddd      %%ymm0, %%"#dst", %%"#dst"      \n\t"              \
+    "vpaddd      %%ymm3, %%"#dst", %%"#dst"      \n\t"              \
+    "vpsrad      $17, %%"#dst", %%"#dst"         \n\t"
+
+/* output rows u and u+1 */
+#define COL_PASS(u)                                                 \
+    COL_OUT(u * 16, ymm1)                                           \
+    COL_OUT(u * 16 + 16, ymm2)                                      \
+    "vpackssdw   %%ymm2, %%ymm1, %%ymm1          \n\t"              \
+    "vpermq      $0xd8, %%ymm1, %%ymm1           \n\t"              \
+    "vmovdqu     %%ymm1, "#u"*16(%0)             \n\t"
+
+static av_always_inline void fdct_islow_avx2(DCTELEM *block, const int16_t (*col)[8])
+{
+    __asm__ volatile(
+        "vpbroadcastd %2, %%ymm7                 \n\t"
+        ROW_PASS(0)
+        ROW_PASS(32)
+        ROW_PASS(64)
+        ROW_PASS(96)
+        :
+        : "r"(block), "r"(fdct_row), "m"(rnd_row)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm7",)
+          "memory"
+    );
+    __asm__ volatile(
+        "vmovdqa     %2, %%ymm3                  \n\t"
+        INTERLEAVE(0,  ymm4)
+        INTERLEAVE(32, ymm5)
+        INTERLEAVE(64, ymm6)
+        INTERLEAVE(96, ymm7)
+        "vpbroadcastd %3, %%ymm3                 \n\t"
+        COL_PASS(0)
+        COL_PASS(2)
+        COL_PASS(4)
+        COL_PASS(6)
+        "vzeroupper                              \n\t"
+        :
+        : "r"(block), "r"(col), "m"(*interleave_qwords), "m"(rnd_col)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)
+          "memory"
+    );
+}
+
+void ff_jpeg_fdct_islow_avx2(DCTELEM *block)
+{
+    fdct_islow_avx2(block, fdct_col_88);
+}
+
+void ff_fdct248_islow_avx2(DCTELEM *block)
+{
+    fdct_islow_avx2(block, fdct_col_248);
+}
+
+#endif /* HAVE_AVX2 */
@@ -589,6 +589,103 @@ static void  denoise_dct_sse2(MpegEncContext *s, DCTELEM *block){
     );
 }
 
+#if HAVE_AVX2 && ARCH_X86_64
+DECLARE_ALIGNED(32, static const int, lane_index)[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+static const int lane_step = 8;
+static const int byte_mask = 0xff;
+
+/* Eight survivors per iteration, the lengths are gathered as dwords and the
+ * byte is extracted: the dword starts 3 bytes before it when possible so
+ * that no lane reads past the end of the table. Every lane keeps its best
+ * score and the highest index reaching it, the lanes are merged at the end.
+ * All 16 ymm registers are used, hence x86-64 only. */
+int ff_trellis_best_survivor_avx2(const int *survivor, const int *survivor_score, int survivor_count,
+                                  const uint8_t *length, int level, int i, int distortion, int lambda,
+                                  int *best_score)
+{
+    const uint8_t *base = length + level;
+    int shift = 0, score, best;
+    x86_reg count = survivor_count;
+
+    if (level >= 3) {
+        base -= 3;
+        shift = 24;
+    }
+
+    __asm__ volatile(
+        "vpbroadcastd %[i],          %%ymm15            \n\t"
+        "vpbroadcastd %[lambda],     %%ymm14            \n\t"
+        "vpbroadcastd %[distortion], %%ymm13            \n\t"
+        "vpbroadcastd %[count],      %%ymm12            \n\t"
+        "vpbroadcastd %[byte_mask],  %%ymm11            \n\t"
+        "vmovd        %[shift],      %%xmm10            \n\t"
+        "vpbroadcastd %[lane_step],  %%ymm9             \n\t"
+        "vmovdqa      %[lane_index], %%ymm8             \n\t"
+        "vpcmpeqd     %%ymm7, %%ymm7, %%ymm7            \n\t"
+        "vpsrld       $1, %%ymm7, %%ymm7                \n\t" /* INT_MAX */
+        "vmovdqa      %%ymm7, %%ymm4                    \n\t" /* best score */
+        "vpcmpeqd     %%ymm3, %%ymm3, %%ymm3            \n\t" /* best index */
+        "1:                                             \n\t"
+        "vpcmpgtd     %%ymm8, %%ymm12, %%ymm0           \n\t" /* lane < count */
+        "vpmaskmovd   (%[survivor]), %%ymm0, %%ymm1     \n\t"
+        "vpsubd       %%ymm1, %%ymm15, %%ymm1           \n\t" /* run */
+        "vpslld       $7, %%ymm1, %%ymm1                \n\t"
+        "vmovdqa      %%ymm0, %%ymm5                    \n\t"
+        "vpxor        %%ymm2, %%ymm2, %%ymm2            \n\t"
+        "vpgatherdd   %%ymm5, (%[base], %%ymm1, 1), %%ymm2 \n\t"
+        "vpsrld       %%xmm10, %%ymm2, %%ymm2           \n\t"
+        "vpand        %%ymm11, %%ymm2, %%ymm2           \n\t"
+        "vpmulld      %%ymm14, %%ymm2, %%ymm2           \n\t"
+        "vpaddd       %%ymm13, %%ymm2, %%ymm2           \n\t"
+        "vpmaskmovd   (%[survivor_score]), %%ymm0, %%ymm6 \n\t"
+        "vpaddd       %%ymm6, %%ymm2, %%ymm2            \n\t"
+        "vpblendvb    %%ymm0, %%ymm2, %%ymm7, %%ymm2    \n\t" /* unused lanes: INT_MAX */
+        "vpcmpgtd     %%ymm4, %%ymm2, %%ymm6            \n\t" /* score > best */
+        "vpblendvb    %%ymm6, %%ymm4, %%ymm2, %%ymm4    \n\t"
+        "vpblendvb    %%ymm6, %%ymm3, %%ymm8, %%ymm3    \n\t"
+        "vpaddd       %%ymm9, %%ymm8, %%ymm8            \n\t"
+        "add          $32, %[survivor]                  \n\t"
+        "add          $32, %[survivor_score]            \n\t"
+        "sub          $8, %[n]                          \n\t"
+        "jg 1b                                          \n\t"
+        /* lowest score, then highest index among the lanes reaching it */
+        "vextracti128 $1, %%ymm4, %%xmm0                \n\t"
+        "vpminsd      %%xmm4, %%xmm0, %%xmm0            \n\t"
+        "vpshufd      $0x4e, %%xmm0, %%xmm1             \n\t"
+        "vpminsd      %%xmm1, %%xmm0, %%xmm0            \n\t"
+        "vpshufd      $0xb1, %%xmm0, %%xmm1             \n\t"
+        "vpminsd      %%xmm1, %%xmm0, %%xmm0            \n\t"
+        "vpbroadcastd %%xmm0, %%ymm1                    \n\t"
+        "vpcmpeqd     %%ymm4, %%ymm1, %%ymm1            \n\t"
+        "vpcmpeqd     %%ymm2, %%ymm2, %%ymm2            \n\t"
+        "vpblendvb    %%ymm1, %%ymm3, %%ymm2, %%ymm2    \n\t"
+        "vextracti128 $1, %%ymm2, %%xmm1                \n\t"
+        "vpmaxsd      %%xmm2, %%xmm1, %%xmm1            \n\t"
+        "vpshufd      $0x4e, %%xmm1, %%xmm2             \n\t"
+        "vpmaxsd      %%xmm2, %%xmm1, %%xmm1            \n\t"
+        "vpshufd      $0xb1, %%xmm1, %%xmm2             \n\t"
+        "vpmaxsd      %%xmm2, %%xmm1, %%xmm1            \n\t"
+        "vmovd        %%xmm0, %[score]                  \n\t"
+        "vmovd        %%xmm1, %[best]                   \n\t"
+        "vzeroupper                                     \n\t"
+        : [survivor]"+r"(survivor), [survivor_score]"+r"(survivor_score), [n]"+r"(count),
+          [score]"=r"(score), [best]"=r"(best)
+        : [base]"r"(base), [i]"m"(i), [lambda]"m"(lambda), [distortion]"m"(distortion),
+          [count]"m"(survivor_count), [shift]"m"(shift), [byte_mask]"m"(byte_mask),
+          [lane_step]"m"(lane_step), [lane_index]"m"(*lane_index)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2",  "%xmm3",  "%xmm4",  "%xmm5",  "%xmm6",  "%xmm7",
+                       "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15",)
+          "memory"
+    );
+
+    if (score < *best_score) {
+        *best_score = score;
+        return best;
+    }
+    return -1;
+}
+#endif /* HAVE_AVX2 && ARCH_X86_64 */
+
 #if HAVE_SSSE3
 #define HAVE_SSSE3_BAK
 #endif
@@ -664,5 +761,9 @@ void MPV_common_init_mmx(MpegEncContext *s)
                 s->dct_quantize= dct_quantize_MMX;
             }
         }
+#if HAVE_AVX2 && ARCH_X86_64
+        if (mm_flags & AV_CPU_FLAG_AVX2)
+            s->trellis_best_survivor = ff_trellis_best_survivor_avx2;
+#endif
     }
 }
@@ -0,0 +1,99 @@
+/*
+ * audio resampling, x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/resample2.h"
+
+static float dot_flt_sse(const float *src, const float *filter, int len)
+{
+    x86_reg i = -4*len;
+    float sum;
+
+    __asm__ volatile(
+        "xorps      %%xmm0, %%xmm0      \n\t"
+        "xorps      %%xmm1, %%xmm1      \n\t"
+        "1:                             \n\t"
+        "movups       (%2,%0), %%xmm2   \n\t"
+        "movups     16(%2,%0), %%xmm3   \n\t"
+        "movups       (%3,%0), %%xmm4   \n\t"
+        "movups     16(%3,%0), %%xmm5   \n\t"
+        "mulps      %%xmm4, %%xmm2      \n\t"
+        "mulps      %%xmm5, %%xmm3      \n\t"
+        "addps      %%xmm2, %%xmm0      \n\t"
+        "addps      %%xmm3, %%xmm1      \n\t"
+        "add        $32, %0             \n\t"
+        "jl 1b                          \n\t"
+        "addps      %%xmm1, %%xmm0      \n\t"
+        "movhlps    %%xmm0, %%xmm1      \n\t"
+        "addps      %%xmm1, %%xmm0      \n\t"
+        "movaps     %%xmm0, %%xmm1      \n\t"
+        "shufps     $0x55, %%xmm0, %%xmm1 \n\t"
+        "addss      %%xmm1, %%xmm0      \n\t"
+        "movss      %%xmm0, %1          \n\t"
+        : "+r"(i), "=m"(sum)
+        : "r"(src + len), "r"(filter + len)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",)
+          "memory"
+    );
+    return sum;
+}
+
+#if HAVE_AVX
+static float dot_flt_avx(const float *src, const float *filter, int len)
+{
+    x86_reg i = -4*len;
+    float sum;
+
+    __asm__ volatile(
+        "vxorps     %%ymm0, %%ymm0, %%ymm0          \n\t"
+        "1:                                         \n\t"
+        "vmovups      (%2,%0), %%ymm1               \n\t"
+        "vmulps       (%3,%0), %%ymm1, %%ymm1       \n\t"
+        "vaddps     %%ymm1, %%ymm0, %%ymm0          \n\t"
+        "add        $32, %0                         \n\t"
+        "jl 1b                                      \n\t"
+        "vextractf128 $1, %%ymm0, %%xmm1            \n\t"
+        "vaddps     %%xmm1, %%xmm0, %%xmm0          \n\t"
+        "vmovhlps   %%xmm0, %%xmm0, %%xmm1          \n\t"
+        "vaddps     %%xmm1, %%xmm0, %%xmm0          \n\t"
+        "vshufps    $0x55, %%xmm0, %%xmm0, %%xmm1   \n\t"
+        "vaddss     %%xmm1, %%xmm0, %%xmm0          \n\t"
+        "vmovss     %%xmm0, %1                      \n\t"
+        "vzeroupper                                 \n\t"
+        : "+r"(i), "=m"(sum)
+        : "r"(src + len), "r"(filter + len)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+    return sum;
+}
+#endif
+
+void ff_resample_dsp_init_x86(ResampleDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE)
+        c->dot_flt = dot_flt_sse;
+#if HAVE_AVX
+    if (mm_flags & AV_CPU_FLAG_AVX)
+        c->dot_flt = dot_flt_avx;
+#endif
+}
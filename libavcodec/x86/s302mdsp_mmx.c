@@ -0,0 +1,123 @@
+/*
+ * SMPTE 302M DSP functions, x86 optimizations
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/s302mdsp.h"
+
+#if HAVE_SSSE3
+/* bits of each nibble reversed, in the high and in the low nibble */
+DECLARE_ALIGNED(16, static const uint8_t, rev_nibble_hi)[16] = {
+    0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+    0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+};
+DECLARE_ALIGNED(16, static const uint8_t, rev_nibble_lo)[16] = {
+    0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+    0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f,
+};
+DECLARE_ALIGNED(16, static const uint8_t, nibble_mask)[16] = {
+    0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+    0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+};
+
+static void reverse_bits_ssse3(uint8_t *dst, const uint8_t *src, int len)
+{
+    x86_reg i = -(len & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "movdqa     %3, %%xmm5              \n\t"
+            "movdqa     %4, %%xmm6              \n\t"
+            "movdqa     %5, %%xmm7              \n\t"
+            "1:                                 \n\t"
+            "movdqu     (%2,%0), %%xmm0         \n\t"
+            "movdqa     %%xmm0, %%xmm1          \n\t"
+            "psrlw      $4, %%xmm1              \n\t"
+            "pand       %%xmm7, %%xmm0          \n\t"
+            "pand       %%xmm7, %%xmm1          \n\t"
+            "movdqa     %%xmm5, %%xmm2          \n\t"
+            "movdqa     %%xmm6, %%xmm3          \n\t"
+            "pshufb     %%xmm0, %%xmm2          \n\t"
+            "pshufb     %%xmm1, %%xmm3          \n\t"
+            "por        %%xmm3, %%xmm2          \n\t"
+            "movdqu     %%xmm2, (%1,%0)         \n\t"
+            "add        $16, %0                 \n\t"
+            "jl 1b                              \n\t"
+            : "+r"(i)
+            : "r"(dst + (len & ~15)), "r"(src + (len & ~15)),
+              "m"(*rev_nibble_hi), "m"(*rev_nibble_lo), "m"(*nibble_mask)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                           "%xmm5", "%xmm6", "%xmm7",) "memory"
+        );
+    }
+    for (i = len & ~15; i < len; i++)
+        dst[i] = av_reverse[src[i]];
+}
+#endif /* HAVE_SSSE3 */
+
+#if HAVE_AVX2
+static void reverse_bits_avx2(uint8_t *dst, const uint8_t *src, int len)
+{
+    x86_reg i = -(len & ~31);
+
+    if (i) {
+        __asm__ volatile(
+            "vbroadcasti128 %3, %%ymm5              \n\t"
+            "vbroadcasti128 %4, %%ymm6              \n\t"
+            "vbroadcasti128 %5, %%ymm7              \n\t"
+            "1:                                     \n\t"
+            "vmovdqu    (%2,%0), %%ymm0             \n\t"
+            "vpsrlw     $4, %%ymm0, %%ymm1          \n\t"
+            "vpand      %%ymm7, %%ymm0, %%ymm0      \n\t"
+            "vpand      %%ymm7, %%ymm1, %%ymm1      \n\t"
+            "vpshufb    %%ymm0, %%ymm5, %%ymm0      \n\t"
+            "vpshufb    %%ymm1, %%ymm6, %%ymm1      \n\t"
+            "vpor       %%ymm1, %%ymm0, %%ymm0      \n\t"
+            "vmovdqu    %%ymm0, (%1,%0)             \n\t"
+            "add        $32, %0                     \n\t"
+            "jl 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (len & ~31)), "r"(src + (len & ~31)),
+              "m"(*rev_nibble_hi), "m"(*rev_nibble_lo), "m"(*nibble_mask)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm5", "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    for (i = len & ~31; i < len; i++)
+        dst[i] = av_reverse[src[i]];
+}
+#endif /* HAVE_AVX2 */
+
+void ff_s302m_dsp_init_x86(S302MDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+#if HAVE_SSSE3
+    if (mm_flags & AV_CPU_FLAG_SSSE3)
+        c->reverse_bits = reverse_bits_ssse3;
+#endif
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2)
+        c->reverse_bits = reverse_bits_avx2;
+#endif
+}
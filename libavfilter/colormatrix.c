@@ -0,0 +1,276 @@
+/*
+ * ColorMatrix v2.2 for Avisynth 2.5.x
+ *
+ * ColorMatrix 2.0 is based on the original ColorMatrix filter by Wilbert
+ * khof.  It adds the ability to convert between any of: Rec.709, FCC,
+ * .601, and SMPTE 240M. It also makes pre and post clipping optional,
+ * s an option to use scaled or non-scaled coefficients, and more...
+ *
+ * Copyright (C) 2006-2007 Kevin Stone
+ *
+ * ColorMatrix 1.x is Copyright (C) Wilbert Dijkhof
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * OUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file
+ * color matrix conversion shared by the colormatrix and scale filters
+ */
+
+#include <strings.h>
+#include <float.h>
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "colormatrix.h"
+
+#define NS(n) n < 0 ? (int)(n*65536.0-0.5+DBL_EPSILON) : (int)(n*65536.0+0.5)
+
+static const char *matrix_names[4] = { "bt709", "fcc", "bt601", "smpte240m" };
+
+static const double yuv_coeff[4][3][3] = {
+    { { +0.7152, +0.0722, +0.2126 }, // Rec.709 (0)
+      { -0.3850, +0.5000, -0.1150 },
+      { -0.4540, -0.0460, +0.5000 } },
+    { { +0.5900, +0.1100, +0.3000 }, // FCC (1)
+      { -0.3310, +0.5000, -0.1690 },
+      { -0.4210, -0.0790, +0.5000 } },
+    { { +0.5870, +0.1140, +0.2990 }, // Rec.601 (ITU-R BT.470-2/SMPTE 170M) (2)
+      { -0.3313, +0.5000, -0.1687 },
+      { -0.4187, -0.0813, +0.5000 } },
+    { { +0.7010, +0.0870, +0.2120 }, // SMPTE 240M (3)
+      { -0.3840, +0.5000, -0.1160 },
+      { -0.4450, -0.0550, +0.5000 } },
+};
+
+#define ma m[0][0]
+#define mb m[0][1]
+#define mc m[0][2]
+#define md m[1][0]
+#define me m[1][1]
+#define mf m[1][2]
+#define mg m[2][0]
+#define mh m[2][1]
+#define mi m[2][2]
+
+#define ima im[0][0]
+#define imb im[0][1]
+#define imc im[0][2]
+#define imd im[1][0]
+#define ime im[1][1]
+#define imf im[1][2]
+#define img im[2][0]
+#define imh im[2][1]
+#define imi im[2][2]
+
+static void inverse3x3(double im[3][3], const double m[3][3])
+{
+    double det = ma * (me * mi - mf * mh) - mb * (md * mi - mf * mg) + mc * (md * mh - me * mg);
+    det = 1.0 / det;
+    ima = det * (me * mi - mf * mh);
+    imb = det * (mc * mh - mb * mi);
+    imc = det * (mb * mf - mc * me);
+    imd = det * (mf * mg - md * mi);
+    ime = det * (ma * mi - mc * mg);
+    imf = det * (mc * md - ma * mf);
+    img = det * (md * mh - me * mg);
+    imh = det * (mb * mg - ma * mh);
+    imi = det * (ma * me - mb * md);
+}
+
+static void solve_coefficients(double cm[3][3], double rgb[3][3], const double yuv[3][3])
+{
+    int i, j;
+    for (i = 0; i < 3; ++i)
+        for (j = 0; j < 3; ++j)
+            cm[i][j] = yuv[i][0] * rgb[0][j] + yuv[i][1] * rgb[1][j] + yuv[i][2] * rgb[2][j];
+}
+
+int ff_colormatrix_get_matrix(const char *name)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(matrix_names); i++)
+        if (!strcasecmp(name, matrix_names[i]))
+            return i;
+    return -1;
+}
+
+int ff_colormatrix_calc_coeffs(ColorMatrixCoeffs coeffs, int source, int dest)
+{
+    double rgb_coeffd[3][3];
+    double yuv_convertd[3][3];
+    int c[3][3];
+    int k;
+
+    inverse3x3(rgb_coeffd, yuv_coeff[source]);
+    solve_coefficients(yuv_convertd, rgb_coeffd, yuv_coeff[dest]);
+    for (k = 0; k < 3; ++k) {
+        c[k][0] = NS(yuv_convertd[k][0]);
+        c[k][1] = NS(yuv_convertd[k][1]);
+        c[k][2] = NS(yuv_convertd[k][2]);
+    }
+    if (c[0][0] != 65536 || c[1][0] != 0 || c[2][0] != 0)
+        return -1;
+
+    c[1][1] -= 65536;
+    c[2][2] -= 65536;
+    for (k = 0; k < 6; k++) {
+        int v = c[k >> 1][1 + (k & 1)];
+        if (v != (int16_t)v)
+            return -1;
+        coeffs[k] = v;
+    }
+    return 0;
+}
+
+static void convert_chroma_c(int16_t *delta, uint8_t *dstu, uint8_t *dstv,
+                             const uint8_t *srcu, const uint8_t *srcv,
+                             const int16_t *c, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        const int u = srcu[x] - 128;
+        const int v = srcv[x] - 128;
+        delta[x] = (c[0] * u + c[1] * v + 32768) >> 16;
+        dstu[x]  = av_clip_uint8(srcu[x] + ((c[2] * u + c[3] * v + 32768) >> 16));
+        dstv[x]  = av_clip_uint8(srcv[x] + ((c[4] * u + c[5] * v + 32768) >> 16));
+    }
+}
+
+static void convert_chroma_10_c(int16_t *delta, uint16_t *dstu, uint16_t *dstv,
+                                const uint16_t *srcu, const uint16_t *srcv,
+                                const int16_t *c, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        const int u = srcu[x] - 512;
+        const int v = srcv[x] - 512;
+        delta[x] = (c[0] * u + c[1] * v + 32768) >> 16;
+        dstu[x]  = av_clip_uintp2(srcu[x] + ((c[2] * u + c[3] * v + 32768) >> 16), 10);
+        dstv[x]  = av_clip_uintp2(srcv[x] + ((c[4] * u + c[5] * v + 32768) >> 16), 10);
+    }
+}
+
+static void add_delta_c(uint8_t *dst, const uint8_t *src,
+                        const int16_t *delta, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++)
+        dst[x] = av_clip_uint8(src[x] + delta[x >> 1]);
+}
+
+static void add_delta_10_c(uint16_t *dst, const uint16_t *src,
+                           const int16_t *delta, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++)
+        dst[x] = av_clip_uintp2(src[x] + delta[x >> 1], 10);
+}
+
+int ff_colormatrix_alloc_rows(ColorMatrixRows *rows, int w)
+{
+    const int cw = (w + 1) >> 1;
+    int i;
+
+    av_freep(&rows->buf);
+    rows->buf = av_malloc(4 * cw * sizeof(*rows->buf));
+    if (!rows->buf)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < 4; i++)
+        rows->delta[i] = rows->buf + i * cw;
+    ff_colormatrix_reset_rows(rows);
+    return 0;
+}
+
+void ff_colormatrix_free_rows(ColorMatrixRows *rows)
+{
+    av_freep(&rows->buf);
+}
+
+void ff_colormatrix_convert_rows(const ColorMatrixDSPContext *dsp,
+                                 const int16_t *coeffs, int depth,
+                                 uint8_t *data[4], const int linesize[4],
+                                 int w, int y, int h, int vsub,
+                                 ColorMatrixRows *rows)
+{
+    const int cw = (w + 1) >> 1;
+    const int top = y >> vsub, bottom = (y + h - 1) >> vsub;
+    const int converted = rows->first <= rows->last;
+    /* the rows of this slice extending the converted range, whose offsets
+     * the next slice may need */
+    const int new_top    = !converted || top    < rows->first;
+    const int new_bottom = !converted || bottom > rows->last;
+    int16_t *delta = NULL;
+    int i, cy = -1;
+
+    for (i = y; i < y + h; i++) {
+        uint8_t *luma = data[0] + i * linesize[0];
+
+        if (i >> vsub != cy) {
+            cy = i >> vsub;
+            if (converted && cy == rows->first) {
+                delta = rows->delta[0];
+            } else if (converted && cy == rows->last) {
+                delta = rows->delta[1];
+            } else {
+                uint8_t *u = data[1] + cy * linesize[1];
+                uint8_t *v = data[2] + cy * linesize[2];
+
+                /* the old last row is not used anymore once below it, the
+                 * old first row can still be the bottom of this slice */
+                if (cy == bottom && new_bottom)
+                    delta = rows->delta[1];
+                else if (cy == top && new_top)
+                    delta = rows->delta[3];
+                else
+                    delta = rows->delta[2];
+                if (depth > 8)
+                    dsp->convert_chroma_10(delta, (uint16_t *)u, (uint16_t *)v,
+                                           (uint16_t *)u, (uint16_t *)v, coeffs, cw);
+                else
+                    dsp->convert_chroma(delta, u, v, u, v, coeffs, cw);
+            }
+        }
+        if (depth > 8)
+            dsp->add_delta_10((uint16_t *)luma, (uint16_t *)luma, delta, w);
+        else
+            dsp->add_delta(luma, luma, delta, w);
+    }
+
+    if (new_top) {
+        if (top == bottom && new_bottom)
+            memcpy(rows->delta[3], rows->delta[1], cw * sizeof(*delta));
+        FFSWAP(int16_t *, rows->delta[0], rows->delta[3]);
+        rows->first = top;
+    }
+    if (new_bottom)
+        rows->last = bottom;
+}
+
+void ff_colormatrix_init(ColorMatrixDSPContext *dsp)
+{
+    dsp->convert_chroma    = convert_chroma_c;
+    dsp->convert_chroma_10 = convert_chroma_10_c;
+    dsp->add_delta         = add_delta_c;
+    dsp->add_delta_10      = add_delta_10_c;
+
+    if (HAVE_MMX) ff_colormatrix_init_x86(dsp);
+}
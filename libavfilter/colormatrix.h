@@ -0,0 +1,109 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_COLORMATRIX_H
+#define AVFILTER_COLORMATRIX_H
+
+#include <stdint.h>
+
+/**
+ * Conversion coefficients in 16.16 fixed point, stored as the pmaddwd
+ * friendly pairs (c2, c3), (c4 - 65536, c5), (c6, c7 - 65536):
+ * Y' = Y + ((c2 * U + c3 * V + 32768) >> 16)
+ * U' = U + ((c4' * U + c5 * V + 32768) >> 16)
+ * V' = V + ((c6 * U + c7' * V + 32768) >> 16)
+ * with U and V centered on zero.
+ */
+typedef int16_t ColorMatrixCoeffs[6];
+
+typedef struct ColorMatrixDSPContext {
+    /**
+     * Convert w chroma samples and store the matching luma offsets in delta.
+     * dst may be equal to src.
+     */
+    void (*convert_chroma)(int16_t *delta, uint8_t *dstu, uint8_t *dstv,
+                           const uint8_t *srcu, const uint8_t *srcv,
+                           const int16_t *coeffs, int w);
+    void (*convert_chroma_10)(int16_t *delta, uint16_t *dstu, uint16_t *dstv,
+                              const uint16_t *srcu, const uint16_t *srcv,
+                              const int16_t *coeffs, int w);
+    /**
+     * Add the luma offsets to w luma samples, one offset covering two
+     * horizontally adjacent samples. dst may be equal to src.
+     */
+    void (*add_delta)(uint8_t *dst, const uint8_t *src,
+                      const int16_t *delta, int w);
+    void (*add_delta_10)(uint16_t *dst, const uint16_t *src,
+                         const int16_t *delta, int w);
+} ColorMatrixDSPContext;
+
+/**
+ * @return the matrix index of a color standard name
+ * (bt709, fcc, bt601 or smpte240m), -1 if unknown
+ */
+int ff_colormatrix_get_matrix(const char *name);
+
+/**
+ * Compute the coefficients converting from the source to the destination
+ * matrix.
+ * @return 0 on success, a negative value if they do not fit
+ */
+int ff_colormatrix_calc_coeffs(ColorMatrixCoeffs coeffs, int source, int dest);
+
+/**
+ * Chroma rows converted so far in a frame. Two slices share a chroma row
+ * when their boundary is not aligned on the chroma subsampling; it must be
+ * converted only once, whether the slices come top-down or bottom-up.
+ */
+typedef struct ColorMatrixRows {
+    int first, last;    ///< range of converted chroma rows, empty if first > last
+    /**
+     * Luma offsets of the chroma rows first and last, then scratch rows,
+     * (w + 1) / 2 elements each.
+     */
+    int16_t *delta[4];
+    int16_t *buf;       ///< allocation holding the delta rows
+} ColorMatrixRows;
+
+int  ff_colormatrix_alloc_rows(ColorMatrixRows *rows, int w);
+void ff_colormatrix_free_rows(ColorMatrixRows *rows);
+
+/**
+ * Mark the start of a new frame, no chroma row is converted yet.
+ */
+static inline void ff_colormatrix_reset_rows(ColorMatrixRows *rows)
+{
+    rows->first = 0;
+    rows->last  = -1;
+}
+
+/**
+ * Convert in place the luma rows y to y + h - 1 of a planar frame with
+ * horizontally subsampled chroma, and the chroma rows they use which were
+ * not converted by a previous call for the same frame. The slices of a
+ * frame must be given in order, top-down or bottom-up.
+ */
+void ff_colormatrix_convert_rows(const ColorMatrixDSPContext *dsp,
+                                 const int16_t *coeffs, int depth,
+                                 uint8_t *data[4], const int linesize[4],
+                                 int w, int y, int h, int vsub,
+                                 ColorMatrixRows *rows);
+
+void ff_colormatrix_init(ColorMatrixDSPContext *dsp);
+void ff_colormatrix_init_x86(ColorMatrixDSPContext *dsp);
+
+#endif /* AVFILTER_COLORMATRIX_H */
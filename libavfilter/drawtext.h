@@ -0,0 +1,39 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_DRAWTEXT_H
+#define AVFILTER_DRAWTEXT_H
+
+#include <stdint.h>
+
+typedef struct DrawTextDSPContext {
+    /**
+     * Blend a constant color on w 8-bit samples, the weights being
+     * in the 0 to 32767 range:
+     * dst += ((color - dst) * weight + (1 << 14)) >> 15
+     */
+    void (*blend_row)(uint8_t *dst, const uint16_t *weight, int color, int w);
+    /**
+     * Same for 10-bit samples and a 10-bit color.
+     */
+    void (*blend_row_10)(uint16_t *dst, const uint16_t *weight, int color, int w);
+} DrawTextDSPContext;
+
+void ff_drawtext_init_x86(DrawTextDSPContext *dsp);
+
+#endif /* AVFILTER_DRAWTEXT_H */
@@ -0,0 +1,39 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_HQDN3D_H
+#define AVFILTER_HQDN3D_H
+
+#include <stdint.h>
+
+/** fractional bits of the pixel differences indexing the coefficient tables */
+#define LUT_BITS 4
+
+typedef struct HQDN3DDSPContext {
+    /**
+     * Recursive lowpass of a line against the previous one (vertical) or
+     * the same line of the previous frame (temporal):
+     * prev[x] = cur[x] + coef[(prev[x] - cur[x]) >> (8 - LUT_BITS)]
+     * Samples are 16-bit, coef points to the middle of the table.
+     */
+    void (*lowpass_line)(uint16_t *prev, const uint16_t *cur,
+                         const int16_t *coef, int w);
+} HQDN3DDSPContext;
+
+void ff_hqdn3d_init_x86(HQDN3DDSPContext *dsp);
+
+#endif /* AVFILTER_HQDN3D_H */
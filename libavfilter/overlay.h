@@ -0,0 +1,40 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include <stdint.h>
+
+typedef struct OverlayDSPContext {
+    /**
+     * Blend w 8-bit overlay samples on 8-bit main samples:
+     * dst = (dst * (255 - alpha) + src * alpha) / 255
+     */
+    void (*blend_row)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha,
+                      int w);
+    /**
+     * Same for a 10-bit main, the overlay samples being scaled to 10 bits.
+     */
+    void (*blend_row_10)(uint16_t *dst, const uint8_t *src,
+                         const uint8_t *alpha, int w);
+} OverlayDSPContext;
+
+void ff_overlay_init_x86(OverlayDSPContext *dsp);
+
+#endif /* AVFILTER_OVERLAY_H */
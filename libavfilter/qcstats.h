@@ -0,0 +1,46 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_QCSTATS_H
+#define AVFILTER_QCSTATS_H
+
+#include <stdint.h>
+
+typedef struct QCLineStats {
+    uint64_t sum;           ///< sum of the samples
+    uint64_t sad;           ///< sum of absolute differences with the previous frame
+    uint64_t nblack;        ///< number of samples below the black threshold
+    int min, max;
+} QCLineStats;
+
+typedef struct QCStatsDSPContext {
+    /**
+     * Add the statistics of w luma samples to s, and the samples to the
+     * column sums. The column sums are 16-bit, they must be flushed at
+     * least every 257 lines and be aligned on 16 bytes.
+     * @param prev         the same line of the previous frame, may be src
+     * @param black_thresh samples below it are counted as black, 1 to 255
+     */
+    void (*line_stats)(QCLineStats *s, uint16_t *col_sum,
+                       const uint8_t *src, const uint8_t *prev,
+                       int w, int black_thresh);
+} QCStatsDSPContext;
+
+void ff_qcstats_init_x86(QCStatsDSPContext *dsp);
+
+#endif /* AVFILTER_QCSTATS_H */
@@ -0,0 +1,215 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * slice threading for filters, same scheme as the libavcodec slice threads
+ */
+
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#if HAVE_SYSCONF
+#include <unistd.h>
+#endif
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "thread.h"
+
+struct AVFilterThreads {
+    int nb_threads;
+#if HAVE_PTHREADS
+    pthread_t *workers;
+    avfilter_action_func *func;
+    AVFilterContext *ctx;
+    void *arg;
+    int *rets;
+    int rets_count;
+    int job_count;
+
+    pthread_cond_t last_job_cond;
+    pthread_cond_t current_job_cond;
+    pthread_mutex_t current_job_lock;
+    int current_job;
+    int done;
+    int init;             ///< the locks have been initialized
+#endif
+};
+
+static int cpu_count(void)
+{
+    int nb_cpus = 1;
+#if HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+    nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return av_clip(nb_cpus, 1, MAX_FILTER_THREADS);
+}
+
+#if HAVE_PTHREADS
+static void* attribute_align_arg worker(void *v)
+{
+    AVFilterThreads *c = v;
+    int our_job = c->job_count;
+    int self_id;
+
+    pthread_mutex_lock(&c->current_job_lock);
+    self_id = c->current_job++;
+    for (;;) {
+        while (our_job >= c->job_count) {
+            if (c->current_job == c->nb_threads + c->job_count)
+                pthread_cond_signal(&c->last_job_cond);
+
+            if (!c->done)
+                pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
+            our_job = self_id;
+
+            if (c->done) {
+                pthread_mutex_unlock(&c->current_job_lock);
+                return NULL;
+            }
+        }
+        pthread_mutex_unlock(&c->current_job_lock);
+
+        c->rets[our_job % c->rets_count] = c->func(c->ctx, c->arg, our_job,
+                                                   c->job_count);
+
+        pthread_mutex_lock(&c->current_job_lock);
+        our_job = c->current_job++;
+    }
+}
+
+static void park_workers(AVFilterThreads *c)
+{
+    pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
+    pthread_mutex_unlock(&c->current_job_lock);
+}
+
+static int thread_init(AVFilterThreads *c, int nb_threads)
+{
+    c->workers = av_mallocz(sizeof(*c->workers) * nb_threads);
+    if (!c->workers)
+        return AVERROR(ENOMEM);
+
+    pthread_cond_init(&c->current_job_cond, NULL);
+    pthread_cond_init(&c->last_job_cond, NULL);
+    pthread_mutex_init(&c->current_job_lock, NULL);
+    c->init = 1;
+
+    pthread_mutex_lock(&c->current_job_lock);
+    for (c->nb_threads = 0; c->nb_threads < nb_threads; c->nb_threads++) {
+        if (pthread_create(&c->workers[c->nb_threads], NULL, worker, c)) {
+            pthread_mutex_unlock(&c->current_job_lock);
+            return AVERROR(ENOMEM);
+        }
+    }
+    park_workers(c);
+    return 0;
+}
+#endif
+
+int ff_filter_threads_init(AVFilterThreads **threads, int nb_threads)
+{
+    *threads = NULL;
+    if (nb_threads <= 0)
+        nb_threads = cpu_count();
+    nb_threads = FFMIN(nb_threads, MAX_FILTER_THREADS);
+    if (nb_threads <= 1)
+        return 1;
+
+#if HAVE_PTHREADS
+    if (!(*threads = av_mallocz(sizeof(**threads))))
+        return AVERROR(ENOMEM);
+    if (thread_init(*threads, nb_threads) < 0) {
+        ff_filter_threads_free(threads);
+        return AVERROR(ENOMEM);
+    }
+    return nb_threads;
+#else
+    return 1;
+#endif
+}
+
+int ff_filter_execute(AVFilterThreads *c, AVFilterContext *ctx,
+                      avfilter_action_func *func, void *arg, int *ret,
+                      int nb_jobs)
+{
+    int i;
+
+    if (!c || nb_jobs <= 1) {
+        for (i = 0; i < nb_jobs; i++) {
+            int r = func(ctx, arg, i, nb_jobs);
+            if (ret)
+                ret[i] = r;
+        }
+        return 0;
+    }
+
+#if HAVE_PTHREADS
+    {
+        int dummy_ret;
+
+        pthread_mutex_lock(&c->current_job_lock);
+        c->current_job = c->nb_threads;
+        c->job_count   = nb_jobs;
+        c->ctx         = ctx;
+        c->arg         = arg;
+        c->func        = func;
+        if (ret) {
+            c->rets       = ret;
+            c->rets_count = nb_jobs;
+        } else {
+            c->rets       = &dummy_ret;
+            c->rets_count = 1;
+        }
+        pthread_cond_broadcast(&c->current_job_cond);
+        park_workers(c);
+    }
+#endif
+    return 0;
+}
+
+void ff_filter_threads_free(AVFilterThreads **threads)
+{
+#if HAVE_PTHREADS
+    AVFilterThreads *c = *threads;
+    int i;
+
+    if (!c)
+        return;
+
+    if (c->init) {
+        pthread_mutex_lock(&c->current_job_lock);
+        c->done = 1;
+        pthread_cond_broadcast(&c->current_job_cond);
+        pthread_mutex_unlock(&c->current_job_lock);
+
+        for (i = 0; i < c->nb_threads; i++)
+            pthread_join(c->workers[i], NULL);
+
+        pthread_mutex_destroy(&c->current_job_lock);
+        pthread_cond_destroy(&c->current_job_cond);
+        pthread_cond_destroy(&c->last_job_cond);
+    }
+    av_free(c->workers);
+#endif
+    av_freep(threads);
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * slice threading for filters
+ */
+
+#ifndef AVFILTER_THREAD_H
+#define AVFILTER_THREAD_H
+
+#include "avfilter.h"
+
+/** maximum number of threads of a pool */
+#define MAX_FILTER_THREADS 16
+
+typedef struct AVFilterThreads AVFilterThreads;
+
+/**
+ * Job run by ff_filter_execute().
+ * @param jobnr  index of the job, 0 to nb_jobs-1
+ * @param nb_jobs number of jobs of this execution
+ */
+typedef int (avfilter_action_func)(AVFilterContext *ctx, void *arg,
+                                   int jobnr, int nb_jobs);
+
+/**
+ * Start a pool of worker threads for a filter.
+ * @param nb_threads number of threads, 0 for one per CPU
+ * @return the number of threads actually available (1 if the jobs will run
+ *         in the calling thread), or a negative error code
+ */
+int ff_filter_threads_init(AVFilterThreads **threads, int nb_threads);
+
+/**
+ * Run func nb_jobs times, spread over the threads of the pool, and wait
+ * for all of them to complete. threads may be NULL, in which case the jobs
+ * are run in the calling thread.
+ * @param ret if not NULL, the return value of each job
+ */
+int ff_filter_execute(AVFilterThreads *threads, AVFilterContext *ctx,
+                      avfilter_action_func *func, void *arg, int *ret,
+                      int nb_jobs);
+
+void ff_filter_threads_free(AVFilterThreads **threads);
+
+#endif /* AVFILTER_THREAD_H */
@@ -25,150 +25,21 @@
  * Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-#include <strings.h>
-#include <float.h>
 #include "avfilter.h"
 #include "libavutil/pixdesc.h"
-
-#define NS(n) n < 0 ? (int)(n*65536.0-0.5+DBL_EPSILON) : (int)(n*65536.0+0.5)
-#define CB(n) av_clip_uint8(n)
-
-static const double yuv_coeff[4][3][3] = {
-    { { +0.7152, +0.0722, +0.2126 }, // Rec.709 (0)
-      { -0.3850, +0.5000, -0.1150 },
-      { -0.4540, -0.0460, +0.5000 } },
-    { { +0.5900, +0.1100, +0.3000 }, // FCC (1)
-      { -0.3310, +0.5000, -0.1690 },
-      { -0.4210, -0.0790, +0.5000 } },
-    { { +0.5870, +0.1140, +0.2990 }, // Rec.601 (ITU-R BT.470-2/SMPTE 170M) (2)
-      { -0.3313, +0.5000, -0.1687 },
-      { -0.4187, -0.0813, +0.5000 } },
-    { { +0.7010, +0.0870, +0.2120 }, // SMPTE 240M (3)
-      { -0.3840, +0.5000, -0.1160 },
-      { -0.4450, -0.0550, +0.5000 } },
-};
+#include "colormatrix.h"
 
 typedef struct {
-    int yuv_convert[16][3][3];
-    int interlaced;
-    int source, dest, mode;
+    ColorMatrixCoeffs coeffs;
+    ColorMatrixDSPContext dsp;
+    int source, dest;
     char src[256];
     char dst[256];
-    int hsub, vsub;
+    int depth;
+    int vsub;
+    ColorMatrixRows rows;
 } ColorMatrixContext;
 
-#define ma m[0][0]
-#define mb m[0][1]
-#define mc m[0][2]
-#define md m[1][0]
-#define me m[1][1]
-#define mf m[1][2]
-#define mg m[2][0]
-#define mh m[2][1]
-#define mi m[2][2]
-
-#define ima im[0][0]
-#define imb im[0][1]
-#define imc im[0][2]
-#define imd im[1][0]
-#define ime im[1][1]
-#define imf im[1][2]
-#define img im[2][0]
-#define imh im[2][1]
-#define imi im[2][2]
-
-static void inverse3x3(double im[3][3], const double m[3][3])
-{
-    double det = ma * (me * mi - mf * mh) - mb * (md * mi - mf * mg) + mc * (md * mh - me * mg);
-    det = 1.0 / det;
-    ima = det * (me * mi - mf * mh);
-    imb = det * (mc * mh - mb * mi);
-    imc = det * (mb * mf - mc * me);
-    imd = det * (mf * mg - md * mi);
-    ime = det * (ma * mi - mc * mg);
-    imf = det * (mc * md - ma * mf);
-    img = det * (md * mh - me * mg);
-    imh = det * (mb * mg - ma * mh);
-    imi = det * (ma * me - mb * md);
-}
-
-static void solve_coefficients(double cm[3][3], double rgb[3][3], const double yuv[3][3])
-{
-    int i, j;
-    for (i = 0; i < 3; ++i)
-        for (j = 0; j < 3; ++j)
-            cm[i][j] = yuv[i][0] * rgb[0][j] + yuv[i][1] * rgb[1][j] + yuv[i][2] * rgb[2][j];
-}
-
-static void calc_coefficients(AVFilterContext *ctx)
-{
-    ColorMatrixContext *color = ctx->priv;
-    double rgb_coeffd[4][3][3];
-    double yuv_convertd[16][3][3];
-    int v = 0;
-    int i, j, k;
-
-    for (i = 0; i < 4; ++i)
-        inverse3x3(rgb_coeffd[i], yuv_coeff[i]);
-    for (i = 0; i < 4; ++i) {
-        for (j = 0; j < 4; ++j) {
-            solve_coefficients(yuv_convertd[v], rgb_coeffd[i], yuv_coeff[j]);
-            for (k = 0; k < 3; ++k) {
-                color->yuv_convert[v][k][0] = NS(yuv_convertd[v][k][0]);
-                color->yuv_convert[v][k][1] = NS(yuv_convertd[v][k][1]);
-                color->yuv_convert[v][k][2] = NS(yuv_convertd[v][k][2]);
-            }
-            if (color->yuv_convert[v][0][0] != 65536 || color->yuv_convert[v][1][0] != 0 ||
-                color->yuv_convert[v][2][0] != 0) {
-                av_log(ctx, AV_LOG_ERROR, "error calculating conversion coefficients\n");
-            }
-            ++v;
-        }
-    }
-}
-
-static void check_mode(ColorMatrixContext *color)
-{
-    color->source = color->dest = -1;
-    if (!strcasecmp(color->src, "bt709") && !strcasecmp(color->dst, "FCC")) {
-        color->source = 0;
-        color->dest = 1;
-    } else if (!strcasecmp(color->src, "bt709") && !strcasecmp(color->dst, "bt601")) {
-        color->source = 0;
-        color->dest = 2;
-    } else if (!strcasecmp(color->src, "bt709") && !strcasecmp(color->dst, "smpte240m")) {
-        color->source = 0;
-        color->dest = 3;
-    } else if (!strcasecmp(color->src, "FCC") && !strcasecmp(color->dst, "bt709")) {
-        color->source = 1;
-        color->dest = 0;
-    } else if (!strcasecmp(color->src, "FCC") && !strcasecmp(color->dst, "bt601")) {
-        color->source = 1;
-        color->dest = 2;
-    } else if (!strcasecmp(color->src, "FCC") && !strcasecmp(color->dst, "smpte240m")) {
-        color->source = 1;
-        color->dest = 3;
-    } else if (!strcasecmp(color->src, "bt601") && !strcasecmp(color->dst, "bt709")) {
-        color->source = 2;
-        color->dest = 0;
-    } else if (!strcasecmp(color->src, "bt601") && !strcasecmp(color->dst, "FCC")) {
-        color->source = 2;
-        color->dest = 1;
-    } else if (!strcasecmp(color->src, "bt601") && !strcasecmp(color->dst, "smpte240m")) {
-        color->source = 2;
-        color->dest = 3;
-    } else if (!strcasecmp(color->src, "smpte240m") && !strcasecmp(color->dst, "bt709")) {
-        color->source = 3;
-        color->dest = 0;
-    } else if (!strcasecmp(color->src, "smpte240m") && !strcasecmp(color->dst, "FCC")) {
-        color->source = 3;
-        color->dest = 1;
-    }  else if (!strcasecmp(color->src, "smpte240m") && !strcasecmp(color->dst, "bt601")) {
-        color->source = 3;
-        color->dest = 2;
-    }
-}
-
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     ColorMatrixContext *color = ctx->priv;
@@ -182,139 +53,55 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
         return -1;
     }
 
-    check_mode(color);
+    color->source = ff_colormatrix_get_matrix(color->src);
+    color->dest   = ff_colormatrix_get_matrix(color->dst);
 
-    if (color->source == -1 || color->dest == -1) {
+    if (color->source == -1 || color->dest == -1 || color->source == color->dest) {
         av_log(ctx, AV_LOG_ERROR, "invalid mode");
         return -1;
     }
 
-    color->mode = color->source * 4 + color->dest;
+    if (ff_colormatrix_calc_coeffs(color->coeffs, color->source, color->dest) < 0) {
+        av_log(ctx, AV_LOG_ERROR, "error calculating conversion coefficients\n");
+        return -1;
+    }
 
-    calc_coefficients(ctx);
+    ff_colormatrix_init(&color->dsp);
 
     return 0;
 }
 
-static void process_frame_uyvy422(ColorMatrixContext *color,
-                                  AVFilterBufferRef *dst, AVFilterBufferRef *src)
+static av_cold void uninit(AVFilterContext *ctx)
 {
-    const unsigned char *srcp = src->data[0];
-    const int src_pitch = src->linesize[0];
-    const int height = src->video->h;
-    const int width = src->video->w*2;
-    unsigned char *dstp = dst->data[0];
-    const int dst_pitch = dst->linesize[0];
-    const int c2 = color->yuv_convert[color->mode][0][1];
-    const int c3 = color->yuv_convert[color->mode][0][2];
-    const int c4 = color->yuv_convert[color->mode][1][1];
-    const int c5 = color->yuv_convert[color->mode][1][2];
-    const int c6 = color->yuv_convert[color->mode][2][1];
-    const int c7 = color->yuv_convert[color->mode][2][2];
-    int x, y;
-
-    for (y = 0; y < height; ++y) {
-        for (x = 0; x < width; x += 4) {
-            const int u = srcp[x + 0] - 128;
-            const int v = srcp[x + 2] - 128;
-            const int uvval = c2 * u + c3 * v + 1081344;
-            dstp[x + 0] = CB((c4 * u + c5 * v + 8421376) >> 16);
-            dstp[x + 1] = CB((65536 * (srcp[x + 1] - 16) + uvval) >> 16);
-            dstp[x + 2] = CB((c6 * u + c7 * v + 8421376) >> 16);
-            dstp[x + 3] = CB((65536 * (srcp[x + 3] - 16) + uvval) >> 16);
-        }
-        srcp += src_pitch;
-        dstp += dst_pitch;
-    }
-}
+    ColorMatrixContext *color = ctx->priv;
 
-static void process_frame_yuv422p(ColorMatrixContext *color,
-                                  AVFilterBufferRef *dst, AVFilterBufferRef *src)
-{
-    const unsigned char *srcpU = src->data[1];
-    const unsigned char *srcpV = src->data[2];
-    const unsigned char *srcpY = src->data[0];
-    const int src_pitchY  = src->linesize[0];
-    const int src_pitchUV = src->linesize[1];
-    const int height = src->video->h;
-    const int width = src->video->w;
-    unsigned char *dstpU = dst->data[1];
-    unsigned char *dstpV = dst->data[2];
-    unsigned char *dstpY = dst->data[0];
-    const int dst_pitchY  = dst->linesize[0];
-    const int dst_pitchUV = dst->linesize[1];
-    const int c2 = color->yuv_convert[color->mode][0][1];
-    const int c3 = color->yuv_convert[color->mode][0][2];
-    const int c4 = color->yuv_convert[color->mode][1][1];
-    const int c5 = color->yuv_convert[color->mode][1][2];
-    const int c6 = color->yuv_convert[color->mode][2][1];
-    const int c7 = color->yuv_convert[color->mode][2][2];
-    int x, y;
-
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x += 2) {
-            const int u = srcpU[x >> 1] - 128;
-            const int v = srcpV[x >> 1] - 128;
-            const int uvval = c2 * u + c3 * v + 1081344;
-            dstpY[x + 0] = CB((65536 * (srcpY[x + 0] - 16) + uvval) >> 16);
-            dstpY[x + 1] = CB((65536 * (srcpY[x + 1] - 16) + uvval) >> 16);
-            dstpU[x >> 1] = CB((c4 * u + c5 * v + 8421376) >> 16);
-            dstpV[x >> 1] = CB((c6 * u + c7 * v + 8421376) >> 16);
-        }
-        srcpY += src_pitchY;
-        dstpY += dst_pitchY;
-        srcpU += src_pitchUV;
-        srcpV += src_pitchUV;
-        dstpU += dst_pitchUV;
-        dstpV += dst_pitchUV;
-    }
+    ff_colormatrix_free_rows(&color->rows);
 }
 
-static void process_frame_yuv420p(ColorMatrixContext *color,
-                                  AVFilterBufferRef *dst, AVFilterBufferRef *src)
+static void process_slice_uyvy422(ColorMatrixContext *color,
+                                  AVFilterBufferRef *buf, int y, int h)
 {
-    const unsigned char *srcpU = src->data[1];
-    const unsigned char *srcpV = src->data[2];
-    const unsigned char *srcpY = src->data[0];
-    const unsigned char *srcpN = src->data[0] + src->linesize[0];
-    const int src_pitchY  = src->linesize[0];
-    const int src_pitchUV = src->linesize[1];
-    const int height = src->video->h;
-    const int width = src->video->w;
-    unsigned char *dstpU = dst->data[1];
-    unsigned char *dstpV = dst->data[2];
-    unsigned char *dstpY = dst->data[0];
-    unsigned char *dstpN = dst->data[0] + dst->linesize[0];
-    const int dst_pitchY  = dst->linesize[0];
-    const int dst_pitchUV = dst->linesize[1];
-    const int c2 = color->yuv_convert[color->mode][0][1];
-    const int c3 = color->yuv_convert[color->mode][0][2];
-    const int c4 = color->yuv_convert[color->mode][1][1];
-    const int c5 = color->yuv_convert[color->mode][1][2];
-    const int c6 = color->yuv_convert[color->mode][2][1];
-    const int c7 = color->yuv_convert[color->mode][2][2];
-    int x, y;
-
-    for (y = 0; y < height; y += 2) {
-        for (x = 0; x < width; x += 2) {
-            const int u = srcpU[x >> 1] - 128;
-            const int v = srcpV[x >> 1] - 128;
-            const int uvval = c2 * u + c3 * v + 1081344;
-            dstpY[x + 0] = CB((65536 * (srcpY[x + 0] - 16) + uvval) >> 16);
-            dstpY[x + 1] = CB((65536 * (srcpY[x + 1] - 16) + uvval) >> 16);
-            dstpN[x + 0] = CB((65536 * (srcpN[x + 0] - 16) + uvval) >> 16);
-            dstpN[x + 1] = CB((65536 * (srcpN[x + 1] - 16) + uvval) >> 16);
-            dstpU[x >> 1] = CB((c4 * u + c5 * v + 8421376) >> 16);
-            dstpV[x >> 1] = CB((c6 * u + c7 * v + 8421376) >> 16);
+    unsigned char *dstp = buf->data[0] + y * buf->linesize[0];
+    const int width = buf->video->w*2;
+    const int c2 = color->coeffs[0];
+    const int c3 = color->coeffs[1];
+    const int c4 = color->coeffs[2];
+    const int c5 = color->coeffs[3];
+    const int c6 = color->coeffs[4];
+    const int c7 = color->coeffs[5];
+    int x, i;
+
+    for (i = 0; i < h; i++) {
+        for (x = 0; x < width; x += 4) {
+            const int u = dstp[x + 0] - 128;
+            const int v = dstp[x + 2] - 128;
+            const int uvval = (c2 * u + c3 * v + 32768) >> 16;
+            dstp[x + 0] = av_clip_uint8(dstp[x + 0] + ((c4 * u + c5 * v + 32768) >> 16));
+            dstp[x + 1] = av_clip_uint8(dstp[x + 1] + uvval);
+            dstp[x + 2] = av_clip_uint8(dstp[x + 2] + ((c6 * u + c7 * v + 32768) >> 16));
+            dstp[x + 3] = av_clip_uint8(dstp[x + 3] + uvval);
         }
-        srcpY += src_pitchY << 1;
-        dstpY += dst_pitchY << 1;
-        srcpN += src_pitchY << 1;
-        dstpN += dst_pitchY << 1;
-        srcpU += src_pitchUV;
-        srcpV += src_pitchUV;
-        dstpU += dst_pitchUV;
-        dstpV += dst_pitchUV;
+        dstp += buf->linesize[0];
     }
 }
 
@@ -324,8 +111,11 @@ static int config_input(AVFilterLink *inlink)
     ColorMatrixContext *color = ctx->priv;
     const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[inlink->format];
 
-    color->hsub = pix_desc->log2_chroma_w;
-    color->vsub = pix_desc->log2_chroma_h;
+    color->vsub  = pix_desc->log2_chroma_h;
+    color->depth = pix_desc->comp[0].depth_minus1 + 1;
+
+    if (ff_colormatrix_alloc_rows(&color->rows, inlink->w) < 0)
+        return AVERROR(ENOMEM);
 
     av_log(ctx, AV_LOG_INFO, "%s -> %s\n", color->src, color->dst);
 
@@ -338,6 +128,8 @@ static int query_formats(AVFilterContext *ctx)
         PIX_FMT_YUV422P,
         PIX_FMT_YUV420P,
         PIX_FMT_UYVY422,
+        PIX_FMT_YUV422P10,
+        PIX_FMT_YUV420P10,
         PIX_FMT_NONE
     };
 
@@ -355,39 +147,38 @@ static AVFilterBufferRef *get_video_buffer(AVFilterLink *inlink, int perms, int
 
 static void start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
 {
+    ColorMatrixContext *color = link->dst->priv;
     AVFilterBufferRef *outpicref = avfilter_ref_buffer(picref, ~0);
 
     link->dst->outputs[0]->out_buf = outpicref;
+    ff_colormatrix_reset_rows(&color->rows);
 
-    avfilter_start_frame(link->dst->outputs[0], outpicref);
+    avfilter_start_frame(link->dst->outputs[0], avfilter_ref_buffer(outpicref, ~0));
 }
 
-static void end_frame(AVFilterLink *link)
+/* the output shares the input buffer, slices are converted in place */
+static void draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
 {
-    AVFilterContext *ctx = link->dst;
-    ColorMatrixContext *color = ctx->priv;
+    ColorMatrixContext *color = link->dst->priv;
     AVFilterBufferRef *out = link->dst->outputs[0]->out_buf;
 
-    if (link->cur_buf->format == PIX_FMT_YUV422P)
-        process_frame_yuv422p(color, out, link->cur_buf);
-    else if (link->cur_buf->format == PIX_FMT_YUV420P)
-        process_frame_yuv420p(color, out, link->cur_buf);
+    if (out->format == PIX_FMT_UYVY422)
+        process_slice_uyvy422(color, out, y, h);
     else
-        process_frame_uyvy422(color, out, link->cur_buf);
+        ff_colormatrix_convert_rows(&color->dsp, color->coeffs, color->depth,
+                                    out->data, out->linesize, out->video->w,
+                                    y, h, color->vsub, &color->rows);
 
-    avfilter_draw_slice(ctx->outputs[0], 0, link->dst->outputs[0]->h, 1);
-    avfilter_end_frame(ctx->outputs[0]);
-    avfilter_unref_buffer(link->cur_buf);
+    avfilter_draw_slice(link->dst->outputs[0], y, h, slice_dir);
 }
 
-static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
-
 AVFilter avfilter_vf_colormatrix = {
     .name          = "colormatrix",
     .description   = NULL_IF_CONFIG_SMALL("Color matrix conversion"),
 
     .priv_size     = sizeof(ColorMatrixContext),
     .init          = init,
+    .uninit        = uninit,
     .query_formats = query_formats,
 
     .inputs    = (AVFilterPad[]) {{ .name             = "default",
@@ -395,8 +186,8 @@ AVFilter avfilter_vf_colormatrix = {
                                     .config_props     = config_input,
                                     .start_frame      = start_frame,
                                     .get_video_buffer = get_video_buffer,
-                                    .draw_slice       = null_draw_slice,
-                                    .end_frame        = end_frame, },
+                                    .draw_slice       = draw_slice,
+                                    .min_perms        = AV_PERM_READ | AV_PERM_WRITE, },
                                   { .name = NULL}},
 
     .outputs   = (AVFilterPad[]) {{ .name             = "default",
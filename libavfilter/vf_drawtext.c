@@ -36,6 +36,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/tree.h"
 #include "avfilter.h"
+#include "drawtext.h"
 #include "drawutils.h"
 
 #undef time
@@ -45,6 +46,25 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 
+typedef struct {
+    uint32_t code;
+    int x, y;                       ///< position of the top left corner of the glyph bitmap
+    int w, h;                       ///< size of the glyph bitmap
+    const uint8_t *bitmap;          ///< 8-bit coverage of the glyph
+} TextChar;
+
+/**
+ * Blending weights of the text or of its shadow, pre-rendered from the
+ * glyph bitmaps. The area is aligned on the chroma subsampling and is
+ * not clipped to the frame.
+ */
+typedef struct {
+    int x, y, w, h;                 ///< area covered by the layer
+    uint8_t  *coverage;             ///< coverage of the glyphs, w * h
+    uint16_t *weight[2];            ///< luma and chroma weights, from 0 to 32767
+    int      *span[2];              ///< first and last + 1 non-zero weight of each row
+} TextLayer;
+
 typedef struct {
     const AVClass *class;
     uint8_t *fontfile;              ///< font to be used
@@ -52,8 +72,6 @@ typedef struct {
     uint8_t *expanded_text;         ///< used to contain the strftime()-expanded text
     size_t   expanded_text_size;    ///< size in bytes of the expanded_text buffer
     int ft_load_flags;              ///< flags used for loading fonts, see FT_LOAD_*
-    FT_Vector *positions;           ///< positions for each element in the text
-    size_t nb_positions;            ///< number of elements of positions array
     char *textfile;                 ///< file with text to be drawn
     unsigned int x;                 ///< x position to start drawing text
     unsigned int y;                 ///< y position to start drawing text
@@ -81,6 +99,17 @@ typedef struct {
     int pixel_step[4];              ///< distance in bytes between the component of each pixel
     uint8_t rgba_map[4];            ///< map RGBA offsets to the positions in the packed RGBA format
     uint8_t *box_line[4];           ///< line used for filling the box background
+    uint16_t *box_weight;           ///< weights used for blending the box background
+    int is_10bit;
+
+    char *layout_text;              ///< text the current layout was computed for
+    TextChar *chars;                ///< glyphs of the current layout
+    TextChar *prev_chars;           ///< glyphs of the previous layout
+    int nb_chars, nb_prev_chars;
+    int chars_size;                 ///< allocated size of the chars and prev_chars arrays
+    int box_x, box_y, box_w, box_h;
+    TextLayer layers[2];            ///< shadow and text layers
+    DrawTextDSPContext dsp;
 } DrawTextContext;
 
 #define OFFSET(x) offsetof(DrawTextContext, x)
@@ -145,10 +174,12 @@ struct ft_error
 
 #define FT_ERRMSG(e) ft_errors[e].err_msg
 
+
 typedef struct {
     FT_Glyph *glyph;
     uint32_t code;
-    FT_Bitmap bitmap; ///< array holding bitmaps of font
+    uint8_t *bitmap;  ///< 8-bit coverage of the rendered glyph
+    int bitmap_w, bitmap_h;
     FT_BBox bbox;
     int advance;
     int bitmap_left;
@@ -162,23 +193,35 @@ static int glyph_cmp(void *key, const void *b)
     return diff > 0 ? 1 : diff < 0 ? -1 : 0;
 }
 
+#define GET_BITMAP_VAL(r, c)                                            \
+    bitmap->pixel_mode == FT_PIXEL_MODE_MONO ?                          \
+        (bitmap->buffer[(r) * bitmap->pitch + ((c)>>3)] & (0x80 >> ((c)&7)) ? 255 : 0) : \
+         bitmap->buffer[(r) * bitmap->pitch +  (c)]
+
 /**
  * Load glyphs corresponding to the UTF-32 codepoint code.
  */
 static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code)
 {
     DrawTextContext *dtext = ctx->priv;
+    FT_Bitmap *bitmap;
     Glyph *glyph;
     struct AVTreeNode *node = NULL;
-    int ret;
+    int r, c, ret;
 
     /* load glyph into dtext->face->glyph */
     if (FT_Load_Char(dtext->face, code, dtext->ft_load_flags))
         return AVERROR(EINVAL);
 
+    bitmap = &dtext->face->glyph->bitmap;
+    if (bitmap->pixel_mode != FT_PIXEL_MODE_MONO &&
+        bitmap->pixel_mode != FT_PIXEL_MODE_GRAY)
+        return AVERROR(EINVAL);
+
     /* save glyph */
     if (!(glyph = av_mallocz(sizeof(*glyph))) ||
-        !(glyph->glyph = av_mallocz(sizeof(*glyph->glyph)))) {
+        !(glyph->glyph = av_mallocz(sizeof(*glyph->glyph))) ||
+        !(glyph->bitmap = av_malloc(FFMAX(bitmap->width * bitmap->rows, 1)))) {
         ret = AVERROR(ENOMEM);
         goto error;
     }
@@ -189,7 +232,13 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code)
         goto error;
     }
 
-    glyph->bitmap      = dtext->face->glyph->bitmap;
+    /* keep a copy of the bitmap, the one of the glyph slot is overwritten
+     * by the next load */
+    for (r = 0; r < bitmap->rows; r++)
+        for (c = 0; c < bitmap->width; c++)
+            glyph->bitmap[r * bitmap->width + c] = GET_BITMAP_VAL(r, c);
+    glyph->bitmap_w    = bitmap->width;
+    glyph->bitmap_h    = bitmap->rows;
     glyph->bitmap_left = dtext->face->glyph->bitmap_left;
     glyph->bitmap_top  = dtext->face->glyph->bitmap_top;
     glyph->advance     = dtext->face->glyph->advance.x >> 6;
@@ -209,13 +258,33 @@ static int load_glyph(AVFilterContext *ctx, Glyph **glyph_ptr, uint32_t code)
     return 0;
 
 error:
-    if (glyph)
+    if (glyph) {
+        if (glyph->glyph && *glyph->glyph)
+            FT_Done_Glyph(*glyph->glyph);
         av_freep(&glyph->glyph);
+        av_freep(&glyph->bitmap);
+    }
     av_freep(&glyph);
     av_freep(&node);
     return ret;
 }
 
+static void blend_row_c(uint8_t *dst, const uint16_t *weight, int color, int w)
+{
+    int i;
+
+    for (i = 0; i < w; i++)
+        dst[i] += ((color - dst[i]) * weight[i] + (1 << 14)) >> 15;
+}
+
+static void blend_row_10_c(uint16_t *dst, const uint16_t *weight, int color, int w)
+{
+    int i;
+
+    for (i = 0; i < w; i++)
+        dst[i] += ((color - dst[i]) * weight[i] + (1 << 14)) >> 15;
+}
+
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     int err;
@@ -315,6 +384,10 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
     }
     dtext->tabsize *= glyph->advance;
 
+    dtext->dsp.blend_row    = blend_row_c;
+    dtext->dsp.blend_row_10 = blend_row_10_c;
+    if (HAVE_MMX) ff_drawtext_init_x86(&dtext->dsp);
+
 #if !HAVE_LOCALTIME_R
     av_log(ctx, AV_LOG_WARNING, "strftime() expansion unavailable!\n");
 #endif
@@ -331,6 +404,7 @@ static int query_formats(AVFilterContext *ctx)
         PIX_FMT_YUV420P, PIX_FMT_YUV444P,
         PIX_FMT_YUV422P, PIX_FMT_YUV411P,
         PIX_FMT_YUV410P, PIX_FMT_YUV440P,
+        PIX_FMT_YUV420P10, PIX_FMT_YUV422P10,
         PIX_FMT_NONE
     };
 
@@ -340,10 +414,30 @@ static int query_formats(AVFilterContext *ctx)
 
 static int glyph_enu_free(void *opaque, void *elem)
 {
+    Glyph *glyph = elem;
+
+    FT_Done_Glyph(*glyph->glyph);
+    av_free(glyph->glyph);
+    av_free(glyph->bitmap);
     av_free(elem);
     return 0;
 }
 
+static void free_layer(TextLayer *layer)
+{
+    int i;
+
+    for (i = 1; i >= 0; i--) {
+        if (i && layer->weight[1] == layer->weight[0])
+            layer->weight[1] = NULL;
+        if (i && layer->span[1] == layer->span[0])
+            layer->span[1] = NULL;
+        av_freep(&layer->weight[i]);
+        av_freep(&layer->span[i]);
+    }
+    av_freep(&layer->coverage);
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     DrawTextContext *dtext = ctx->priv;
@@ -354,8 +448,13 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&dtext->expanded_text);
     av_freep(&dtext->fontcolor_string);
     av_freep(&dtext->boxcolor_string);
-    av_freep(&dtext->positions);
     av_freep(&dtext->shadowcolor_string);
+    av_freep(&dtext->layout_text);
+    av_freep(&dtext->chars);
+    av_freep(&dtext->prev_chars);
+    av_freep(&dtext->box_weight);
+    free_layer(&dtext->layers[0]);
+    free_layer(&dtext->layers[1]);
     av_tree_enumerate(dtext->glyphs, NULL, NULL, glyph_enu_free);
     av_tree_destroy(dtext->glyphs);
     dtext->glyphs = 0;
@@ -369,15 +468,21 @@ static av_cold void uninit(AVFilterContext *ctx)
 
 }
 
+/* weight of a sample from the alpha of the color and the coverage */
+#define WEIGHT(alpha, val) ((alpha) * (val) * 129 >> 8)
+
 static int config_input(AVFilterLink *inlink)
 {
     DrawTextContext *dtext = inlink->dst->priv;
     const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[inlink->format];
-    int ret;
+    int i, ret;
 
     dtext->hsub = pix_desc->log2_chroma_w;
     dtext->vsub = pix_desc->log2_chroma_h;
+    dtext->is_10bit = pix_desc->comp[0].depth_minus1 == 9;
 
+    for (i = 0; i < 4; i++)
+        av_freep(&dtext->box_line[i]);
     if ((ret =
          ff_fill_line_with_color(dtext->box_line, dtext->pixel_step,
                                  inlink->w, dtext->boxcolor,
@@ -398,209 +503,343 @@ static int config_input(AVFilterLink *inlink)
         dtext->shadowcolor[3] = rgba[3];
     }
 
+    av_freep(&dtext->box_weight);
+    if (!(dtext->box_weight = av_malloc(inlink->w * sizeof(*dtext->box_weight))))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < inlink->w; i++)
+        dtext->box_weight[i] = WEIGHT(dtext->boxcolor_rgba[3], 255);
+
+    /* force a new layout */
+    av_freep(&dtext->layout_text);
+
     return 0;
 }
 
-#define GET_BITMAP_VAL(r, c)                                            \
-    bitmap->pixel_mode == FT_PIXEL_MODE_MONO ?                          \
-        (bitmap->buffer[(r) * bitmap->pitch + ((c)>>3)] & (0x80 >> ((c)&7))) * 255 : \
-         bitmap->buffer[(r) * bitmap->pitch +  (c)]
+static inline void blend_rgb(uint8_t *p, const uint8_t rgba_color[4],
+                             const uint8_t rgba_map[4], int weight)
+{
+    int i;
 
-#define SET_PIXEL_YUV(picref, yuva_color, val, x, y, hsub, vsub) {           \
-    luma_pos    = ((x)          ) + ((y)          ) * picref->linesize[0]; \
-    alpha = yuva_color[3] * (val) * 129;                               \
-    picref->data[0][luma_pos]    = (alpha * yuva_color[0] + (255*255*129 - alpha) * picref->data[0][luma_pos]   ) >> 23; \
-    if (((x) & ((1<<(hsub)) - 1)) == 0 && ((y) & ((1<<(vsub)) - 1)) == 0) {\
-        chroma_pos1 = ((x) >> (hsub)) + ((y) >> (vsub)) * picref->linesize[1]; \
-        chroma_pos2 = ((x) >> (hsub)) + ((y) >> (vsub)) * picref->linesize[2]; \
-        picref->data[1][chroma_pos1] = (alpha * yuva_color[1] + (255*255*129 - alpha) * picref->data[1][chroma_pos1]) >> 23; \
-        picref->data[2][chroma_pos2] = (alpha * yuva_color[2] + (255*255*129 - alpha) * picref->data[2][chroma_pos2]) >> 23; \
-    }\
+    for (i = 0; i < 3; i++)
+        p[rgba_map[i]] += ((rgba_color[i] - p[rgba_map[i]]) * weight + (1 << 14)) >> 15;
 }
 
-static inline int draw_glyph_yuv(AVFilterBufferRef *picref, FT_Bitmap *bitmap, unsigned int x,
-                                 unsigned int y, unsigned int width, unsigned int height,
-                                 const uint8_t yuva_color[4], int hsub, int vsub)
+static void blend_box(DrawTextContext *dtext, AVFilterBufferRef *picref,
+                      int width, int height)
 {
-    int r, c, alpha;
-    unsigned int luma_pos, chroma_pos1, chroma_pos2;
-    uint8_t src_val;
-
-    for (r = 0; r < bitmap->rows && r+y < height; r++) {
-        for (c = 0; c < bitmap->width && c+x < width; c++) {
-            /* get intensity value in the glyph bitmap (source) */
-            src_val = GET_BITMAP_VAL(r, c);
-            if (!src_val)
-                continue;
+    int x0 = FFMAX(dtext->box_x, 0), x1 = FFMIN(dtext->box_x + dtext->box_w, width);
+    int y0 = FFMAX(dtext->box_y, 0), y1 = FFMIN(dtext->box_y + dtext->box_h, height);
+    int plane, x, y;
 
-            SET_PIXEL_YUV(picref, yuva_color, src_val, c+x, y+r, hsub, vsub);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    if (dtext->boxcolor_rgba[3] == 0xFF && !dtext->is_10bit) {
+        ff_draw_rectangle(picref->data, picref->linesize,
+                          dtext->box_line, dtext->pixel_step, dtext->hsub, dtext->vsub,
+                          x0, y0, x1 - x0, y1 - y0);
+    } else if (dtext->is_packed_rgb) {
+        for (y = y0; y < y1; y++) {
+            uint8_t *p = picref->data[0] + y * picref->linesize[0] + x0 * dtext->pixel_step[0];
+            for (x = x0; x < x1; x++, p += dtext->pixel_step[0])
+                blend_rgb(p, dtext->boxcolor_rgba, dtext->rgba_map, dtext->box_weight[0]);
+        }
+    } else {
+        for (plane = 0; plane < 3; plane++) {
+            int hsub = plane ? dtext->hsub : 0, vsub = plane ? dtext->vsub : 0;
+            int cx0 = x0 >> hsub, cx1 = -((-x1) >> hsub);
+            int color = dtext->boxcolor[plane] << 2 * dtext->is_10bit;
+
+            for (y = y0 >> vsub; y < -((-y1) >> vsub); y++) {
+                uint8_t *dst = picref->data[plane] + y * picref->linesize[plane];
+                if (dtext->is_10bit)
+                    dtext->dsp.blend_row_10((uint16_t *)dst + cx0, dtext->box_weight,
+                                            color, cx1 - cx0);
+                else
+                    dtext->dsp.blend_row(dst + cx0, dtext->box_weight, color, cx1 - cx0);
+            }
         }
     }
-
-    return 0;
 }
 
-#define SET_PIXEL_RGB(picref, rgba_color, val, x, y, pixel_step, r_off, g_off, b_off, a_off) { \
-    p   = picref->data[0] + (x) * pixel_step + ((y) * picref->linesize[0]); \
-    alpha = rgba_color[3] * (val) * 129;                              \
-    *(p+r_off) = (alpha * rgba_color[0] + (255*255*129 - alpha) * *(p+r_off)) >> 23; \
-    *(p+g_off) = (alpha * rgba_color[1] + (255*255*129 - alpha) * *(p+g_off)) >> 23; \
-    *(p+b_off) = (alpha * rgba_color[2] + (255*255*129 - alpha) * *(p+b_off)) >> 23; \
-}
-
-static inline int draw_glyph_rgb(AVFilterBufferRef *picref, FT_Bitmap *bitmap,
-                                 unsigned int x, unsigned int y,
-                                 unsigned int width, unsigned int height, int pixel_step,
-                                 const uint8_t rgba_color[4], const uint8_t rgba_map[4])
+static void blend_layer(DrawTextContext *dtext, AVFilterBufferRef *picref,
+                        const TextLayer *layer, const uint8_t yuva_color[4],
+                        const uint8_t rgba_color[4], int width, int height)
 {
-    int r, c, alpha;
-    uint8_t *p;
-    uint8_t src_val;
-
-    for (r = 0; r < bitmap->rows && r+y < height; r++) {
-        for (c = 0; c < bitmap->width && c+x < width; c++) {
-            /* get intensity value in the glyph bitmap (source) */
-            src_val = GET_BITMAP_VAL(r, c);
-            if (!src_val)
-                continue;
+    int plane, x, y;
+
+    if (dtext->is_packed_rgb) {
+        for (y = FFMAX(-layer->y, 0); y < FFMIN(layer->h, height - layer->y); y++) {
+            int start = FFMAX(layer->span[0][2*y    ], -layer->x);
+            int end   = FFMIN(layer->span[0][2*y + 1], width - layer->x);
+            const uint16_t *weight = layer->weight[0] + y * layer->w;
+            uint8_t *p = picref->data[0] + (layer->y + y) * picref->linesize[0] +
+                         (layer->x + start) * dtext->pixel_step[0];
+
+            for (x = start; x < end; x++, p += dtext->pixel_step[0])
+                if (weight[x])
+                    blend_rgb(p, rgba_color, dtext->rgba_map, weight[x]);
+        }
+        return;
+    }
+
+    for (plane = 0; plane < 3; plane++) {
+        int hsub = plane ? dtext->hsub : 0, vsub = plane ? dtext->vsub : 0;
+        int lx = layer->x >> hsub, ly = layer->y >> vsub, lw = layer->w >> hsub;
+        int pw = -((-width) >> hsub), ph = -((-height) >> vsub);
+        int color = yuva_color[plane] << 2 * dtext->is_10bit;
+        const uint16_t *weight = layer->weight[!!plane];
+        const int *span = layer->span[!!plane];
 
-            SET_PIXEL_RGB(picref, rgba_color, src_val, c+x, y+r, pixel_step,
-                          rgba_map[0], rgba_map[1], rgba_map[2], rgba_map[3]);
+        for (y = FFMAX(-ly, 0); y < FFMIN(layer->h >> vsub, ph - ly); y++) {
+            int start = FFMAX(span[2*y    ], -lx);
+            int end   = FFMIN(span[2*y + 1], pw - lx);
+            uint8_t *dst = picref->data[plane] + (ly + y) * picref->linesize[plane];
+
+            if (start >= end)
+                continue;
+            if (dtext->is_10bit)
+                dtext->dsp.blend_row_10((uint16_t *)dst + lx + start,
+                                        weight + y * lw + start, color, end - start);
+            else
+                dtext->dsp.blend_row(dst + lx + start,
+                                     weight + y * lw + start, color, end - start);
         }
     }
+}
+
+static int alloc_layer(DrawTextContext *dtext, TextLayer *layer,
+                       int x, int y, int w, int h)
+{
+    int cw = w >> dtext->hsub, ch = h >> dtext->vsub;
+
+    free_layer(layer);
+    layer->x = x;
+    layer->y = y;
+    layer->w = w;
+    layer->h = h;
 
+    if (!(layer->coverage  = av_mallocz(FFMAX(w * h, 1))) ||
+        !(layer->weight[0] = av_malloc(FFMAX(w * h, 1) * sizeof(*layer->weight[0]))) ||
+        !(layer->span[0]   = av_malloc(FFMAX(h, 1) * 2 * sizeof(*layer->span[0]))))
+        return AVERROR(ENOMEM);
+
+    if (dtext->hsub || dtext->vsub) {
+        if (!(layer->weight[1] = av_malloc(FFMAX(cw * ch, 1) * sizeof(*layer->weight[1]))) ||
+            !(layer->span[1]   = av_malloc(FFMAX(ch, 1) * 2 * sizeof(*layer->span[1]))))
+            return AVERROR(ENOMEM);
+    } else {
+        layer->weight[1] = layer->weight[0];
+        layer->span[1]   = layer->span[0];
+    }
     return 0;
 }
 
-static inline void drawbox(AVFilterBufferRef *picref, unsigned int x, unsigned int y,
-                           unsigned int width, unsigned int height,
-                           uint8_t *line[4], int pixel_step[4], uint8_t color[4],
-                           int hsub, int vsub, int is_rgba_packed, uint8_t rgba_map[4])
+static void draw_char(TextLayer *layer, const TextChar *c, int dx, int dy)
 {
-    int i, j, alpha;
-
-    if (color[3] != 0xFF) {
-        if (is_rgba_packed) {
-            uint8_t *p;
-            for (j = 0; j < height; j++)
-                for (i = 0; i < width; i++)
-                    SET_PIXEL_RGB(picref, color, 255, i+x, y+j, pixel_step[0],
-                                  rgba_map[0], rgba_map[1], rgba_map[2], rgba_map[3]);
-        } else {
-            unsigned int luma_pos, chroma_pos1, chroma_pos2;
-            for (j = 0; j < height; j++)
-                for (i = 0; i < width; i++)
-                    SET_PIXEL_YUV(picref, color, 255, i+x, y+j, hsub, vsub);
-        }
-    } else {
-        ff_draw_rectangle(picref->data, picref->linesize,
-                          line, pixel_step, hsub, vsub,
-                          x, y, width, height);
+    int x = c->x + dx - layer->x, y = c->y + dy - layer->y;
+    int i, j;
+
+    for (j = 0; j < c->h; j++) {
+        uint8_t *dst = layer->coverage + (y + j) * layer->w + x;
+        const uint8_t *src = c->bitmap + j * c->w;
+        for (i = 0; i < c->w; i++)
+            dst[i] = FFMAX(dst[i], src[i]);
     }
 }
 
-static inline int is_newline(uint32_t c)
+static void clear_char(TextLayer *layer, const TextChar *c, int dx, int dy)
 {
-    return (c == '\n' || c == '\r' || c == '\f' || c == '\v');
+    int x = c->x + dx - layer->x, y = c->y + dy - layer->y;
+    int j;
+
+    for (j = 0; j < c->h; j++)
+        memset(layer->coverage + (y + j) * layer->w + x, 0, c->w);
 }
 
-static int draw_glyphs(DrawTextContext *dtext, AVFilterBufferRef *picref,
-                       int width, int height, const uint8_t rgbcolor[4], const uint8_t yuvcolor[4], int x, int y)
+static void add_rect(int rect[4], const TextChar *c, int dx, int dy)
 {
-    char *text = HAVE_LOCALTIME_R ? dtext->expanded_text : dtext->text;
-    uint32_t code = 0;
-    int i;
-    uint8_t *p;
-    Glyph *glyph = NULL;
+    rect[0] = FFMIN(rect[0], c->x + dx);
+    rect[1] = FFMIN(rect[1], c->y + dy);
+    rect[2] = FFMAX(rect[2], c->x + dx + c->w);
+    rect[3] = FFMAX(rect[3], c->y + dy + c->h);
+}
 
-    for (i = 0, p = text; *p; i++) {
-        Glyph dummy = { 0 };
-        GET_UTF8(code, *p++, continue;);
+static int char_changed(const DrawTextContext *dtext, int i)
+{
+    const TextChar *a = &dtext->chars[i], *b = &dtext->prev_chars[i];
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
-            continue;
+    return i >= dtext->nb_chars || i >= dtext->nb_prev_chars ||
+           a->code != b->code || a->x != b->x || a->y != b->y;
+}
 
-        dummy.code = code;
-        glyph = av_tree_find(dtext->glyphs, &dummy, (void *)glyph_cmp, NULL);
+static void update_spans(const uint16_t *weight, int *span, int w, int y0, int y1)
+{
+    int y;
+
+    for (y = y0; y < y1; y++) {
+        const uint16_t *row = weight + y * w;
+        int start = 0, end = w;
+
+        while (start < end && !row[start])
+            start++;
+        while (end > start && !row[end - 1])
+            end--;
+        span[2*y    ] = start;
+        span[2*y + 1] = end;
+    }
+}
 
-        if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
-            glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
-            return AVERROR(EINVAL);
+/**
+ * Compute the weights of the part of layer covered by rect, the chroma
+ * weights are the average of the luma ones over the subsampled block.
+ */
+static void update_weights(DrawTextContext *dtext, TextLayer *layer,
+                           const int rect[4], int alpha)
+{
+    int hsub = dtext->hsub, vsub = dtext->vsub;
+    int hmask = (1 << hsub) - 1, vmask = (1 << vsub) - 1;
+    int x0 = FFMAX(rect[0] - layer->x, 0) & ~hmask;
+    int y0 = FFMAX(rect[1] - layer->y, 0) & ~vmask;
+    int x1 = FFMIN((rect[2] - layer->x + hmask) & ~hmask, layer->w);
+    int y1 = FFMIN((rect[3] - layer->y + vmask) & ~vmask, layer->h);
+    int x, y, i, j;
+
+    for (y = y0; y < y1; y++) {
+        const uint8_t *cov = layer->coverage + y * layer->w;
+        uint16_t *weight   = layer->weight[0] + y * layer->w;
+        for (x = x0; x < x1; x++)
+            weight[x] = WEIGHT(alpha, cov[x]);
+    }
+    update_spans(layer->weight[0], layer->span[0], layer->w, y0, y1);
+
+    if (layer->weight[1] != layer->weight[0]) {
+        int cw = layer->w >> hsub, shift = hsub + vsub;
+
+        for (y = y0 >> vsub; y < y1 >> vsub; y++) {
+            uint16_t *weight = layer->weight[1] + y * cw;
+            for (x = x0 >> hsub; x < x1 >> hsub; x++) {
+                const uint8_t *cov = layer->coverage + (y << vsub) * layer->w + (x << hsub);
+                int sum = 0;
+                for (j = 0; j <= vmask; j++)
+                    for (i = 0; i <= hmask; i++)
+                        sum += cov[j * layer->w + i];
+                weight[x] = WEIGHT(alpha, (sum + (1 << shift >> 1)) >> shift);
+            }
+        }
+        update_spans(layer->weight[1], layer->span[1], cw, y0 >> vsub, y1 >> vsub);
+    }
+}
 
-        if (dtext->is_packed_rgb) {
-            draw_glyph_rgb(picref, &glyph->bitmap,
-                           dtext->positions[i].x+x, dtext->positions[i].y+y, width, height,
-                           dtext->pixel_step[0], rgbcolor, dtext->rgba_map);
-        } else {
-            draw_glyph_yuv(picref, &glyph->bitmap,
-                           dtext->positions[i].x+x, dtext->positions[i].y+y, width, height,
-                           yuvcolor, dtext->hsub, dtext->vsub);
+/**
+ * Update the layer for the current layout, drawn at offset dx, dy.
+ * When the area covered by the text does not change, only the glyphs
+ * that differ from the previous layout are cleared and drawn again.
+ */
+static int update_layer(DrawTextContext *dtext, TextLayer *layer,
+                        int dx, int dy, int alpha, int full)
+{
+    int hmask = (1 << dtext->hsub) - 1, vmask = (1 << dtext->vsub) - 1;
+    int area[4]  = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    int dirty[4] = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    int i, ret;
+
+    for (i = 0; i < dtext->nb_chars; i++)
+        if (dtext->chars[i].w && dtext->chars[i].h)
+            add_rect(area, &dtext->chars[i], dx, dy);
+    if (area[0] > area[2])
+        area[0] = area[1] = area[2] = area[3] = 0;
+    area[0] &= ~hmask;
+    area[1] &= ~vmask;
+    area[2] = (area[2] + hmask) & ~hmask;
+    area[3] = (area[3] + vmask) & ~vmask;
+
+    if (full || area[0] != layer->x || area[2] - area[0] != layer->w ||
+                area[1] != layer->y || area[3] - area[1] != layer->h) {
+        if ((ret = alloc_layer(dtext, layer, area[0], area[1],
+                               area[2] - area[0], area[3] - area[1])) < 0)
+            return ret;
+        for (i = 0; i < dtext->nb_chars; i++)
+            draw_char(layer, &dtext->chars[i], dx, dy);
+        memcpy(dirty, area, sizeof(dirty));
+    } else {
+        for (i = 0; i < dtext->nb_prev_chars; i++) {
+            const TextChar *c = &dtext->prev_chars[i];
+            if (c->w && c->h && char_changed(dtext, i)) {
+                clear_char(layer, c, dx, dy);
+                add_rect(dirty, c, dx, dy);
+            }
+        }
+        for (i = 0; i < dtext->nb_chars; i++) {
+            const TextChar *c = &dtext->chars[i];
+            if (!c->w || !c->h)
+                continue;
+            if (char_changed(dtext, i)) {
+                draw_char(layer, c, dx, dy);
+                add_rect(dirty, c, dx, dy);
+            } else if (c->x + dx < dirty[2] && c->x + dx + c->w > dirty[0] &&
+                       c->y + dy < dirty[3] && c->y + dy + c->h > dirty[1]) {
+                /* overlaps a cleared glyph */
+                draw_char(layer, c, dx, dy);
+            }
         }
     }
 
+    if (dirty[0] < dirty[2] && dirty[1] < dirty[3])
+        update_weights(dtext, layer, dirty, alpha);
     return 0;
 }
 
-static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
-                     int width, int height)
+static inline int is_newline(uint32_t c)
+{
+    return (c == '\n' || c == '\r' || c == '\f' || c == '\v');
+}
+
+/**
+ * Compute the position of each glyph of text and the size of the box,
+ * the previous layout is kept in prev_chars.
+ */
+static int layout_text(AVFilterContext *ctx, const char *text,
+                       int width, int height)
 {
     DrawTextContext *dtext = ctx->priv;
     uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, ret;
+    int x = 0, y = 0, ret, n = 0;
     int text_height, baseline;
-    char *text = dtext->text;
-    uint8_t *p;
+    const uint8_t *p;
     int str_w = 0, len;
     int y_min = 32000, y_max = -32000;
     FT_Vector delta;
     Glyph *glyph = NULL, *prev_glyph = NULL;
     Glyph dummy = { 0 };
 
-#if HAVE_LOCALTIME_R
-    time_t now = time(0);
-    struct tm ltime;
-    uint8_t *buf = dtext->expanded_text;
-    int buf_size = dtext->expanded_text_size;
-
-    if (!buf) {
-        buf_size = 2*strlen(dtext->text)+1;
-        buf = av_malloc(buf_size);
-    }
-
-    localtime_r(&now, &ltime);
+    FFSWAP(TextChar *, dtext->chars, dtext->prev_chars);
+    dtext->nb_prev_chars = dtext->nb_chars;
+    dtext->nb_chars      = 0;
 
-    do {
-        *buf = 1;
-        if (strftime(buf, buf_size, dtext->text, &ltime) != 0 || *buf == 0)
-            break;
-        buf_size *= 2;
-    } while ((buf = av_realloc(buf, buf_size)));
-
-    if (!buf)
-        return AVERROR(ENOMEM);
-    text = dtext->expanded_text = buf;
-    dtext->expanded_text_size = buf_size;
-#endif
-    if ((len = strlen(text)) > dtext->nb_positions) {
-        if (!(dtext->positions =
-              av_realloc(dtext->positions, len*sizeof(*dtext->positions))))
+    if ((len = strlen(text)) > dtext->chars_size) {
+        TextChar *chars;
+        if (!(chars = av_realloc(dtext->chars, len * sizeof(*chars))))
+            return AVERROR(ENOMEM);
+        dtext->chars = chars;
+        if (!(chars = av_realloc(dtext->prev_chars, len * sizeof(*chars))))
             return AVERROR(ENOMEM);
-        dtext->nb_positions = len;
+        dtext->prev_chars = chars;
+        dtext->chars_size = len;
     }
 
     x = dtext->x;
     y = dtext->y;
 
     /* load and cache glyphs */
-    for (i = 0, p = text; *p; i++) {
+    for (p = (const uint8_t *)text; *p; ) {
         GET_UTF8(code, *p++, continue;);
 
         /* get glyph */
         dummy.code = code;
         glyph = av_tree_find(dtext->glyphs, &dummy, glyph_cmp, NULL);
-        if (!glyph)
-            load_glyph(ctx, &glyph, code);
+        if (!glyph && (ret = load_glyph(ctx, &glyph, code)) < 0)
+            return ret;
 
         y_min = FFMIN(glyph->bbox.yMin, y_min);
         y_max = FFMAX(glyph->bbox.yMax, y_max);
@@ -610,7 +849,7 @@ static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
 
     /* compute and save position for each glyph */
     glyph = NULL;
-    for (i = 0, p = text; *p; i++) {
+    for (p = (const uint8_t *)text; *p; ) {
         GET_UTF8(code, *p++, continue;);
 
         /* skip the \n in the sequence \r\n */
@@ -644,30 +883,91 @@ static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
         }
 
         /* save position */
-        dtext->positions[i].x = x + glyph->bitmap_left;
-        dtext->positions[i].y = y - glyph->bitmap_top + baseline;
+        if (code != '\t') {
+            TextChar *c = &dtext->chars[n++];
+            c->code   = code;
+            c->x      = x + glyph->bitmap_left;
+            c->y      = y - glyph->bitmap_top + baseline;
+            c->w      = glyph->bitmap_w;
+            c->h      = glyph->bitmap_h;
+            c->bitmap = glyph->bitmap;
+        }
         if (code == '\t') x  = (x / dtext->tabsize + 1)*dtext->tabsize;
         else              x += glyph->advance;
     }
+    dtext->nb_chars = n;
 
     str_w = FFMIN(width - dtext->x - 1, FFMAX(str_w, x - dtext->x));
     y     = FFMIN(y + text_height, height - 1);
 
-    /* draw box */
-    if (dtext->draw_box)
-        drawbox(picref, dtext->x, dtext->y, str_w, y-dtext->y,
-                dtext->box_line, dtext->pixel_step, dtext->boxcolor,
-                dtext->hsub, dtext->vsub, dtext->is_packed_rgb, dtext->rgba_map);
+    dtext->box_x = dtext->x;
+    dtext->box_y = dtext->y;
+    dtext->box_w = str_w;
+    dtext->box_h = y - dtext->y;
+
+    return 0;
+}
+
+static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
+                     int width, int height)
+{
+    DrawTextContext *dtext = ctx->priv;
+    char *text = dtext->text;
+    int ret;
 
-    if (dtext->shadowx || dtext->shadowy) {
-        if ((ret = draw_glyphs(dtext, picref, width, height, dtext->shadowcolor_rgba,
-                               dtext->shadowcolor, dtext->shadowx, dtext->shadowy)) < 0)
+#if HAVE_LOCALTIME_R
+    time_t now = time(0);
+    struct tm ltime;
+    uint8_t *buf = dtext->expanded_text;
+    int buf_size = dtext->expanded_text_size;
+
+    if (!buf) {
+        buf_size = 2*strlen(dtext->text)+1;
+        buf = av_malloc(buf_size);
+    }
+
+    localtime_r(&now, &ltime);
+
+    do {
+        *buf = 1;
+        if (strftime(buf, buf_size, dtext->text, &ltime) != 0 || *buf == 0)
+            break;
+        buf_size *= 2;
+    } while ((buf = av_realloc(buf, buf_size)));
+
+    if (!buf)
+        return AVERROR(ENOMEM);
+    text = dtext->expanded_text = buf;
+    dtext->expanded_text_size = buf_size;
+#endif
+
+    /* the glyphs are laid out and rendered again only when the text changes */
+    if (!dtext->layout_text || strcmp(text, dtext->layout_text)) {
+        int full = !dtext->layout_text;
+
+        av_freep(&dtext->layout_text);
+        if ((ret = layout_text(ctx, text, width, height)) < 0)
+            return ret;
+        if ((dtext->shadowx || dtext->shadowy) &&
+            (ret = update_layer(dtext, &dtext->layers[0], dtext->shadowx,
+                                dtext->shadowy, dtext->shadowcolor_rgba[3], full)) < 0)
+            return ret;
+        if ((ret = update_layer(dtext, &dtext->layers[1], 0, 0,
+                                dtext->fontcolor_rgba[3], full)) < 0)
             return ret;
+        if (!(dtext->layout_text = av_strdup(text)))
+            return AVERROR(ENOMEM);
     }
 
-    if ((ret = draw_glyphs(dtext, picref, width, height, dtext->fontcolor_rgba,
-                           dtext->fontcolor, 0, 0)) < 0)
-        return ret;
+    if (dtext->draw_box)
+        blend_box(dtext, picref, width, height);
+
+    if (dtext->shadowx || dtext->shadowy)
+        blend_layer(dtext, picref, &dtext->layers[0], dtext->shadowcolor,
+                    dtext->shadowcolor_rgba, width, height);
+
+    blend_layer(dtext, picref, &dtext->layers[1], dtext->fontcolor,
+                dtext->fontcolor_rgba, width, height);
 
     return 0;
 }
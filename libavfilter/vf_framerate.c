@@ -35,6 +35,7 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "thread.h"
 
 #undef NDEBUG
 #include <assert.h>
@@ -50,6 +51,14 @@ static int next;
 static int prev;
 static const int last = N_SRCE - 1;
 
+#define MC_BLOCK  16                    ///< size of the motion compensated luma blocks
+#define MC_RANGE  64                    ///< maximum vector length in each direction
+#define MC_LAMBDA 4                     ///< cost of one pixel of vector length
+
+typedef struct {
+    int16_t x, y;
+} MotionVector;
+
 typedef struct {
     const AVClass *class;
     // parameters
@@ -58,9 +67,11 @@ typedef struct {
     double scene_score;                 ///< score that denotes a scene change has happened
     int interp_start;                   ///< start of range to apply linear interpolation
     int interp_end;                     ///< end of range to apply linear interpolation
+    int scene_sub;                      ///< subsampling factor of the luma compared for scene change detection
+    int threads_opt;                    ///< number of threads, 0 for one per CPU
 
     int line_size[4];                   ///< bytes of pixel data per line for each plane
-    int vsub;
+    int hsub, vsub;
 
     int pending_srce_frames;            ///< how many input frames are still waiting to be processed
     int flush;                          ///< are we flushing final frames
@@ -79,7 +90,20 @@ typedef struct {
     AVCodecContext *avctx;              ///< codec context required for the DSPContext (scene detect only)
     DSPContext c;                       ///< context providing optimized SAD methods   (scene detect only)
     double prev_mafd;                   ///< previous MAFD                             (scene detect only)
+    AVFilterBufferRef *score_src1;      ///< frames of the last scene score            (scene detect only)
+    AVFilterBufferRef *score_src2;
+    double score;                       ///< last scene score                          (scene detect only)
+
+    int mb_w, mb_h;                     ///< size of the block grid                    (mc only)
+    MotionVector *mv[2];                ///< vectors of the last searched pair and of the pair before it
+    AVFilterBufferRef *mv_src1;         ///< frames the vectors in mv[0] were searched between
+    AVFilterBufferRef *mv_src2;
 #endif
+    AVFilterThreads *threads;
+    int nb_threads;
+
+    uint8_t *srce_sig[N_SRCE];          ///< subsampled luma of the source frames, NULL if not subsampled
+    int sig_w, sig_h, sig_linesize;     ///< dimensions of the subsampled luma
 
     AVFilterBufferRef *srce[N_SRCE];    ///< buffered source frames
     int64_t srce_pts_dest[N_SRCE];      ///< pts for source frames scaled to output timebase
@@ -90,6 +114,7 @@ typedef struct {
 
 #define OFFSET(x) offsetof(FRAMERATEContext, x)
 #define FRAMERATE_FLAG_SCD 01
+#define FRAMERATE_FLAG_MC  02
 
 static const AVOption framerate_options[] = {
     {"fps",                 "required output frames per second rate", OFFSET(dest_frame_rate), FF_OPT_TYPE_RATIONAL, {.dbl=50},                 0,       INT_MAX, 0 },
@@ -97,10 +122,13 @@ static const AVOption framerate_options[] = {
     {"interp_start",        "point to start linear interpolation",    OFFSET(interp_start),      FF_OPT_TYPE_INT,      {.dbl=15},                 0,       255,     0 },
     {"interp_end",          "point to end linear interpolation",      OFFSET(interp_end),        FF_OPT_TYPE_INT,      {.dbl=240},                0,       255,     0 },
     {"scene",               "scene change level",                     OFFSET(scene_score),       FF_OPT_TYPE_DOUBLE,   {.dbl=7.0},                0,       INT_MAX, 0 },
+    {"scene_sub",           "scene change detection subsampling",     OFFSET(scene_sub),         FF_OPT_TYPE_INT,      {.dbl=1},                  1,       16,      0 },
+    {"threads",             "number of threads, 0 for one per CPU",   OFFSET(threads_opt),       FF_OPT_TYPE_INT,      {.dbl=1},                  0,       MAX_FILTER_THREADS, 0 },
 
     {"flags",               "set flags",                              OFFSET(flags),             FF_OPT_TYPE_FLAGS,    {.dbl=1},                  0,       INT_MAX, 0, "flags" },
     {"scene_change_detect", "enable scene change detection",          0,                         FF_OPT_TYPE_CONST,    {.dbl=FRAMERATE_FLAG_SCD}, INT_MIN, INT_MAX, 0, "flags" },
     {"scd",                 "enable scene change detection",          0,                         FF_OPT_TYPE_CONST,    {.dbl=FRAMERATE_FLAG_SCD}, INT_MIN, INT_MAX, 0, "flags" },
+    {"mc",                  "enable motion compensated interpolation", 0,                        FF_OPT_TYPE_CONST,    {.dbl=FRAMERATE_FLAG_MC},  INT_MIN, INT_MAX, 0, "flags" },
 
     {NULL}
 };
@@ -127,22 +155,127 @@ static void next_source(AVFilterContext *ctx)
     if (priv_ctx->srce[last] && priv_ctx->srce[last] != priv_ctx->srce[last-1]) {
 #ifdef DEBUG
         av_dlog(ctx, "next_source() unlink %d\n", last);
+#endif
+#if CONFIG_AVCODEC
+        if (priv_ctx->srce[last] == priv_ctx->score_src1 ||
+            priv_ctx->srce[last] == priv_ctx->score_src2)
+            priv_ctx->score_src1 = priv_ctx->score_src2 = NULL;
+        if (priv_ctx->srce[last] == priv_ctx->mv_src1 ||
+            priv_ctx->srce[last] == priv_ctx->mv_src2)
+            priv_ctx->mv_src1 = priv_ctx->mv_src2 = NULL;
 #endif
         avfilter_unref_buffer(priv_ctx->srce[last]);
+        av_free(priv_ctx->srce_sig[last]);
     }
     for (int i = last; i > frst; i--) {
 #ifdef DEBUG
         av_dlog(ctx, "next_source() copy %d to %d\n", i - 1, i);
 #endif
         priv_ctx->srce[i] = priv_ctx->srce[i - 1];
+        priv_ctx->srce_sig[i] = priv_ctx->srce_sig[i - 1];
     }
 #ifdef DEBUG
     av_dlog(ctx, "next_source() make %d null\n", frst);
 #endif
     priv_ctx->srce[frst] = NULL;
+    priv_ctx->srce_sig[frst] = NULL;
 }
 
 #if CONFIG_AVCODEC
+typedef struct {
+    const uint8_t *src;
+    int src_linesize;
+    uint8_t *dst;
+} SignatureThreadData;
+
+/**
+ * Gather one 8x8 luma block out of scene_sub in each direction, done once
+ * per source frame so that each frame pair is then compared on the small
+ * picture.
+ */
+static int compute_signature(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FRAMERATEContext *priv_ctx = ctx->priv;
+    SignatureThreadData *td = arg;
+    const int step = 8 * priv_ctx->scene_sub;
+    const int start = priv_ctx->sig_h *  jobnr      / nb_jobs;
+    const int end   = priv_ctx->sig_h * (jobnr + 1) / nb_jobs;
+
+    for (int y = start; y < end; y++) {
+        const uint8_t *src = td->src + ((y >> 3) * step + (y & 7)) * td->src_linesize;
+        uint8_t *dst = td->dst + y * priv_ctx->sig_linesize;
+        for (int x = 0; x < priv_ctx->sig_w; x += 8)
+            memcpy(dst + x, src + x / 8 * step, 8);
+    }
+    return 0;
+}
+
+static void set_srce_signature(AVFilterContext *ctx)
+{
+    FRAMERATEContext *priv_ctx = ctx->priv;
+    AVFilterBufferRef *srce = priv_ctx->srce[frst];
+    SignatureThreadData td;
+
+    if (priv_ctx->scene_sub == 1 || !(priv_ctx->flags & FRAMERATE_FLAG_SCD))
+        return;
+
+    priv_ctx->srce_sig[frst] = av_malloc(priv_ctx->sig_linesize * priv_ctx->sig_h);
+    if (!priv_ctx->srce_sig[frst])
+        return;
+
+    td.src          = srce->data[0];
+    td.src_linesize = srce->linesize[0];
+    td.dst          = priv_ctx->srce_sig[frst];
+    ff_filter_execute(priv_ctx->threads, ctx, compute_signature, &td, NULL,
+                      FFMIN(priv_ctx->sig_h, priv_ctx->nb_threads));
+}
+
+typedef struct {
+    uint8_t *p1, *p2;
+    int linesize;
+    int w, h;
+    int64_t sad[MAX_FILTER_THREADS];
+} SADThreadData;
+
+/** SAD of a band of 8 line blocks, the last band also gets the remaining lines */
+static int compute_sad(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FRAMERATEContext *priv_ctx = ctx->priv;
+    SADThreadData *td = arg;
+    const int linesize = td->linesize;
+    const int w8 = td->w & ~7;
+    const int start = 8 * ((td->h >> 3) *  jobnr      / nb_jobs);
+    const int end   = jobnr == nb_jobs - 1 ? td->h : 8 * ((td->h >> 3) * (jobnr + 1) / nb_jobs);
+    const int end8  = start + ((end - start) & ~7);
+    int64_t sad = 0;
+    int x, y;
+
+    for (y = start; y < end8; y += 8)
+        for (x = 0; x < w8; x += 8)
+            sad += priv_ctx->c.sad[1](priv_ctx,
+                                      td->p1 + y * linesize + x,
+                                      td->p2 + y * linesize + x,
+                                      linesize, 8);
+    emms_c();
+
+    for (y = start; y < end; y++) {
+        const uint8_t *p1 = td->p1 + y * linesize;
+        const uint8_t *p2 = td->p2 + y * linesize;
+        for (x = y < end8 ? w8 : 0; x < td->w; x++)
+            sad += abs(p1[x] - p2[x]);
+    }
+    td->sad[jobnr] = sad;
+    return 0;
+}
+
+static uint8_t *get_signature(FRAMERATEContext *priv_ctx, AVFilterBufferRef *srce)
+{
+    for (int i = frst; i <= last; i++)
+        if (priv_ctx->srce[i] == srce)
+            return priv_ctx->srce_sig[i];
+    return NULL;
+}
+
 static double get_scene_score(AVFilterContext *ctx, AVFilterBufferRef *crnt, AVFilterBufferRef *next)
 {
     FRAMERATEContext *priv_ctx = ctx->priv;
@@ -153,40 +286,242 @@ static double get_scene_score(AVFilterContext *ctx, AVFilterBufferRef *crnt, AVF
     av_dlog(ctx, "get_scene_score()\n");
 #endif
 
+    // the same pair is compared for every output frame created between them
+    if (crnt == priv_ctx->score_src1 && next == priv_ctx->score_src2)
+        return priv_ctx->score;
+
     if (crnt &&
             crnt->video->h    == next->video->h &&
             crnt->video->w    == next->video->w &&
             crnt->linesize[0] == next->linesize[0]) {
-        int x, y;
-        int64_t sad;
+        SADThreadData td;
+        int64_t sad = 0;
         double mafd, diff;
-        uint8_t *p1 = crnt->data[0];
-        uint8_t *p2 = next->data[0];
-        const int linesize = crnt->linesize[0];
+        int nb_jobs;
 
 #ifdef DEBUG
         av_dlog(ctx, "get_scene_score() process\n");
 #endif
 
-        for (sad = y = 0; y < crnt->video->h; y += 8) {
-            for (x = 0; x < linesize; x += 8) {
-                sad += priv_ctx->c.sad[1](priv_ctx,
-                                        p1 + y * linesize + x,
-                                        p2 + y * linesize + x,
-                                        linesize, 8);
-            }
+        if (priv_ctx->scene_sub > 1) {
+            td.p1 = get_signature(priv_ctx, crnt);
+            td.p2 = get_signature(priv_ctx, next);
+            if (!td.p1 || !td.p2)
+                return 0;
+            td.linesize = priv_ctx->sig_linesize;
+            td.w        = priv_ctx->sig_w;
+            td.h        = priv_ctx->sig_h;
+        } else {
+            td.p1       = crnt->data[0];
+            td.p2       = next->data[0];
+            td.linesize = crnt->linesize[0];
+            td.w        = crnt->video->w;
+            td.h        = crnt->video->h;
         }
-        emms_c();
-        mafd = sad / (crnt->video->h * crnt->video->w * 3);
+
+        nb_jobs = av_clip(td.h >> 3, 1, priv_ctx->nb_threads);
+        ff_filter_execute(priv_ctx->threads, ctx, compute_sad, &td, NULL, nb_jobs);
+        for (int i = 0; i < nb_jobs; i++)
+            sad += td.sad[i];
+
+        mafd = sad / (td.h * td.w * 3);
         diff = fabs(mafd - priv_ctx->prev_mafd);
         ret  = av_clipf(FFMIN(mafd, diff), 0, 100.0);
         priv_ctx->prev_mafd = mafd;
     }
+    priv_ctx->score_src1 = crnt;
+    priv_ctx->score_src2 = next;
+    priv_ctx->score      = ret;
 #ifdef DEBUG
         av_dlog(ctx, "get_scene_score() result is:%f\n", ret);
 #endif
     return ret;
 }
+
+typedef struct {
+    AVFilterBufferRef *src1, *src2;
+    int src2_factor;                    ///< position of the output frame between src1 and src2, in 1/256
+    int sign;                           ///< -1 if the vectors were searched from src2 to src1
+} MCThreadData;
+
+/**
+ * Cost of the vector v for the block at (x, y) of the frame half way
+ * between src1 and src2, INT_MAX if a block it points to is not inside
+ * the frames.
+ */
+static int block_cost(FRAMERATEContext *priv_ctx, MCThreadData *td,
+                      int x, int y, int vx, int vy)
+{
+    const int linesize = td->src1->linesize[0];
+    const int x1 = x - (vx >> 1), x2 = x1 + vx;
+    const int y1 = y - (vy >> 1), y2 = y1 + vy;
+    uint8_t *p1, *p2;
+
+    if (FFABS(vx) > MC_RANGE || FFABS(vy) > MC_RANGE ||
+        FFMIN(x1, x2) < 0 || FFMAX(x1, x2) + MC_BLOCK > priv_ctx->srce_w ||
+        FFMIN(y1, y2) < 0 || FFMAX(y1, y2) + MC_BLOCK > priv_ctx->srce_h)
+        return INT_MAX;
+
+    p1 = td->src1->data[0] + y1 * linesize + x1;
+    p2 = td->src2->data[0] + y2 * linesize + x2;
+    // both blocks are unaligned, the 8 wide SAD does not mind
+    return priv_ctx->c.sad[1](priv_ctx, p1,     p2,     linesize, MC_BLOCK) +
+           priv_ctx->c.sad[1](priv_ctx, p1 + 8, p2 + 8, linesize, MC_BLOCK) +
+           MC_LAMBDA * (FFABS(vx) + FFABS(vy));
+}
+
+/**
+ * Search the vectors of a band of block rows. The predictors are the zero
+ * vector, the left block and the blocks of the previous pair, so that the
+ * result does not depend on the number of bands.
+ */
+static int search_vectors(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    static const int8_t diamond[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    FRAMERATEContext *priv_ctx = ctx->priv;
+    MCThreadData *td = arg;
+    const int mb_w  = priv_ctx->mb_w;
+    const int start = priv_ctx->mb_h *  jobnr      / nb_jobs;
+    const int end   = priv_ctx->mb_h * (jobnr + 1) / nb_jobs;
+
+    for (int by = start; by < end; by++) {
+        for (int bx = 0; bx < mb_w; bx++) {
+            const int idx = by * mb_w + bx;
+            const int x = bx * MC_BLOCK, y = by * MC_BLOCK;
+            const MotionVector *prev_mv = priv_ctx->mv[1];
+            MotionVector pred[5], best = { 0, 0 };
+            int nb_pred = 0, best_cost;
+
+            if (x + MC_BLOCK > priv_ctx->srce_w || y + MC_BLOCK > priv_ctx->srce_h) {
+                priv_ctx->mv[0][idx] = best;
+                continue;
+            }
+
+            if (bx)
+                pred[nb_pred++] = priv_ctx->mv[0][idx - 1];
+            pred[nb_pred++] = prev_mv[idx];
+            if (bx + 1 < mb_w)
+                pred[nb_pred++] = prev_mv[idx + 1];
+            if (by + 1 < priv_ctx->mb_h)
+                pred[nb_pred++] = prev_mv[idx + mb_w];
+
+            best_cost = block_cost(priv_ctx, td, x, y, 0, 0);
+            for (int i = 0; i < nb_pred; i++) {
+                int cost = block_cost(priv_ctx, td, x, y, pred[i].x, pred[i].y);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best      = pred[i];
+                }
+            }
+
+            for (int step = 4; step; step >>= 1) {
+                for (int iter = 0; iter < MC_RANGE / step; iter++) {
+                    MotionVector center = best;
+                    for (int i = 0; i < 4; i++) {
+                        int vx = center.x + diamond[i][0] * step;
+                        int vy = center.y + diamond[i][1] * step;
+                        int cost = block_cost(priv_ctx, td, x, y, vx, vy);
+                        if (cost < best_cost) {
+                            best_cost = cost;
+                            best.x    = vx;
+                            best.y    = vy;
+                        }
+                    }
+                    if (best.x == center.x && best.y == center.y)
+                        break;
+                }
+            }
+            priv_ctx->mv[0][idx] = best;
+        }
+    }
+    emms_c();
+    return 0;
+}
+
+/** Blend the motion compensated blocks of a band of block rows. */
+static int interpolate_blocks(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FRAMERATEContext *priv_ctx = ctx->priv;
+    MCThreadData *td = arg;
+    const int src2_factor = td->src2_factor;
+    const int src1_factor = 256 - src2_factor;
+    const int start = priv_ctx->mb_h *  jobnr      / nb_jobs;
+    const int end   = priv_ctx->mb_h * (jobnr + 1) / nb_jobs;
+
+    for (int plane = 0; plane < 4 && td->src1->data[plane] && td->src2->data[plane]; plane++) {
+        const int chroma = plane == 1 || plane == 2;
+        const int hsub = chroma ? priv_ctx->hsub : 0;
+        const int vsub = chroma ? priv_ctx->vsub : 0;
+        const int plane_w = priv_ctx->line_size[plane];
+        const int plane_h = priv_ctx->srce_h >> vsub;
+        const int src1_line_size = td->src1->linesize[plane];
+        const int src2_line_size = td->src2->linesize[plane];
+        const int dst_line_size  = priv_ctx->work->linesize[plane];
+
+        for (int by = start; by < end; by++) {
+            const int y0 = (by * MC_BLOCK) >> vsub;
+            const int bh = FFMIN(MC_BLOCK >> vsub, plane_h - y0);
+
+            for (int bx = 0; bx < priv_ctx->mb_w && bh > 0; bx++) {
+                const MotionVector *mv = &priv_ctx->mv[0][by * priv_ctx->mb_w + bx];
+                const int vx = mv->x * td->sign, vy = mv->y * td->sign;
+                const int x0 = (bx * MC_BLOCK) >> hsub;
+                const int bw = FFMIN(MC_BLOCK >> hsub, plane_w - x0);
+                // the output frame is src2_factor / 256 of the way along the vector
+                const int x1 = -((vx * src2_factor + 128) >> 8);
+                const int y1 = -((vy * src2_factor + 128) >> 8);
+                const int dx1 = av_clip(x1 >> hsub,        -x0, plane_w - bw - x0);
+                const int dy1 = av_clip(y1 >> vsub,        -y0, plane_h - bh - y0);
+                const int dx2 = av_clip((x1 + vx) >> hsub, -x0, plane_w - bw - x0);
+                const int dy2 = av_clip((y1 + vy) >> vsub, -y0, plane_h - bh - y0);
+                const uint8_t *src1 = td->src1->data[plane] + (y0 + dy1) * src1_line_size + x0 + dx1;
+                const uint8_t *src2 = td->src2->data[plane] + (y0 + dy2) * src2_line_size + x0 + dx2;
+                uint8_t *dst = priv_ctx->work->data[plane] + y0 * dst_line_size + x0;
+
+                if (bw <= 0)
+                    break;
+                for (int line = 0; line < bh; line++) {
+                    // same as the blend of process_work_frame(), the chroma
+                    // offsets cancel out since the factors add up to 256
+                    for (int pixel = 0; pixel < bw; pixel++)
+                        dst[pixel] = (src1[pixel] * src1_factor + src2[pixel] * src2_factor + 128) >> 8;
+                    src1 += src1_line_size;
+                    src2 += src2_line_size;
+                    dst  += dst_line_size;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Create the work frame by blending the blocks of src1 and src2 along their
+ * motion. The vectors are searched once for each pair of source frames and
+ * reused for every output frame created between them, in either direction.
+ */
+static void process_mc_frame(AVFilterContext *ctx, AVFilterBufferRef *src1,
+                             AVFilterBufferRef *src2, int src2_factor)
+{
+    FRAMERATEContext *priv_ctx = ctx->priv;
+    const int nb_jobs = FFMIN(priv_ctx->mb_h, priv_ctx->nb_threads);
+    MCThreadData td = { src1, src2, src2_factor, 1 };
+
+    if (src1 == priv_ctx->mv_src2 && src2 == priv_ctx->mv_src1) {
+        td.sign = -1;
+    } else if (src1 != priv_ctx->mv_src1 || src2 != priv_ctx->mv_src2) {
+        // the vectors of the previous pair become the temporal predictors
+        FFSWAP(MotionVector *, priv_ctx->mv[0], priv_ctx->mv[1]);
+        if (src1->linesize[0] == src2->linesize[0])
+            ff_filter_execute(priv_ctx->threads, ctx, search_vectors, &td, NULL, nb_jobs);
+        else
+            memset(priv_ctx->mv[0], 0, priv_ctx->mb_w * priv_ctx->mb_h * sizeof(*priv_ctx->mv[0]));
+        priv_ctx->mv_src1 = src1;
+        priv_ctx->mv_src2 = src2;
+    }
+
+    ff_filter_execute(priv_ctx->threads, ctx, interpolate_blocks, &td, NULL, nb_jobs);
+}
 #endif
 
 static int process_work_frame(AVFilterContext *ctx)
@@ -288,6 +623,13 @@ static int process_work_frame(AVFilterContext *ctx)
         if (interpolate_scene_score < priv_ctx->scene_score && copy_src2) {
             uint16_t src2_factor = abs(interpolate);
             uint16_t src1_factor = 256 - src2_factor;
+            if (CONFIG_AVCODEC && (priv_ctx->flags & FRAMERATE_FLAG_MC)) {
+#ifdef DEBUG
+                av_dlog(ctx, "process_work_frame() MOTION COMPENSATED INTERPOLATE to create work frame\n");
+#endif
+                process_mc_frame(ctx, copy_src1, copy_src2, src2_factor);
+                goto copy_done;
+            }
 #ifdef DEBUG
             av_dlog(ctx, "process_work_frame() INTERPOLATE to create work frame\n");
 #endif
@@ -541,6 +883,10 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
         }
     }
 
+    if ((err = ff_filter_threads_init(&priv_ctx->threads, priv_ctx->threads_opt)) < 0)
+        return err;
+    priv_ctx->nb_threads = err;
+
     return 0;
 }
 
@@ -548,10 +894,22 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     FRAMERATEContext *priv_ctx = ctx->priv;
 
-    for (int i = frst + 1; i > last; i++) {
-        if (priv_ctx->srce[i] && (priv_ctx->srce[i] != priv_ctx->srce[i + 1])) avfilter_unref_buffer(priv_ctx->srce[i]);
+    for (int i = frst; i < last; i++) {
+        if (priv_ctx->srce[i] && (priv_ctx->srce[i] != priv_ctx->srce[i + 1])) {
+            avfilter_unref_buffer(priv_ctx->srce[i]);
+            av_free(priv_ctx->srce_sig[i]);
+        }
     }
-    if (priv_ctx->srce[last]) avfilter_unref_buffer(priv_ctx->srce[last]);
+    if (priv_ctx->srce[last]) {
+        avfilter_unref_buffer(priv_ctx->srce[last]);
+        av_free(priv_ctx->srce_sig[last]);
+    }
+#if CONFIG_AVCODEC
+    av_freep(&priv_ctx->avctx);
+    av_freep(&priv_ctx->mv[0]);
+    av_freep(&priv_ctx->mv[1]);
+#endif
+    ff_filter_threads_free(&priv_ctx->threads);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -586,14 +944,33 @@ static int config_input(AVFilterLink *inlink)
                 plane);
     }
 
+    priv_ctx->hsub = pix_desc->log2_chroma_w;
     priv_ctx->vsub = pix_desc->log2_chroma_h;
 
-    if (CONFIG_AVCODEC) {
+    if (CONFIG_AVCODEC && !priv_ctx->avctx) {
         priv_ctx->avctx = avcodec_alloc_context3(NULL);
         if (!priv_ctx->avctx) return AVERROR(ENOMEM);
         dsputil_init(&priv_ctx->c, priv_ctx->avctx);
     }
 
+#if CONFIG_AVCODEC
+    priv_ctx->mb_w = (inlink->w + MC_BLOCK - 1) / MC_BLOCK;
+    priv_ctx->mb_h = (inlink->h + MC_BLOCK - 1) / MC_BLOCK;
+    priv_ctx->mv_src1 = priv_ctx->mv_src2 = NULL;
+    av_freep(&priv_ctx->mv[0]);
+    av_freep(&priv_ctx->mv[1]);
+    if (priv_ctx->flags & FRAMERATE_FLAG_MC) {
+        priv_ctx->mv[0] = av_mallocz(priv_ctx->mb_w * priv_ctx->mb_h * sizeof(*priv_ctx->mv[0]));
+        priv_ctx->mv[1] = av_mallocz(priv_ctx->mb_w * priv_ctx->mb_h * sizeof(*priv_ctx->mv[1]));
+        if (!priv_ctx->mv[0] || !priv_ctx->mv[1])
+            return AVERROR(ENOMEM);
+    }
+#endif
+
+    priv_ctx->sig_w        = 8 * (((inlink->w >> 3) + priv_ctx->scene_sub - 1) / priv_ctx->scene_sub);
+    priv_ctx->sig_h        = 8 * (((inlink->h >> 3) + priv_ctx->scene_sub - 1) / priv_ctx->scene_sub);
+    priv_ctx->sig_linesize = FFALIGN(priv_ctx->sig_w, 16);
+
     priv_ctx->srce_time_base = inlink->time_base;
     priv_ctx->srce_w = inlink->w;
     priv_ctx->srce_h = inlink->h;
@@ -663,6 +1040,11 @@ static void end_frame(AVFilterLink *link)
     av_dlog(ctx, "end_frame()\n");
 #endif
 
+#if CONFIG_AVCODEC
+    // the frame is complete, analyze it once for all the comparisons it takes part in
+    set_srce_signature(ctx);
+#endif
+
 //    if (!priv_ctx->srce[crnt]) {
 //        av_log(ctx, AV_LOG_DEBUG, "end_frame() no current frame\n");
 //        return;
@@ -844,6 +1226,7 @@ static int request_frame(AVFilterLink *outlink)
             av_dlog(ctx, "request_frame() copy:%d to:%d\n", i, i - 1);
 #endif
             priv_ctx->srce[i - 1] = priv_ctx->srce[i];
+            priv_ctx->srce_sig[i - 1] = priv_ctx->srce_sig[i];
         }
     }
 
@@ -24,168 +24,210 @@
  * libmpcodecs/vf_hqdn3d.c.
  */
 
+#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "hqdn3d.h"
+#include "thread.h"
+
+#define LUT_SIZE (512 << LUT_BITS)
 
 typedef struct {
-    int Coefs[4][512*16];
-    unsigned int *Line;
-    unsigned short *Frame[3];
+    int16_t Coefs[4][LUT_SIZE + 1];   ///< one more for the 32-bit SIMD loads
+    uint16_t *Line;                   ///< vertical lowpass state
+    uint16_t *Frame[3];               ///< temporal lowpass state
+    uint16_t *Tmp;                    ///< horizontally filtered plane
     int hsub, vsub;
+    int depth;
+    int frame_init;                   ///< the temporal state holds a frame
+    HQDN3DDSPContext dsp;
+    AVFilterThreads *threads;
+    int nb_threads;
 } HQDN3DContext;
 
-static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, int *Coef)
+/**
+ * Samples are processed as 16-bit values, the pixel shifted left by
+ * 16 - depth, so the strengths do not depend on the bit depth.
+ */
+static av_always_inline unsigned int LowPassMul(int PrevMul, int CurrMul,
+                                                const int16_t *Coef)
 {
-    //    int dMul= (PrevMul&0xFFFFFF)-(CurrMul&0xFFFFFF);
-    int dMul= PrevMul-CurrMul;
-    unsigned int d=((dMul+0x10007FF)>>12);
-    return CurrMul + Coef[d];
+    return CurrMul + Coef[(PrevMul - CurrMul) >> (8 - LUT_BITS)];
 }
 
-static void deNoiseTemporal(unsigned char *FrameSrc,
-                            unsigned char *FrameDest,
-                            unsigned short *FrameAnt,
-                            int W, int H, int sStride, int dStride,
-                            int *Temporal)
+static void lowpass_line_c(uint16_t *prev, const uint16_t *cur,
+                           const int16_t *coef, int w)
 {
-    long X, Y;
-    unsigned int PixelDst;
-
-    for (Y = 0; Y < H; Y++) {
-        for (X = 0; X < W; X++) {
-            PixelDst = LowPassMul(FrameAnt[X]<<8, FrameSrc[X]<<16, Temporal);
-            FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-        }
-        FrameSrc  += sStride;
-        FrameDest += dStride;
-        FrameAnt += W;
+    int x;
+
+    for (x = 0; x < w; x++)
+        prev[x] = LowPassMul(prev[x], cur[x], coef);
+}
+
+static av_always_inline void load_line(uint16_t *dst, const uint8_t *src,
+                                       int w, int depth)
+{
+    int x;
+
+    if (depth == 8) {
+        for (x = 0; x < w; x++)
+            dst[x] = src[x] << 8;
+    } else {
+        for (x = 0; x < w; x++)
+            dst[x] = AV_RN16A(src + 2*x) << (16 - depth);
     }
 }
 
-static void deNoiseSpacial(unsigned char *Frame,
-                           unsigned char *FrameDest,
-                           unsigned int *LineAnt,
-                           int W, int H, int sStride, int dStride,
-                           int *Horizontal, int *Vertical)
+static av_always_inline void horizontal_line(uint16_t *dst, const uint8_t *src,
+                                             const int16_t *coef,
+                                             int w, int depth)
 {
-    long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
     unsigned int PixelAnt;
-    unsigned int PixelDst;
-
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+    int x;
+
+    /* First pixel has no left neighbor. */
+    if (depth == 8) {
+        dst[0] = PixelAnt = src[0] << 8;
+        for (x = 1; x < w; x++)
+            dst[x] = PixelAnt = LowPassMul(PixelAnt, src[x] << 8, coef);
+    } else {
+        const uint16_t *src16 = (const uint16_t *)src;
+        dst[0] = PixelAnt = src16[0] << (16 - depth);
+        for (x = 1; x < w; x++)
+            dst[x] = PixelAnt = LowPassMul(PixelAnt, src16[x] << (16 - depth),
+                                           coef);
+    }
+}
 
-    /* First line has no top neighbor, only left. */
-    for (X = 1; X < W; X++) {
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+static av_always_inline void store_line(uint8_t *dst, const uint16_t *src,
+                                        int w, int depth)
+{
+    int x;
+
+    if (depth == 8) {
+        for (x = 0; x < w; x++)
+            dst[x] = (src[x] + 0x7F) >> 8;
+    } else {
+        for (x = 0; x < w; x++)
+            AV_WN16A(dst + 2*x, (src[x] + (1 << (15 - depth)) - 1) >> (16 - depth));
     }
+}
+
+typedef struct ThreadData {
+    AVFilterBufferRef *in, *out;
+    int plane, w, h;
+    const int16_t *spatial, *temporal;
+} ThreadData;
 
-    for (Y = 1; Y < H; Y++) {
-        unsigned int PixelAnt;
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++) {
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+/**
+ * First pass, on bands of lines: horizontal lowpass into the Tmp plane.
+ * The horizontal recursion only spans one line, so lines are independent.
+ */
+static int filter_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *hqdn3d = ctx->priv;
+    ThreadData *td = arg;
+    const int16_t *Horizontal = td->spatial + (256 << LUT_BITS);
+    int y, start = td->h * jobnr / nb_jobs, end = td->h * (jobnr + 1) / nb_jobs;
+
+    for (y = start; y < end; y++) {
+        const uint8_t *src = td->in->data[td->plane] + y * td->in->linesize[td->plane];
+        uint16_t *dst = hqdn3d->Tmp + y * td->w;
+
+        if (td->spatial[0]) {
+            if (hqdn3d->depth == 8) horizontal_line(dst, src, Horizontal, td->w, 8);
+            else                    horizontal_line(dst, src, Horizontal, td->w, hqdn3d->depth);
+        } else {
+            if (hqdn3d->depth == 8) load_line(dst, src, td->w, 8);
+            else                    load_line(dst, src, td->w, hqdn3d->depth);
         }
     }
+    return 0;
 }
 
-static void deNoise(unsigned char *Frame,
-                    unsigned char *FrameDest,
-                    unsigned int *LineAnt,
-                    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical, int *Temporal)
+/**
+ * Second pass, on bands of columns: vertical and temporal lowpass.
+ * The vertical recursion goes down whole columns, so splitting columns
+ * rather than lines gives the same result with any number of threads.
+ */
+static int filter_columns(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    long X, Y;
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if (!FrameAnt) {
-        (*FrameAntPtr) = FrameAnt = av_malloc(W*H*sizeof(unsigned short));
-        for (Y = 0; Y < H; Y++) {
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (X = 0; X < W; X++) dst[X]=src[X]<<8;
+    HQDN3DContext *hqdn3d = ctx->priv;
+    ThreadData *td = arg;
+    const int16_t *Vertical = td->spatial  + (256 << LUT_BITS);
+    const int16_t *Temporal = td->temporal + (256 << LUT_BITS);
+    const int depth = hqdn3d->depth;
+    /** bands are multiples of 16 samples wide, for the SIMD functions */
+    int x0 = (td->w *  jobnr      / nb_jobs) & ~15;
+    int x1 = jobnr + 1 == nb_jobs ? td->w : (td->w * (jobnr + 1) / nb_jobs) & ~15;
+    int w = x1 - x0, y;
+    uint16_t *LineAnt = hqdn3d->Line + x0;
+    uint16_t *FrameAnt = hqdn3d->Frame[td->plane] + x0;
+    uint8_t *dst = td->out->data[td->plane] + x0 * (depth > 8 ? 2 : 1);
+
+    for (y = 0; y < td->h; y++) {
+        const uint16_t *cur = hqdn3d->Tmp + y * td->w + x0;
+
+        if (td->spatial[0]) {
+            /* First line has no top neighbor. */
+            if (y) hqdn3d->dsp.lowpass_line(LineAnt, cur, Vertical, w);
+            else   memcpy(LineAnt, cur, w * sizeof(*LineAnt));
+            cur = LineAnt;
         }
-    }
+        if (td->temporal[0]) {
+            hqdn3d->dsp.lowpass_line(FrameAnt, cur, Temporal, w);
+            cur = FrameAnt;
+        }
+        if (depth == 8) store_line(dst, cur, w, 8);
+        else            store_line(dst, cur, w, depth);
 
-    if (!Horizontal[0] && !Vertical[0]) {
-        deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
-        return;
-    }
-    if (!Temporal[0]) {
-        deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
-        return;
+        FrameAnt += td->w;
+        dst      += td->out->linesize[td->plane];
     }
+    return 0;
+}
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
-
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (X = 1; X < W; X++) {
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+static void deNoise(AVFilterContext *ctx, AVFilterBufferRef *in,
+                    AVFilterBufferRef *out, int plane, int W, int H,
+                    const int16_t *Spatial, const int16_t *Temporal)
+{
+    HQDN3DContext *hqdn3d = ctx->priv;
+    ThreadData td = { in, out, plane, W, H, Spatial, Temporal };
+    int y;
+
+    /* The first frame has no previous one, start from itself. */
+    if (!hqdn3d->frame_init) {
+        for (y = 0; y < H; y++)
+            load_line(hqdn3d->Frame[plane] + y * W, in->data[plane] + y * in->linesize[plane],
+                      W, hqdn3d->depth);
     }
 
-    for (Y = 1; Y < H; Y++) {
-        unsigned int PixelAnt;
-        unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (X = 1; X < W; X++) {
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
-        }
-    }
+    ff_filter_execute(hqdn3d->threads, ctx, filter_rows, &td, NULL,
+                      FFMIN(H, hqdn3d->nb_threads));
+    ff_filter_execute(hqdn3d->threads, ctx, filter_columns, &td, NULL,
+                      av_clip(W / 16, 1, hqdn3d->nb_threads));
 }
 
-static void PrecalcCoefs(int *Ct, double Dist25)
+static void PrecalcCoefs(int16_t *Ct, double Dist25)
 {
     int i;
-    double Gamma, Simil, C;
-
-    Gamma = log(0.25) / log(1.0 - Dist25/255.0 - 0.00001);
-
-    for (i = -255*16; i <= 255*16; i++) {
-        Simil = 1.0 - FFABS(i) / (16*255.0);
-        C = pow(Simil, Gamma) * 65536.0 * i / 16.0;
-        Ct[16*256+i] = lrint(C);
+    double Gamma, Simil, C, f;
+
+    Gamma = log(0.25) / log(1.0 - FFMIN(Dist25, 252.0)/255.0 - 0.00001);
+
+    for (i = -256 << LUT_BITS; i < 256 << LUT_BITS; i++) {
+        /* middle of the range of differences, in pixels, mapped to i */
+        f = (i * (1 << (8 - LUT_BITS)) + (1 << (7 - LUT_BITS)) - 0.5) / 256.0;
+        Simil = 1.0 - FFMIN(FFABS(f), 255.0) / 255.0;
+        C = lrint(pow(Simil, Gamma) * 256.0 * f);
+        /* never overshoot, the result must stay between the two samples */
+        if (i < 0) C = FFMAX(C, i * (1 << (8 - LUT_BITS)) + (1 << (8 - LUT_BITS)) - 1);
+        else       C = FFMIN(C, i * (1 << (8 - LUT_BITS)));
+        Ct[(256 << LUT_BITS) + i] = C;
     }
+    Ct[LUT_SIZE] = 0;
 
+    /* the lowest difference cannot happen, the entry is used as a flag */
     Ct[0] = !!Dist25;
 }
 
@@ -198,6 +240,7 @@ static int init(AVFilterContext *ctx, const char *args, void *opaque)
     HQDN3DContext *hqdn3d = ctx->priv;
     double LumSpac, LumTmp, ChromSpac, ChromTmp;
     double Param1, Param2, Param3, Param4;
+    int threads = 1, ret;
 
     LumSpac   = PARAM1_DEFAULT;
     ChromSpac = PARAM2_DEFAULT;
@@ -205,8 +248,8 @@ static int init(AVFilterContext *ctx, const char *args, void *opaque)
     ChromTmp  = LumTmp * ChromSpac / LumSpac;
 
     if (args) {
-        switch (sscanf(args, "%lf:%lf:%lf:%lf",
-                       &Param1, &Param2, &Param3, &Param4)) {
+        switch (sscanf(args, "%lf:%lf:%lf:%lf:%d",
+                       &Param1, &Param2, &Param3, &Param4, &threads)) {
         case 1:
             LumSpac   = Param1;
             ChromSpac = PARAM2_DEFAULT * Param1 / PARAM1_DEFAULT;
@@ -226,6 +269,7 @@ static int init(AVFilterContext *ctx, const char *args, void *opaque)
             ChromTmp  = LumTmp * ChromSpac / LumSpac;
             break;
         case 4:
+        case 5:
             LumSpac   = Param1;
             ChromSpac = Param2;
             LumTmp    = Param3;
@@ -248,6 +292,13 @@ static int init(AVFilterContext *ctx, const char *args, void *opaque)
     PrecalcCoefs(hqdn3d->Coefs[2], ChromSpac);
     PrecalcCoefs(hqdn3d->Coefs[3], ChromTmp);
 
+    hqdn3d->dsp.lowpass_line = lowpass_line_c;
+    if (HAVE_MMX) ff_hqdn3d_init_x86(&hqdn3d->dsp);
+
+    if ((ret = ff_filter_threads_init(&hqdn3d->threads, threads)) < 0)
+        return ret;
+    hqdn3d->nb_threads = ret;
+
     return 0;
 }
 
@@ -255,7 +306,9 @@ static void uninit(AVFilterContext *ctx)
 {
     HQDN3DContext *hqdn3d = ctx->priv;
 
+    ff_filter_threads_free(&hqdn3d->threads);
     av_freep(&hqdn3d->Line);
+    av_freep(&hqdn3d->Tmp);
     av_freep(&hqdn3d->Frame[0]);
     av_freep(&hqdn3d->Frame[1]);
     av_freep(&hqdn3d->Frame[2]);
@@ -264,7 +317,11 @@ static void uninit(AVFilterContext *ctx)
 static int query_formats(AVFilterContext *ctx)
 {
     static const enum PixelFormat pix_fmts[] = {
-        PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_YUV411P, PIX_FMT_NONE
+        PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_YUV444P, PIX_FMT_YUV411P,
+        AV_NE(PIX_FMT_YUV420P10BE, PIX_FMT_YUV420P10LE),
+        AV_NE(PIX_FMT_YUV422P10BE, PIX_FMT_YUV422P10LE),
+        AV_NE(PIX_FMT_YUV444P10BE, PIX_FMT_YUV444P10LE),
+        PIX_FMT_NONE
     };
 
     avfilter_set_common_pixel_formats(ctx, avfilter_make_format_list(pix_fmts));
@@ -275,13 +332,31 @@ static int query_formats(AVFilterContext *ctx)
 static int config_input(AVFilterLink *inlink)
 {
     HQDN3DContext *hqdn3d = inlink->dst->priv;
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[inlink->format];
+    int cw, ch, i;
 
-    hqdn3d->hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
-    hqdn3d->vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
+    hqdn3d->hsub  = desc->log2_chroma_w;
+    hqdn3d->vsub  = desc->log2_chroma_h;
+    hqdn3d->depth = desc->comp[0].depth_minus1 + 1;
+    cw = -((-inlink->w) >> hqdn3d->hsub);
+    ch = -((-inlink->h) >> hqdn3d->vsub);
+
+    hqdn3d->frame_init = 0;
+    av_freep(&hqdn3d->Line);
+    av_freep(&hqdn3d->Tmp);
+    for (i = 0; i < 3; i++)
+        av_freep(&hqdn3d->Frame[i]);
 
     hqdn3d->Line = av_malloc(inlink->w * sizeof(*hqdn3d->Line));
-    if (!hqdn3d->Line)
+    hqdn3d->Tmp  = av_malloc(inlink->w * inlink->h * sizeof(*hqdn3d->Tmp));
+    if (!hqdn3d->Line || !hqdn3d->Tmp)
         return AVERROR(ENOMEM);
+    for (i = 0; i < 3; i++) {
+        hqdn3d->Frame[i] = av_malloc((i ? cw * ch : inlink->w * inlink->h) *
+                                     sizeof(*hqdn3d->Frame[i]));
+        if (!hqdn3d->Frame[i])
+            return AVERROR(ENOMEM);
+    }
 
     return 0;
 }
@@ -290,31 +365,21 @@ static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
 
 static void end_frame(AVFilterLink *inlink)
 {
-    HQDN3DContext *hqdn3d = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFilterContext *ctx = inlink->dst;
+    HQDN3DContext *hqdn3d = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFilterBufferRef *inpic  = inlink ->cur_buf;
     AVFilterBufferRef *outpic = outlink->out_buf;
-    int cw = inpic->video->w >> hqdn3d->hsub;
-    int ch = inpic->video->h >> hqdn3d->vsub;
-
-    deNoise(inpic->data[0], outpic->data[0],
-            hqdn3d->Line, &hqdn3d->Frame[0], inpic->video->w, inpic->video->h,
-            inpic->linesize[0], outpic->linesize[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[1]);
-    deNoise(inpic->data[1], outpic->data[1],
-            hqdn3d->Line, &hqdn3d->Frame[1], cw, ch,
-            inpic->linesize[1], outpic->linesize[1],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
-    deNoise(inpic->data[2], outpic->data[2],
-            hqdn3d->Line, &hqdn3d->Frame[2], cw, ch,
-            inpic->linesize[2], outpic->linesize[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
+    int cw = -((-inlink->w) >> hqdn3d->hsub);
+    int ch = -((-inlink->h) >> hqdn3d->vsub);
+
+    deNoise(ctx, inpic, outpic, 0, inlink->w, inlink->h,
+            hqdn3d->Coefs[0], hqdn3d->Coefs[1]);
+    deNoise(ctx, inpic, outpic, 1, cw, ch,
+            hqdn3d->Coefs[2], hqdn3d->Coefs[3]);
+    deNoise(ctx, inpic, outpic, 2, cw, ch,
+            hqdn3d->Coefs[2], hqdn3d->Coefs[3]);
+    hqdn3d->frame_init = 1;
 
     avfilter_draw_slice(outlink, 0, inpic->video->h, 1);
     avfilter_end_frame(outlink);
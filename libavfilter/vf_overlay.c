@@ -34,6 +34,7 @@
 #include "libavutil/mathematics.h"
 #include "drawutils.h"
 #include "internal.h"
+#include "overlay.h"
 
 /* #define DEBUG */
 
@@ -65,6 +66,13 @@ enum { MAIN = 0, OVERLAY };
 enum { R = 0, G, B, A };
 enum { Y = 0, U, V };
 
+/** alpha coverage of a block of the overlay */
+enum { ALPHA_TRANSPARENT = 0, ALPHA_MIXED, ALPHA_OPAQUE };
+
+/** size of the blocks of the alpha coverage map, in overlay luma samples */
+#define MAP_BLOCK_W 16
+#define MAP_BLOCK_H 2
+
 typedef struct {
     int x, y;                   ///< position of overlayed picture
 
@@ -82,10 +90,44 @@ typedef struct {
     int main_pix_step[4];       ///< steps per pixel for each plane of the main output
     int overlay_pix_step[4];    ///< steps per pixel for each plane of the overlay
     int hsub, vsub;             ///< chroma subsampling values
+    int main_depth;             ///< bits per sample of the main input
+
+    uint8_t *alpha_map;         ///< ALPHA_* coverage of each block of the overlay
+    int alpha_map_w;            ///< number of blocks per line of the map
+    uint8_t *alpha_line;        ///< chroma alpha of the line being blended
+    OverlayDSPContext dsp;
 
     char x_expr[256], y_expr[256], rgb_expr[256];
 } OverlayContext;
 
+// divide by 255 and round to nearest
+// apply a fast variant: (X+127)/255 = ((X+127)*257+257)>>16 = ((X+128)*257)>>16
+#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+
+// calculate the unpremultiplied alpha, applying the general equation:
+// alpha = alpha_overlay / ( (alpha_main + alpha_overlay) - (alpha_main * alpha_overlay) )
+// (((x) << 16) - ((x) << 9) + (x)) is a faster version of: 255 * 255 * x
+// ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
+#define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
+
+static void blend_row_c(uint8_t *dst, const uint8_t *src, const uint8_t *alpha,
+                        int w)
+{
+    int i;
+
+    for (i = 0; i < w; i++)
+        dst[i] = FAST_DIV255(dst[i] * (255 - alpha[i]) + src[i] * alpha[i]);
+}
+
+static void blend_row_10_c(uint16_t *dst, const uint8_t *src,
+                           const uint8_t *alpha, int w)
+{
+    int i;
+
+    for (i = 0; i < w; i++)
+        dst[i] = FAST_DIV255(dst[i] * (255 - alpha[i]) + (src[i] << 2) * alpha[i]);
+}
+
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     OverlayContext *over = ctx->priv;
@@ -108,6 +150,10 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
         over->allow_packed_rgb = 1;
     }
 
+    over->dsp.blend_row    = blend_row_c;
+    over->dsp.blend_row_10 = blend_row_10_c;
+    if (HAVE_MMX) ff_overlay_init_x86(&over->dsp);
+
     return 0;
 }
 
@@ -117,6 +163,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     if (over->overpicref)
         avfilter_unref_buffer(over->overpicref);
+    av_freep(&over->alpha_map);
+    av_freep(&over->alpha_line);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -124,7 +172,11 @@ static int query_formats(AVFilterContext *ctx)
     OverlayContext *over = ctx->priv;
 
     /* overlay formats contains alpha, for avoiding conversion with alpha information loss */
-    const enum PixelFormat main_pix_fmts_yuv[] = { PIX_FMT_YUV420P, PIX_FMT_YUVA420P, PIX_FMT_NONE };
+    const enum PixelFormat main_pix_fmts_yuv[] = {
+        PIX_FMT_YUV420P, PIX_FMT_YUVA420P, PIX_FMT_YUV422P,
+        AV_NE(PIX_FMT_YUV422P10BE, PIX_FMT_YUV422P10LE),
+        PIX_FMT_NONE
+    };
     const enum PixelFormat overlay_pix_fmts_yuv[] = { PIX_FMT_YUVA420P, PIX_FMT_NONE };
     const enum PixelFormat main_pix_fmts_rgb[] = {
         PIX_FMT_ARGB,  PIX_FMT_RGBA,
@@ -179,6 +231,7 @@ static int config_input_main(AVFilterLink *inlink)
 
     over->hsub = pix_desc->log2_chroma_w;
     over->vsub = pix_desc->log2_chroma_h;
+    over->main_depth = pix_desc->comp[0].depth_minus1 + 1;
 
     over->main_is_packed_rgb =
         ff_fill_rgba_map(over->main_rgba_map, inlink->format) >= 0;
@@ -250,6 +303,17 @@ static int config_input_overlay(AVFilterLink *inlink)
                (int)var_values[VAR_MAIN_W], (int)var_values[VAR_MAIN_H]);
         return AVERROR(EINVAL);
     }
+
+    if (!over->overlay_is_packed_rgb) {
+        av_freep(&over->alpha_map);
+        av_freep(&over->alpha_line);
+        over->alpha_map_w = (inlink->w + MAP_BLOCK_W - 1) / MAP_BLOCK_W;
+        over->alpha_map   = av_malloc(over->alpha_map_w *
+                                      ((inlink->h + MAP_BLOCK_H - 1) / MAP_BLOCK_H));
+        over->alpha_line  = av_malloc(inlink->w);
+        if (!over->alpha_map || !over->alpha_line)
+            return AVERROR(ENOMEM);
+    }
     return 0;
 
 fail:
@@ -297,23 +361,142 @@ static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
     avfilter_start_frame(inlink->dst->outputs[0], outpicref);
 }
 
+/**
+ * Classify the blocks of the overlay as fully transparent, fully opaque or
+ * mixed, so that blending can skip or copy the first two.
+ */
+static void update_alpha_map(OverlayContext *over, AVFilterBufferRef *pic)
+{
+    int w = pic->video->w, h = pic->video->h;
+    int bx, by, i, j;
+
+    for (by = 0; by < (h + MAP_BLOCK_H - 1) / MAP_BLOCK_H; by++) {
+        for (bx = 0; bx < over->alpha_map_w; bx++) {
+            const uint8_t *a = pic->data[3] + by * MAP_BLOCK_H * pic->linesize[3] +
+                               bx * MAP_BLOCK_W;
+            int bw = FFMIN(MAP_BLOCK_W, w - bx * MAP_BLOCK_W);
+            int bh = FFMIN(MAP_BLOCK_H, h - by * MAP_BLOCK_H);
+            int alpha_and = 255, alpha_or = 0;
+
+            for (j = 0; j < bh; j++) {
+                for (i = 0; i < bw; i++) {
+                    alpha_and &= a[i];
+                    alpha_or  |= a[i];
+                }
+                a += pic->linesize[3];
+            }
+            over->alpha_map[by * over->alpha_map_w + bx] =
+                !alpha_or ? ALPHA_TRANSPARENT : alpha_and == 255 ? ALPHA_OPAQUE : ALPHA_MIXED;
+        }
+    }
+}
+
 static void start_frame_overlay(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
 {
     AVFilterContext *ctx = inlink->dst;
     OverlayContext *over = ctx->priv;
 
     over->overpicref = inpicref;
+    if (over->alpha_map)
+        update_alpha_map(over, inpicref);
 }
 
-// divide by 255 and round to nearest
-// apply a fast variant: (X+127)/255 = ((X+127)*257+257)>>16 = ((X+128)*257)>>16
-#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+/**
+ * Blend a line of one plane, skipping the transparent blocks of the overlay
+ * and copying the opaque ones.
+ * @param map   line of the alpha coverage map, NULL to blend every sample
+ * @param bsize width of the map blocks in samples of this plane
+ */
+static void blend_line(OverlayContext *over, uint8_t *d, const uint8_t *s,
+                       const uint8_t *a, const uint8_t *map, int bsize, int w)
+{
+    int k, i, end;
+
+    for (k = 0; k < w; k = end) {
+        int type = map ? map[k / bsize] : ALPHA_MIXED;
+
+        end = FFMIN((k / bsize + 1) * bsize, w);
+        while (map && end < w && map[end / bsize] == type)
+            end = FFMIN(end + bsize, w);
+
+        if (type == ALPHA_TRANSPARENT)
+            continue;
+        if (over->main_depth > 8) {
+            uint16_t *d16 = (uint16_t *)d;
+            if (type == ALPHA_OPAQUE) {
+                for (i = k; i < end; i++)
+                    d16[i] = s[i] << 2;
+            } else
+                over->dsp.blend_row_10(d16 + k, s + k, a + k, end - k);
+        } else {
+            if (type == ALPHA_OPAQUE)
+                memcpy(d + k, s + k, end - k);
+            else
+                over->dsp.blend_row(d + k, s + k, a + k, end - k);
+        }
+    }
+}
 
-// calculate the unpremultiplied alpha, applying the general equation:
-// alpha = alpha_overlay / ( (alpha_main + alpha_overlay) - (alpha_main * alpha_overlay) )
-// (((x) << 16) - ((x) << 9) + (x)) is a faster version of: 255 * 255 * x
-// ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
-#define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
+/**
+ * Blend a YUVA 4:2:0 overlay on a main picture without alpha. The
+ * chroma of the overlay is repeated vertically for a 4:2:2 main.
+ */
+static void blend_slice_yuv(OverlayContext *over,
+                            AVFilterBufferRef *dst, AVFilterBufferRef *src,
+                            int x, int y, int width, int height, int start_y)
+{
+    const int bps = over->main_depth > 8 ? 2 : 1;
+    const int oy  = start_y - y;    ///< first overlay line of the slice
+    int i, j, k;
+
+    for (j = 0; j < height; j++) {
+        blend_line(over,
+                   dst->data[0] + (start_y + j) * dst->linesize[0] + x * bps,
+                   src->data[0] + (oy + j) * src->linesize[0],
+                   src->data[3] + (oy + j) * src->linesize[3],
+                   over->alpha_map + (oy + j) / MAP_BLOCK_H * over->alpha_map_w,
+                   MAP_BLOCK_W, width);
+    }
+
+    for (i = 1; i < 3; i++) {
+        const int hsub = over->hsub, vsub = over->vsub;
+        const int wp = FFALIGN(width,  1 << hsub) >> hsub;
+        const int hp = FFALIGN(height, 1 << vsub) >> vsub;
+        uint8_t *alpha = over->alpha_line;
+
+        for (j = 0; j < hp; j++) {
+            int ay = oy + (j << vsub);  ///< overlay luma line of this line
+            const uint8_t *a = src->data[3] + ay * src->linesize[3];
+            const uint8_t *map = NULL;
+
+            // average alpha for color components, improve quality
+            for (k = 0; k < wp; k++) {
+                const uint8_t *ak = a + (k << hsub);
+                int alpha_v, alpha_h;
+                if (hsub && vsub && j+1 < hp && k+1 < wp) {
+                    alpha[k] = (ak[0] + ak[src->linesize[3]] +
+                                ak[1] + ak[src->linesize[3]+1]) >> 2;
+                } else if (hsub || vsub) {
+                    alpha_h = hsub && k+1 < wp ?
+                        (ak[0] + ak[1]) >> 1 : ak[0];
+                    alpha_v = vsub && j+1 < hp ?
+                        (ak[0] + ak[src->linesize[3]]) >> 1 : ak[0];
+                    alpha[k] = (alpha_v + alpha_h) >> 1;
+                } else
+                    alpha[k] = ak[0];
+            }
+            /* the averaged alpha must not straddle two lines of blocks */
+            if (!vsub || !(ay % MAP_BLOCK_H))
+                map = over->alpha_map + ay / MAP_BLOCK_H * over->alpha_map_w;
+
+            blend_line(over,
+                       dst->data[i] + ((start_y >> vsub) + j) * dst->linesize[i] +
+                       (x >> hsub) * bps,
+                       src->data[i] + (ay >> 1) * src->linesize[i],
+                       alpha, map, MAP_BLOCK_W >> hsub, wp);
+        }
+    }
+}
 
 static void blend_slice(AVFilterContext *ctx,
                         AVFilterBufferRef *dst, AVFilterBufferRef *src,
@@ -395,6 +578,8 @@ static void blend_slice(AVFilterContext *ctx,
             dp += dst->linesize[0];
             sp += src->linesize[0];
         }
+    } else if (!over->main_has_alpha) {
+        blend_slice_yuv(over, dst, src, x, y, width, height, start_y);
     } else {
         const int main_has_alpha = over->main_has_alpha;
         if (main_has_alpha) {
@@ -0,0 +1,350 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * quality control statistics filter
+ *
+ * Computes in one pass over the luma the statistics of blackframe,
+ * cropdetect, a freeze detection and the checksums of showinfo.
+ */
+
+#include "libavutil/adler32.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "qcstats.h"
+
+typedef struct {
+    const AVClass *class;
+    int bthresh;                ///< threshold below which a sample is black
+    int bamount;                ///< percentage of black samples of a black frame
+    int limit;                  ///< average above which a line or column is not border
+    int round;                  ///< the crop width and height are multiples of it
+    int reset_count;            ///< number of frames after which the crop area is reset
+    double freeze;              ///< mean absolute difference of a frozen frame
+    int checksum;               ///< compute the checksums
+
+    QCStatsDSPContext dsp;
+    int hsub, vsub;
+    uint16_t *col_sum16;        ///< column sums of the last 256 lines at most
+    uint32_t *col_sum;          ///< column sums of the frame
+    uint32_t *line_sum;         ///< line sums of the frame
+    uint8_t *prev;              ///< luma of the previous frame, for the freeze detection
+    int have_prev;
+    int x1, y1, x2, y2;         ///< crop area found since the last reset
+    int crop_nb;                ///< number of frames since the last reset
+    int frozen;                 ///< number of consecutive frozen frames
+    unsigned frame;
+} QCStatsContext;
+
+#define OFFSET(x) offsetof(QCStatsContext, x)
+
+static const AVOption qcstats_options[] = {
+    {"bthresh",     "black sample threshold",               OFFSET(bthresh),     FF_OPT_TYPE_INT,    {.dbl=32},   1, 255,     0 },
+    {"bamount",     "percentage of black samples",          OFFSET(bamount),     FF_OPT_TYPE_INT,    {.dbl=98},   0, 100,     0 },
+    {"limit",       "crop detection threshold",             OFFSET(limit),       FF_OPT_TYPE_INT,    {.dbl=24},   0, 255,     0 },
+    {"round",       "crop size rounding",                   OFFSET(round),       FF_OPT_TYPE_INT,    {.dbl=16},   0, INT_MAX, 0 },
+    {"reset_count", "frames after which the crop is reset", OFFSET(reset_count), FF_OPT_TYPE_INT,    {.dbl=0},    0, INT_MAX, 0 },
+    {"freeze",      "freeze detection threshold",           OFFSET(freeze),      FF_OPT_TYPE_DOUBLE, {.dbl=0.25}, 0, 255,     0 },
+    {"checksum",    "compute the checksums",                OFFSET(checksum),    FF_OPT_TYPE_INT,    {.dbl=1},    0, 1,       0 },
+    {NULL}
+};
+
+static const char *qcstats_get_name(void *ctx)
+{
+    return "qcstats";
+}
+
+static const AVClass qcstats_class = {
+    "QCStatsContext",
+    qcstats_get_name,
+    qcstats_options
+};
+
+static void line_stats_c(QCLineStats *s, uint16_t *col_sum,
+                         const uint8_t *src, const uint8_t *prev,
+                         int w, int black_thresh)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        int v = src[x];
+        s->sum    += v;
+        s->sad    += FFABS(v - prev[x]);
+        s->nblack += v < black_thresh;
+        s->min     = FFMIN(s->min, v);
+        s->max     = FFMAX(s->max, v);
+        col_sum[x] += v;
+    }
+}
+
+static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
+{
+    QCStatsContext *qc = ctx->priv;
+    int ret;
+
+    qc->class = &qcstats_class;
+    av_opt_set_defaults2(qc, 0, 0);
+
+    if (args && (ret = av_set_options_string(qc, args, "=", ":")) < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Error parsing options string: '%s'\n", args);
+        return ret;
+    }
+
+    // same rounding as cropdetect, even and 16 by default
+    if (qc->round <= 1)
+        qc->round = 16;
+    if (qc->round % 2)
+        qc->round *= 2;
+
+    qc->dsp.line_stats = line_stats_c;
+    if (HAVE_MMX) ff_qcstats_init_x86(&qc->dsp);
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    QCStatsContext *qc = ctx->priv;
+
+    av_freep(&qc->col_sum16);
+    av_freep(&qc->col_sum);
+    av_freep(&qc->line_sum);
+    av_freep(&qc->prev);
+    qc->have_prev = 0;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum PixelFormat pix_fmts[] = {
+        PIX_FMT_YUV420P, PIX_FMT_YUVJ420P,
+        PIX_FMT_YUV422P, PIX_FMT_YUVJ422P,
+        PIX_FMT_YUV444P, PIX_FMT_YUVJ444P,
+        PIX_FMT_YUV411P, PIX_FMT_YUV410P,
+        PIX_FMT_GRAY8,
+        PIX_FMT_NONE
+    };
+
+    avfilter_set_common_pixel_formats(ctx, avfilter_make_format_list(pix_fmts));
+    return 0;
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    QCStatsContext *qc = ctx->priv;
+    const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[inlink->format];
+
+    qc->hsub = pix_desc->log2_chroma_w;
+    qc->vsub = pix_desc->log2_chroma_h;
+
+    uninit(ctx);
+    qc->col_sum16 = av_mallocz(FFALIGN(inlink->w, 32) * sizeof(*qc->col_sum16));
+    qc->col_sum   = av_malloc(inlink->w * sizeof(*qc->col_sum));
+    qc->line_sum  = av_malloc(inlink->h * sizeof(*qc->line_sum));
+    qc->prev      = av_malloc(inlink->w * inlink->h);
+    if (!qc->col_sum16 || !qc->col_sum || !qc->line_sum || !qc->prev)
+        return AVERROR(ENOMEM);
+
+    qc->x1 = inlink->w - 1;
+    qc->y1 = inlink->h - 1;
+    qc->x2 = 0;
+    qc->y2 = 0;
+
+    return 0;
+}
+
+static void flush_col_sum(QCStatsContext *qc, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++)
+        qc->col_sum[x] += qc->col_sum16[x];
+    memset(qc->col_sum16, 0, w * sizeof(*qc->col_sum16));
+}
+
+/**
+ * Checksum of two concatenated buffers, from the checksums of each
+ * computed from 0 as showinfo does.
+ */
+static uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, int64_t len2)
+{
+    const uint32_t base = 65521;
+    uint32_t s1 = ((adler1 & 0xFFFF) + (adler2 & 0xFFFF)) % base;
+    uint32_t s2 = ((adler1 >> 16) + (uint64_t)(len2 % base) * (adler1 & 0xFFFF) +
+                   (adler2 >> 16)) % base;
+
+    return s2 << 16 | s1;
+}
+
+/**
+ * Update the crop area with the first and last lines and columns whose
+ * average is above limit, in the same way as cropdetect.
+ */
+static void update_crop_area(QCStatsContext *qc, int w, int h)
+{
+    int x, y;
+
+    for (y = 0; y < qc->y1; y++)
+        if (qc->line_sum[y] / w > qc->limit) {
+            qc->y1 = y;
+            break;
+        }
+    for (y = h - 1; y > qc->y2; y--)
+        if (qc->line_sum[y] / w > qc->limit) {
+            qc->y2 = y;
+            break;
+        }
+    for (x = 0; x < qc->x1; x++)
+        if (qc->col_sum[x] / h > qc->limit) {
+            qc->x1 = x;
+            break;
+        }
+    for (x = w - 1; x > qc->x2; x--)
+        if (qc->col_sum[x] / h > qc->limit) {
+            qc->x2 = x;
+            break;
+        }
+}
+
+static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *picref)
+{
+    /* the samples are measured in end_frame, after the slices went
+     * downstream, so in-place filters must work on a copy */
+    avfilter_start_frame(inlink->dst->outputs[0],
+                         avfilter_ref_buffer(picref, ~AV_PERM_WRITE));
+}
+
+static void end_frame(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    QCStatsContext *qc = ctx->priv;
+    AVFilterBufferRef *picref = inlink->cur_buf;
+    const int w = inlink->w, h = inlink->h;
+    const uint8_t *src  = picref->data[0];
+    uint8_t *prev = qc->prev;
+    QCLineStats s = { 0, 0, 0, 255, 0 };
+    uint32_t plane_checksum[4] = { 0 }, checksum = 0;
+    int plane, y, crop_w, crop_h, crop_x, crop_y, shrink_by, pblack;
+    double diff;
+
+    memset(qc->col_sum, 0, w * sizeof(*qc->col_sum));
+    for (y = 0; y < h; y++) {
+        uint64_t sum = s.sum;
+
+        qc->dsp.line_stats(&s, qc->col_sum16, src, qc->have_prev ? prev : src,
+                           w, qc->bthresh);
+        qc->line_sum[y] = s.sum - sum;
+        if ((y & 255) == 255)
+            flush_col_sum(qc, w);
+        // the line is still in the cache
+        if (qc->checksum)
+            plane_checksum[0] = av_adler32_update(plane_checksum[0], src, w);
+        memcpy(prev, src, w);
+        src  += picref->linesize[0];
+        prev += w;
+    }
+    flush_col_sum(qc, w);
+    checksum = plane_checksum[0];
+
+    if (qc->checksum) {
+        for (plane = 1; plane < 4 && picref->data[plane]; plane++) {
+            int linesize = av_image_get_linesize(picref->format, w, plane);
+            int plane_h  = plane == 1 || plane == 2 ? h >> qc->vsub : h;
+
+            src = picref->data[plane];
+            for (y = 0; y < plane_h; y++) {
+                plane_checksum[plane] = av_adler32_update(plane_checksum[plane], src, linesize);
+                src += picref->linesize[plane];
+            }
+            checksum = adler32_combine(checksum, plane_checksum[plane],
+                                       (int64_t)linesize * plane_h);
+        }
+    }
+
+    // crop area, reset every reset_count frames if reset_count is > 0
+    if (qc->reset_count > 0 && ++qc->crop_nb > qc->reset_count) {
+        qc->x1 = w - 1;
+        qc->y1 = h - 1;
+        qc->x2 = 0;
+        qc->y2 = 0;
+        qc->crop_nb = 1;
+    }
+    update_crop_area(qc, w, h);
+
+    crop_x = (qc->x1 + 1) & ~1;
+    crop_y = (qc->y1 + 1) & ~1;
+    crop_w = qc->x2 - crop_x + 1;
+    crop_h = qc->y2 - crop_y + 1;
+
+    shrink_by = crop_w % qc->round;
+    crop_w -= shrink_by;
+    crop_x += (shrink_by / 2 + 1) & ~1;
+
+    shrink_by = crop_h % qc->round;
+    crop_h -= shrink_by;
+    crop_y += (shrink_by / 2 + 1) & ~1;
+
+    pblack = s.nblack * 100 / ((int64_t)w * h);
+
+    diff = (double)s.sad / ((int64_t)w * h);
+    qc->frozen = qc->have_prev && diff <= qc->freeze ? qc->frozen + 1 : 0;
+
+    av_log(ctx, AV_LOG_INFO,
+           "n:%u pts:%"PRId64" t:%f pos:%"PRId64" "
+           "min:%d max:%d avg:%.2f pblack:%d black:%d "
+           "crop=%d:%d:%d:%d diff:%.3f frozen:%d "
+           "checksum:%u plane_checksum:[%u %u %u %u]\n",
+           qc->frame, picref->pts,
+           picref->pts == AV_NOPTS_VALUE ? -1 : picref->pts * av_q2d(inlink->time_base),
+           picref->pos,
+           s.min, s.max, (double)s.sum / ((int64_t)w * h), pblack, pblack >= qc->bamount,
+           crop_w, crop_h, crop_x, crop_y, diff, qc->frozen,
+           checksum, plane_checksum[0], plane_checksum[1], plane_checksum[2], plane_checksum[3]);
+
+    qc->frame++;
+    qc->have_prev = 1;
+
+    avfilter_end_frame(ctx->outputs[0]);
+}
+
+AVFilter avfilter_vf_qcstats = {
+    .name        = "qcstats",
+    .description = NULL_IF_CONFIG_SMALL("Compute black, crop, freeze and checksum statistics in one pass."),
+
+    .priv_size = sizeof(QCStatsContext),
+    .init      = init,
+    .uninit    = uninit,
+
+    .query_formats = query_formats,
+
+    .inputs    = (AVFilterPad[]) {{ .name = "default",
+                                    .type             = AVMEDIA_TYPE_VIDEO,
+                                    .config_props     = config_input,
+                                    .get_video_buffer = avfilter_null_get_video_buffer,
+                                    .start_frame      = start_frame,
+                                    .end_frame        = end_frame,
+                                    .min_perms        = AV_PERM_READ, },
+                                  { .name = NULL}},
+
+    .outputs   = (AVFilterPad[]) {{ .name             = "default",
+                                    .type             = AVMEDIA_TYPE_VIDEO },
+                                  { .name = NULL}},
+};
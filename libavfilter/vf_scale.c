@@ -30,6 +30,10 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/avassert.h"
 #include "libswscale/swscale.h"
+#include "colormatrix.h"
+
+/** input lines fed to the scaler at once when converting the color matrix */
+#define MATRIX_SLICE_H 16
 
 static const char *var_names[] = {
     "PI",
@@ -80,6 +84,13 @@ typedef struct {
 
     char w_expr[256];           ///< width  expression string
     char h_expr[256];           ///< height expression string
+
+    int matrix_src, matrix_dst; ///< color matrices to convert between, -1 if none
+    ColorMatrixCoeffs matrix;
+    ColorMatrixDSPContext matrix_dsp;
+    int matrix_depth;
+    int matrix_vsub;
+    ColorMatrixRows matrix_rows;
 } ScaleContext;
 
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
@@ -91,7 +102,9 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
     av_strlcpy(scale->h_expr, "ih", sizeof(scale->h_expr));
 
     scale->flags = SWS_BILINEAR;
+    scale->matrix_src = scale->matrix_dst = -1;
     if (args) {
+        char name[16];
         sscanf(args, "%255[^:]:%255[^:]", scale->w_expr, scale->h_expr);
         p = strstr(args,"flags=");
         if (p) scale->flags = strtoul(p+6, NULL, 0);
@@ -99,6 +112,27 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
             scale->interlaced=1;
         }else if(strstr(args,"interl=-1"))
             scale->interlaced=-1;
+        p = strstr(args, "matrix_src=");
+        if (p && sscanf(p+11, "%15[^:]", name) == 1)
+            scale->matrix_src = ff_colormatrix_get_matrix(name);
+        p = strstr(args, "matrix_dst=");
+        if (p && sscanf(p+11, "%15[^:]", name) == 1)
+            scale->matrix_dst = ff_colormatrix_get_matrix(name);
+    }
+
+    if (scale->matrix_src >= 0 || scale->matrix_dst >= 0) {
+        if (scale->matrix_src < 0 || scale->matrix_dst < 0 ||
+            scale->matrix_src == scale->matrix_dst) {
+            av_log(ctx, AV_LOG_ERROR, "invalid color matrix conversion, "
+                   "possible matrices: bt709,bt601,smpte240m,fcc\n");
+            return AVERROR(EINVAL);
+        }
+        if (ff_colormatrix_calc_coeffs(scale->matrix, scale->matrix_src,
+                                       scale->matrix_dst) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "error calculating conversion coefficients\n");
+            return AVERROR(EINVAL);
+        }
+        ff_colormatrix_init(&scale->matrix_dsp);
     }
 
     return 0;
@@ -111,10 +145,16 @@ static av_cold void uninit(AVFilterContext *ctx)
     sws_freeContext(scale->isws[0]);
     sws_freeContext(scale->isws[1]);
     scale->sws = NULL;
+    ff_colormatrix_free_rows(&scale->matrix_rows);
 }
 
 static int query_formats(AVFilterContext *ctx)
 {
+    static const enum PixelFormat matrix_pix_fmts[] = {
+        PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_YUV420P10, PIX_FMT_YUV422P10,
+        PIX_FMT_NONE
+    };
+    ScaleContext *scale = ctx->priv;
     AVFilterFormats *formats;
     enum PixelFormat pix_fmt;
     int ret;
@@ -129,7 +169,12 @@ static int query_formats(AVFilterContext *ctx)
             }
         avfilter_formats_ref(formats, &ctx->inputs[0]->out_formats);
     }
-    if (ctx->outputs[0]) {
+    if (ctx->outputs[0] && scale->matrix_src >= 0) {
+        formats = avfilter_make_format_list(matrix_pix_fmts);
+        if (!formats)
+            return AVERROR(ENOMEM);
+        avfilter_formats_ref(formats, &ctx->outputs[0]->in_formats);
+    } else if (ctx->outputs[0]) {
         formats = NULL;
         for (pix_fmt = 0; pix_fmt < PIX_FMT_NB; pix_fmt++)
             if (    sws_isSupportedOutput(pix_fmt)
@@ -225,10 +270,20 @@ static int config_props(AVFilterLink *outlink)
 
     scale->input_is_pal = av_pix_fmt_descriptors[inlink->format].flags & PIX_FMT_PAL;
 
+    if (scale->matrix_src >= 0) {
+        const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[outlink->format];
+        scale->matrix_depth = desc->comp[0].depth_minus1 + 1;
+        scale->matrix_vsub  = desc->log2_chroma_h;
+        if (ff_colormatrix_alloc_rows(&scale->matrix_rows, outlink->w) < 0)
+            return AVERROR(ENOMEM);
+    }
+
     if (scale->sws)
         sws_freeContext(scale->sws);
+    /* the color matrix is applied on the scaler output, keep it even when
+     * it only copies */
     if (inlink->w == outlink->w && inlink->h == outlink->h &&
-        inlink->format == outlink->format) {
+        inlink->format == outlink->format && scale->matrix_src < 0) {
         scale->sws = NULL;
     } else {
         scale->sws = sws_getContext(inlink ->w, inlink ->h, inlink ->format,
@@ -283,6 +338,7 @@ static void start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
               INT_MAX);
 
     scale->slice_y = 0;
+    ff_colormatrix_reset_rows(&scale->matrix_rows);
     avfilter_start_frame(outlink, avfilter_ref_buffer(outpicref, ~0));
 }
 
@@ -312,19 +368,12 @@ static int scale_slice(AVFilterLink *link, struct SwsContext *sws, int y, int h,
                          out,out_stride);
 }
 
-static void draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
+static void scale_and_draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
 {
     ScaleContext *scale = link->dst->priv;
+    AVFilterLink *outlink = link->dst->outputs[0];
     int out_h;
 
-    if (!scale->sws) {
-        avfilter_draw_slice(link->dst->outputs[0], y, h, slice_dir);
-        return;
-    }
-
-    if (scale->slice_y == 0 && slice_dir == -1)
-        scale->slice_y = link->dst->outputs[0]->h;
-
     if(scale->interlaced>0 || (scale->interlaced<0 && link->cur_buf->video->interlaced)){
         av_assert0(y%4 == 0);
         out_h = scale_slice(link, scale->isws[0], y, (h+1)/2, 2, 0);
@@ -335,11 +384,39 @@ static void draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
 
     if (slice_dir == -1)
         scale->slice_y -= out_h;
-    avfilter_draw_slice(link->dst->outputs[0], scale->slice_y, out_h, slice_dir);
+    if (scale->matrix_src >= 0)
+        ff_colormatrix_convert_rows(&scale->matrix_dsp, scale->matrix,
+                                    scale->matrix_depth, outlink->out_buf->data,
+                                    outlink->out_buf->linesize, outlink->w,
+                                    scale->slice_y, out_h, scale->matrix_vsub,
+                                    &scale->matrix_rows);
+    avfilter_draw_slice(outlink, scale->slice_y, out_h, slice_dir);
     if (slice_dir == 1)
         scale->slice_y += out_h;
 }
 
+static void draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
+{
+    ScaleContext *scale = link->dst->priv;
+    int slice_h = h;
+
+    if (!scale->sws) {
+        avfilter_draw_slice(link->dst->outputs[0], y, h, slice_dir);
+        return;
+    }
+
+    if (scale->slice_y == 0 && slice_dir == -1)
+        scale->slice_y = link->dst->outputs[0]->h;
+
+    /* feed the scaler a few lines at a time so that the color matrix is
+     * applied on output rows that are still in the cache */
+    if (scale->matrix_src >= 0 && slice_dir == 1)
+        slice_h = MATRIX_SLICE_H;
+
+    for (; h > 0; y += slice_h, h -= slice_h)
+        scale_and_draw_slice(link, y, FFMIN(slice_h, h), slice_dir);
+}
+
 AVFilter avfilter_vf_scale = {
     .name      = "scale",
     .description = NULL_IF_CONFIG_SMALL("Scale the input video to width:height size and/or convert the image format."),
@@ -24,6 +24,8 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "thread.h"
+#include "w3fdif.h"
 
 /* #define DEBUG */
 
@@ -32,6 +34,10 @@
 
 typedef struct {
     int line_size[4];     ///< bytes of pixel data per line for each plane
+    int nb_planes;
+    int planewidth[4];    ///< width of each plane in samples
+    int planeheight[4];   ///< height of each plane
+    int max;              ///< maximum sample value
     int pending;          ///< how many fields are still waiting to be sent to next filter
     int field;            ///< which field are we on, 0 or 1
     int flush;            ///< are we flushing final frames
@@ -40,38 +46,118 @@ typedef struct {
 
     AVFilterBufferRef *prev, *crnt, *next;  ///< previous, current, next frames
     AVFilterBufferRef *work;                ///< frame we are working on
-    int32_t* work_line;   ///< line we are calculating
+    int32_t *work_line[MAX_FILTER_THREADS]; ///< line we are calculating, one per thread
 
+    W3FDIFDSPContext dsp;
+    AVFilterThreads *threads;
+    int nb_threads;
 } W3FDIFContext;
 
 /** Martin Weston deinterlace filter */
 
-/** filter coefficients from PH-2071, scaled by 256*256
+/** filter coefficients from PH-2071, scaled by 128*256
  *
  *  each set of coefficients have a sets for low-frequencies and high-frequencies
  *  n_coef_lf[] and n_coef_hf[] are the number of coefs for simple and more-complex
  *  it is important for later that n_coef_lf[] is even and n_coef_hf[] is odd
  *  coef_lf[][] and coef_hf[][] are the coefficients for low-frequencies and high-
- *                              frequencies for simple and more-complex mode */
+ *                              frequencies for simple and more-complex mode
+ *  the coefficients scaled by 256*256 are all even, so halving them keeps the
+ *  output identical while fitting them in 16 bits */
 static const int     n_coef_lf[2]    = {2, 4};
-static const int32_t   coef_lf[2][4] = {{ 32768, 32768,     0,      0},
-                                        { -1704, 34472, 34472,  -1704}};
+static const int16_t   coef_lf[2][4] = {{ 16384, 16384,     0,      0},
+                                        {  -852, 17236, 17236,   -852}};
 static const int     n_coef_hf[2]    = {3, 5};
-static const int32_t   coef_hf[2][5] = {{ -4096,  8192, -4096,     0,     0},
-                                        {  2032, -7602, 11140, -7602,  2032}};
+static const int16_t   coef_hf[2][5] = {{ -2048,  4096, -2048,     0,     0},
+                                        {  1016, -3801,  5570, -3801,  1016}};
+
+#define FILTER_FUNCS(depth)                                                     \
+static void filter_simple_low_ ## depth(int32_t *work_line,                     \
+                                        uint8_t *in_lines_cur[2],               \
+                                        const int16_t *coef, int linesize)      \
+{                                                                               \
+    w3fdif_filter_low(work_line, in_lines_cur, coef, 2, 0, linesize, depth);    \
+}                                                                               \
+                                                                                \
+static void filter_complex_low_ ## depth(int32_t *work_line,                    \
+                                         uint8_t *in_lines_cur[4],              \
+                                         const int16_t *coef, int linesize)     \
+{                                                                               \
+    w3fdif_filter_low(work_line, in_lines_cur, coef, 4, 0, linesize, depth);    \
+}                                                                               \
+                                                                                \
+static void filter_simple_high_ ## depth(int32_t *work_line,                    \
+                                         uint8_t *in_lines_cur[3],              \
+                                         uint8_t *in_lines_adj[3],              \
+                                         const int16_t *coef, int linesize)     \
+{                                                                               \
+    w3fdif_filter_high(work_line, in_lines_cur, in_lines_adj, coef, 3,          \
+                       0, linesize, depth);                                     \
+}                                                                               \
+                                                                                \
+static void filter_complex_high_ ## depth(int32_t *work_line,                   \
+                                          uint8_t *in_lines_cur[5],             \
+                                          uint8_t *in_lines_adj[5],             \
+                                          const int16_t *coef, int linesize)    \
+{                                                                               \
+    w3fdif_filter_high(work_line, in_lines_cur, in_lines_adj, coef, 5,          \
+                       0, linesize, depth);                                     \
+}                                                                               \
+                                                                                \
+static void filter_scale_ ## depth(uint8_t *out_pixel,                          \
+                                   const int32_t *work_pixel,                   \
+                                   int linesize, int max)                       \
+{                                                                               \
+    w3fdif_filter_scale(out_pixel, work_pixel, 0, linesize, max, depth);        \
+}
+
+FILTER_FUNCS(8)
+FILTER_FUNCS(16)
 
-static int deinterlace_component(AVFilterContext *ctx,
-        const AVFilterBufferRef *cur, const AVFilterBufferRef *adj,
-        const int filter, const int plane)
+void ff_w3fdif_init(W3FDIFDSPContext *dsp, int depth)
 {
-    W3FDIFContext *w3fdif = ctx->priv;
+    if (depth <= 8) {
+        dsp->filter_simple_low   = filter_simple_low_8;
+        dsp->filter_complex_low  = filter_complex_low_8;
+        dsp->filter_simple_high  = filter_simple_high_8;
+        dsp->filter_complex_high = filter_complex_high_8;
+        dsp->filter_scale        = filter_scale_8;
+    } else {
+        dsp->filter_simple_low   = filter_simple_low_16;
+        dsp->filter_complex_low  = filter_complex_low_16;
+        dsp->filter_simple_high  = filter_simple_high_16;
+        dsp->filter_complex_high = filter_complex_high_16;
+        dsp->filter_scale        = filter_scale_16;
+    }
+
+    if (HAVE_MMX) ff_w3fdif_init_x86(dsp, depth);
+}
+
+typedef struct ThreadData {
+    const AVFilterBufferRef *cur, *adj;
+    int plane;
+} ThreadData;
 
+static int deinterlace_slice(AVFilterContext *ctx, void *arg,
+                             int jobnr, int nb_jobs)
+{
+    W3FDIFContext *w3fdif = ctx->priv;
+    ThreadData *td = arg;
+    const AVFilterBufferRef *cur = td->cur;
+    const AVFilterBufferRef *adj = td->adj;
+    const int filter = w3fdif->filter;
+    const int plane  = td->plane;
+    const int height = w3fdif->planeheight[plane];
+    const int width  = w3fdif->planewidth[plane];
+    /** bands start on an even line so each one holds whole line pairs */
+    const int start  = (height *  jobnr      / nb_jobs) & ~1;
+    const int end    = jobnr + 1 == nb_jobs ? height :
+                       (height * (jobnr + 1) / nb_jobs) & ~1;
+    W3FDIFDSPContext *dsp = &w3fdif->dsp;
     uint8_t *in_line, *out_line;
     uint8_t *in_lines_cur[5];
     uint8_t *in_lines_adj[5];
-    uint8_t *out_pixel;
-    int32_t* work_line;
-    int32_t *work_pixel;
+    int32_t *work_line = w3fdif->work_line[jobnr];
     int j, y_in, y_out;
     int cur_line_stride, adj_line_stride, dst_line_stride, line_size;
     uint8_t *cur_data, *adj_data, *dst_data;
@@ -87,16 +173,12 @@ static int deinterlace_component(AVFilterContext *ctx,
     line_size = w3fdif->line_size[plane];
 
     /** copy unchanged the lines of the field */
-    if (w3fdif->field != cur->video->top_field_first) {
-        y_out = 0;
-    } else {
-        y_out = 1;
-    }
+    y_out = start + (w3fdif->field == cur->video->top_field_first);
 
     in_line  = cur_data + (y_out * cur_line_stride);
     out_line = dst_data + (y_out * dst_line_stride);
 
-    while (y_out < cur->video->h) {
+    while (y_out < end) {
         memcpy(out_line, in_line, line_size);
         y_out += 2;
         in_line  += cur_line_stride * 2;
@@ -104,93 +186,39 @@ static int deinterlace_component(AVFilterContext *ctx,
     }
 
     /** interpolate other other lines of the field */
-    if (w3fdif->field==cur->video->top_field_first) {
-        y_out = 0;
-    } else {
-        y_out = 1;
-    }
+    y_out = start + (w3fdif->field != cur->video->top_field_first);
 
     out_line = dst_data + (y_out * dst_line_stride);
 
-    while (y_out < w3fdif->crnt->video->h) {
-        /** clear workspace */
-        memset(w3fdif->work_line, 0, sizeof(uint32_t) * line_size);
+    while (y_out < end) {
         /** get low vertical frequencies from current field */
         for (j = 0; j < n_coef_lf[filter]; j++) {
             y_in = (y_out + 1) + (j * 2) - n_coef_lf[filter];
             while (y_in < 0) y_in += 2;
-            while (y_in >= cur->video->h) y_in -= 2;
+            while (y_in >= height) y_in -= 2;
             in_lines_cur[j] = cur_data + (y_in * cur_line_stride);
         }
-        work_line = w3fdif->work_line;
-        // TODO: set pixel stride for in
-        // these have been unrolled from an function with loops for speed
-        switch (n_coef_lf[filter]) {
-        case 4:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_lf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_lf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_lf[filter][2];
-                *work_line++ += *in_lines_cur[3]++ * coef_lf[filter][3];
-            }
-            break;
-        case 2:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_lf[filter][0];
-                *work_line++ += *in_lines_cur[1]++ * coef_lf[filter][1];
-            }
-            break;
-        default:
-            assert(0);
-        }
+        if (filter)
+            dsp->filter_complex_low(work_line, in_lines_cur, coef_lf[filter], width);
+        else
+            dsp->filter_simple_low(work_line, in_lines_cur, coef_lf[filter], width);
+
         /** get high vertical frequencies from adjacent fields */
         for (j = 0; j < n_coef_hf[filter]; j++) {
             y_in = (y_out + 1) + (j * 2) - n_coef_hf[filter];
             while (y_in < 0) y_in += 2;
-            while (y_in >= cur->video->h) y_in -= 2;
+            while (y_in >= height) y_in -= 2;
             in_lines_cur[j] = cur_data + (y_in * cur_line_stride);
             in_lines_adj[j] = adj_data + (y_in * adj_line_stride);
         }
-        work_line = w3fdif->work_line;
-        // TODO: set pixel stride for in
-        // these have been unrolled from an function with loops for speed
-        switch (n_coef_hf[filter]) {
-        case 5:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_adj[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_adj[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_hf[filter][2];
-                *work_line   += *in_lines_adj[2]++ * coef_hf[filter][2];
-                *work_line   += *in_lines_cur[3]++ * coef_hf[filter][3];
-                *work_line   += *in_lines_adj[3]++ * coef_hf[filter][3];
-                *work_line   += *in_lines_cur[4]++ * coef_hf[filter][4];
-                *work_line++ += *in_lines_adj[4]++ * coef_hf[filter][4];
-            }
-            break;
-        case 3:
-            for (int i = 0; i < line_size; i++) {
-                *work_line   += *in_lines_cur[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_adj[0]++ * coef_hf[filter][0];
-                *work_line   += *in_lines_cur[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_adj[1]++ * coef_hf[filter][1];
-                *work_line   += *in_lines_cur[2]++ * coef_hf[filter][2];
-                *work_line++ += *in_lines_adj[2]++ * coef_hf[filter][2];
-            }
-            break;
-        default:
-            assert(0);
-        }
-        /** save scaled result to the output frame, scaling down by 256 * 256 */
-        //TODO: set pixel stride for out
-        work_pixel = w3fdif->work_line;
-        out_pixel = out_line;
-        for (j = 0; j < line_size; j++) {
-            *out_pixel =  (*work_pixel>(255*256*256)?(255*256*256):(*work_pixel<0?0:*work_pixel))>>16;
-            out_pixel++;
-            work_pixel++;
-        }
+        if (filter)
+            dsp->filter_complex_high(work_line, in_lines_cur, in_lines_adj, coef_hf[filter], width);
+        else
+            dsp->filter_simple_high(work_line, in_lines_cur, in_lines_adj, coef_hf[filter], width);
+
+        /** save scaled result to the output frame, scaling down by 128 * 256 */
+        dsp->filter_scale(out_line, work_line, width, w3fdif->max);
+
         /** move on to next line */
         y_out += 2;
         out_line += dst_line_stride * 2;
@@ -198,6 +226,22 @@ static int deinterlace_component(AVFilterContext *ctx,
     return 0;
 }
 
+static void deinterlace_field(AVFilterContext *ctx,
+                              const AVFilterBufferRef *cur, const AVFilterBufferRef *adj)
+{
+    W3FDIFContext *w3fdif = ctx->priv;
+    ThreadData td;
+
+    td.cur = cur;
+    td.adj = adj;
+    for (td.plane = 0; td.plane < w3fdif->nb_planes; td.plane++)
+        ff_filter_execute(w3fdif->threads, ctx, deinterlace_slice, &td, NULL,
+                          av_clip(w3fdif->planeheight[td.plane] / 2, 1, w3fdif->nb_threads));
+#if HAVE_MMX
+    __asm__ volatile("emms \n\t" : : : "memory");
+#endif
+}
+
 /** FFmpeg filter integration */
 
 static void set_frame_pts(AVFilterContext *ctx)
@@ -226,15 +270,9 @@ static void process_frame(AVFilterContext *ctx)
 {
     W3FDIFContext *w3fdif = ctx->priv;
 
-    int plane;
-
-    w3fdif->work_line = av_malloc(w3fdif->crnt->linesize[0] * sizeof(uint32_t));
-
     if (!w3fdif->field) {
         /** do the deinterlacing for field 0 */
-        for (plane = 0; plane < 4 && w3fdif->crnt->data[plane]; plane++) {
-            deinterlace_component(ctx, w3fdif->crnt, w3fdif->prev, w3fdif->filter, plane);
-        }
+        deinterlace_field(ctx, w3fdif->crnt, w3fdif->prev);
 
         /** prev is not neede after this point*/
         if (w3fdif->prev && w3fdif->prev != w3fdif->crnt) {
@@ -247,9 +285,7 @@ static void process_frame(AVFilterContext *ctx)
         w3fdif->next = NULL;
     } else {
         /** do the deinterlacing for field 1 */
-        for (plane = 0; plane < 4 && w3fdif->crnt->data[plane]; plane++) {
-            deinterlace_component(ctx, w3fdif->crnt, w3fdif->next, w3fdif->filter, plane);
-        }
+        deinterlace_field(ctx, w3fdif->crnt, w3fdif->next);
 
         /** at the end of the second field we _always_ copy current to previous
          *  and copy next to current */
@@ -257,8 +293,6 @@ static void process_frame(AVFilterContext *ctx)
         w3fdif->crnt = w3fdif->next;
     }
 
-    av_free(w3fdif->work_line);
-
     /** swap field */
     w3fdif->field = !w3fdif->field;
 }
@@ -269,8 +303,8 @@ static int config_input(AVFilterLink *link)
 {
     AVFilterContext *ctx = link->dst;
     W3FDIFContext *w3fdif = ctx->priv;
-
-    int plane;
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[link->format];
+    int plane, i;
 
     /** full an array with the number of bytes that the video
      *  data occupies per line for each plane of the input video */
@@ -280,6 +314,22 @@ static int config_input(AVFilterLink *link)
                 link->w,
                 plane);
     }
+
+    w3fdif->nb_planes = desc->nb_components;
+    w3fdif->planewidth[0]  = w3fdif->planewidth[3]  = link->w;
+    w3fdif->planeheight[0] = w3fdif->planeheight[3] = link->h;
+    w3fdif->planewidth[1]  = w3fdif->planewidth[2]  = -((-link->w) >> desc->log2_chroma_w);
+    w3fdif->planeheight[1] = w3fdif->planeheight[2] = -((-link->h) >> desc->log2_chroma_h);
+    w3fdif->max = (1 << (desc->comp[0].depth_minus1 + 1)) - 1;
+
+    ff_w3fdif_init(&w3fdif->dsp, desc->comp[0].depth_minus1 + 1);
+
+    for (i = 0; i < w3fdif->nb_threads; i++) {
+        av_freep(&w3fdif->work_line[i]);
+        w3fdif->work_line[i] = av_malloc(link->w * sizeof(int32_t));
+        if (!w3fdif->work_line[i])
+            return AVERROR(ENOMEM);
+    }
     return 0;
 }
 
@@ -410,18 +460,21 @@ static int request_frame(AVFilterLink *link)
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     W3FDIFContext *w3fdif = ctx->priv;
+    int threads = 1, ret;
 
-    if (!args) {
-        w3fdif->filter = 1;
-    } else if (sscanf(args, "%u", &w3fdif->filter) == 1) {
-        w3fdif->filter = !!w3fdif->filter;
-    } else {
+    w3fdif->filter = 1;
+    if (args && sscanf(args, "%u:%d", &w3fdif->filter, &threads) < 1) {
         av_log(ctx, AV_LOG_ERROR, "Invalid argument '%s'.\n", args);
         return AVERROR(EINVAL);
     }
+    w3fdif->filter = !!w3fdif->filter;
 
-    av_log(ctx, AV_LOG_INFO, "using %s filter\n",
-            w3fdif->filter ? "more complex" : "simple");
+    if ((ret = ff_filter_threads_init(&w3fdif->threads, threads)) < 0)
+        return ret;
+    w3fdif->nb_threads = ret;
+
+    av_log(ctx, AV_LOG_INFO, "using %s filter, %d threads\n",
+            w3fdif->filter ? "more complex" : "simple", w3fdif->nb_threads);
 
     return 0;
 }
@@ -429,30 +482,36 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     W3FDIFContext *w3fdif = ctx->priv;
+    int i;
 
     if (w3fdif->prev && (w3fdif->prev != w3fdif->crnt)) avfilter_unref_buffer(w3fdif->prev);
     if (w3fdif->next && (w3fdif->next != w3fdif->crnt)) avfilter_unref_buffer(w3fdif->next);
     if (w3fdif->crnt) avfilter_unref_buffer(w3fdif->crnt);
+
+    ff_filter_threads_free(&w3fdif->threads);
+    for (i = 0; i < FF_ARRAY_ELEMS(w3fdif->work_line); i++)
+        av_freep(&w3fdif->work_line[i]);
 }
 
 static int query_formats(AVFilterContext *ctx)
 {
     static const enum PixelFormat pix_fmts[] = {
-//        PIX_FMT_YUV420P,
+        PIX_FMT_YUV420P,
         PIX_FMT_YUV422P,
-//        PIX_FMT_YUV444P,
-//        PIX_FMT_YUV410P,
-//        PIX_FMT_YUV411P,
-//        PIX_FMT_GRAY8,
-//        PIX_FMT_YUVJ420P,
-//        PIX_FMT_YUVJ422P,
-//        PIX_FMT_YUVJ444P,
-//        AV_NE( PIX_FMT_GRAY16BE, PIX_FMT_GRAY16LE ),
-//        PIX_FMT_YUV440P,
-//        PIX_FMT_YUVJ440P,
-//        AV_NE( PIX_FMT_YUV420P16BE, PIX_FMT_YUV420P16LE ),
-//        AV_NE( PIX_FMT_YUV422P16BE, PIX_FMT_YUV422P16LE ),
-//        AV_NE( PIX_FMT_YUV444P16BE, PIX_FMT_YUV444P16LE ),
+        PIX_FMT_YUV444P,
+        PIX_FMT_YUV410P,
+        PIX_FMT_YUV411P,
+        PIX_FMT_GRAY8,
+        PIX_FMT_YUVJ420P,
+        PIX_FMT_YUVJ422P,
+        PIX_FMT_YUVJ444P,
+        PIX_FMT_YUV440P,
+        PIX_FMT_YUVJ440P,
+        AV_NE( PIX_FMT_YUV420P9BE,  PIX_FMT_YUV420P9LE  ),
+        AV_NE( PIX_FMT_YUV444P9BE,  PIX_FMT_YUV444P9LE  ),
+        AV_NE( PIX_FMT_YUV420P10BE, PIX_FMT_YUV420P10LE ),
+        AV_NE( PIX_FMT_YUV422P10BE, PIX_FMT_YUV422P10LE ),
+        AV_NE( PIX_FMT_YUV444P10BE, PIX_FMT_YUV444P10LE ),
         PIX_FMT_NONE
     };
 
@@ -483,3 +542,111 @@ AVFilter avfilter_vf_w3fdif = {
                                             .request_frame  = request_frame, },
                                            {.name = NULL}},
 };
+
+#ifdef TEST
+#undef printf
+#undef fprintf
+#include <stdio.h>
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+
+#define W 67
+#define GUARD 16
+
+/* run the C and SIMD filters on lines of w samples, checking that the work
+ * lines and outputs match and that nothing is written past w */
+static int check(const W3FDIFDSPContext *c, const W3FDIFDSPContext *simd,
+                 int depth, int w, AVLFG *lfg)
+{
+    int bps = depth > 8 ? 2 : 1;
+    int max = (1 << depth) - 1;
+    uint8_t *in_lines_cur[5] = { NULL }, *in_lines_adj[5] = { NULL }, *out[2] = { NULL };
+    int32_t *work[2] = { NULL };
+    int i, x, filter, ret = 1;
+
+    for (i = 0; i < 5; i++) {
+        in_lines_cur[i] = av_malloc(w * bps);
+        in_lines_adj[i] = av_malloc(w * bps);
+        if (!in_lines_cur[i] || !in_lines_adj[i])
+            goto end;
+        for (x = 0; x < w; x++) {
+            /* mix noise with extreme values to exercise the clipping */
+            int v = av_lfg_get(lfg);
+            v = v & 0x10000 ? (v >> 4) & max : v & 0x20000 ? max : 0;
+            if (bps == 1) in_lines_cur[i][x] = v;
+            else          ((uint16_t *)in_lines_cur[i])[x] = v;
+            v = av_lfg_get(lfg) & max;
+            if (bps == 1) in_lines_adj[i][x] = v;
+            else          ((uint16_t *)in_lines_adj[i])[x] = v;
+        }
+    }
+    for (i = 0; i < 2; i++) {
+        work[i] = av_malloc((w + GUARD) * sizeof(int32_t));
+        out[i]  = av_malloc(w * bps + GUARD);
+        if (!work[i] || !out[i])
+            goto end;
+    }
+
+    for (filter = 0; filter < 2; filter++) {
+        for (i = 0; i < 2; i++) {
+            const W3FDIFDSPContext *dsp = i ? simd : c;
+            memset(work[i], 0x55, (w + GUARD) * sizeof(int32_t));
+            memset(out[i], 0xAA, w * bps + GUARD);
+            if (filter) {
+                dsp->filter_complex_low(work[i], in_lines_cur, coef_lf[1], w);
+                dsp->filter_complex_high(work[i], in_lines_cur, in_lines_adj, coef_hf[1], w);
+            } else {
+                dsp->filter_simple_low(work[i], in_lines_cur, coef_lf[0], w);
+                dsp->filter_simple_high(work[i], in_lines_cur, in_lines_adj, coef_hf[0], w);
+            }
+            dsp->filter_scale(out[i], work[i], w, max);
+        }
+        if (memcmp(work[0], work[1], (w + GUARD) * sizeof(int32_t)) ||
+            memcmp(out[0], out[1], w * bps + GUARD)) {
+            fprintf(stderr, "%d bits: mismatch with the %s filter, width %d\n",
+                    depth, filter ? "complex" : "simple", w);
+            goto end;
+        }
+        for (x = w * bps; x < w * bps + GUARD; x++)
+            if (out[1][x] != 0xAA) {
+                fprintf(stderr, "%d bits: write past width %d\n", depth, w);
+                goto end;
+            }
+    }
+    ret = 0;
+end:
+    for (i = 0; i < 5; i++) {
+        av_free(in_lines_cur[i]);
+        av_free(in_lines_adj[i]);
+    }
+    for (i = 0; i < 2; i++) {
+        av_free(work[i]);
+        av_free(out[i]);
+    }
+    return ret;
+}
+
+int main(void)
+{
+    static const int depths[] = { 8, 10 };
+    int cpu_flags = av_get_cpu_flags();
+    W3FDIFDSPContext c, simd;
+    int i, w, ret = 0;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 1);
+    for (i = 0; i < FF_ARRAY_ELEMS(depths); i++) {
+        int err = 0;
+
+        av_force_cpu_flags(0);
+        ff_w3fdif_init(&c, depths[i]);
+        av_force_cpu_flags(cpu_flags);
+        ff_w3fdif_init(&simd, depths[i]);
+        for (w = 1; w <= W && !err; w++)
+            err = check(&c, &simd, depths[i], w, &lfg);
+        printf("%d bits: %s\n", depths[i], err ? "failed" : "ok");
+        ret |= err;
+    }
+    return ret;
+}
+#endif /* TEST */
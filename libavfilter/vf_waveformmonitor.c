@@ -18,34 +18,101 @@
 
 /**
  * @file
- * video waveform monitor filter
+ * video waveform monitor and vectorscope filter
  */
 
 /* #define DEBUG */
 
 #include "libavutil/colorspace.h"
+#include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/parseutils.h"
 #include "avfilter.h"
+#include "thread.h"
+
+enum WFMMode {
+    WFM_MODE_NONE,          ///< pass the input through, statistics only
+    WFM_MODE_LUMA,          ///< luma waveform
+    WFM_MODE_PARADE,        ///< Y, Cb and Cr waveforms side by side
+    WFM_MODE_VECTORSCOPE,   ///< Cb horizontally, Cr vertically
+};
+
+/** legal ranges of the statistics */
+#define LUMA_MIN   16
+#define LUMA_MAX   235
+#define CHROMA_MIN 16
+#define CHROMA_MAX 240
 
 typedef struct {
+    const AVClass *class;
+    int mode;
+    int stats;              ///< log the value statistics of each frame
+    int threads_opt;        ///< number of threads, 0 for one per CPU
+
     int w, h;
+    int in_w, in_h;         ///< input width and height
+    int in_hsub, in_vsub;   ///< input chroma subsampling values
     int hsub, vsub;         ///< chroma subsampling values
     uint8_t rgba_color[4];
     uint8_t yuva_color[4];
-    uint16_t *luma_data;    ///< pointer to array of pic-width * 256 to store incoming luma value buckets
     int brightness;         ///< brightness, contrast and gama for waveform display
     float gain, gamma;
     uint8_t *y_lut;         ///< transform to make waveform monitor brightness look right
     uint8_t *a_lut;         ///< transform for alpha
+    int lut_max;            ///< last entry of the luts
+
+    AVFilterThreads *threads;
+    int nb_threads;
+    int nb_jobs;            ///< number of bands the input frame is accumulated in
+    uint32_t *hist[MAX_FILTER_THREADS];             ///< partial w * h display buckets of each band
+    uint32_t values[MAX_FILTER_THREADS][3][256];    ///< partial value histograms of each band and plane
+    unsigned frame;
 } WFMContext;
 
+#define OFFSET(x) offsetof(WFMContext, x)
+
+static const AVOption wfm_options[] = {
+    {"mode",        "display mode",                         OFFSET(mode),        FF_OPT_TYPE_INT, {.dbl=WFM_MODE_LUMA},        0, WFM_MODE_VECTORSCOPE, 0, "mode" },
+    {"none",        "no display, statistics only",          0,                   FF_OPT_TYPE_CONST, {.dbl=WFM_MODE_NONE},      0, 0, 0, "mode" },
+    {"luma",        "luma waveform",                        0,                   FF_OPT_TYPE_CONST, {.dbl=WFM_MODE_LUMA},      0, 0, 0, "mode" },
+    {"parade",      "Y, Cb and Cr waveforms",               0,                   FF_OPT_TYPE_CONST, {.dbl=WFM_MODE_PARADE},    0, 0, 0, "mode" },
+    {"vectorscope", "Cb and Cr vectorscope",                0,                   FF_OPT_TYPE_CONST, {.dbl=WFM_MODE_VECTORSCOPE}, 0, 0, 0, "mode" },
+    {"stats",       "log the statistics of each frame",     OFFSET(stats),       FF_OPT_TYPE_INT, {.dbl=0},                    0, 1, 0 },
+    {"threads",     "number of threads, 0 for one per CPU", OFFSET(threads_opt), FF_OPT_TYPE_INT, {.dbl=1},                    0, MAX_FILTER_THREADS, 0 },
+    {NULL}
+};
+
+static const char *wfm_get_name(void *ctx)
+{
+    return "wfm";
+}
+
+static const AVClass wfm_class = {
+    "WFMContext",
+    wfm_get_name,
+    wfm_options
+};
+
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     WFMContext *wfm = ctx->priv;
 
     int ret;
 
+    wfm->class = &wfm_class;
+    av_opt_set_defaults2(wfm, 0, 0);
+
+    if (args && (ret = av_set_options_string(wfm, args, "=", ":")) < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Error parsing options string: '%s'\n", args);
+        return ret;
+    }
+    if (wfm->mode == WFM_MODE_NONE)
+        wfm->stats = 1;
+
+    if ((ret = ff_filter_threads_init(&wfm->threads, wfm->threads_opt)) < 0)
+        return ret;
+    wfm->nb_threads = ret;
+
     //TODO: make brightness, gain and gamma parameters
     wfm->brightness = 40;
     wfm->gain       = 4.0;
@@ -66,14 +133,18 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     WFMContext *wfm = ctx->priv;
+    int i;
 
-    av_freep(&wfm->luma_data);
+    for (i = 0; i < MAX_FILTER_THREADS; i++)
+        av_freep(&wfm->hist[i]);
     av_freep(&wfm->y_lut);
     av_freep(&wfm->a_lut);
+    ff_filter_threads_free(&wfm->threads);
 }
 
 static int query_formats(AVFilterContext *ctx)
 {
+    WFMContext *wfm = ctx->priv;
     const enum PixelFormat in_pix_fmts[] = {
             PIX_FMT_YUV422P,
             PIX_FMT_YUV444P,
@@ -83,7 +154,9 @@ static int query_formats(AVFilterContext *ctx)
             PIX_FMT_YUVA420P,
             PIX_FMT_NONE };
 
-    if (ctx->inputs[0]) {
+    if (wfm->mode == WFM_MODE_NONE) {
+        avfilter_set_common_pixel_formats(ctx, avfilter_make_format_list(in_pix_fmts));
+    } else if (ctx->inputs[0]) {
         AVFilterFormats *in_formats = avfilter_make_format_list(in_pix_fmts);
         AVFilterFormats *out_formats = avfilter_make_format_list(out_pix_fmts);
 
@@ -94,24 +167,58 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static int config_input_luma(AVFilterLink *inlink)
+static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
     WFMContext *wfm = ctx->priv;
+    const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[inlink->format];
+
+    int h, i;
+
+    wfm->in_w    = inlink->w;
+    wfm->in_h    = inlink->h;
+    wfm->in_hsub = pix_desc->log2_chroma_w;
+    wfm->in_vsub = pix_desc->log2_chroma_h;
+
+    switch (wfm->mode) {
+    case WFM_MODE_NONE:
+        wfm->w = inlink->w;
+        wfm->h = inlink->h;
+        break;
+    case WFM_MODE_LUMA:
+        wfm->w = inlink->w;
+        wfm->h = 256;
+        break;
+    case WFM_MODE_PARADE:
+        wfm->w = inlink->w + 2 * -((-inlink->w) >> wfm->in_hsub);
+        wfm->h = 256;
+        break;
+    case WFM_MODE_VECTORSCOPE:
+        wfm->w = 256;
+        wfm->h = 256;
+        break;
+    }
 
-    int h;
+    wfm->nb_jobs = FFMIN(-((-inlink->h) >> wfm->in_vsub), wfm->nb_threads);
 
-    av_log(ctx, AV_LOG_INFO, "config_input_luma\n");
+    for (i = 0; i < MAX_FILTER_THREADS; i++)
+        av_freep(&wfm->hist[i]);
+    av_freep(&wfm->y_lut);
+    av_freep(&wfm->a_lut);
 
-    wfm->w = inlink->w;
-    wfm->h = 256;
+    if (wfm->mode == WFM_MODE_NONE)
+        return 0;
 
-    if (!(wfm->luma_data = av_malloc(wfm->w * wfm->h * sizeof(wfm->luma_data))) ||
-        !(wfm->y_lut = av_malloc((1 + inlink->h) * sizeof(wfm->y_lut))) ||
-        !(wfm->a_lut = av_malloc((1 + inlink->h) * sizeof(wfm->a_lut)))) {
-        uninit(ctx);
+    for (i = 0; i < wfm->nb_jobs; i++)
+        if (!(wfm->hist[i] = av_mallocz(wfm->w * wfm->h * sizeof(*wfm->hist[i]))))
+            return AVERROR(ENOMEM);
+
+    /* a waveform column takes at most one sample of each line, the
+     * vectorscope counts are clipped to the same range */
+    wfm->lut_max = inlink->h;
+    if (!(wfm->y_lut = av_malloc((1 + wfm->lut_max) * sizeof(*wfm->y_lut))) ||
+        !(wfm->a_lut = av_malloc((1 + wfm->lut_max) * sizeof(*wfm->a_lut))))
         return AVERROR(ENOMEM);
-    }
 
     /* calculate 8 bit luminance LUT emulating a waveform monitor display
      * within CCIR-601 space
@@ -126,12 +233,11 @@ static int config_input_luma(AVFilterLink *inlink)
     }
     /* calculate an 8 bit alpha LUT for keying the above luminance */
     wfm->a_lut[0] = wfm->yuva_color[3];
-    for (h = 0; h <= inlink->h; h++) {
+    for (h = 0; h < inlink->h; h++) {
         wfm->a_lut[h+1] = FFMIN(255,
                 wfm->yuva_color[3] + wfm->brightness +
                 pow(wfm->gain*h,1/wfm->gamma) / pow(inlink->h, 1/wfm->gamma) *
                 (255 - wfm->yuva_color[3] - wfm->brightness));
-//        av_log(ctx, AV_LOG_DEBUG, "%d\tA = %d\tY = %d\n",h,wfm->a_lut[h],wfm->y_lut[h]);
     }
 
     return 0;
@@ -144,8 +250,6 @@ static int config_output(AVFilterLink *outlink)
 
     const AVPixFmtDescriptor *pix_desc = &av_pix_fmt_descriptors[outlink->format];
 
-    av_log(ctx, AV_LOG_INFO, "config_output\n");
-
     outlink->w = wfm->w;
     outlink->h = wfm->h;
 
@@ -155,75 +259,229 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
-static void start_frame_luma(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
+static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
 {
     AVFilterContext *ctx = inlink->dst;
     WFMContext *wfm = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
 
+    if (wfm->mode == WFM_MODE_NONE) {
+        avfilter_start_frame(outlink, avfilter_ref_buffer(inpicref, ~0));
+        return;
+    }
+
     outlink->out_buf = avfilter_get_video_buffer(
             outlink,
             AV_PERM_WRITE,
             FFALIGN(wfm->w,32),
             FFALIGN(wfm->h,32));
     avfilter_copy_buffer_ref_props(outlink->out_buf, inpicref);
+    outlink->out_buf->video->w = wfm->w;
+    outlink->out_buf->video->h = wfm->h;
     outlink->out_buf->video->sample_aspect_ratio = (AVRational){1,1};
 
-    /** clear waveform monitor cache data */
-    memset(wfm->luma_data, 0, wfm->w * wfm->h * sizeof(wfm->luma_data));
+    avfilter_start_frame(outlink, avfilter_ref_buffer(outlink->out_buf, ~0));
+}
+
+static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
+{
+    WFMContext *wfm = inlink->dst->priv;
 
-    avfilter_start_frame(outlink, outlink->out_buf);
+    if (wfm->mode == WFM_MODE_NONE)
+        avfilter_draw_slice(inlink->dst->outputs[0], y, h, slice_dir);
+    // otherwise do not call next avfilter_draw_slice() because the outpic
+    //  is not created until end_frame()
 }
 
-static void draw_slice_luma(AVFilterLink *inlink, int y, int h, int slice_dir)
+/**
+ * Count the values of a line in 4 interleaved histograms, so that
+ * consecutive equal samples do not wait for each other's increments.
+ */
+static void count_values(uint32_t hist[4][256], const uint8_t *p, int w)
+{
+    int x;
+
+    for (x = 0; x < (w & ~3); x += 4) {
+        hist[0][p[x    ]]++;
+        hist[1][p[x + 1]]++;
+        hist[2][p[x + 2]]++;
+        hist[3][p[x + 3]]++;
+    }
+    for (; x < w; x++)
+        hist[0][p[x]]++;
+}
+
+/**
+ * Accumulate a band of lines of each plane in the partial buckets and
+ * value histograms of the band, they are merged when rendering.
+ */
+static int accumulate(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFilterContext *ctx = inlink->dst;
     WFMContext *wfm = ctx->priv;
+    AVFilterBufferRef *in = arg;
+    uint32_t *hist = wfm->hist[jobnr];
+    const int out_w = wfm->w;
+    int plane, x, y;
+
+    for (plane = 0; plane < 3; plane++) {
+        const int w = plane ? -((-wfm->in_w) >> wfm->in_hsub) : wfm->in_w;
+        const int h = plane ? -((-wfm->in_h) >> wfm->in_vsub) : wfm->in_h;
+        const int start = h *  jobnr      / nb_jobs;
+        const int end   = h * (jobnr + 1) / nb_jobs;
+        const int offset = plane ? wfm->in_w + (plane - 1) * w : 0;
+        const uint8_t *p = in->data[plane] + start * in->linesize[plane];
+
+        if (wfm->stats) {
+            uint32_t values[4][256] = {{ 0 }};
+            for (y = start; y < end; y++)
+                count_values(values, p + (y - start) * in->linesize[plane], w);
+            for (x = 0; x < 256; x++)
+                wfm->values[jobnr][plane][x] = values[0][x] + values[1][x] +
+                                               values[2][x] + values[3][x];
+        }
 
-    AVFilterBufferRef *inpicref = inlink->cur_buf;
+        if (wfm->mode == WFM_MODE_PARADE || (wfm->mode == WFM_MODE_LUMA && !plane)) {
+            // value v of column x goes to display line 255 - v
+            uint32_t *col = hist + 255 * out_w + offset;
+            for (y = start; y < end; y++, p += in->linesize[plane])
+                for (x = 0; x < w; x++)
+                    col[x - p[x] * out_w]++;
+        }
+    }
+
+    if (wfm->mode == WFM_MODE_VECTORSCOPE) {
+        const int w = -((-wfm->in_w) >> wfm->in_hsub);
+        const int h = -((-wfm->in_h) >> wfm->in_vsub);
+        const int start = h *  jobnr      / nb_jobs;
+        const int end   = h * (jobnr + 1) / nb_jobs;
+        const uint8_t *u = in->data[1] + start * in->linesize[1];
+        const uint8_t *v = in->data[2] + start * in->linesize[2];
+
+        for (y = start; y < end; y++, u += in->linesize[1], v += in->linesize[2])
+            for (x = 0; x < w; x++)
+                hist[(255 - v[x]) * 256 + u[x]]++;
+    }
+    return 0;
+}
 
-    int dy, dx;     ///< delta x and y within the input slice
-    uint8_t *p;     ///< pointer to picture data
+/**
+ * Merge the partial buckets of a band of display lines, render them and
+ * clear the buckets for the next frame.
+ */
+static int render(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    WFMContext *wfm = ctx->priv;
+    AVFilterBufferRef *out = arg;
+    const int start = wfm->h *  jobnr      / nb_jobs;
+    const int end   = wfm->h * (jobnr + 1) / nb_jobs;
+    int i, x, y;
+
+    for (y = start; y < end; y++) {
+        uint32_t *sum = wfm->hist[0] + y * wfm->w;
+        uint8_t *dsty = out->data[0] + y * out->linesize[0];
+        uint8_t *dsta = out->data[3] + y * out->linesize[3];
+
+        for (i = 1; i < wfm->nb_jobs; i++) {
+            uint32_t *part = wfm->hist[i] + y * wfm->w;
+            for (x = 0; x < wfm->w; x++)
+                sum[x] += part[x];
+            memset(part, 0, wfm->w * sizeof(*part));
+        }
+        for (x = 0; x < wfm->w; x++) {
+            int count = FFMIN(sum[x], wfm->lut_max);
+            dsty[x] = wfm->y_lut[count];
+            dsta[x] = wfm->a_lut[count];
+        }
+        memset(sum, 0, wfm->w * sizeof(*sum));
+    }
+    return 0;
+}
 
-    for (dy = 0; dy < h; dy++) {
-        p = inpicref->data[0] + (y+dy) * inpicref->linesize[0];
-        for (dx = 0; dx < inpicref->video->w && dx < wfm->w; dx++) {
-            wfm->luma_data[dx + *p * wfm->w]++;
-            p++;
+static void log_stats(AVFilterContext *ctx, AVFilterBufferRef *picref)
+{
+    static const int legal[3][2] = {
+        { LUMA_MIN,   LUMA_MAX   },
+        { CHROMA_MIN, CHROMA_MAX },
+        { CHROMA_MIN, CHROMA_MAX },
+    };
+    WFMContext *wfm = ctx->priv;
+    int min[3], max[3];
+    double avg[3], low[3], high[3];
+    int plane, i, v;
+
+    for (plane = 0; plane < 3; plane++) {
+        int64_t count = 0, sum = 0, nb_low = 0, nb_high = 0;
+
+        min[plane] = 255;
+        max[plane] = 0;
+        for (v = 0; v < 256; v++) {
+            uint32_t n = 0;
+            for (i = 0; i < wfm->nb_jobs; i++)
+                n += wfm->values[i][plane][v];
+            if (!n)
+                continue;
+            min[plane] = FFMIN(min[plane], v);
+            max[plane] = v;
+            count += n;
+            sum   += (int64_t)n * v;
+            if (v < legal[plane][0])
+                nb_low  += n;
+            if (v > legal[plane][1])
+                nb_high += n;
         }
+        count = FFMAX(count, 1);
+        avg [plane] = (double)sum / count;
+        low [plane] = 100.0 * nb_low  / count;
+        high[plane] = 100.0 * nb_high / count;
     }
-    // do not call next avfilter_draw_slice() because the outpic
-    //  is not created until end_frame()
+
+    av_log(ctx, AV_LOG_INFO, "frame:%u pts:%"PRId64" t:%f "
+           "y:%d-%d avg:%.1f low:%.3f%% high:%.3f%% "
+           "u:%d-%d avg:%.1f low:%.3f%% high:%.3f%% "
+           "v:%d-%d avg:%.1f low:%.3f%% high:%.3f%%\n",
+           wfm->frame, picref->pts,
+           picref->pts == AV_NOPTS_VALUE ? -1 : picref->pts * av_q2d(ctx->inputs[0]->time_base),
+           min[0], max[0], avg[0], low[0], high[0],
+           min[1], max[1], avg[1], low[1], high[1],
+           min[2], max[2], avg[2], low[2], high[2]);
 }
 
-static void end_frame_luma(AVFilterLink *inlink)
+static void end_frame(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
     WFMContext *wfm = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
-
+    AVFilterBufferRef *inpicref = inlink->cur_buf;
     AVFilterBufferRef *outpicref = outlink->out_buf;
 
-    int dy, dx;     ///< delta x and y within the input slice
-    uint8_t *y, *a; ///< pointer to picture data and alpha data
+    ff_filter_execute(wfm->threads, ctx, accumulate, inpicref, NULL, wfm->nb_jobs);
+    if (wfm->stats)
+        log_stats(ctx, inpicref);
+    wfm->frame++;
 
-    for (dy = 0; dy < wfm->h; dy++) {
-        y = outpicref->data[0] + (wfm->h - dy - 1) * outpicref->linesize[0];
-        a = outpicref->data[3] + (wfm->h - dy - 1) * outpicref->linesize[0];
-        for (dx = 0; dx < wfm->w; dx++) {
-            *y++ = wfm->y_lut[wfm->luma_data[dx + dy * wfm->w]];
-            *a++ = wfm->a_lut[wfm->luma_data[dx + dy * wfm->w]];
-        }
-    }
+    if (wfm->mode != WFM_MODE_NONE) {
+        int plane, y;
+
+        ff_filter_execute(wfm->threads, ctx, render, outpicref, NULL,
+                          FFMIN(wfm->h, wfm->nb_threads));
+        for (plane = 1; plane < 3; plane++)
+            for (y = 0; y < -((-wfm->h) >> wfm->vsub); y++)
+                memset(outpicref->data[plane] + y * outpicref->linesize[plane],
+                       wfm->yuva_color[plane], -((-wfm->w) >> wfm->hsub));
 
-    avfilter_draw_slice(outlink, 0, wfm->h, 1);
+        avfilter_draw_slice(outlink, 0, wfm->h, 1);
+    }
     avfilter_end_frame(outlink);
-    avfilter_unref_buffer(inlink->cur_buf);
+    avfilter_unref_buffer(inpicref);
+    if (outlink->out_buf) {
+        avfilter_unref_buffer(outlink->out_buf);
+        outlink->out_buf = NULL;
+    }
 }
 
 AVFilter avfilter_vf_wfm_luma = {
     .name          = "wfm_luma",
-    .description   = NULL_IF_CONFIG_SMALL("Luma waveform monitor."),
+    .description   = NULL_IF_CONFIG_SMALL("Waveform monitor and vectorscope."),
     .priv_size     = sizeof(WFMContext),
     .init          = init,
     .uninit        = uninit,
@@ -231,11 +489,10 @@ AVFilter avfilter_vf_wfm_luma = {
     .inputs        = (const AVFilterPad[]) {{
                                             .name             = "default",
                                             .type             = AVMEDIA_TYPE_VIDEO,
-                                            .config_props     = config_input_luma,
-                                            .get_video_buffer = avfilter_null_get_video_buffer,
-                                            .start_frame      = start_frame_luma,
-                                            .draw_slice       = draw_slice_luma,
-                                            .end_frame        = end_frame_luma,
+                                            .config_props     = config_input,
+                                            .start_frame      = start_frame,
+                                            .draw_slice       = draw_slice,
+                                            .end_frame        = end_frame,
                                             .min_perms        = AV_PERM_READ,
                                             .rej_perms        = AV_PERM_REUSE2|AV_PERM_PRESERVE,},
                                             {.name = NULL}},
@@ -151,7 +151,7 @@ static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
         int w = dstpic->video->w;
         int h = dstpic->video->h;
         int refs = c->linesize[i];
-        int df = (yadif->csp->comp[i].depth_minus1+1) / 8;
+        int df = (yadif->csp->comp[i].depth_minus1 + 8) / 8;
 
         if (i) {
         /* Why is this not part of the per-plane description thing? */
@@ -213,10 +213,25 @@ static void return_frame(AVFilterContext *ctx, int is_second)
         yadif->out = avfilter_get_video_buffer(link, AV_PERM_WRITE,
                                                link->w, link->h);
 
-    if (!yadif->csp)
+    if (!yadif->csp) {
+        av_unused int cpu_flags = av_get_cpu_flags();
+        int depth;
+
         yadif->csp = &av_pix_fmt_descriptors[link->format];
-    if (yadif->csp->comp[0].depth_minus1 == 15)
-        yadif->filter_line = filter_line_c_16bit;
+        depth = yadif->csp->comp[0].depth_minus1 + 1;
+        if (depth > 8) {
+            yadif->filter_line = (void*)filter_line_c_16bit;
+            /* the SIMD versions compute in signed words */
+            if (depth <= 12) {
+                if (HAVE_AVX2 && HAVE_SSSE3 && cpu_flags & AV_CPU_FLAG_AVX2)
+                    yadif->filter_line = (void*)ff_yadif_filter_line_10bit_avx2;
+                else if (HAVE_SSSE3 && cpu_flags & AV_CPU_FLAG_SSSE3)
+                    yadif->filter_line = (void*)ff_yadif_filter_line_10bit_ssse3;
+                else if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+                    yadif->filter_line = (void*)ff_yadif_filter_line_10bit_sse2;
+            }
+        }
+    }
 
     filter(ctx, yadif->out, tff ^ !is_second, tff);
 
@@ -371,6 +386,11 @@ static int query_formats(AVFilterContext *ctx)
         AV_NE( PIX_FMT_YUV420P16BE, PIX_FMT_YUV420P16LE ),
         AV_NE( PIX_FMT_YUV422P16BE, PIX_FMT_YUV422P16LE ),
         AV_NE( PIX_FMT_YUV444P16BE, PIX_FMT_YUV444P16LE ),
+        AV_NE( PIX_FMT_YUV420P9BE,  PIX_FMT_YUV420P9LE  ),
+        AV_NE( PIX_FMT_YUV444P9BE,  PIX_FMT_YUV444P9LE  ),
+        AV_NE( PIX_FMT_YUV420P10BE, PIX_FMT_YUV420P10LE ),
+        AV_NE( PIX_FMT_YUV422P10BE, PIX_FMT_YUV422P10LE ),
+        AV_NE( PIX_FMT_YUV444P10BE, PIX_FMT_YUV444P10LE ),
         PIX_FMT_NONE
     };
 
@@ -429,3 +449,95 @@ AVFilter avfilter_vf_yadif = {
                                     .request_frame    = request_frame, },
                                   { .name = NULL}},
 };
+
+#ifdef TEST
+#undef printf
+#undef fprintf
+#include <stdio.h>
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+
+#define W 67
+#define H 16
+#define STRIDE 192
+
+typedef void (*filter_line_16bit_func)(uint16_t *dst,
+                                       uint16_t *prev, uint16_t *cur, uint16_t *next,
+                                       int w, int prefs, int mrefs, int parity, int mode);
+
+static int check(const char *name, filter_line_16bit_func func, int bits, AVLFG *lfg)
+{
+    /* 2 rows and 16 samples of padding around each plane */
+    DECLARE_ALIGNED(16, uint16_t, src)[3][(H + 4) * STRIDE];
+    DECLARE_ALIGNED(16, uint16_t, dst)[2][(H + 4) * STRIDE];
+    int refs = STRIDE * 2;
+    int i, x, y, w, parity, mode;
+
+    for (w = 1; w <= W; w += 11) {
+        for (i = 0; i < 3; i++) {
+            for (x = 0; x < (H + 4) * STRIDE; x++) {
+                /* mix noise with flat areas and sharp edges */
+                int v = av_lfg_get(lfg);
+                src[i][x] = v & 0x10000 ? (v >> 4) & ((1 << bits) - 1)
+                                        : v & 0x20000 ? (1 << bits) - 1 : 0;
+            }
+        }
+        for (parity = 0; parity < 2; parity++) {
+            for (mode = 0; mode < 4; mode++) {
+                memset(dst, 0, sizeof(dst));
+                for (y = parity ^ 1; y < H; y += 2) {
+                    int off   = (y + 2) * STRIDE + 16;
+                    int m     = y == 1 || y + 2 == H ? 2 : mode;
+                    int prefs = y + 1 < H ? refs : -refs;
+                    int mrefs = y ? -refs : refs;
+
+                    filter_line_c_16bit(dst[0] + off, src[0] + off, src[1] + off,
+                                        src[2] + off, w, prefs, mrefs, parity, m);
+                    func(dst[1] + off, src[0] + off, src[1] + off,
+                         src[2] + off, w, prefs, mrefs, parity, m);
+                    for (x = 0; x < w; x++) {
+                        if (dst[0][off + x] != dst[1][off + x]) {
+                            fprintf(stderr, "%s %d bits: mismatch at %dx%d, w %d parity %d mode %d\n",
+                                    name, bits, x, y, w, parity, mode);
+                            return 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        filter_line_16bit_func func;
+        int cpu_flag;
+    } funcs[] = {
+#if HAVE_SSE
+        { "sse2",  ff_yadif_filter_line_10bit_sse2,  AV_CPU_FLAG_SSE2  },
+#endif
+#if HAVE_SSSE3
+        { "ssse3", ff_yadif_filter_line_10bit_ssse3, AV_CPU_FLAG_SSSE3 },
+#endif
+#if HAVE_AVX2 && HAVE_SSSE3
+        { "avx2",  ff_yadif_filter_line_10bit_avx2,  AV_CPU_FLAG_AVX2  },
+#endif
+        { NULL }
+    };
+    int cpu_flags = av_get_cpu_flags();
+    int i, bits, ret = 0;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 1);
+    for (bits = 9; bits <= 12; bits++) {
+        for (i = 0; funcs[i].name; i++)
+            if (cpu_flags & funcs[i].cpu_flag)
+                ret |= check(funcs[i].name, funcs[i].func, bits, &lfg);
+        printf("%d bits: %s\n", bits, ret ? "failed" : "ok");
+    }
+    return ret;
+}
+#endif /* TEST */
@@ -0,0 +1,110 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef AVFILTER_W3FDIF_H
+#define AVFILTER_W3FDIF_H
+
+#include <stdint.h>
+#include "libavutil/common.h"
+
+/**
+ * Line filters of the w3fdif deinterlacer.
+ * Lines are arrays of 8-bit or native endian 16-bit samples depending on
+ * the depth the context was initialized for, linesize is in samples.
+ * Coefficients are scaled by 128*256, so the interpolated samples are the
+ * work line values shifted right by 15.
+ */
+typedef struct W3FDIFDSPContext {
+    /** set the work line to the low frequencies of the current field */
+    void (*filter_simple_low)(int32_t *work_line, uint8_t *in_lines_cur[2],
+                              const int16_t *coef, int linesize);
+    void (*filter_complex_low)(int32_t *work_line, uint8_t *in_lines_cur[4],
+                               const int16_t *coef, int linesize);
+    /** add the high frequencies of the current and adjacent fields */
+    void (*filter_simple_high)(int32_t *work_line, uint8_t *in_lines_cur[3],
+                               uint8_t *in_lines_adj[3], const int16_t *coef,
+                               int linesize);
+    void (*filter_complex_high)(int32_t *work_line, uint8_t *in_lines_cur[5],
+                                uint8_t *in_lines_adj[5], const int16_t *coef,
+                                int linesize);
+    /** scale the work line down and clip it to 0..max */
+    void (*filter_scale)(uint8_t *out_pixel, const int32_t *work_pixel,
+                         int linesize, int max);
+} W3FDIFDSPContext;
+
+/*
+ * C versions of the line filters on samples start to end - 1, with 8-bit
+ * samples if bits is 8 and 16-bit ones if it is 16, used by the C functions
+ * and for the last samples of the SIMD ones.
+ */
+static av_always_inline int w3fdif_sample(const uint8_t *line, int i, int bits)
+{
+    return bits == 8 ? line[i] : ((const uint16_t *)line)[i];
+}
+
+static av_always_inline void w3fdif_filter_low(int32_t *work_line,
+                                               uint8_t **in_lines_cur,
+                                               const int16_t *coef, int n_coef,
+                                               int start, int end, int bits)
+{
+    int i, j;
+
+    for (i = start; i < end; i++) {
+        int32_t sum = 0;
+        for (j = 0; j < n_coef; j++)
+            sum += w3fdif_sample(in_lines_cur[j], i, bits) * coef[j];
+        work_line[i] = sum;
+    }
+}
+
+static av_always_inline void w3fdif_filter_high(int32_t *work_line,
+                                                uint8_t **in_lines_cur,
+                                                uint8_t **in_lines_adj,
+                                                const int16_t *coef, int n_coef,
+                                                int start, int end, int bits)
+{
+    int i, j;
+
+    for (i = start; i < end; i++) {
+        int32_t sum = 0;
+        for (j = 0; j < n_coef; j++)
+            sum += (w3fdif_sample(in_lines_cur[j], i, bits) +
+                    w3fdif_sample(in_lines_adj[j], i, bits)) * coef[j];
+        work_line[i] += sum;
+    }
+}
+
+static av_always_inline void w3fdif_filter_scale(uint8_t *out_pixel,
+                                                 const int32_t *work_pixel,
+                                                 int start, int end, int max,
+                                                 int bits)
+{
+    int i;
+
+    for (i = start; i < end; i++) {
+        int v = av_clip(work_pixel[i] >> 15, 0, max);
+        if (bits == 8) out_pixel[i] = v;
+        else           ((uint16_t *)out_pixel)[i] = v;
+    }
+}
+
+/**
+ * @param depth bits per sample, 8 to 10
+ */
+void ff_w3fdif_init(W3FDIFDSPContext *dsp, int depth);
+void ff_w3fdif_init_x86(W3FDIFDSPContext *dsp, int depth);
+
+#endif /* AVFILTER_W3FDIF_H */
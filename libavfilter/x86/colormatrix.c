@@ -0,0 +1,470 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/x86/dsputil_mmx.h"
+#include "libavfilter/colormatrix.h"
+
+DECLARE_ASM_CONST(16, xmm_reg, pw_128)   = {0x0080008000800080ULL, 0x0080008000800080ULL};
+DECLARE_ASM_CONST(16, xmm_reg, pw_512)   = {0x0200020002000200ULL, 0x0200020002000200ULL};
+DECLARE_ASM_CONST(16, xmm_reg, pw_1023)  = {0x03FF03FF03FF03FFULL, 0x03FF03FF03FF03FFULL};
+DECLARE_ASM_CONST(16, xmm_reg, pd_32768) = {0x0000800000008000ULL, 0x0000800000008000ULL};
+
+static void convert_chroma_tail(int16_t *delta, uint8_t *dstu, uint8_t *dstv,
+                                const uint8_t *srcu, const uint8_t *srcv,
+                                const int16_t *c, int x, int w)
+{
+    for (; x < w; x++) {
+        const int u = srcu[x] - 128;
+        const int v = srcv[x] - 128;
+        delta[x] = (c[0] * u + c[1] * v + 32768) >> 16;
+        dstu[x]  = av_clip_uint8(srcu[x] + ((c[2] * u + c[3] * v + 32768) >> 16));
+        dstv[x]  = av_clip_uint8(srcv[x] + ((c[4] * u + c[5] * v + 32768) >> 16));
+    }
+}
+
+static void convert_chroma_10_tail(int16_t *delta, uint16_t *dstu, uint16_t *dstv,
+                                   const uint16_t *srcu, const uint16_t *srcv,
+                                   const int16_t *c, int x, int w)
+{
+    for (; x < w; x++) {
+        const int u = srcu[x] - 512;
+        const int v = srcv[x] - 512;
+        delta[x] = (c[0] * u + c[1] * v + 32768) >> 16;
+        dstu[x]  = av_clip_uintp2(srcu[x] + ((c[2] * u + c[3] * v + 32768) >> 16), 10);
+        dstv[x]  = av_clip_uintp2(srcv[x] + ((c[4] * u + c[5] * v + 32768) >> 16), 10);
+    }
+}
+
+static void add_delta_tail(uint8_t *dst, const uint8_t *src,
+                           const int16_t *delta, int x, int w)
+{
+    for (; x < w; x++)
+        dst[x] = av_clip_uint8(src[x] + delta[x >> 1]);
+}
+
+static void add_delta_10_tail(uint16_t *dst, const uint16_t *src,
+                              const int16_t *delta, int x, int w)
+{
+    for (; x < w; x++)
+        dst[x] = av_clip_uintp2(src[x] + delta[x >> 1], 10);
+}
+
+/* broadcast the (c2, c3), (c4', c5), (c6, c7') pairs for pmaddwd */
+static void splat_coeffs(int16_t k[3][8], const int16_t *c)
+{
+    int i, j;
+
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 8; j++)
+            k[i][j] = c[2 * i + (j & 1)];
+}
+
+/*
+ * The products are done with pmaddwd on interleaved (u, v) words, the 16.16
+ * coefficients minus the identity all fit signed words.
+ * 8 chroma samples per iteration.
+ */
+#if HAVE_7REGS
+static void convert_chroma_sse2(int16_t *delta, uint8_t *dstu, uint8_t *dstv,
+                                const uint8_t *srcu, const uint8_t *srcv,
+                                const int16_t *c, int w)
+{
+    DECLARE_ALIGNED(16, int16_t, k)[3][8];
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        splat_coeffs(k, c);
+        __asm__ volatile(
+            "pxor      %%xmm7, %%xmm7       \n\t"
+            "1:                             \n\t"
+            "movq      (%4,%0), %%xmm0      \n\t" /* u */
+            "movq      (%5,%0), %%xmm1      \n\t" /* v */
+            "punpcklbw %%xmm7, %%xmm0       \n\t"
+            "punpcklbw %%xmm7, %%xmm1       \n\t"
+            "movdqa    %%xmm0, %%xmm5       \n\t"
+            "movdqa    %%xmm1, %%xmm6       \n\t"
+            "psubw     %9, %%xmm0           \n\t"
+            "psubw     %9, %%xmm1           \n\t"
+            "movdqa    %%xmm0, %%xmm2       \n\t"
+            "punpcklwd %%xmm1, %%xmm0       \n\t" /* u, v */
+            "punpckhwd %%xmm1, %%xmm2       \n\t"
+
+#define DOT(coef, dst)                                \
+            "movdqa    %%xmm0, %%"#dst"     \n\t"     \
+            "movdqa    %%xmm2, %%xmm4       \n\t"     \
+            "pmaddwd   "coef", %%"#dst"     \n\t"     \
+            "pmaddwd   "coef", %%xmm4       \n\t"     \
+            "paddd     %10, %%"#dst"        \n\t"     \
+            "paddd     %10, %%xmm4          \n\t"     \
+            "psrad     $16, %%"#dst"        \n\t"     \
+            "psrad     $16, %%xmm4          \n\t"     \
+            "packssdw  %%xmm4, %%"#dst"     \n\t"
+
+            DOT("%6", xmm3)
+            "movdqu    %%xmm3, (%1,%0,2)    \n\t"
+            DOT("%7", xmm3)
+            "paddw     %%xmm5, %%xmm3       \n\t"
+            DOT("%8", xmm1)
+            "paddw     %%xmm6, %%xmm1       \n\t"
+            "packuswb  %%xmm3, %%xmm3       \n\t"
+            "packuswb  %%xmm1, %%xmm1       \n\t"
+            "movq      %%xmm3, (%2,%0)      \n\t"
+            "movq      %%xmm1, (%3,%0)      \n\t"
+            "add       $8, %0               \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(delta + (w & ~7)), "r"(dstu + (w & ~7)), "r"(dstv + (w & ~7)),
+              "r"(srcu + (w & ~7)), "r"(srcv + (w & ~7)),
+              "m"(k[0]), "m"(k[1]), "m"(k[2]), "m"(pw_128), "m"(pd_32768)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    convert_chroma_tail(delta, dstu, dstv, srcu, srcv, c, w & ~7, w);
+}
+
+static void convert_chroma_10_sse2(int16_t *delta, uint16_t *dstu, uint16_t *dstv,
+                                   const uint16_t *srcu, const uint16_t *srcv,
+                                   const int16_t *c, int w)
+{
+    DECLARE_ALIGNED(16, int16_t, k)[3][8];
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        splat_coeffs(k, c);
+        __asm__ volatile(
+            "1:                             \n\t"
+            "movdqu    (%4,%0,2), %%xmm5    \n\t" /* u */
+            "movdqu    (%5,%0,2), %%xmm6    \n\t" /* v */
+            "movdqa    %%xmm5, %%xmm0       \n\t"
+            "movdqa    %%xmm6, %%xmm1       \n\t"
+            "psubw     %9, %%xmm0           \n\t"
+            "psubw     %9, %%xmm1           \n\t"
+            "movdqa    %%xmm0, %%xmm2       \n\t"
+            "punpcklwd %%xmm1, %%xmm0       \n\t" /* u, v */
+            "punpckhwd %%xmm1, %%xmm2       \n\t"
+            DOT("%6", xmm3)
+            "movdqu    %%xmm3, (%1,%0,2)    \n\t"
+            DOT("%7", xmm3)
+            "paddw     %%xmm5, %%xmm3       \n\t"
+            DOT("%8", xmm1)
+            "paddw     %%xmm6, %%xmm1       \n\t"
+            "pxor      %%xmm7, %%xmm7       \n\t"
+            "pmaxsw    %%xmm7, %%xmm3       \n\t"
+            "pmaxsw    %%xmm7, %%xmm1       \n\t"
+            "pminsw    %11, %%xmm3          \n\t"
+            "pminsw    %11, %%xmm1          \n\t"
+            "movdqu    %%xmm3, (%2,%0,2)    \n\t"
+            "movdqu    %%xmm1, (%3,%0,2)    \n\t"
+            "add       $8, %0               \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(delta + (w & ~7)), "r"(dstu + (w & ~7)), "r"(dstv + (w & ~7)),
+              "r"(srcu + (w & ~7)), "r"(srcv + (w & ~7)),
+              "m"(k[0]), "m"(k[1]), "m"(k[2]), "m"(pw_512), "m"(pd_32768),
+              "m"(pw_1023)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    convert_chroma_10_tail(delta, dstu, dstv, srcu, srcv, c, w & ~7, w);
+}
+#undef DOT
+#endif /* HAVE_7REGS */
+
+/* 16 luma samples per iteration, each offset word is duplicated */
+static void add_delta_sse2(uint8_t *dst, const uint8_t *src,
+                           const int16_t *delta, int w)
+{
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "pxor      %%xmm7, %%xmm7       \n\t"
+            "1:                             \n\t"
+            "movdqu    (%3,%0), %%xmm0      \n\t"
+            "movdqa    %%xmm0, %%xmm1       \n\t"
+            "punpcklwd %%xmm0, %%xmm0       \n\t"
+            "punpckhwd %%xmm1, %%xmm1       \n\t"
+            "movdqu    (%2,%0), %%xmm2      \n\t"
+            "movdqa    %%xmm2, %%xmm3       \n\t"
+            "punpcklbw %%xmm7, %%xmm2       \n\t"
+            "punpckhbw %%xmm7, %%xmm3       \n\t"
+            "paddw     %%xmm0, %%xmm2       \n\t"
+            "paddw     %%xmm1, %%xmm3       \n\t"
+            "packuswb  %%xmm3, %%xmm2       \n\t"
+            "movdqu    %%xmm2, (%1,%0)      \n\t"
+            "add       $16, %0              \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~15)), "r"(src + (w & ~15)),
+              "r"(delta + ((w & ~15) >> 1))
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm7",)
+              "memory"
+        );
+    }
+    add_delta_tail(dst, src, delta, w & ~15, w);
+}
+
+/* 8 luma samples per iteration */
+static void add_delta_10_sse2(uint16_t *dst, const uint16_t *src,
+                              const int16_t *delta, int w)
+{
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        __asm__ volatile(
+            "pxor      %%xmm7, %%xmm7       \n\t"
+            "movdqa    %4, %%xmm6           \n\t"
+            "1:                             \n\t"
+            "movq      (%3,%0), %%xmm0      \n\t"
+            "punpcklwd %%xmm0, %%xmm0       \n\t"
+            "movdqu    (%2,%0,2), %%xmm1    \n\t"
+            "paddw     %%xmm0, %%xmm1       \n\t"
+            "pmaxsw    %%xmm7, %%xmm1       \n\t"
+            "pminsw    %%xmm6, %%xmm1       \n\t"
+            "movdqu    %%xmm1, (%1,%0,2)    \n\t"
+            "add       $8, %0               \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~7)), "r"(src + (w & ~7)),
+              "r"(delta + ((w & ~7) >> 1)), "m"(pw_1023)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    add_delta_10_tail(dst, src, delta, w & ~7, w);
+}
+
+#if HAVE_AVX2
+#if HAVE_7REGS
+/* 16 chroma samples per iteration, the unpacks and packs stay within lanes */
+#define DOT(coef, dst)                                        \
+            "vpmaddwd  "coef", %%ymm0, %%"#dst"     \n\t"     \
+            "vpmaddwd  "coef", %%ymm2, %%ymm4       \n\t"     \
+            "vpaddd    %%ymm7, %%"#dst", %%"#dst"   \n\t"     \
+            "vpaddd    %%ymm7, %%ymm4, %%ymm4       \n\t"     \
+            "vpsrad    $16, %%"#dst", %%"#dst"      \n\t"     \
+            "vpsrad    $16, %%ymm4, %%ymm4          \n\t"     \
+            "vpackssdw %%ymm4, %%"#dst", %%"#dst"   \n\t"
+
+static void convert_chroma_avx2(int16_t *delta, uint8_t *dstu, uint8_t *dstv,
+                                const uint8_t *srcu, const uint8_t *srcv,
+                                const int16_t *c, int w)
+{
+    DECLARE_ALIGNED(16, int16_t, k)[3][8];
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        splat_coeffs(k, c);
+        __asm__ volatile(
+            "vbroadcasti128 %10, %%ymm7             \n\t"
+            "1:                                     \n\t"
+            "vpmovzxbw (%4,%0), %%ymm5              \n\t" /* u */
+            "vpmovzxbw (%5,%0), %%ymm6              \n\t" /* v */
+            "vbroadcasti128 %9, %%ymm3              \n\t"
+            "vpsubw    %%ymm3, %%ymm5, %%ymm0       \n\t"
+            "vpsubw    %%ymm3, %%ymm6, %%ymm1       \n\t"
+            "vpunpckhwd %%ymm1, %%ymm0, %%ymm2      \n\t"
+            "vpunpcklwd %%ymm1, %%ymm0, %%ymm0      \n\t" /* u, v */
+            "vbroadcasti128 %6, %%ymm1              \n\t"
+            DOT("%%ymm1", ymm3)
+            "vmovdqu   %%ymm3, (%1,%0,2)            \n\t"
+            "vbroadcasti128 %7, %%ymm1              \n\t"
+            DOT("%%ymm1", ymm3)
+            "vpaddw    %%ymm5, %%ymm3, %%ymm3       \n\t"
+            "vbroadcasti128 %8, %%ymm1              \n\t"
+            DOT("%%ymm1", ymm0)
+            "vpaddw    %%ymm6, %%ymm0, %%ymm0       \n\t"
+            "vextracti128 $1, %%ymm3, %%xmm4        \n\t"
+            "vpackuswb %%xmm4, %%xmm3, %%xmm3       \n\t"
+            "vextracti128 $1, %%ymm0, %%xmm4        \n\t"
+            "vpackuswb %%xmm4, %%xmm0, %%xmm0       \n\t"
+            "vmovdqu   %%xmm3, (%2,%0)              \n\t"
+            "vmovdqu   %%xmm0, (%3,%0)              \n\t"
+            "add       $16, %0                      \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(delta + (w & ~15)), "r"(dstu + (w & ~15)), "r"(dstv + (w & ~15)),
+              "r"(srcu + (w & ~15)), "r"(srcv + (w & ~15)),
+              "m"(k[0]), "m"(k[1]), "m"(k[2]), "m"(pw_128), "m"(pd_32768)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    convert_chroma_sse2(delta + (w & ~15), dstu + (w & ~15), dstv + (w & ~15),
+                        srcu + (w & ~15), srcv + (w & ~15), c, w & 15);
+}
+
+static void convert_chroma_10_avx2(int16_t *delta, uint16_t *dstu, uint16_t *dstv,
+                                   const uint16_t *srcu, const uint16_t *srcv,
+                                   const int16_t *c, int w)
+{
+    DECLARE_ALIGNED(16, int16_t, k)[3][8];
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        splat_coeffs(k, c);
+        __asm__ volatile(
+            "vbroadcasti128 %10, %%ymm7             \n\t"
+            "1:                                     \n\t"
+            "vmovdqu   (%4,%0,2), %%ymm5            \n\t" /* u */
+            "vmovdqu   (%5,%0,2), %%ymm6            \n\t" /* v */
+            "vbroadcasti128 %9, %%ymm3              \n\t"
+            "vpsubw    %%ymm3, %%ymm5, %%ymm0       \n\t"
+            "vpsubw    %%ymm3, %%ymm6, %%ymm1       \n\t"
+            "vpunpckhwd %%ymm1, %%ymm0, %%ymm2      \n\t"
+            "vpunpcklwd %%ymm1, %%ymm0, %%ymm0      \n\t" /* u, v */
+            "vbroadcasti128 %6, %%ymm1              \n\t"
+            DOT("%%ymm1", ymm3)
+            "vmovdqu   %%ymm3, (%1,%0,2)            \n\t"
+            "vbroadcasti128 %7, %%ymm1              \n\t"
+            DOT("%%ymm1", ymm3)
+            "vpaddw    %%ymm5, %%ymm3, %%ymm3       \n\t"
+            "vbroadcasti128 %8, %%ymm1              \n\t"
+            DOT("%%ymm1", ymm0)
+            "vpaddw    %%ymm6, %%ymm0, %%ymm0       \n\t"
+            "vpxor     %%ymm4, %%ymm4, %%ymm4       \n\t"
+            "vpmaxsw   %%ymm4, %%ymm3, %%ymm3       \n\t"
+            "vpmaxsw   %%ymm4, %%ymm0, %%ymm0       \n\t"
+            "vbroadcasti128 %11, %%ymm4             \n\t"
+            "vpminsw   %%ymm4, %%ymm3, %%ymm3       \n\t"
+            "vpminsw   %%ymm4, %%ymm0, %%ymm0       \n\t"
+            "vmovdqu   %%ymm3, (%2,%0,2)            \n\t"
+            "vmovdqu   %%ymm0, (%3,%0,2)            \n\t"
+            "add       $16, %0                      \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(delta + (w & ~15)), "r"(dstu + (w & ~15)), "r"(dstv + (w & ~15)),
+              "r"(srcu + (w & ~15)), "r"(srcv + (w & ~15)),
+              "m"(k[0]), "m"(k[1]), "m"(k[2]), "m"(pw_512), "m"(pd_32768),
+              "m"(pw_1023)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    convert_chroma_10_sse2(delta + (w & ~15), dstu + (w & ~15), dstv + (w & ~15),
+                           srcu + (w & ~15), srcv + (w & ~15), c, w & 15);
+}
+#undef DOT
+#endif /* HAVE_7REGS */
+
+/*
+ * 32 luma samples per iteration, the offsets are duplicated by zero
+ * extending them to dwords and or-ing a copy shifted by 16.
+ */
+static void add_delta_avx2(uint8_t *dst, const uint8_t *src,
+                           const int16_t *delta, int w)
+{
+    x86_reg i = -(w & ~31);
+
+    if (i) {
+        __asm__ volatile(
+            "1:                                     \n\t"
+            "vpmovzxwd (%3,%0), %%ymm0              \n\t"
+            "vpmovzxwd 16(%3,%0), %%ymm1            \n\t"
+            "vpslld    $16, %%ymm0, %%ymm2          \n\t"
+            "vpslld    $16, %%ymm1, %%ymm3          \n\t"
+            "vpor      %%ymm2, %%ymm0, %%ymm0       \n\t"
+            "vpor      %%ymm3, %%ymm1, %%ymm1       \n\t"
+            "vpmovzxbw (%2,%0), %%ymm2              \n\t"
+            "vpmovzxbw 16(%2,%0), %%ymm3            \n\t"
+            "vpaddw    %%ymm0, %%ymm2, %%ymm2       \n\t"
+            "vpaddw    %%ymm1, %%ymm3, %%ymm3       \n\t"
+            "vpackuswb %%ymm3, %%ymm2, %%ymm2       \n\t"
+            "vpermq    $0xd8, %%ymm2, %%ymm2        \n\t"
+            "vmovdqu   %%ymm2, (%1,%0)              \n\t"
+            "add       $32, %0                      \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~31)), "r"(src + (w & ~31)),
+              "r"(delta + ((w & ~31) >> 1))
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",)
+              "memory"
+        );
+    }
+    add_delta_sse2(dst + (w & ~31), src + (w & ~31), delta + ((w & ~31) >> 1),
+                   w & 31);
+}
+
+/* 16 luma samples per iteration */
+static void add_delta_10_avx2(uint16_t *dst, const uint16_t *src,
+                              const int16_t *delta, int w)
+{
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "vpxor     %%ymm7, %%ymm7, %%ymm7       \n\t"
+            "vbroadcasti128 %4, %%ymm6              \n\t"
+            "1:                                     \n\t"
+            "vpmovzxwd (%3,%0), %%ymm0              \n\t"
+            "vpslld    $16, %%ymm0, %%ymm1          \n\t"
+            "vpor      %%ymm1, %%ymm0, %%ymm0       \n\t"
+            "vpaddw    (%2,%0,2), %%ymm0, %%ymm0    \n\t"
+            "vpmaxsw   %%ymm7, %%ymm0, %%ymm0       \n\t"
+            "vpminsw   %%ymm6, %%ymm0, %%ymm0       \n\t"
+            "vmovdqu   %%ymm0, (%1,%0,2)            \n\t"
+            "add       $16, %0                      \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~15)), "r"(src + (w & ~15)),
+              "r"(delta + ((w & ~15) >> 1)), "m"(pw_1023)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    add_delta_10_sse2(dst + (w & ~15), src + (w & ~15), delta + ((w & ~15) >> 1),
+                      w & 15);
+}
+#endif /* HAVE_AVX2 */
+
+void ff_colormatrix_init_x86(ColorMatrixDSPContext *dsp)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+#if HAVE_7REGS
+        dsp->convert_chroma    = convert_chroma_sse2;
+        dsp->convert_chroma_10 = convert_chroma_10_sse2;
+#endif
+        dsp->add_delta         = add_delta_sse2;
+        dsp->add_delta_10      = add_delta_10_sse2;
+    }
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+#if HAVE_7REGS
+        dsp->convert_chroma    = convert_chroma_avx2;
+        dsp->convert_chroma_10 = convert_chroma_10_avx2;
+#endif
+        dsp->add_delta         = add_delta_avx2;
+        dsp->add_delta_10      = add_delta_10_avx2;
+    }
+#endif
+}
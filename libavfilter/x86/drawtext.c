@@ -0,0 +1,180 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/x86/dsputil_mmx.h"
+#include "libavfilter/drawtext.h"
+
+#if HAVE_SSSE3
+static void blend_row_tail(uint8_t *dst, const uint16_t *weight,
+                           int color, int i, int w)
+{
+    for (; i < w; i++)
+        dst[i] += ((color - dst[i]) * weight[i] + (1 << 14)) >> 15;
+}
+
+static void blend_row_10_tail(uint16_t *dst, const uint16_t *weight,
+                              int color, int i, int w)
+{
+    for (; i < w; i++)
+        dst[i] += ((color - dst[i]) * weight[i] + (1 << 14)) >> 15;
+}
+
+/*
+ * The weights are 15-bit so that the rounded product of the signed
+ * difference with the color is a single pmulhrsw.
+ */
+static void blend_row_ssse3(uint8_t *dst, const uint16_t *weight,
+                            int color, int w)
+{
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        __asm__ volatile(
+            "movd       %3, %%xmm7          \n\t"
+            "pshuflw    $0, %%xmm7, %%xmm7  \n\t"
+            "punpcklqdq %%xmm7, %%xmm7      \n\t"
+            "pxor       %%xmm6, %%xmm6      \n\t"
+            "1:                             \n\t"
+            "movq       (%1,%0), %%xmm0     \n\t"
+            "movdqu     (%2,%0,2), %%xmm2   \n\t"
+            "punpcklbw  %%xmm6, %%xmm0      \n\t"
+            "movdqa     %%xmm7, %%xmm1      \n\t"
+            "psubw      %%xmm0, %%xmm1      \n\t" /* color - dst */
+            "pmulhrsw   %%xmm2, %%xmm1      \n\t"
+            "paddw      %%xmm1, %%xmm0      \n\t"
+            "packuswb   %%xmm0, %%xmm0      \n\t"
+            "movq       %%xmm0, (%1,%0)     \n\t"
+            "add        $8, %0              \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~7)), "r"(weight + (w & ~7)), "rm"(color)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_tail(dst, weight, color, w & ~7, w);
+}
+
+static void blend_row_10_ssse3(uint16_t *dst, const uint16_t *weight,
+                               int color, int w)
+{
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        __asm__ volatile(
+            "movd       %3, %%xmm7          \n\t"
+            "pshuflw    $0, %%xmm7, %%xmm7  \n\t"
+            "punpcklqdq %%xmm7, %%xmm7      \n\t"
+            "1:                             \n\t"
+            "movdqu     (%1,%0,2), %%xmm0   \n\t"
+            "movdqu     (%2,%0,2), %%xmm2   \n\t"
+            "movdqa     %%xmm7, %%xmm1      \n\t"
+            "psubw      %%xmm0, %%xmm1      \n\t"
+            "pmulhrsw   %%xmm2, %%xmm1      \n\t"
+            "paddw      %%xmm1, %%xmm0      \n\t"
+            "movdqu     %%xmm0, (%1,%0,2)   \n\t"
+            "add        $8, %0              \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~7)), "r"(weight + (w & ~7)), "rm"(color)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_10_tail(dst, weight, color, w & ~7, w);
+}
+
+#if HAVE_AVX2
+/* 16 samples per iteration, the SSSE3 versions blend the last 15 */
+static void blend_row_avx2(uint8_t *dst, const uint16_t *weight,
+                           int color, int w)
+{
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "vmovd        %3, %%xmm7                \n\t"
+            "vpbroadcastw %%xmm7, %%ymm7            \n\t"
+            "1:                                     \n\t"
+            "vpmovzxbw    (%1,%0), %%ymm0           \n\t"
+            "vpsubw       %%ymm0, %%ymm7, %%ymm1    \n\t"
+            "vpmulhrsw    (%2,%0,2), %%ymm1, %%ymm1 \n\t"
+            "vpaddw       %%ymm1, %%ymm0, %%ymm0    \n\t"
+            "vextracti128 $1, %%ymm0, %%xmm1        \n\t"
+            "vpackuswb    %%xmm1, %%xmm0, %%xmm0    \n\t"
+            "vmovdqu      %%xmm0, (%1,%0)           \n\t"
+            "add          $16, %0                   \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~15)), "r"(weight + (w & ~15)), "rm"(color)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_ssse3(dst + (w & ~15), weight + (w & ~15), color, w & 15);
+}
+
+static void blend_row_10_avx2(uint16_t *dst, const uint16_t *weight,
+                              int color, int w)
+{
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "vmovd        %3, %%xmm7                \n\t"
+            "vpbroadcastw %%xmm7, %%ymm7            \n\t"
+            "1:                                     \n\t"
+            "vmovdqu      (%1,%0,2), %%ymm0         \n\t"
+            "vpsubw       %%ymm0, %%ymm7, %%ymm1    \n\t"
+            "vpmulhrsw    (%2,%0,2), %%ymm1, %%ymm1 \n\t"
+            "vpaddw       %%ymm1, %%ymm0, %%ymm0    \n\t"
+            "vmovdqu      %%ymm0, (%1,%0,2)         \n\t"
+            "add          $16, %0                   \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~15)), "r"(weight + (w & ~15)), "rm"(color)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_10_ssse3(dst + (w & ~15), weight + (w & ~15), color, w & 15);
+}
+#endif /* HAVE_AVX2 */
+#endif /* HAVE_SSSE3 */
+
+void ff_drawtext_init_x86(DrawTextDSPContext *dsp)
+{
+#if HAVE_SSSE3
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSSE3) {
+        dsp->blend_row    = blend_row_ssse3;
+        dsp->blend_row_10 = blend_row_10_ssse3;
+    }
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+        dsp->blend_row    = blend_row_avx2;
+        dsp->blend_row_10 = blend_row_10_avx2;
+    }
+#endif
+#endif /* HAVE_SSSE3 */
+}
@@ -0,0 +1,142 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/avutil.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/hqdn3d.h"
+
+/* offset of the middle of the coefficient tables, 256 << LUT_BITS */
+DECLARE_ASM_CONST(16, uint16_t, pw_4096)[8] = {
+    4096, 4096, 4096, 4096, 4096, 4096, 4096, 4096,
+};
+
+#define LOOKUP_SSE2(k)                                          \
+    "pextrw      $"#k", %%xmm2, %k1             \n\t"           \
+    "pinsrw      $"#k", (%4,%1,2), %%xmm3       \n\t"
+
+/*
+ * 8 samples per iteration, the table indexes are computed on dwords and
+ * packed to words biased to be positive, the coefficients are then
+ * inserted one at a time. The result lies between the two samples, so it
+ * is computed with word additions.
+ */
+static void lowpass_line_sse2(uint16_t *prev, const uint16_t *cur,
+                              const int16_t *coef, int w)
+{
+    x86_reg i = -2 * (w & ~7), index;
+    int x;
+
+    if (i) {
+        __asm__ volatile(
+            "pxor        %%xmm7, %%xmm7                 \n\t"
+            "movdqa      %5, %%xmm6                     \n\t"
+            "1:                                         \n\t"
+            "movdqu      (%2,%0), %%xmm0                \n\t"
+            "movdqu      (%3,%0), %%xmm1                \n\t"
+            "movdqa      %%xmm0, %%xmm2                 \n\t"
+            "movdqa      %%xmm1, %%xmm3                 \n\t"
+            "movdqa      %%xmm0, %%xmm4                 \n\t"
+            "movdqa      %%xmm1, %%xmm5                 \n\t"
+            "punpcklwd   %%xmm7, %%xmm2                 \n\t"
+            "punpcklwd   %%xmm7, %%xmm3                 \n\t"
+            "punpckhwd   %%xmm7, %%xmm4                 \n\t"
+            "punpckhwd   %%xmm7, %%xmm5                 \n\t"
+            "psubd       %%xmm3, %%xmm2                 \n\t"
+            "psubd       %%xmm5, %%xmm4                 \n\t"
+            "psrad       $"AV_STRINGIFY(8 - LUT_BITS)", %%xmm2 \n\t"
+            "psrad       $"AV_STRINGIFY(8 - LUT_BITS)", %%xmm4 \n\t"
+            "packssdw    %%xmm4, %%xmm2                 \n\t"
+            "paddw       %%xmm6, %%xmm2                 \n\t"
+            LOOKUP_SSE2(0)
+            LOOKUP_SSE2(1)
+            LOOKUP_SSE2(2)
+            LOOKUP_SSE2(3)
+            LOOKUP_SSE2(4)
+            LOOKUP_SSE2(5)
+            LOOKUP_SSE2(6)
+            LOOKUP_SSE2(7)
+            "paddw       %%xmm1, %%xmm3                 \n\t"
+            "movdqu      %%xmm3, (%2,%0)                \n\t"
+            "add         $16, %0                        \n\t"
+            "js 1b                                      \n\t"
+            : "+r"(i), "=&r"(index)
+            : "r"(prev + (w & ~7)), "r"(cur + (w & ~7)),
+              "r"(coef - (256 << LUT_BITS)), "m"(pw_4096)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+
+    for (x = w & ~7; x < w; x++)
+        prev[x] = cur[x] + coef[(prev[x] - cur[x]) >> (8 - LUT_BITS)];
+}
+
+#if HAVE_AVX2
+/*
+ * 8 samples per iteration, the coefficients are fetched with a dword
+ * gather at 2 * index and sign extended from the low word, which is why
+ * the tables have one spare entry at the end.
+ */
+static void lowpass_line_avx2(uint16_t *prev, const uint16_t *cur,
+                              const int16_t *coef, int w)
+{
+    x86_reg i = -2 * (w & ~7);
+    int x;
+
+    if (i) {
+        __asm__ volatile(
+            "1:                                         \n\t"
+            "vpmovzxwd   (%1,%0), %%ymm0                \n\t"
+            "vpmovzxwd   (%2,%0), %%ymm1                \n\t"
+            "vpsubd      %%ymm1, %%ymm0, %%ymm2         \n\t"
+            "vpsrad      $"AV_STRINGIFY(8 - LUT_BITS)", %%ymm2, %%ymm2 \n\t"
+            "vpcmpeqd    %%ymm3, %%ymm3, %%ymm3         \n\t"
+            "vpgatherdd  %%ymm3, (%3,%%ymm2,2), %%ymm4  \n\t"
+            "vpslld      $16, %%ymm4, %%ymm4            \n\t"
+            "vpsrad      $16, %%ymm4, %%ymm4            \n\t"
+            "vpaddd      %%ymm4, %%ymm1, %%ymm1         \n\t"
+            "vextracti128 $1, %%ymm1, %%xmm5            \n\t"
+            "vpackusdw   %%xmm5, %%xmm1, %%xmm1         \n\t"
+            "vmovdqu     %%xmm1, (%1,%0)                \n\t"
+            "add         $16, %0                        \n\t"
+            "js 1b                                      \n\t"
+            "vzeroupper                                 \n\t"
+            : "+r"(i)
+            : "r"(prev + (w & ~7)), "r"(cur + (w & ~7)), "r"(coef)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",)
+              "memory"
+        );
+    }
+
+    for (x = w & ~7; x < w; x++)
+        prev[x] = cur[x] + coef[(prev[x] - cur[x]) >> (8 - LUT_BITS)];
+}
+#endif
+
+void ff_hqdn3d_init_x86(HQDN3DDSPContext *dsp)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2)
+        dsp->lowpass_line = lowpass_line_sse2;
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2)
+        dsp->lowpass_line = lowpass_line_avx2;
+#endif
+}
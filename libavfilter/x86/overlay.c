@@ -0,0 +1,242 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/x86/dsputil_mmx.h"
+#include "libavfilter/overlay.h"
+
+DECLARE_ASM_CONST(16, xmm_reg, pw_128) = {0x0080008000800080ULL, 0x0080008000800080ULL};
+DECLARE_ASM_CONST(16, xmm_reg, pw_255) = {0x00FF00FF00FF00FFULL, 0x00FF00FF00FF00FFULL};
+DECLARE_ASM_CONST(16, xmm_reg, pw_257) = {0x0101010101010101ULL, 0x0101010101010101ULL};
+DECLARE_ASM_CONST(16, xmm_reg, pd_128) = {0x0000008000000080ULL, 0x0000008000000080ULL};
+
+/* same as FAST_DIV255() in vf_overlay.c */
+#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+
+static void blend_row_tail(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *alpha, int i, int w)
+{
+    for (; i < w; i++)
+        dst[i] = FAST_DIV255(dst[i] * (255 - alpha[i]) + src[i] * alpha[i]);
+}
+
+static void blend_row_10_tail(uint16_t *dst, const uint8_t *src,
+                              const uint8_t *alpha, int i, int w)
+{
+    for (; i < w; i++)
+        dst[i] = FAST_DIV255(dst[i] * (255 - alpha[i]) + (src[i] << 2) * alpha[i]);
+}
+
+/*
+ * 8-bit: d * (255 - a) + s * a fits an unsigned word, the division by 255
+ * is done with pmulhuw by 257 after adding 128.
+ */
+static void blend_row_sse2(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *alpha, int w)
+{
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        __asm__ volatile(
+            "pxor      %%xmm7, %%xmm7       \n\t"
+            "movdqa    %4, %%xmm6           \n\t"
+            "1:                             \n\t"
+            "movq      (%1,%0), %%xmm0      \n\t" /* d */
+            "movq      (%2,%0), %%xmm1      \n\t" /* s */
+            "movq      (%3,%0), %%xmm2      \n\t" /* a */
+            "punpcklbw %%xmm7, %%xmm0       \n\t"
+            "punpcklbw %%xmm7, %%xmm1       \n\t"
+            "punpcklbw %%xmm7, %%xmm2       \n\t"
+            "movdqa    %%xmm6, %%xmm3       \n\t"
+            "psubw     %%xmm2, %%xmm3       \n\t" /* 255 - a */
+            "pmullw    %%xmm2, %%xmm1       \n\t"
+            "pmullw    %%xmm3, %%xmm0       \n\t"
+            "paddw     %%xmm1, %%xmm0       \n\t"
+            "paddw     %5, %%xmm0           \n\t"
+            "pmulhuw   %6, %%xmm0           \n\t"
+            "packuswb  %%xmm0, %%xmm0       \n\t"
+            "movq      %%xmm0, (%1,%0)      \n\t"
+            "add       $8, %0               \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~7)), "r"(src + (w & ~7)), "r"(alpha + (w & ~7)),
+              "m"(pw_255), "m"(pw_128), "m"(pw_257)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_tail(dst, src, alpha, w & ~7, w);
+}
+
+/*
+ * 10-bit: d * (255 - a) + 4 * s * a is computed with pmaddwd on interleaved
+ * words, the division by 255 is done on dwords as (x << 8) + x.
+ */
+static void blend_row_10_sse2(uint16_t *dst, const uint8_t *src,
+                              const uint8_t *alpha, int w)
+{
+    x86_reg i = -(w & ~7);
+
+    if (i) {
+        __asm__ volatile(
+            "pxor      %%xmm7, %%xmm7       \n\t"
+            "movdqa    %4, %%xmm6           \n\t"
+            "1:                             \n\t"
+            "movdqu    (%1,%0,2), %%xmm0    \n\t" /* d */
+            "movq      (%2,%0), %%xmm1      \n\t" /* s */
+            "movq      (%3,%0), %%xmm2      \n\t" /* a */
+            "punpcklbw %%xmm7, %%xmm1       \n\t"
+            "punpcklbw %%xmm7, %%xmm2       \n\t"
+            "psllw     $2, %%xmm1           \n\t"
+            "movdqa    %%xmm6, %%xmm3       \n\t"
+            "psubw     %%xmm2, %%xmm3       \n\t" /* 255 - a */
+            "movdqa    %%xmm0, %%xmm4       \n\t"
+            "punpcklwd %%xmm1, %%xmm0       \n\t" /* d, s */
+            "punpckhwd %%xmm1, %%xmm4       \n\t"
+            "movdqa    %%xmm3, %%xmm5       \n\t"
+            "punpcklwd %%xmm2, %%xmm3       \n\t" /* 255 - a, a */
+            "punpckhwd %%xmm2, %%xmm5       \n\t"
+            "pmaddwd   %%xmm3, %%xmm0       \n\t"
+            "pmaddwd   %%xmm5, %%xmm4       \n\t"
+            "paddd     %5, %%xmm0           \n\t"
+            "paddd     %5, %%xmm4           \n\t"
+            "movdqa    %%xmm0, %%xmm1       \n\t"
+            "movdqa    %%xmm4, %%xmm5       \n\t"
+            "pslld     $8, %%xmm0           \n\t"
+            "pslld     $8, %%xmm4           \n\t"
+            "paddd     %%xmm1, %%xmm0       \n\t"
+            "paddd     %%xmm5, %%xmm4       \n\t"
+            "psrld     $16, %%xmm0          \n\t"
+            "psrld     $16, %%xmm4          \n\t"
+            "packssdw  %%xmm4, %%xmm0       \n\t"
+            "movdqu    %%xmm0, (%1,%0,2)    \n\t"
+            "add       $8, %0               \n\t"
+            "js 1b                          \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~7)), "r"(src + (w & ~7)), "r"(alpha + (w & ~7)),
+              "m"(pw_255), "m"(pd_128)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_10_tail(dst, src, alpha, w & ~7, w);
+}
+
+#if HAVE_AVX2
+/* 16 samples per iteration */
+static void blend_row_avx2(uint8_t *dst, const uint8_t *src,
+                           const uint8_t *alpha, int w)
+{
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "vbroadcasti128 %4, %%ymm6              \n\t"
+            "vbroadcasti128 %5, %%ymm5              \n\t"
+            "vbroadcasti128 %6, %%ymm4              \n\t"
+            "1:                                     \n\t"
+            "vpmovzxbw (%1,%0), %%ymm0              \n\t" /* d */
+            "vpmovzxbw (%2,%0), %%ymm1              \n\t" /* s */
+            "vpmovzxbw (%3,%0), %%ymm2              \n\t" /* a */
+            "vpsubw    %%ymm2, %%ymm6, %%ymm3       \n\t" /* 255 - a */
+            "vpmullw   %%ymm2, %%ymm1, %%ymm1       \n\t"
+            "vpmullw   %%ymm3, %%ymm0, %%ymm0       \n\t"
+            "vpaddw    %%ymm1, %%ymm0, %%ymm0       \n\t"
+            "vpaddw    %%ymm5, %%ymm0, %%ymm0       \n\t"
+            "vpmulhuw  %%ymm4, %%ymm0, %%ymm0       \n\t"
+            "vextracti128 $1, %%ymm0, %%xmm1        \n\t"
+            "vpackuswb %%xmm1, %%xmm0, %%xmm0       \n\t"
+            "vmovdqu   %%xmm0, (%1,%0)              \n\t"
+            "add       $16, %0                      \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~15)), "r"(src + (w & ~15)), "r"(alpha + (w & ~15)),
+              "m"(pw_255), "m"(pw_128), "m"(pw_257)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6",)
+              "memory"
+        );
+    }
+    blend_row_sse2(dst + (w & ~15), src + (w & ~15), alpha + (w & ~15), w & 15);
+}
+
+/* 16 samples per iteration, the unpacks and the pack stay within lanes */
+static void blend_row_10_avx2(uint16_t *dst, const uint8_t *src,
+                              const uint8_t *alpha, int w)
+{
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "vbroadcasti128 %4, %%ymm6              \n\t"
+            "vbroadcasti128 %5, %%ymm7              \n\t"
+            "1:                                     \n\t"
+            "vmovdqu   (%1,%0,2), %%ymm0            \n\t" /* d */
+            "vpmovzxbw (%2,%0), %%ymm1              \n\t" /* s */
+            "vpmovzxbw (%3,%0), %%ymm2              \n\t" /* a */
+            "vpsllw    $2, %%ymm1, %%ymm1           \n\t"
+            "vpsubw    %%ymm2, %%ymm6, %%ymm3       \n\t" /* 255 - a */
+            "vpunpckhwd %%ymm1, %%ymm0, %%ymm4      \n\t"
+            "vpunpcklwd %%ymm1, %%ymm0, %%ymm0      \n\t" /* d, s */
+            "vpunpckhwd %%ymm2, %%ymm3, %%ymm5      \n\t"
+            "vpunpcklwd %%ymm2, %%ymm3, %%ymm3      \n\t" /* 255 - a, a */
+            "vpmaddwd  %%ymm3, %%ymm0, %%ymm0       \n\t"
+            "vpmaddwd  %%ymm5, %%ymm4, %%ymm4       \n\t"
+            "vpaddd    %%ymm7, %%ymm0, %%ymm0       \n\t"
+            "vpaddd    %%ymm7, %%ymm4, %%ymm4       \n\t"
+            "vpslld    $8, %%ymm0, %%ymm1           \n\t"
+            "vpslld    $8, %%ymm4, %%ymm5           \n\t"
+            "vpaddd    %%ymm1, %%ymm0, %%ymm0       \n\t"
+            "vpaddd    %%ymm5, %%ymm4, %%ymm4       \n\t"
+            "vpsrld    $16, %%ymm0, %%ymm0          \n\t"
+            "vpsrld    $16, %%ymm4, %%ymm4          \n\t"
+            "vpackssdw %%ymm4, %%ymm0, %%ymm0       \n\t"
+            "vmovdqu   %%ymm0, (%1,%0,2)            \n\t"
+            "add       $16, %0                      \n\t"
+            "js 1b                                  \n\t"
+            "vzeroupper                             \n\t"
+            : "+r"(i)
+            : "r"(dst + (w & ~15)), "r"(src + (w & ~15)), "r"(alpha + (w & ~15)),
+              "m"(pw_255), "m"(pd_128)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5",
+                           "%xmm6", "%xmm7",)
+              "memory"
+        );
+    }
+    blend_row_10_sse2(dst + (w & ~15), src + (w & ~15), alpha + (w & ~15), w & 15);
+}
+#endif
+
+void ff_overlay_init_x86(OverlayDSPContext *dsp)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        dsp->blend_row    = blend_row_sse2;
+        dsp->blend_row_10 = blend_row_10_sse2;
+    }
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2) {
+        dsp->blend_row    = blend_row_avx2;
+        dsp->blend_row_10 = blend_row_10_avx2;
+    }
+#endif
+}
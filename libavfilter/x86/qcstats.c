@@ -0,0 +1,204 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/x86/dsputil_mmx.h"
+#include "libavfilter/qcstats.h"
+
+DECLARE_ASM_CONST(32, uint64_t, pb_0)[4] = { 0, 0, 0, 0 };
+DECLARE_ASM_CONST(32, uint64_t, pb_1)[4] = { 0x0101010101010101ULL, 0x0101010101010101ULL,
+                                             0x0101010101010101ULL, 0x0101010101010101ULL };
+
+static void line_stats_tail(QCLineStats *s, uint16_t *col_sum,
+                            const uint8_t *src, const uint8_t *prev,
+                            int i, int w, int black_thresh)
+{
+    for (; i < w; i++) {
+        int v = src[i];
+        s->sum    += v;
+        s->sad    += FFABS(v - prev[i]);
+        s->nblack += v < black_thresh;
+        s->min     = FFMIN(s->min, v);
+        s->max     = FFMAX(s->max, v);
+        col_sum[i] += v;
+    }
+}
+
+/**
+ * Add the accumulators stored by the kernels, n bytes of minimums and
+ * maximums followed by n / 8 qwords of sums, sads and black counts.
+ */
+static void reduce_stats(QCLineStats *s, const uint64_t *res, int n)
+{
+    const uint8_t *min = (const uint8_t *)res;
+    const uint8_t *max = (const uint8_t *)res + n;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        s->min = FFMIN(s->min, min[i]);
+        s->max = FFMAX(s->max, max[i]);
+    }
+    res += n / 4;
+    for (i = 0; i < n / 8; i++) {
+        s->sum    += res[i];
+        s->sad    += res[i +     n / 8];
+        s->nblack += res[i + 2 * n / 8];
+    }
+}
+
+/*
+ * The sums, sads and black counts are psadbw against zero, the black
+ * samples being those that saturate to zero once the threshold minus one
+ * is subtracted. The column sums are updated with aligned word adds.
+ */
+static void line_stats_sse2(QCLineStats *s, uint16_t *col_sum,
+                            const uint8_t *src, const uint8_t *prev,
+                            int w, int black_thresh)
+{
+    DECLARE_ALIGNED(16, uint64_t, res)[10];
+    x86_reg i = -(w & ~15);
+
+    if (i) {
+        __asm__ volatile(
+            "movd      %5, %%xmm7           \n\t"
+            "pshufd    $0, %%xmm7, %%xmm7   \n\t" /* black_thresh - 1 */
+            "pxor      %%xmm6, %%xmm6       \n\t" /* sum */
+            "pxor      %%xmm5, %%xmm5       \n\t" /* sad */
+            "pxor      %%xmm4, %%xmm4       \n\t" /* black */
+            "pcmpeqb   %%xmm3, %%xmm3       \n\t" /* min */
+            "pxor      %%xmm2, %%xmm2       \n\t" /* max */
+            "1:                             \n\t"
+            "movdqu    (%2,%0), %%xmm0      \n\t"
+            "movdqu    (%3,%0), %%xmm1      \n\t"
+            "psadbw    %%xmm0, %%xmm1       \n\t"
+            "paddq     %%xmm1, %%xmm5       \n\t"
+            "pminub    %%xmm0, %%xmm3       \n\t"
+            "pmaxub    %%xmm0, %%xmm2       \n\t"
+            "movdqa    %%xmm0, %%xmm1       \n\t"
+            "psadbw    %6, %%xmm1           \n\t"
+            "paddq     %%xmm1, %%xmm6       \n\t"
+            "movdqa    %%xmm0, %%xmm1       \n\t"
+            "psubusb   %%xmm7, %%xmm1       \n\t"
+            "pcmpeqb   %6, %%xmm1           \n\t"
+            "pand      %7, %%xmm1           \n\t"
+            "psadbw    %6, %%xmm1           \n\t"
+            "paddq     %%xmm1, %%xmm4       \n\t"
+            "movdqa    %%xmm0, %%xmm1       \n\t"
+            "punpcklbw %6, %%xmm0           \n\t"
+            "punpckhbw %6, %%xmm1           \n\t"
+            "paddw     (%4,%0,2), %%xmm0    \n\t"
+            "paddw   16(%4,%0,2), %%xmm1    \n\t"
+            "movdqa    %%xmm0,   (%4,%0,2)  \n\t"
+            "movdqa    %%xmm1, 16(%4,%0,2)  \n\t"
+            "add       $16, %0              \n\t"
+            "js 1b                          \n\t"
+            "movdqa    %%xmm3,   (%1)       \n\t"
+            "movdqa    %%xmm2, 16(%1)       \n\t"
+            "movdqa    %%xmm6, 32(%1)       \n\t"
+            "movdqa    %%xmm5, 48(%1)       \n\t"
+            "movdqa    %%xmm4, 64(%1)       \n\t"
+            : "+r"(i)
+            : "r"(res), "r"(src + (w & ~15)), "r"(prev + (w & ~15)),
+              "r"(col_sum + (w & ~15)), "rm"((black_thresh - 1) * 0x01010101),
+              "m"(*pb_0), "m"(*pb_1)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",
+                           "%xmm5", "%xmm6", "%xmm7",)
+              "memory"
+        );
+        reduce_stats(s, res, 16);
+    }
+
+    line_stats_tail(s, col_sum, src, prev, w & ~15, w, black_thresh);
+}
+
+#if HAVE_AVX2
+/*
+ * Same as the SSE2 version on 32 samples, the column sums are widened
+ * with vpmovzxbw so that they stay in order across the lanes.
+ */
+static void line_stats_avx2(QCLineStats *s, uint16_t *col_sum,
+                            const uint8_t *src, const uint8_t *prev,
+                            int w, int black_thresh)
+{
+    DECLARE_ALIGNED(32, uint64_t, res)[20];
+    x86_reg i = -(w & ~31);
+
+    if (i) {
+        __asm__ volatile(
+            "vmovd        %5, %%xmm7                    \n\t"
+            "vpbroadcastd %%xmm7, %%ymm7                \n\t"
+            "vpxor        %%ymm6, %%ymm6, %%ymm6        \n\t"
+            "vpxor        %%ymm5, %%ymm5, %%ymm5        \n\t"
+            "vpxor        %%ymm4, %%ymm4, %%ymm4        \n\t"
+            "vpcmpeqb     %%ymm3, %%ymm3, %%ymm3        \n\t"
+            "vpxor        %%ymm2, %%ymm2, %%ymm2        \n\t"
+            "1:                                         \n\t"
+            "vmovdqu      (%2,%0), %%ymm0               \n\t"
+            "vpsadbw      (%3,%0), %%ymm0, %%ymm1       \n\t"
+            "vpaddq       %%ymm1, %%ymm5, %%ymm5        \n\t"
+            "vpminub      %%ymm0, %%ymm3, %%ymm3        \n\t"
+            "vpmaxub      %%ymm0, %%ymm2, %%ymm2        \n\t"
+            "vpsadbw      %6, %%ymm0, %%ymm1            \n\t"
+            "vpaddq       %%ymm1, %%ymm6, %%ymm6        \n\t"
+            "vpsubusb     %%ymm7, %%ymm0, %%ymm1        \n\t"
+            "vpcmpeqb     %6, %%ymm1, %%ymm1            \n\t"
+            "vpand        %7, %%ymm1, %%ymm1            \n\t"
+            "vpsadbw      %6, %%ymm1, %%ymm1            \n\t"
+            "vpaddq       %%ymm1, %%ymm4, %%ymm4        \n\t"
+            "vpmovzxbw    (%2,%0), %%ymm0               \n\t"
+            "vpmovzxbw  16(%2,%0), %%ymm1               \n\t"
+            "vpaddw       (%4,%0,2), %%ymm0, %%ymm0     \n\t"
+            "vpaddw     32(%4,%0,2), %%ymm1, %%ymm1     \n\t"
+            "vmovdqu      %%ymm0,   (%4,%0,2)           \n\t"
+            "vmovdqu      %%ymm1, 32(%4,%0,2)           \n\t"
+            "add          $32, %0                       \n\t"
+            "js 1b                                      \n\t"
+            "vmovdqa      %%ymm3,    (%1)               \n\t"
+            "vmovdqa      %%ymm2,  32(%1)               \n\t"
+            "vmovdqa      %%ymm6,  64(%1)               \n\t"
+            "vmovdqa      %%ymm5,  96(%1)               \n\t"
+            "vmovdqa      %%ymm4, 128(%1)               \n\t"
+            "vzeroupper                                 \n\t"
+            : "+r"(i)
+            : "r"(res), "r"(src + (w & ~31)), "r"(prev + (w & ~31)),
+              "r"(col_sum + (w & ~31)), "rm"((black_thresh - 1) * 0x01010101),
+              "m"(*pb_0), "m"(*pb_1)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",
+                           "%xmm5", "%xmm6", "%xmm7",)
+              "memory"
+        );
+        reduce_stats(s, res, 32);
+    }
+
+    line_stats_sse2(s, col_sum + (w & ~31), src + (w & ~31), prev + (w & ~31),
+                    w & 31, black_thresh);
+}
+#endif
+
+void ff_qcstats_init_x86(QCStatsDSPContext *dsp)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2)
+        dsp->line_stats = line_stats_sse2;
+#if HAVE_AVX2
+    if (mm_flags & AV_CPU_FLAG_AVX2)
+        dsp->line_stats = line_stats_avx2;
+#endif
+}
@@ -0,0 +1,285 @@
+/*
+ * w3fdif deinterlacer, x86 optimizations
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/w3fdif.h"
+
+/*
+ * Two taps are applied at once with pmaddwd on interleaved samples, 8
+ * samples per iteration. The high frequency taps are applied to the sum of
+ * the current and adjacent field lines, which still fits a signed word for
+ * up to 10 bits per sample.
+ */
+
+#if HAVE_7REGS
+
+#define COEFS(c0, c1) (((c1) << 16) | ((c0) & 0xFFFF))
+
+#define SCALE_8  "1"
+#define SCALE_16 "2"
+
+/* load 8 samples as words */
+#define LOAD_8(mem, reg)  "movq   "mem", "reg" \n\t" \
+                          "punpcklbw %%xmm6, "reg" \n\t"
+#define LOAD_16(mem, reg) "movdqu "mem", "reg" \n\t"
+
+/* multiply the words of xmm0 and xmm1 by the coefficient pair of xmm7 */
+#define MADD                                    \
+    "movdqa    %%xmm0, %%xmm2       \n\t"       \
+    "punpcklwd %%xmm1, %%xmm0       \n\t"       \
+    "punpckhwd %%xmm1, %%xmm2       \n\t"       \
+    "pmaddwd   %%xmm7, %%xmm0       \n\t"       \
+    "pmaddwd   %%xmm7, %%xmm2       \n\t"
+
+#define ACCUMULATE(work)                        \
+    "movdqu      "work", %%xmm3     \n\t"       \
+    "movdqu    16"work", %%xmm4     \n\t"       \
+    "paddd     %%xmm3, %%xmm0       \n\t"       \
+    "paddd     %%xmm4, %%xmm2       \n\t"
+
+#define STORE(work)                             \
+    "movdqu    %%xmm0,   "work"     \n\t"       \
+    "movdqu    %%xmm2, 16"work"     \n\t"
+
+/* work (+)= c0 * a + c1 * b */
+#define LOW_PAIR(depth, name, accumulate)                                   \
+static void low_pair_ ## name ## _ ## depth(int32_t *work, const uint8_t *a, \
+                                            const uint8_t *b, int coefs, int n) \
+{                                                                           \
+    x86_reg i = -n;                                                         \
+                                                                            \
+    __asm__ volatile(                                                       \
+        "movd      %4, %%xmm7               \n\t"                           \
+        "pshufd    $0, %%xmm7, %%xmm7       \n\t"                           \
+        "pxor      %%xmm6, %%xmm6           \n\t"                           \
+        "1:                                 \n\t"                           \
+        LOAD_ ## depth("(%2,%0,"SCALE_ ## depth")", "%%xmm0")               \
+        LOAD_ ## depth("(%3,%0,"SCALE_ ## depth")", "%%xmm1")               \
+        MADD                                                                \
+        accumulate                                                          \
+        STORE("(%1,%0,4)")                                                  \
+        "add       $8, %0                   \n\t"                           \
+        "js 1b                              \n\t"                           \
+        : "+r"(i)                                                           \
+        : "r"(work + n), "r"(a + n * (depth / 8)), "r"(b + n * (depth / 8)), \
+          "r"(coefs)                                                        \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",         \
+                       "%xmm6", "%xmm7",) "memory"                          \
+    );                                                                      \
+}
+
+/* work += c0 * (a + a2) + c1 * (b + b2) */
+#define HIGH_PAIR(depth)                                                    \
+static void high_pair_ ## depth(int32_t *work, const uint8_t *a,            \
+                                const uint8_t *a2, const uint8_t *b,        \
+                                const uint8_t *b2, int coefs, int n)        \
+{                                                                           \
+    x86_reg i = -n;                                                         \
+                                                                            \
+    __asm__ volatile(                                                       \
+        "movd      %6, %%xmm7               \n\t"                           \
+        "pshufd    $0, %%xmm7, %%xmm7       \n\t"                           \
+        "pxor      %%xmm6, %%xmm6           \n\t"                           \
+        "1:                                 \n\t"                           \
+        LOAD_ ## depth("(%2,%0,"SCALE_ ## depth")", "%%xmm0")               \
+        LOAD_ ## depth("(%3,%0,"SCALE_ ## depth")", "%%xmm3")               \
+        LOAD_ ## depth("(%4,%0,"SCALE_ ## depth")", "%%xmm1")               \
+        LOAD_ ## depth("(%5,%0,"SCALE_ ## depth")", "%%xmm4")               \
+        "paddw     %%xmm3, %%xmm0           \n\t"                           \
+        "paddw     %%xmm4, %%xmm1           \n\t"                           \
+        MADD                                                                \
+        ACCUMULATE("(%1,%0,4)")                                             \
+        STORE("(%1,%0,4)")                                                  \
+        "add       $8, %0                   \n\t"                           \
+        "js 1b                              \n\t"                           \
+        : "+r"(i)                                                           \
+        : "r"(work + n), "r"(a + n * (depth / 8)), "r"(a2 + n * (depth / 8)), \
+          "r"(b + n * (depth / 8)), "r"(b2 + n * (depth / 8)), "m"(coefs)   \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",         \
+                       "%xmm6", "%xmm7",) "memory"                          \
+    );                                                                      \
+}
+
+LOW_PAIR(8,  set, )
+LOW_PAIR(8,  add, ACCUMULATE("(%1,%0,4)"))
+LOW_PAIR(16, set, )
+LOW_PAIR(16, add, ACCUMULATE("(%1,%0,4)"))
+HIGH_PAIR(8)
+HIGH_PAIR(16)
+
+static void scale_8(uint8_t *out, const int32_t *work, int n, int max)
+{
+    x86_reg i = -n;
+
+    __asm__ volatile(
+        "1:                                 \n\t"
+        "movdqu      (%1,%0,4), %%xmm0      \n\t"
+        "movdqu    16(%1,%0,4), %%xmm1      \n\t"
+        "psrad     $15, %%xmm0              \n\t"
+        "psrad     $15, %%xmm1              \n\t"
+        "packssdw  %%xmm1, %%xmm0           \n\t"
+        "packuswb  %%xmm0, %%xmm0           \n\t"
+        "movq      %%xmm0, (%2,%0)          \n\t"
+        "add       $8, %0                   \n\t"
+        "js 1b                              \n\t"
+        : "+r"(i)
+        : "r"(work + n), "r"(out + n)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+}
+
+static void scale_16(uint8_t *out, const int32_t *work, int n, int max)
+{
+    x86_reg i = -n;
+
+    __asm__ volatile(
+        "movd      %3, %%xmm7               \n\t"
+        "pshuflw   $0, %%xmm7, %%xmm7       \n\t"
+        "punpcklqdq %%xmm7, %%xmm7          \n\t"
+        "pxor      %%xmm6, %%xmm6           \n\t"
+        "1:                                 \n\t"
+        "movdqu      (%1,%0,4), %%xmm0      \n\t"
+        "movdqu    16(%1,%0,4), %%xmm1      \n\t"
+        "psrad     $15, %%xmm0              \n\t"
+        "psrad     $15, %%xmm1              \n\t"
+        "packssdw  %%xmm1, %%xmm0           \n\t"
+        "pmaxsw    %%xmm6, %%xmm0           \n\t"
+        "pminsw    %%xmm7, %%xmm0           \n\t"
+        "movdqu    %%xmm0, (%2,%0,2)        \n\t"
+        "add       $8, %0                   \n\t"
+        "js 1b                              \n\t"
+        : "+r"(i)
+        : "r"(work + n), "r"(out + 2 * n), "r"(max)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6", "%xmm7",) "memory"
+    );
+}
+
+/* the SIMD loops do 8 samples per iteration, the remaining ones are done in C */
+#define FUNCS(depth)                                                        \
+static void filter_simple_low_ ## depth ## _sse2(int32_t *work_line,        \
+                                                 uint8_t *in_lines_cur[2],  \
+                                                 const int16_t *coef,       \
+                                                 int linesize)              \
+{                                                                           \
+    int n = linesize & ~7;                                                  \
+                                                                            \
+    if (n)                                                                  \
+        low_pair_set_ ## depth(work_line, in_lines_cur[0], in_lines_cur[1], \
+                               COEFS(coef[0], coef[1]), n);                 \
+    w3fdif_filter_low(work_line, in_lines_cur, coef, 2, n, linesize, depth); \
+}                                                                           \
+                                                                            \
+static void filter_complex_low_ ## depth ## _sse2(int32_t *work_line,       \
+                                                  uint8_t *in_lines_cur[4], \
+                                                  const int16_t *coef,      \
+                                                  int linesize)             \
+{                                                                           \
+    int n = linesize & ~7;                                                  \
+                                                                            \
+    if (n) {                                                                \
+        low_pair_set_ ## depth(work_line, in_lines_cur[0], in_lines_cur[1], \
+                               COEFS(coef[0], coef[1]), n);                 \
+        low_pair_add_ ## depth(work_line, in_lines_cur[2], in_lines_cur[3], \
+                               COEFS(coef[2], coef[3]), n);                 \
+    }                                                                       \
+    w3fdif_filter_low(work_line, in_lines_cur, coef, 4, n, linesize, depth); \
+}                                                                           \
+                                                                            \
+static void filter_simple_high_ ## depth ## _sse2(int32_t *work_line,       \
+                                                  uint8_t *in_lines_cur[3], \
+                                                  uint8_t *in_lines_adj[3], \
+                                                  const int16_t *coef,      \
+                                                  int linesize)             \
+{                                                                           \
+    int n = linesize & ~7;                                                  \
+                                                                            \
+    if (n) {                                                                \
+        high_pair_ ## depth(work_line, in_lines_cur[0], in_lines_adj[0],    \
+                            in_lines_cur[1], in_lines_adj[1],               \
+                            COEFS(coef[0], coef[1]), n);                    \
+        high_pair_ ## depth(work_line, in_lines_cur[2], in_lines_adj[2],    \
+                            in_lines_cur[2], in_lines_adj[2],               \
+                            COEFS(coef[2], 0), n);                          \
+    }                                                                       \
+    w3fdif_filter_high(work_line, in_lines_cur, in_lines_adj, coef, 3,      \
+                       n, linesize, depth);                                 \
+}                                                                           \
+                                                                            \
+static void filter_complex_high_ ## depth ## _sse2(int32_t *work_line,      \
+                                                   uint8_t *in_lines_cur[5], \
+                                                   uint8_t *in_lines_adj[5], \
+                                                   const int16_t *coef,     \
+                                                   int linesize)            \
+{                                                                           \
+    int n = linesize & ~7;                                                  \
+                                                                            \
+    if (n) {                                                                \
+        high_pair_ ## depth(work_line, in_lines_cur[0], in_lines_adj[0],    \
+                            in_lines_cur[1], in_lines_adj[1],               \
+                            COEFS(coef[0], coef[1]), n);                    \
+        high_pair_ ## depth(work_line, in_lines_cur[2], in_lines_adj[2],    \
+                            in_lines_cur[3], in_lines_adj[3],               \
+                            COEFS(coef[2], coef[3]), n);                    \
+        high_pair_ ## depth(work_line, in_lines_cur[4], in_lines_adj[4],    \
+                            in_lines_cur[4], in_lines_adj[4],               \
+                            COEFS(coef[4], 0), n);                          \
+    }                                                                       \
+    w3fdif_filter_high(work_line, in_lines_cur, in_lines_adj, coef, 5,      \
+                       n, linesize, depth);                                 \
+}                                                                           \
+                                                                            \
+static void filter_scale_ ## depth ## _sse2(uint8_t *out_pixel,             \
+                                            const int32_t *work_pixel,      \
+                                            int linesize, int max)          \
+{                                                                           \
+    int n = linesize & ~7;                                                  \
+                                                                            \
+    if (n)                                                                  \
+        scale_ ## depth(out_pixel, work_pixel, n, max);                     \
+    w3fdif_filter_scale(out_pixel, work_pixel, n, linesize, max, depth);    \
+}
+
+FUNCS(8)
+FUNCS(16)
+
+#endif /* HAVE_7REGS */
+
+void ff_w3fdif_init_x86(W3FDIFDSPContext *dsp, int depth)
+{
+#if HAVE_7REGS
+    int mm_flags = av_get_cpu_flags();
+
+    if (!(mm_flags & AV_CPU_FLAG_SSE2))
+        return;
+    if (depth <= 8) {
+        dsp->filter_simple_low   = filter_simple_low_8_sse2;
+        dsp->filter_complex_low  = filter_complex_low_8_sse2;
+        dsp->filter_simple_high  = filter_simple_high_8_sse2;
+        dsp->filter_complex_high = filter_complex_high_8_sse2;
+        dsp->filter_scale        = filter_scale_8_sse2;
+    } else if (depth <= 10) {
+        dsp->filter_simple_low   = filter_simple_low_16_sse2;
+        dsp->filter_complex_low  = filter_complex_low_16_sse2;
+        dsp->filter_simple_high  = filter_simple_high_16_sse2;
+        dsp->filter_complex_high = filter_complex_high_16_sse2;
+        dsp->filter_scale        = filter_scale_16_sse2;
+    }
+#endif
+}
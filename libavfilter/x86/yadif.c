@@ -25,12 +25,21 @@
 DECLARE_ASM_CONST(16, xmm_reg, pb_1) = {0x0101010101010101ULL, 0x0101010101010101ULL};
 DECLARE_ASM_CONST(16, xmm_reg, pw_1) = {0x0001000100010001ULL, 0x0001000100010001ULL};
 
+#if HAVE_AVX2 && HAVE_SSSE3
+#define COMPILE_TEMPLATE_AVX2 1
+#undef RENAME
+#define RENAME(a) a ## _avx2
+#include "yadif_10bit_template.c"
+#undef COMPILE_TEMPLATE_AVX2
+#endif
+
 #if HAVE_SSSE3
 #define COMPILE_TEMPLATE_SSE 1
 #define COMPILE_TEMPLATE_SSSE3 1
 #undef RENAME
 #define RENAME(a) a ## _ssse3
 #include "yadif_template.c"
+#include "yadif_10bit_template.c"
 #undef COMPILE_TEMPLATE_SSSE3
 #endif
 
@@ -38,6 +47,7 @@ DECLARE_ASM_CONST(16, xmm_reg, pw_1) = {0x0001000100010001ULL, 0x000100010001000
 #undef RENAME
 #define RENAME(a) a ## _sse2
 #include "yadif_template.c"
+#include "yadif_10bit_template.c"
 #undef COMPILE_TEMPLATE_SSE
 #endif
 
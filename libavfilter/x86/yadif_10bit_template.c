@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2006 Michael Niedermayer <michaelni@gmx.at>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Same algorithm as yadif_template.c on 16-bit words. Samples are loaded
+ * without unpacking and all intermediate values stay in signed words, which
+ * holds for samples of up to 12 bits: the spatial score is at most
+ * 3 * 4095 and the penalty added by CHECK2 is 1 << 14.
+ */
+
+#ifdef COMPILE_TEMPLATE_AVX2
+#define MM "%%ymm"
+#define STEP 16
+#define MOVA  "vmovdqa"
+#define MOVU  "vmovdqu"
+#define OP(op,src,dst) "v"op"  "src", "dst", "dst" \n\t"
+#define PABS(tmp,dst) \
+            "vpabsw    "dst", "dst" \n\t"
+#else
+#define MM "%%xmm"
+#define STEP 8
+#define MOVA  "movdqa"
+#define MOVU  "movdqu"
+#define OP(op,src,dst) op"  "src", "dst" \n\t"
+#ifdef COMPILE_TEMPLATE_SSSE3
+#define PABS(tmp,dst) \
+            "pabsw     "dst", "dst" \n\t"
+#else
+#define PABS(tmp,dst) \
+            "pxor     "tmp", "tmp" \n\t"\
+            "psubw    "dst", "tmp" \n\t"\
+            "pmaxsw   "tmp", "dst" \n\t"
+#endif
+#endif
+
+#define MOV(src,dst) MOVA" "src", "dst" \n\t"
+#define LOAD(mem,dst) MOVU" "mem", "dst" \n\t"
+#define TMP(n) #n"*2*"AV_STRINGIFY(STEP)"(%[tmpA])"
+
+/* offsets are in bytes, j is a sample offset: 2*j-2 and -2*j-2 */
+#define CHECK(pj,mj) \
+            LOAD(#pj"+2(%[cur],%[mrefs])", MM"5") /* cur[x-refs+j] */\
+            LOAD(#mj"+2(%[cur],%[prefs])", MM"4") /* cur[x+refs-j] */\
+            MOV(MM"5", MM"2")\
+            OP("paddw",  MM"4", MM"5")\
+            OP("psrlw",  "$1",  MM"5") /* (cur[x-refs+j] + cur[x+refs-j])>>1 */\
+            OP("psubw",  MM"4", MM"2")\
+            PABS(        MM"3", MM"2")\
+            LOAD(#pj"(%[cur],%[mrefs])", MM"3") /* cur[x-refs-1+j] */\
+            LOAD(#mj"(%[cur],%[prefs])", MM"4") /* cur[x+refs-1-j] */\
+            OP("psubw",  MM"4", MM"3")\
+            PABS(        MM"4", MM"3")\
+            OP("paddw",  MM"3", MM"2")\
+            LOAD(#pj"+4(%[cur],%[mrefs])", MM"3") /* cur[x-refs+1+j] */\
+            LOAD(#mj"+4(%[cur],%[prefs])", MM"4") /* cur[x+refs+1-j] */\
+            OP("psubw",  MM"4", MM"3")\
+            PABS(        MM"4", MM"3")\
+            OP("paddw",  MM"3", MM"2") /* score */
+
+#define CHECK1 \
+            MOV(MM"0", MM"3")\
+            OP("pcmpgtw", MM"2", MM"3") /* if(score < spatial_score) */\
+            OP("pminsw",  MM"2", MM"0") /* spatial_score= score; */\
+            MOV(MM"3", MM"6")\
+            OP("pand",    MM"3", MM"5")\
+            OP("pandn",   MM"1", MM"3")\
+            OP("por",     MM"5", MM"3")\
+            MOV(MM"3", MM"1") /* spatial_pred= (cur[x-refs+j] + cur[x+refs-j])>>1; */
+
+#define CHECK2 /* pretend not to have checked dir=2 if dir=1 was bad.\
+                  hurts both quality and speed, but matches the C version. */\
+            OP("paddw",   MM"7", MM"6")\
+            OP("psllw",   "$14", MM"6")\
+            OP("paddsw",  MM"6", MM"2")\
+            MOV(MM"0", MM"3")\
+            OP("pcmpgtw", MM"2", MM"3")\
+            OP("pminsw",  MM"2", MM"0")\
+            OP("pand",    MM"3", MM"5")\
+            OP("pandn",   MM"1", MM"3")\
+            OP("por",     MM"5", MM"3")\
+            MOV(MM"3", MM"1")
+
+void RENAME(ff_yadif_filter_line_10bit)(uint16_t *dst,
+                                        uint16_t *prev, uint16_t *cur, uint16_t *next,
+                                        int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t tmp[4*2*STEP + 31];
+    uint8_t *tmpA= (uint8_t*)(((uintptr_t)(tmp+31)) & ~31);
+    int x, w_simd = w;
+
+#ifdef COMPILE_TEMPLATE_AVX2
+    /* the last columns are left to the SSSE3 version, the rows are only
+       padded to 16 bytes */
+    w_simd &= ~(STEP-1);
+#endif
+
+#define FILTER\
+    for(x=0; x<w_simd; x+=STEP){\
+        __asm__ volatile(\
+            LOAD("(%[cur],%[mrefs])", MM"0") /* c = cur[x-refs] */\
+            LOAD("(%[cur],%[prefs])", MM"1") /* e = cur[x+refs] */\
+            LOAD("(%["prev2"])", MM"2") /* prev2[x] */\
+            LOAD("(%["next2"])", MM"3") /* next2[x] */\
+            MOV(MM"3", MM"4")\
+            OP("paddw",  MM"2", MM"3")\
+            OP("psrlw",  "$1",  MM"3") /* d = (prev2[x] + next2[x])>>1 */\
+            MOV(MM"0", TMP(0)) /* c */\
+            MOV(MM"3", TMP(1)) /* d */\
+            MOV(MM"1", TMP(2)) /* e */\
+            OP("psubw",  MM"4", MM"2")\
+            PABS(        MM"4", MM"2") /* temporal_diff0 */\
+            LOAD("(%[prev],%[mrefs])", MM"3") /* prev[x-refs] */\
+            LOAD("(%[prev],%[prefs])", MM"4") /* prev[x+refs] */\
+            OP("psubw",  MM"0", MM"3")\
+            OP("psubw",  MM"1", MM"4")\
+            PABS(        MM"5", MM"3")\
+            PABS(        MM"5", MM"4")\
+            OP("paddw",  MM"4", MM"3") /* temporal_diff1 */\
+            OP("psrlw",  "$1",  MM"2")\
+            OP("psrlw",  "$1",  MM"3")\
+            OP("pmaxsw", MM"3", MM"2")\
+            LOAD("(%[next],%[mrefs])", MM"3") /* next[x-refs] */\
+            LOAD("(%[next],%[prefs])", MM"4") /* next[x+refs] */\
+            OP("psubw",  MM"0", MM"3")\
+            OP("psubw",  MM"1", MM"4")\
+            PABS(        MM"5", MM"3")\
+            PABS(        MM"5", MM"4")\
+            OP("paddw",  MM"4", MM"3") /* temporal_diff2 */\
+            OP("psrlw",  "$1",  MM"3")\
+            OP("pmaxsw", MM"3", MM"2")\
+            MOV(MM"2", TMP(3)) /* diff */\
+\
+            OP("paddw",  MM"0", MM"1")\
+            OP("paddw",  MM"0", MM"0")\
+            OP("psubw",  MM"1", MM"0")\
+            OP("psrlw",  "$1",  MM"1") /* spatial_pred */\
+            PABS(        MM"2", MM"0") /* ABS(c-e) */\
+\
+            LOAD("-2(%[cur],%[mrefs])", MM"2") /* cur[x-refs-1] */\
+            LOAD("-2(%[cur],%[prefs])", MM"3") /* cur[x+refs-1] */\
+            OP("psubw",  MM"3", MM"2")\
+            PABS(        MM"3", MM"2")\
+            OP("paddw",  MM"2", MM"0")\
+            LOAD("2(%[cur],%[mrefs])", MM"2") /* cur[x-refs+1] */\
+            LOAD("2(%[cur],%[prefs])", MM"3") /* cur[x+refs+1] */\
+            OP("psubw",  MM"3", MM"2")\
+            PABS(        MM"3", MM"2")\
+            OP("paddw",  MM"2", MM"0")\
+            OP("pcmpeqw", MM"7", MM"7")\
+            OP("psrlw",  "$15", MM"7") /* pw_1 */\
+            OP("psubw",  MM"7", MM"0") /* spatial_score */\
+\
+            CHECK(-4,0)\
+            CHECK1\
+            CHECK(-6,2)\
+            CHECK2\
+            CHECK(0,-4)\
+            CHECK1\
+            CHECK(2,-6)\
+            CHECK2\
+\
+            /* if(p->mode<2) ... */\
+            MOV(TMP(3), MM"6") /* diff */\
+            "cmpl      $2, %[mode] \n\t"\
+            "jge       1f \n\t"\
+            LOAD("(%["prev2"],%[mrefs],2)", MM"2") /* prev2[x-2*refs] */\
+            LOAD("(%["next2"],%[mrefs],2)", MM"4") /* next2[x-2*refs] */\
+            LOAD("(%["prev2"],%[prefs],2)", MM"3") /* prev2[x+2*refs] */\
+            LOAD("(%["next2"],%[prefs],2)", MM"5") /* next2[x+2*refs] */\
+            OP("paddw",  MM"4", MM"2")\
+            OP("paddw",  MM"5", MM"3")\
+            OP("psrlw",  "$1",  MM"2") /* b */\
+            OP("psrlw",  "$1",  MM"3") /* f */\
+            MOV(TMP(0), MM"4") /* c */\
+            MOV(TMP(1), MM"5") /* d */\
+            MOV(TMP(2), MM"7") /* e */\
+            OP("psubw",  MM"4", MM"2") /* b-c */\
+            OP("psubw",  MM"7", MM"3") /* f-e */\
+            MOV(MM"5", MM"0")\
+            OP("psubw",  MM"4", MM"5") /* d-c */\
+            OP("psubw",  MM"7", MM"0") /* d-e */\
+            MOV(MM"2", MM"4")\
+            OP("pminsw", MM"3", MM"2")\
+            OP("pmaxsw", MM"4", MM"3")\
+            OP("pmaxsw", MM"5", MM"2")\
+            OP("pminsw", MM"5", MM"3")\
+            OP("pmaxsw", MM"0", MM"2") /* max */\
+            OP("pminsw", MM"0", MM"3") /* min */\
+            OP("pxor",   MM"4", MM"4")\
+            OP("pmaxsw", MM"3", MM"6")\
+            OP("psubw",  MM"2", MM"4") /* -max */\
+            OP("pmaxsw", MM"4", MM"6") /* diff= MAX3(diff, min, -max); */\
+            "1: \n\t"\
+\
+            MOV(TMP(1), MM"2") /* d */\
+            MOV(MM"2", MM"3")\
+            OP("psubw",  MM"6", MM"2") /* d-diff */\
+            OP("paddw",  MM"6", MM"3") /* d+diff */\
+            OP("pmaxsw", MM"2", MM"1")\
+            OP("pminsw", MM"3", MM"1") /* d = clip(spatial_pred, d-diff, d+diff); */\
+\
+            :\
+            :[tmpA] "r"(tmpA),\
+             [prev] "r"(prev),\
+             [cur]  "r"(cur),\
+             [next] "r"(next),\
+             [prefs]"r"((x86_reg)prefs),\
+             [mrefs]"r"((x86_reg)mrefs),\
+             [mode] "g"(mode)\
+        );\
+        __asm__ volatile(MOVU" "MM"1, %0" :"=m"(*dst));\
+        dst += STEP;\
+        prev+= STEP;\
+        cur += STEP;\
+        next+= STEP;\
+    }
+
+    if (parity) {
+#define prev2 "prev"
+#define next2 "cur"
+        FILTER
+#undef prev2
+#undef next2
+    } else {
+#define prev2 "cur"
+#define next2 "next"
+        FILTER
+#undef prev2
+#undef next2
+    }
+
+#ifdef COMPILE_TEMPLATE_AVX2
+    __asm__ volatile("vzeroupper \n\t");
+    if (w > w_simd)
+        ff_yadif_filter_line_10bit_ssse3(dst, prev, cur, next, w - w_simd,
+                                         prefs, mrefs, parity, mode);
+#endif
+}
+#undef STEP
+#undef MM
+#undef MOVA
+#undef MOVU
+#undef OP
+#undef MOV
+#undef LOAD
+#undef TMP
+#undef PABS
+#undef CHECK
+#undef CHECK1
+#undef CHECK2
+#undef FILTER
@@ -32,4 +32,19 @@ void ff_yadif_filter_line_ssse3(uint8_t *dst,
                                 uint8_t *prev, uint8_t *cur, uint8_t *next,
                                 int w, int prefs, int mrefs, int parity, int mode);
 
+/**
+ * 16-bit versions, for samples of up to 12 bits; prefs and mrefs are in bytes.
+ */
+void ff_yadif_filter_line_10bit_sse2(uint16_t *dst,
+                                     uint16_t *prev, uint16_t *cur, uint16_t *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+
+void ff_yadif_filter_line_10bit_ssse3(uint16_t *dst,
+                                      uint16_t *prev, uint16_t *cur, uint16_t *next,
+                                      int w, int prefs, int mrefs, int parity, int mode);
+
+void ff_yadif_filter_line_10bit_avx2(uint16_t *dst,
+                                     uint16_t *prev, uint16_t *cur, uint16_t *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+
 #endif /* AVFILTER_YADIF_H */
@@ -70,6 +70,23 @@ int ff_audio_interleave_init(AVFormatContext *s,
     return 0;
 }
 
+/**
+ * Set the timestamps of the next audio frame in pkt.
+ */
+static void audio_frame_timing(AVStream *st, AVPacket *pkt)
+{
+    AudioInterleaveContext *aic = st->priv_data;
+
+    pkt->dts = pkt->pts = aic->dts;
+    pkt->duration = av_rescale_q(*aic->samples, st->time_base, aic->time_base);
+    pkt->stream_index = st->index;
+    aic->dts += pkt->duration;
+
+    aic->samples++;
+    if (!*aic->samples)
+        aic->samples = aic->samples_per_frame;
+}
+
 int ff_audio_interleave_new_packet(AVFormatContext *s, AVPacket *pkt,
                                    int stream_index, int flush)
 {
@@ -86,14 +103,7 @@ int ff_audio_interleave_new_packet(AVFormatContext *s, AVPacket *pkt,
     if (size < pkt->size)
         memset(pkt->data + size, 0, pkt->size - size);
 
-    pkt->dts = pkt->pts = aic->dts;
-    pkt->duration = av_rescale_q(*aic->samples, st->time_base, aic->time_base);
-    pkt->stream_index = stream_index;
-    aic->dts += pkt->duration;
-
-    aic->samples++;
-    if (!*aic->samples)
-        aic->samples = aic->samples_per_frame;
+    audio_frame_timing(st, pkt);
 
     return frame_size;
 }
@@ -102,24 +112,34 @@ int ff_audio_rechunk_interleave(AVFormatContext *s, AVPacket *out, AVPacket *pkt
                         int (*get_packet)(AVFormatContext *, AVPacket *, AVPacket *, int),
                         int (*compare_ts)(AVFormatContext *, AVPacket *, AVPacket *))
 {
-    int i;
+    int i, ret;
 
     if (pkt) {
         AVStream *st = s->streams[pkt->stream_index];
         AudioInterleaveContext *aic = st->priv_data;
         if (st->codec->codec_type == AVMEDIA_TYPE_AUDIO) {
-            unsigned new_size = av_fifo_size(aic->fifo) + pkt->size;
-            if (new_size > aic->fifo_size) {
-                if (av_fifo_realloc2(aic->fifo, new_size) < 0)
-                    return -1;
-                aic->fifo_size = new_size;
+            if (!av_fifo_size(aic->fifo) &&
+                pkt->size == *aic->samples * aic->sample_size) {
+                /* exactly one frame, queue it as is instead of
+                   copying it through the fifo */
+                audio_frame_timing(st, pkt);
+                if ((ret = ff_interleave_add_packet(s, pkt, compare_ts)) < 0)
+                    return ret;
+            } else {
+                unsigned new_size = av_fifo_size(aic->fifo) + pkt->size;
+                if (new_size > aic->fifo_size) {
+                    if (av_fifo_realloc2(aic->fifo, new_size) < 0)
+                        return -1;
+                    aic->fifo_size = new_size;
+                }
+                av_fifo_generic_write(aic->fifo, pkt->data, pkt->size, NULL);
             }
-            av_fifo_generic_write(aic->fifo, pkt->data, pkt->size, NULL);
         } else {
             // rewrite pts and dts to be decoded time line position
             pkt->pts = pkt->dts = aic->dts;
             aic->dts += pkt->duration;
-            ff_interleave_add_packet(s, pkt, compare_ts);
+            if ((ret = ff_interleave_add_packet(s, pkt, compare_ts)) < 0)
+                return ret;
         }
         pkt = NULL;
     }
@@ -129,7 +149,8 @@ int ff_audio_rechunk_interleave(AVFormatContext *s, AVPacket *out, AVPacket *pkt
         if (st->codec->codec_type == AVMEDIA_TYPE_AUDIO) {
             AVPacket new_pkt;
             while (ff_audio_interleave_new_packet(s, &new_pkt, i, flush))
-                ff_interleave_add_packet(s, &new_pkt, compare_ts);
+                if ((ret = ff_interleave_add_packet(s, &new_pkt, compare_ts)) < 0)
+                    return ret;
         }
     }
 
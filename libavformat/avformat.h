@@ -277,6 +277,9 @@ typedef struct AVFormatParameters {
 #define AVFMT_TS_NONSTRICT  0x8000 /**< Format does not require strictly
                                           increasing timestamps, but they must
                                           still be monotonic */
+#define AVFMT_TRUSTED_HEADER 0x10000 /**< Stream parameters set by read_header()
+                                          describe the essence exactly, see
+                                          AVFMT_FLAG_FAST_OPEN */
 
 typedef struct AVOutputFormat {
     const char *name;
@@ -401,7 +404,7 @@ typedef struct AVInputFormat {
                               int64_t *pos, int64_t pos_limit);
 
     /**
-     * Can use flags: AVFMT_NOFILE, AVFMT_NEEDNUMBER.
+     * Can use flags: AVFMT_NOFILE, AVFMT_NEEDNUMBER, AVFMT_TRUSTED_HEADER.
      */
     int flags;
 
@@ -605,11 +608,14 @@ typedef struct AVStream {
 #define MAX_PROBE_PACKETS 2500
     int probe_packets;
 
+#if FF_API_LAST_IN_PACKET_BUFFER
     /**
-     * last packet in packet_buffer for this stream when muxing.
-     * used internally, NOT PART OF PUBLIC API, dont read or write from outside of libav*
+     * Unused, the packets waiting to be interleaved are kept in
+     * AVFormatContext.interleaver.
+     * NOT PART OF PUBLIC API
      */
-    struct AVPacketList *last_in_packet_buffer;
+    attribute_deprecated struct AVPacketList *last_in_packet_buffer;
+#endif
 
     /**
      * Average framerate
@@ -766,6 +772,7 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_SORT_DTS    0x10000 ///< try to interleave outputted packets by dts (using this flag can slow demuxing down)
 #define AVFMT_FLAG_PRIV_OPT    0x20000 ///< Enable use of private options by delaying codec open (this could be made default once all code is converted)
 #define AVFMT_FLAG_KEEP_SIDE_DATA 0x40000 ///< Dont merge side data but keep it seperate.
+#define AVFMT_FLAG_FAST_OPEN   0x80000 ///< Trust the header of AVFMT_TRUSTED_HEADER formats in av_find_stream_info(), only read and decode packets for the parameters it does not give
 
 #if FF_API_LOOP_INPUT
     /**
@@ -882,6 +889,19 @@ typedef struct AVFormatContext {
      * duration are known as FFmpeg can compute it automatically.
      */
     int64_t bit_rate;
+
+    /**
+     * Decoding: number of bytes read from the input by
+     * avformat_open_input() and avformat_find_stream_info().
+     * - decoding: Set by libavformat.
+     */
+    int64_t probe_bytes;
+
+    /**
+     * Muxing: per stream queues of the packets waiting to be interleaved.
+     * NOT PART OF PUBLIC API
+     */
+    struct PacketInterleaver *interleaver;
 } AVFormatContext;
 
 typedef struct AVPacketList {
@@ -87,6 +87,7 @@ typedef struct {
      */
     int seekable;
     unsigned char *max_buf_ptr; /**< max written position in buf */
+    int64_t bytes_read;         /**< number of bytes read with read_packet() */
 } AVIOContext;
 
 /* unbuffered I/O */
@@ -67,6 +67,7 @@ int ffio_init_context(AVIOContext *s,
     s->max_packet_size = 0;
     s->update_checksum= NULL;
     s->max_buf_ptr = s->buf_ptr;
+    s->bytes_read = 0;
     if(!read_packet && !write_flag){
         s->pos = buffer_size;
         s->buf_end = s->buffer + buffer_size;
@@ -588,6 +589,7 @@ static void fill_buffer(AVIOContext *s)
             s->error= len;
     } else {
         s->pos += len;
+        s->bytes_read += len;
         s->buf_ptr = dst;
         s->buf_end = dst + len;
     }
@@ -660,6 +662,7 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
                     break;
                 } else {
                     s->pos += len;
+                    s->bytes_read += len;
                     size -= len;
                     buf += len;
                     s->buf_ptr = s->buffer;
@@ -320,6 +320,8 @@ static int gxf_header(AVFormatContext *s, AVFormatParameters *ap) {
             main_timebase.den = si->frames_per_second.num * 2;
         }
         st->start_time = si->first_field;
+        if (st->codec->codec_type == AVMEDIA_TYPE_VIDEO && si->frames_per_second.num)
+            st->r_frame_rate = si->frames_per_second;
         if (si->first_field != AV_NOPTS_VALUE && si->last_field != AV_NOPTS_VALUE)
             st->duration = si->last_field - si->first_field;
     }
@@ -529,4 +531,5 @@ AVInputFormat ff_gxf_demuxer = {
     .read_packet    = gxf_packet,
     .read_seek      = gxf_seek,
     .read_timestamp = gxf_read_timestamp,
+    .flags          = AVFMT_TRUSTED_HEADER,
 };
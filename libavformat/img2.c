@@ -20,6 +20,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE     /* Needed for O_DIRECT with glibc */
+
 #include "libavutil/intreadwrite.h"
 #include "libavutil/avstring.h"
 #include "libavutil/log.h"
@@ -30,6 +32,23 @@
 #include "avio_internal.h"
 #include "internal.h"
 #include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#ifdef O_DIRECT
+/** O_DIRECT buffers, file offsets and read sizes are aligned to this */
+#define DIRECT_ALIGN 4096
+#endif
+
+typedef struct {
+    AVPacket pkt;
+    int ret;
+    int done;                  /**< set by the worker once pkt and ret are valid */
+} ReadAheadSlot;
 
 typedef struct {
     const AVClass *class;  /**< Class for private options. */
@@ -44,6 +63,18 @@ typedef struct {
     char *video_size;       /**< Set by a private option. */
     char *framerate;        /**< Set by a private option. */
     int loop;
+    int readahead;          /**< number of files read in parallel, set by a private option */
+    int direct;             /**< read ahead with O_DIRECT, set by a private option */
+#if HAVE_PTHREADS
+    pthread_t *workers;
+    int nb_workers;
+    ReadAheadSlot *slots;   /**< readahead entries, the packet of index i in slots[i % readahead] */
+    int64_t seq;            /**< index of the next packet to return */
+    int64_t next_seq;       /**< index of the next file to read */
+    int abort;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
 } VideoData;
 
 typedef struct {
@@ -209,6 +240,213 @@ enum CodecID av_guess_image2_codec(const char *filename){
 }
 #endif
 
+#if HAVE_PTHREADS
+#ifdef O_DIRECT
+static void destruct_direct(AVPacket *pkt)
+{
+    av_free(pkt->priv);
+    pkt->data = NULL;
+    pkt->size = 0;
+    pkt->priv = NULL;
+}
+
+/**
+ * Read a whole file with O_DIRECT.
+ * @return AVERROR(ENOSYS) if the file can not be read that way
+ */
+static int read_file_direct(const char *filename, AVPacket *pkt)
+{
+    struct stat st;
+    uint8_t *buf, *data;
+    int fd, size, pos = 0, ret = 0;
+
+    av_strstart(filename, "file:", &filename);
+    if ((fd = open(filename, O_RDONLY | O_DIRECT)) < 0)
+        return AVERROR(ENOSYS);
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        st.st_size > INT_MAX - 2 * DIRECT_ALIGN - FF_INPUT_BUFFER_PADDING_SIZE) {
+        close(fd);
+        return AVERROR(ENOSYS);
+    }
+    size = st.st_size;
+    buf  = av_malloc(FFALIGN(size + FF_INPUT_BUFFER_PADDING_SIZE, DIRECT_ALIGN) + DIRECT_ALIGN - 1);
+    if (!buf) {
+        close(fd);
+        return AVERROR(ENOMEM);
+    }
+    data = (uint8_t *)FFALIGN((uintptr_t)buf, DIRECT_ALIGN);
+    while (pos < size && (ret = read(fd, data + pos, FFALIGN(size - pos, DIRECT_ALIGN))) > 0)
+        pos += ret;
+    close(fd);
+    /* some filesystems accept O_DIRECT in open() but not in read() */
+    if (pos != size) {
+        av_free(buf);
+        return AVERROR(ENOSYS);
+    }
+    memset(data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+    av_init_packet(pkt);
+    pkt->data     = data;
+    pkt->size     = size;
+    pkt->priv     = buf;
+    pkt->destruct = destruct_direct;
+    return 0;
+}
+#endif
+
+static int read_file(AVFormatContext *s1, const char *filename, int direct,
+                     AVPacket *pkt)
+{
+    AVIOContext *f;
+    int64_t size;
+    int ret;
+
+#ifdef O_DIRECT
+    if (direct && (ret = read_file_direct(filename, pkt)) != AVERROR(ENOSYS))
+        return ret;
+#endif
+    if (avio_open(&f, filename, AVIO_FLAG_READ) < 0) {
+        av_log(s1, AV_LOG_ERROR, "Could not open file : %s\n", filename);
+        return AVERROR(EIO);
+    }
+    size = avio_size(f);
+    if (size <= 0 || size > INT_MAX - FF_INPUT_BUFFER_PADDING_SIZE) {
+        avio_close(f);
+        return AVERROR(EIO);
+    }
+    if ((ret = av_new_packet(pkt, size)) < 0) {
+        avio_close(f);
+        return ret;
+    }
+    ret = avio_read(f, pkt->data, size);
+    avio_close(f);
+    if (ret <= 0) {
+        av_free_packet(pkt);
+        return AVERROR(EIO);
+    }
+    pkt->size = ret;
+    memset(pkt->data + ret, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    return 0;
+}
+
+static void *readahead_worker(void *arg)
+{
+    AVFormatContext *s1 = arg;
+    VideoData *s = s1->priv_data;
+    int nb_images = s->img_last - s->img_first + 1;
+    char filename[1024];
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        ReadAheadSlot *slot;
+        int number, ret;
+
+        while (!s->abort && (s->next_seq - s->seq >= s->readahead ||
+                             (!s->loop && s->next_seq >= nb_images)))
+            pthread_cond_wait(&s->cond, &s->lock);
+        if (s->abort)
+            break;
+        number = s->img_first + s->next_seq % nb_images;
+        slot   = &s->slots[s->next_seq++ % s->readahead];
+        pthread_mutex_unlock(&s->lock);
+
+        if (av_get_frame_filename(filename, sizeof(filename), s->path, number) < 0 && number > 1)
+            ret = AVERROR(EIO);
+        else
+            ret = read_file(s1, filename, s->direct, &slot->pkt);
+
+        pthread_mutex_lock(&s->lock);
+        slot->ret  = ret;
+        slot->done = 1;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+static void readahead_stop(VideoData *s)
+{
+    int i;
+
+    pthread_mutex_lock(&s->lock);
+    s->abort = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    for (i = 0; i < s->nb_workers; i++)
+        pthread_join(s->workers[i], NULL);
+    for (i = 0; i < s->readahead; i++)
+        if (s->slots[i].done && s->slots[i].ret >= 0)
+            av_free_packet(&s->slots[i].pkt);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    av_freep(&s->workers);
+    av_freep(&s->slots);
+    s->nb_workers = 0;
+}
+
+/**
+ * Start one worker per readahead entry, each reading whole files,
+ * so that up to readahead files are read at the same time.
+ */
+static int readahead_start(AVFormatContext *s1)
+{
+    VideoData *s = s1->priv_data;
+    int i;
+
+    s->workers = av_mallocz(s->readahead * sizeof(*s->workers));
+    s->slots   = av_mallocz(s->readahead * sizeof(*s->slots));
+    if (!s->workers || !s->slots) {
+        av_freep(&s->workers);
+        av_freep(&s->slots);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    for (i = 0; i < s->readahead; i++) {
+        if (pthread_create(&s->workers[i], NULL, readahead_worker, s1)) {
+            av_log(s1, AV_LOG_ERROR, "pthread_create failed\n");
+            readahead_stop(s);
+            return AVERROR(ENOMEM);
+        }
+        s->nb_workers++;
+    }
+    return 0;
+}
+
+static int read_packet_readahead(AVFormatContext *s1, AVPacket *pkt)
+{
+    VideoData *s = s1->priv_data;
+    AVCodecContext *codec = s1->streams[0]->codec;
+    ReadAheadSlot *slot = &s->slots[s->seq % s->readahead];
+    int ret;
+
+    if (!s->loop && s->seq > s->img_last - s->img_first)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&s->lock);
+    while (!slot->done)
+        pthread_cond_wait(&s->cond, &s->lock);
+    ret = slot->ret;
+    if (ret >= 0)
+        *pkt = slot->pkt;
+    slot->done = 0;
+    s->seq++;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    if (ret < 0)
+        return ret;
+
+    if (codec->codec_id == CODEC_ID_RAWVIDEO && !codec->width)
+        infer_size(&codec->width, &codec->height, pkt->size);
+    pkt->stream_index = 0;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+    s->img_count++;
+    s->img_number = s->img_first + s->seq % (s->img_last - s->img_first + 1);
+    return 0;
+}
+#endif
+
 static int read_header(AVFormatContext *s1, AVFormatParameters *ap)
 {
     VideoData *s = s1->priv_data;
@@ -299,6 +537,15 @@ static int read_header(AVFormatContext *s1, AVFormatParameters *ap)
     if(st->codec->codec_type == AVMEDIA_TYPE_VIDEO && pix_fmt != PIX_FMT_NONE)
         st->codec->pix_fmt = pix_fmt;
 
+    if (s->readahead && !s->is_pipe && !s->split_planes) {
+#if HAVE_PTHREADS
+        if ((ret = readahead_start(s1)) < 0)
+            return ret;
+#else
+        av_log(s1, AV_LOG_WARNING, "readahead needs threads, ignoring it\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -311,6 +558,11 @@ static int read_packet(AVFormatContext *s1, AVPacket *pkt)
     AVIOContext *f[3];
     AVCodecContext *codec= s1->streams[0]->codec;
 
+#if HAVE_PTHREADS
+    if (s->nb_workers)
+        return read_packet_readahead(s1, pkt);
+#endif
+
     if (!s->is_pipe) {
         /* loop over input */
         if (s->loop && s->img_number > s->img_last) {
@@ -369,6 +621,17 @@ static int read_packet(AVFormatContext *s1, AVPacket *pkt)
     }
 }
 
+static int read_close(AVFormatContext *s1)
+{
+#if HAVE_PTHREADS
+    VideoData *s = s1->priv_data;
+
+    if (s->nb_workers)
+        readahead_stop(s);
+#endif
+    return 0;
+}
+
 #if CONFIG_IMAGE2_MUXER || CONFIG_IMAGE2PIPE_MUXER
 /******************************************************/
 /* image output */
@@ -475,6 +738,8 @@ static const AVOption options[] = {
     { "video_size",   "", OFFSET(video_size),   FF_OPT_TYPE_STRING, {.str = NULL}, 0, 0, DEC },
     { "framerate",    "", OFFSET(framerate),    FF_OPT_TYPE_STRING, {.str = "25"}, 0, 0, DEC },
     { "loop",         "", OFFSET(loop),         FF_OPT_TYPE_INT,    {.dbl = 0},    0, 1, DEC },
+    { "readahead",    "number of upcoming files read in parallel", OFFSET(readahead), FF_OPT_TYPE_INT, {.dbl = 0}, 0, 64, DEC },
+    { "direct",       "read ahead bypassing the page cache (O_DIRECT)", OFFSET(direct), FF_OPT_TYPE_INT, {.dbl = 0}, 0, 1, DEC },
     { NULL },
 };
 
@@ -494,6 +759,7 @@ AVInputFormat ff_image2_demuxer = {
     .read_probe     = read_probe,
     .read_header    = read_header,
     .read_packet    = read_packet,
+    .read_close     = read_close,
     .flags          = AVFMT_NOFILE,
     .priv_class     = &img2_class,
 };
@@ -71,11 +71,34 @@ int ff_hex_to_data(uint8_t *data, const char *p);
 void ff_program_add_stream_index(AVFormatContext *ac, int progid, unsigned int idx);
 
 /**
- * Add packet to AVFormatContext->packet_buffer list, determining its
+ * Add packet to the interleaving queue of its stream, determining its
  * interleaved position using compare() function argument.
+ * The packets of a stream must be added in their muxing order.
+ * @return 0 on success, a negative AVERROR on failure
  */
-void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                              int (*compare)(AVFormatContext *, AVPacket *, AVPacket *));
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *));
+
+/**
+ * @return the number of streams with packets waiting to be interleaved
+ */
+int ff_interleave_queued_streams(AVFormatContext *s);
+
+/**
+ * @return the next interleaved packet, still owned by the queue, or NULL
+ */
+AVPacket *ff_interleave_peek_packet(AVFormatContext *s);
+
+/**
+ * Remove the next interleaved packet from the queues.
+ * @return 1 if a packet was output, 0 if the queues are empty
+ */
+int ff_interleave_get_packet(AVFormatContext *s, AVPacket *out);
+
+/**
+ * Free the interleaving queues and the packets they hold.
+ */
+void ff_interleave_free(AVFormatContext *s);
 
 void ff_read_frame_flush(AVFormatContext *s);
 
@@ -50,8 +50,10 @@ typedef struct MpegTSService {
     char *name;
     char *provider_name;
     int pcr_pid;
+    AVStream *pcr_st;  ///< stream carrying the PCR
     int pcr_packet_count;
     int pcr_packet_period;
+    int64_t last_pcr;  ///< last PCR written in CBR mode, -1 if none yet
 } MpegTSService;
 
 typedef struct MpegTSWrite {
@@ -68,6 +70,12 @@ typedef struct MpegTSWrite {
     int tsid;
     int64_t first_pcr;
     int mux_rate; ///< set to 1 when VBR
+    int64_t pcr_period;   ///< PCR interval in CBR mode, in 27MHz units
+    int64_t nb_packets;   ///< TS packets written so far, drives the CBR clock
+
+    uint8_t *block;       ///< packets are assembled here before avio_write
+    int block_packets;    ///< number of packets the block can hold
+    int block_count;      ///< number of packets currently in the block
 
     int transport_stream_id;
     int original_network_id;
@@ -75,6 +83,7 @@ typedef struct MpegTSWrite {
 
     int pmt_start_pid;
     int start_pid;
+    int pcr_period_ms;
 } MpegTSWrite;
 
 static const AVOption options[] = {
@@ -88,6 +97,8 @@ static const AVOption options[] = {
       offsetof(MpegTSWrite, pmt_start_pid), FF_OPT_TYPE_INT, {.dbl = 0x1000 }, 0x1000, 0x1f00, AV_OPT_FLAG_ENCODING_PARAM},
     { "mpegts_start_pid", "Set the first pid.",
       offsetof(MpegTSWrite, start_pid), FF_OPT_TYPE_INT, {.dbl = 0x0100 }, 0x0100, 0x0f00, AV_OPT_FLAG_ENCODING_PARAM},
+    { "mpegts_pcr_period", "Set the PCR interval in milliseconds for CBR streams.",
+      offsetof(MpegTSWrite, pcr_period_ms), FF_OPT_TYPE_INT, {.dbl = 20 }, 1, 100, AV_OPT_FLAG_ENCODING_PARAM},
     { NULL },
 };
 
@@ -194,7 +205,12 @@ static int mpegts_write_section1(MpegTSSection *s, int tid, int id,
 /* we retransmit the SI info at this rate */
 #define SDT_RETRANS_TIME 500
 #define PAT_RETRANS_TIME 100
-#define PCR_RETRANS_TIME 20
+
+/* size of the T-STD transport buffer TBn in bytes, see ISO 13818-1 2.4.2.3 */
+#define TSTD_TB_SIZE 512
+
+/* number of TS packets assembled before being passed to avio */
+#define TS_BLOCK_PACKETS 64
 
 typedef struct MpegTSWriteStream {
     struct MpegTSService *service;
@@ -207,6 +223,11 @@ typedef struct MpegTSWriteStream {
     int payload_flags;
     uint8_t payload[DEFAULT_PES_PAYLOAD_SIZE];
     ADTSContext *adts;
+
+    /* T-STD transport buffer model, CBR mode only */
+    int64_t tb_rate;  ///< leak rate Rx in bits/s, 0 if not modeled
+    int64_t tb_level; ///< buffer fullness in bits * PCR_TIME_BASE
+    int64_t tb_time;  ///< PCR time of the last fullness update
 } MpegTSWriteStream;
 
 static void mpegts_write_pat(AVFormatContext *s)
@@ -320,6 +341,14 @@ static void mpegts_write_pmt(AVFormatContext *s, MpegTSService *service)
                 if (*len_ptr == 0)
                     q -= 2; /* no language codes were written */
             }
+            if (st->codec->codec_id == CODEC_ID_S302M) {
+                *q++ = 0x05; /* MPEG-2 registration descriptor */
+                *q++ = 4;
+                *q++ = 'B';
+                *q++ = 'S';
+                *q++ = 'S';
+                *q++ = 'D';
+            }
             break;
         case AVMEDIA_TYPE_SUBTITLE:
             {
@@ -434,10 +463,41 @@ static MpegTSService *mpegts_add_service(MpegTSWrite *ts,
     return service;
 }
 
+/* Pass all assembled packets to the I/O layer */
+static void mpegts_flush_block(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->block_count > 0) {
+        avio_write(s->pb, ts->block, ts->block_count * TS_PACKET_SIZE);
+        ts->block_count = 0;
+    }
+}
+
+/* Get the location where the next TS packet has to be assembled.
+ * The packet is only accounted for after mpegts_commit_packet(). */
+static uint8_t *mpegts_get_packet(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->block_count == ts->block_packets)
+        mpegts_flush_block(s);
+    return ts->block + ts->block_count * TS_PACKET_SIZE;
+}
+
+static void mpegts_commit_packet(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    ts->block_count++;
+    ts->nb_packets++;
+}
+
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
 {
     AVFormatContext *ctx = s->opaque;
-    avio_write(ctx->pb, packet, TS_PACKET_SIZE);
+    memcpy(mpegts_get_packet(ctx), packet, TS_PACKET_SIZE);
+    mpegts_commit_packet(ctx);
 }
 
 static int mpegts_write_header(AVFormatContext *s)
@@ -447,10 +507,10 @@ static int mpegts_write_header(AVFormatContext *s)
     MpegTSService *service;
     AVStream *st, *pcr_st = NULL;
     AVDictionaryEntry *title, *provider;
-    int i, j;
+    int i, j, ret = -1;
     const char *service_name;
     const char *provider_name;
-    int *pids;
+    int *pids = NULL;
 
     ts->tsid = ts->transport_stream_id;
     ts->onid = ts->original_network_id;
@@ -476,9 +536,13 @@ static int mpegts_write_header(AVFormatContext *s)
     ts->sdt.write_packet = section_write_packet;
     ts->sdt.opaque = s;
 
+    ts->block_packets = TS_BLOCK_PACKETS;
+    ts->block = av_malloc(ts->block_packets * TS_PACKET_SIZE);
     pids = av_malloc(s->nb_streams * sizeof(*pids));
-    if (!pids)
-        return AVERROR(ENOMEM);
+    if (!ts->block || !pids) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
 
     /* assign pids to each stream */
     for(i = 0;i < s->nb_streams; i++) {
@@ -522,11 +586,13 @@ static int mpegts_write_header(AVFormatContext *s)
         if (st->codec->codec_id == CODEC_ID_AAC &&
             st->codec->extradata_size > 0) {
             ts_st->adts = av_mallocz(sizeof(*ts_st->adts));
-            if (!ts_st->adts)
-                return AVERROR(ENOMEM);
+            if (!ts_st->adts) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
             if (ff_adts_decode_extradata(s, ts_st->adts, st->codec->extradata,
                                          st->codec->extradata_size) < 0)
-                return -1;
+                goto fail;
         }
     }
 
@@ -538,11 +604,14 @@ static int mpegts_write_header(AVFormatContext *s)
         ts_st = pcr_st->priv_data;
         service->pcr_pid = ts_st->pid;
     }
+    service->pcr_st = pcr_st;
 
     ts->mux_rate = s->mux_rate ? s->mux_rate : 1;
 
     if (ts->mux_rate > 1) {
-        service->pcr_packet_period = (ts->mux_rate * PCR_RETRANS_TIME) /
+        ts->pcr_period = av_rescale(ts->pcr_period_ms, PCR_TIME_BASE, 1000);
+        service->last_pcr = -1;
+        service->pcr_packet_period = (ts->mux_rate * ts->pcr_period_ms) /
             (TS_PACKET_SIZE * 8 * 1000);
         ts->sdt_packet_period      = (ts->mux_rate * SDT_RETRANS_TIME) /
             (TS_PACKET_SIZE * 8 * 1000);
@@ -550,6 +619,17 @@ static int mpegts_write_header(AVFormatContext *s)
             (TS_PACKET_SIZE * 8 * 1000);
 
         ts->first_pcr = av_rescale(s->max_delay, PCR_TIME_BASE, AV_TIME_BASE);
+
+        /* leak rates of the transport buffers, ISO 13818-1 2.4.2.3 */
+        for (i = 0; i < s->nb_streams; i++) {
+            AVCodecContext *avctx = s->streams[i]->codec;
+            ts_st = s->streams[i]->priv_data;
+            if (avctx->codec_type == AVMEDIA_TYPE_VIDEO)
+                ts_st->tb_rate = FFMAX(avctx->rc_max_rate, avctx->bit_rate) * 6LL / 5;
+            else if (avctx->codec_type == AVMEDIA_TYPE_AUDIO)
+                ts_st->tb_rate = FFMAX(2000000, avctx->bit_rate * 6LL / 5);
+            ts_st->tb_time = ts->first_pcr;
+        }
     } else {
         /* Arbitrary values, PAT/PMT could be written on key frames */
         ts->sdt_packet_period = 200;
@@ -590,11 +670,15 @@ static int mpegts_write_header(AVFormatContext *s)
 
  fail:
     av_free(pids);
+    av_freep(&ts->block);
     for(i = 0;i < s->nb_streams; i++) {
         st = s->streams[i];
+        ts_st = st->priv_data;
+        if (ts_st)
+            av_freep(&ts_st->adts);
         av_freep(&st->priv_data);
     }
-    return -1;
+    return ret;
 }
 
 /* send SDT, PAT and PMT tables regulary */
@@ -616,10 +700,36 @@ static void retransmit_si_info(AVFormatContext *s)
     }
 }
 
-static int64_t get_pcr(const MpegTSWrite *ts, AVIOContext *pb)
+/* PCR of the next packet in CBR mode, derived from the packet count
+ * so that it does not depend on where the output starts or is flushed */
+static int64_t get_pcr(const MpegTSWrite *ts)
+{
+    return av_rescale(ts->nb_packets * TS_PACKET_SIZE + 11,
+                      8 * PCR_TIME_BASE, ts->mux_rate) + ts->first_pcr;
+}
+
+/* Drain the transport buffer of a stream up to time 'now' and check
+ * whether it can take one more TS packet without overflowing. */
+static int tstd_tb_has_room(MpegTSWriteStream *ts_st, int64_t now)
+{
+    const int64_t tb_size = TSTD_TB_SIZE * 8LL * PCR_TIME_BASE;
+    int64_t elapsed;
+
+    if (!ts_st->tb_rate)
+        return 1;
+    elapsed = now - ts_st->tb_time;
+    if (elapsed >= tb_size / ts_st->tb_rate)
+        ts_st->tb_level = 0;
+    else if (elapsed > 0)
+        ts_st->tb_level = FFMAX(ts_st->tb_level - ts_st->tb_rate * elapsed, 0);
+    ts_st->tb_time = now;
+    return ts_st->tb_level + TS_PACKET_SIZE * 8LL * PCR_TIME_BASE <= tb_size;
+}
+
+static void tstd_tb_add_packet(MpegTSWriteStream *ts_st)
 {
-    return av_rescale(avio_tell(pb) + 11, 8 * PCR_TIME_BASE, ts->mux_rate) +
-           ts->first_pcr;
+    if (ts_st->tb_rate)
+        ts_st->tb_level += TS_PACKET_SIZE * 8LL * PCR_TIME_BASE;
 }
 
 static int write_pcr_bits(uint8_t *buf, int64_t pcr)
@@ -640,7 +750,7 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t *buf = mpegts_get_packet(s);
 
     q = buf;
     *q++ = 0x47;
@@ -648,7 +758,7 @@ static void mpegts_insert_null_packet(AVFormatContext *s)
     *q++ = 0xff;
     *q++ = 0x10;
     memset(q, 0x0FF, TS_PACKET_SIZE - (q - buf));
-    avio_write(s->pb, buf, TS_PACKET_SIZE);
+    mpegts_commit_packet(s);
 }
 
 /* Write a single transport stream packet with a PCR and no payload */
@@ -657,7 +767,8 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
     MpegTSWrite *ts = s->priv_data;
     MpegTSWriteStream *ts_st = st->priv_data;
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t *buf = mpegts_get_packet(s);
+    int64_t pcr = get_pcr(ts);
 
     q = buf;
     *q++ = 0x47;
@@ -669,11 +780,15 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
     *q++ = 0x10;               /* Adaptation flags: PCR present */
 
     /* PCR coded into 6 bytes */
-    q += write_pcr_bits(q, get_pcr(ts, s->pb));
+    q += write_pcr_bits(q, pcr);
 
     /* stuffing bytes */
     memset(q, 0xFF, TS_PACKET_SIZE - (q - buf));
-    avio_write(s->pb, buf, TS_PACKET_SIZE);
+    mpegts_commit_packet(s);
+
+    ts_st->service->last_pcr = pcr;
+    tstd_tb_has_room(ts_st, pcr);
+    tstd_tb_add_packet(ts_st);
 }
 
 static void write_pts(uint8_t *q, int fourbits, int64_t pts)
@@ -733,8 +848,9 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
                              int64_t pts, int64_t dts, int key)
 {
     MpegTSWriteStream *ts_st = st->priv_data;
+    MpegTSService *service = ts_st->service;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t *buf;
     uint8_t *q;
     int val, is_start, len, header_len, write_pcr, private_code, flags;
     int afc_len, stuffing_len;
@@ -746,27 +862,38 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         retransmit_si_info(s);
 
         write_pcr = 0;
-        if (ts_st->pid == ts_st->service->pcr_pid) {
-            if (ts->mux_rate > 1 || is_start) // VBR pcr period is based on frames
-                ts_st->service->pcr_packet_count++;
-            if (ts_st->service->pcr_packet_count >=
-                ts_st->service->pcr_packet_period) {
-                ts_st->service->pcr_packet_count = 0;
+        if (ts->mux_rate > 1) {
+            /* CBR: PCRs are scheduled on the 27MHz clock of the output */
+            pcr = get_pcr(ts);
+            if (service->last_pcr < 0 ||
+                pcr - service->last_pcr >= ts->pcr_period) {
+                if (ts_st->pid != service->pcr_pid) {
+                    mpegts_insert_pcr_only(s, service->pcr_st);
+                    continue;
+                }
                 write_pcr = 1;
             }
-        }
 
-        if (ts->mux_rate > 1 && dts != AV_NOPTS_VALUE &&
-            (dts - get_pcr(ts, s->pb)/300) > delay) {
-            /* pcr insert gets priority over null packet insert */
-            if (write_pcr)
-                mpegts_insert_pcr_only(s, st);
-            else
-                mpegts_insert_null_packet(s);
-            continue; /* recalculate write_pcr and possibly retransmit si_info */
+            if ((dts != AV_NOPTS_VALUE && (dts - pcr/300) > delay) ||
+                !tstd_tb_has_room(ts_st, pcr)) {
+                /* pcr insert gets priority over null packet insert */
+                if (write_pcr)
+                    mpegts_insert_pcr_only(s, st);
+                else
+                    mpegts_insert_null_packet(s);
+                continue; /* recalculate write_pcr and possibly retransmit si_info */
+            }
+        } else if (ts_st->pid == service->pcr_pid) {
+            if (is_start) // VBR pcr period is based on frames
+                service->pcr_packet_count++;
+            if (service->pcr_packet_count >= service->pcr_packet_period) {
+                service->pcr_packet_count = 0;
+                write_pcr = 1;
+            }
         }
 
         /* prepare packet header */
+        buf = mpegts_get_packet(s);
         q = buf;
         *q++ = 0x47;
         val = (ts_st->pid >> 8);
@@ -787,9 +914,10 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
             set_af_flag(buf, 0x10);
             q = get_ts_payload_start(buf);
             // add 11, pcr references the last byte of program clock reference base
-            if (ts->mux_rate > 1)
-                pcr = get_pcr(ts, s->pb);
-            else
+            if (ts->mux_rate > 1) {
+                pcr = get_pcr(ts);
+                service->last_pcr = pcr;
+            } else
                 pcr = (dts - delay)*300;
             if (dts != AV_NOPTS_VALUE && dts < pcr / 300)
                 av_log(s, AV_LOG_WARNING, "dts < pcr, TS is invalid\n");
@@ -909,8 +1037,10 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         memcpy(buf + TS_PACKET_SIZE - len, payload, len);
         payload += len;
         payload_size -= len;
-        avio_write(s->pb, buf, TS_PACKET_SIZE);
+        mpegts_commit_packet(s);
+        tstd_tb_add_packet(ts_st);
     }
+    mpegts_flush_block(s);
     avio_flush(s->pb);
 }
 
@@ -991,7 +1121,8 @@ static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
-    if (st->codec->codec_type != AVMEDIA_TYPE_AUDIO) {
+    if (st->codec->codec_type != AVMEDIA_TYPE_AUDIO ||
+        st->codec->codec_id == CODEC_ID_S302M) {
         // flush buffered audio
         for (i = 0; i < s->nb_streams; i++) {
             AVStream *st = s->streams[i];
@@ -1003,7 +1134,8 @@ static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
                 ts_st->payload_index = 0;
             }
         }
-        // for video and subtitle, write a single pes packet
+        // for video, subtitle and 302M audio, whose header describes the
+        // whole PES payload, write a single pes packet
         mpegts_write_pes(s, st, buf, size, pts, dts, pkt->flags & AV_PKT_FLAG_KEY);
         av_free(data);
         return 0;
@@ -1056,7 +1188,9 @@ static int mpegts_write_end(AVFormatContext *s)
         }
         av_freep(&ts_st->adts);
     }
+    mpegts_flush_block(s);
     avio_flush(s->pb);
+    av_freep(&ts->block);
 
     for(i = 0; i < ts->nb_services; i++) {
         service = ts->services[i];
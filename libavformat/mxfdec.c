@@ -1472,4 +1472,5 @@ AVInputFormat ff_mxf_demuxer = {
     .read_packet    = mxf_read_packet,
     .read_close     = mxf_read_close,
     .read_seek      = mxf_read_seek,
+    .flags          = AVFMT_TRUSTED_HEADER,
 };
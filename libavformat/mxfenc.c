@@ -2392,23 +2392,16 @@ static int mxf_compare_timestamps(AVFormatContext *s, AVPacket *next, AVPacket *
 static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush)
 {
     MXFContext *mxf = s->priv_data;
-    int i, stream_count = 0;
+    int i, stream_count = ff_interleave_queued_streams(s);
     int64_t duration = mxf->last_indexed_edit_unit + mxf->edit_units_count;
 
-    for (i = 0; i < s->nb_streams; i++)
-        stream_count += !!s->streams[i]->last_in_packet_buffer;
-
     if (s->nb_streams == stream_count || flush) {
-        AVPacketList *pktl = s->packet_buffer;
+        AVPacket *next = ff_interleave_peek_packet(s);
         if (s->nb_streams != stream_count) {
             // extra audio at the end
-            if (pktl && pktl->pkt.stream_index > 0 && pktl->pkt.dts >= duration) {
-                AVStream *st = s->streams[pktl->pkt.stream_index];
-                s->packet_buffer = pktl->next;
-                if (st->last_in_packet_buffer == pktl)
-                    st->last_in_packet_buffer = NULL;
-                av_free_packet(&pktl->pkt);
-                av_freep(&pktl);
+            if (next && next->stream_index > 0 && next->dts >= duration) {
+                ff_interleave_get_packet(s, out);
+                av_free_packet(out);
                 goto out;
             }
 
@@ -2417,24 +2410,20 @@ static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket
                 AudioInterleaveContext *aic = s->streams[i]->priv_data;
                 if (aic->dts < duration) {
                     AVPacket new_pkt;
-                    if (ff_audio_interleave_new_packet(s, &new_pkt, i, 2))
-                        ff_interleave_add_packet(s, &new_pkt, mxf_compare_timestamps);
+                    if (ff_audio_interleave_new_packet(s, &new_pkt, i, 2)) {
+                        int ret = ff_interleave_add_packet(s, &new_pkt, mxf_compare_timestamps);
+                        if (ret < 0) {
+                            av_free_packet(&new_pkt);
+                            return ret;
+                        }
+                    }
                 }
             }
-            pktl = s->packet_buffer;
         }
 
-        if (!pktl)
+        if (!ff_interleave_get_packet(s, out))
             goto out;
-
-        *out = pktl->pkt;
         //av_log(s, AV_LOG_DEBUG, "out st:%d dts:%lld\n", (*out).stream_index, (*out).dts);
-        s->packet_buffer = pktl->next;
-        if (s->streams[pktl->pkt.stream_index]->last_in_packet_buffer == pktl)
-            s->streams[pktl->pkt.stream_index]->last_in_packet_buffer = NULL;
-        if (!s->packet_buffer)
-            s->packet_buffer_end = NULL;
-        av_freep(&pktl);
         return 1;
     } else {
     out:
@@ -674,6 +674,9 @@ int avformat_open_input(AVFormatContext **ps, const char *filename, AVInputForma
 
     s->raw_packet_buffer_remaining_size = RAW_PACKET_BUFFER_SIZE;
 
+    if (s->pb)
+        s->probe_bytes = s->pb->bytes_read;
+
     if (options) {
         av_dict_free(options);
         *options = tmp;
@@ -1092,6 +1095,7 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
                     if(pkt->data == st->cur_pkt.data && pkt->size == st->cur_pkt.size){
                         s->cur_st = NULL;
                         pkt->destruct= st->cur_pkt.destruct;
+                        pkt->priv    = st->cur_pkt.priv;
                         st->cur_pkt.destruct= NULL;
                         st->cur_pkt.data    = NULL;
                         assert(st->cur_len == 0);
@@ -2084,6 +2088,23 @@ static int has_codec_parameters(AVCodecContext *avctx)
     return avctx->codec_id != CODEC_ID_PROBE && val != 0;
 }
 
+/**
+ * Return 1 if the container header gave everything av_find_stream_info()
+ * would otherwise read and decode packets of st for.
+ */
+static int has_header_parameters(AVFormatContext *ic, AVStream *st)
+{
+    if (!(ic->flags & AVFMT_FLAG_FAST_OPEN) ||
+        !(ic->iformat->flags & AVFMT_TRUSTED_HEADER) ||
+        !has_codec_parameters(st->codec))
+        return 0;
+    if (st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+        !st->r_frame_rate.num && !st->avg_frame_rate.num)
+        return 0;
+    /* without a start time, one packet is still needed for first_dts */
+    return st->start_time != AV_NOPTS_VALUE || st->first_dts != AV_NOPTS_VALUE;
+}
+
 static int has_decode_delay_been_guessed(AVStream *st)
 {
     return st->codec->codec_id != CODEC_ID_H264 ||
@@ -2278,6 +2299,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             int fps_analyze_framecount = 20;
 
             st = ic->streams[i];
+            if (has_header_parameters(ic, st))
+                continue;
             if (!has_codec_parameters(st->codec))
                 break;
             /* if the timebase is coarse (like the usual millisecond precision
@@ -2398,7 +2421,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
            it takes longer and uses more memory. For MPEG-4, we need to
            decompress for QuickTime.
         */
-        try_decode_frame(st, pkt, (options && i < orig_nb_streams )? &options[i] : NULL);
+        if (!has_header_parameters(ic, st))
+            try_decode_frame(st, pkt, (options && i < orig_nb_streams )? &options[i] : NULL);
 
         st->codec_info_nb_frames++;
         count++;
@@ -2483,6 +2507,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 
     compute_chapters_end(ic);
 
+    if (ic->pb)
+        ic->probe_bytes = ic->pb->bytes_read;
+
 #if 0
     /* correct DTS for B-frame streams with no timestamps */
     for(i=0;i<ic->nb_streams;i++) {
@@ -2614,6 +2641,7 @@ void avformat_free_context(AVFormatContext *s)
     av_opt_free(s);
     if (s->iformat && s->iformat->priv_class && s->priv_data)
         av_opt_free(s->priv_data);
+    ff_interleave_free(s);
 
     for(i=0;i<s->nb_streams;i++) {
         /* free all data in a stream component */
@@ -3138,40 +3166,191 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
-void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                              int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+/**
+ * Packets waiting to be muxed are kept in one ring buffer per stream, the
+ * packets of a stream being added in order. The streams having packets are
+ * kept in a heap ordered on their first packet, so that adding and removing
+ * a packet costs O(log(nb_streams)) and no allocation once the rings have
+ * grown to the interleaving depth.
+ */
+typedef struct PacketQueue {
+    AVPacket *pkts;
+    int size;                   ///< allocated number of packets
+    int first;                  ///< index of the first packet
+    int count;                  ///< number of queued packets
+} PacketQueue;
+
+typedef struct PacketInterleaver {
+    PacketQueue *queues;
+    int nb_queues;
+    int *heap;                  ///< indexes of the non-empty queues
+    int heap_size;
+    int (*compare)(AVFormatContext *, AVPacket *, AVPacket *);
+} PacketInterleaver;
+
+/* whether the first packet of queue a must be muxed after the one of queue b */
+static int queue_after(AVFormatContext *s, int a, int b)
 {
-    AVPacketList **next_point, *this_pktl;
+    PacketInterleaver *il = s->interleaver;
+    PacketQueue *qa = &il->queues[a], *qb = &il->queues[b];
 
-    this_pktl = av_mallocz(sizeof(AVPacketList));
-    this_pktl->pkt= *pkt;
-    pkt->destruct= NULL;             // do not free original but only the copy
-    av_dup_packet(&this_pktl->pkt);  // duplicate the packet if it uses non-alloced memory
+    return il->compare(s, &qa->pkts[qa->first], &qb->pkts[qb->first]);
+}
 
-    if(s->streams[pkt->stream_index]->last_in_packet_buffer){
-        next_point = &(s->streams[pkt->stream_index]->last_in_packet_buffer->next);
-    }else
-        next_point = &s->packet_buffer;
+static void heap_sift_up(AVFormatContext *s, int pos)
+{
+    PacketInterleaver *il = s->interleaver;
+    int idx = il->heap[pos];
 
-    if(*next_point){
-        if(compare(s, &s->packet_buffer_end->pkt, pkt)){
-            while(!compare(s, &(*next_point)->pkt, pkt)){
-                next_point= &(*next_point)->next;
-            }
-            goto next_non_null;
-        }else{
-            next_point = &(s->packet_buffer_end->next);
-        }
+    while (pos > 0 && queue_after(s, il->heap[(pos - 1) >> 1], idx)) {
+        il->heap[pos] = il->heap[(pos - 1) >> 1];
+        pos = (pos - 1) >> 1;
+    }
+    il->heap[pos] = idx;
+}
+
+static void heap_sift_down(AVFormatContext *s, int pos)
+{
+    PacketInterleaver *il = s->interleaver;
+    int idx = il->heap[pos];
+
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= il->heap_size)
+            break;
+        if (child + 1 < il->heap_size &&
+            queue_after(s, il->heap[child], il->heap[child + 1]))
+            child++;
+        if (!queue_after(s, idx, il->heap[child]))
+            break;
+        il->heap[pos] = il->heap[child];
+        pos = child;
     }
-    assert(!*next_point);
+    il->heap[pos] = idx;
+}
+
+static int interleaver_alloc_queues(AVFormatContext *s, int nb_queues)
+{
+    PacketInterleaver *il = s->interleaver;
+    PacketQueue *queues;
+    int *heap;
 
-    s->packet_buffer_end= this_pktl;
-next_non_null:
+    if (!il && !(il = s->interleaver = av_mallocz(sizeof(*il))))
+        return AVERROR(ENOMEM);
+    if (nb_queues <= il->nb_queues)
+        return 0;
+    if (!(queues = av_realloc(il->queues, nb_queues * sizeof(*queues))))
+        return AVERROR(ENOMEM);
+    il->queues = queues;
+    if (!(heap = av_realloc(il->heap, nb_queues * sizeof(*heap))))
+        return AVERROR(ENOMEM);
+    il->heap = heap;
+    memset(&queues[il->nb_queues], 0, (nb_queues - il->nb_queues) * sizeof(*queues));
+    il->nb_queues = nb_queues;
+    return 0;
+}
 
-    this_pktl->next= *next_point;
+static int queue_grow(PacketQueue *q)
+{
+    int i, size = FFMAX(2 * q->size, 16);
+    AVPacket *pkts = av_malloc(size * sizeof(*pkts));
 
-    s->streams[pkt->stream_index]->last_in_packet_buffer=
-    *next_point= this_pktl;
+    if (!pkts)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < q->count; i++)
+        pkts[i] = q->pkts[(q->first + i) % q->size];
+    av_free(q->pkts);
+    q->pkts  = pkts;
+    q->size  = size;
+    q->first = 0;
+    return 0;
+}
+
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+{
+    PacketInterleaver *il;
+    PacketQueue *q;
+    AVPacket *dst;
+    int i, ret;
+
+    if ((ret = interleaver_alloc_queues(s, FFMAX(s->nb_streams, pkt->stream_index + 1))) < 0)
+        return ret;
+    il = s->interleaver;
+    q  = &il->queues[pkt->stream_index];
+    if (q->count == q->size && (ret = queue_grow(q)) < 0)
+        return ret;
+
+    if (il->compare != compare) {
+        /* the heap order depends on the comparison function */
+        il->compare = compare;
+        for (i = il->heap_size / 2 - 1; i >= 0; i--)
+            heap_sift_down(s, i);
+    }
+
+    dst  = &q->pkts[(q->first + q->count++) % q->size];
+    *dst = *pkt;
+    pkt->destruct = NULL;   // do not free original but only the copy
+    av_dup_packet(dst);     // duplicate the packet if it uses non-alloced memory
+
+    if (q->count == 1) {
+        il->heap[il->heap_size] = pkt->stream_index;
+        heap_sift_up(s, il->heap_size++);
+    }
+    return 0;
+}
+
+int ff_interleave_queued_streams(AVFormatContext *s)
+{
+    PacketInterleaver *il = s->interleaver;
+
+    return il ? il->heap_size : 0;
+}
+
+AVPacket *ff_interleave_peek_packet(AVFormatContext *s)
+{
+    PacketInterleaver *il = s->interleaver;
+    PacketQueue *q;
+
+    if (!il || !il->heap_size)
+        return NULL;
+    q = &il->queues[il->heap[0]];
+    return &q->pkts[q->first];
+}
+
+int ff_interleave_get_packet(AVFormatContext *s, AVPacket *out)
+{
+    PacketInterleaver *il = s->interleaver;
+    PacketQueue *q;
+
+    if (!il || !il->heap_size)
+        return 0;
+    q = &il->queues[il->heap[0]];
+    *out = q->pkts[q->first];
+    q->first = (q->first + 1) % q->size;
+    if (!--q->count)
+        il->heap[0] = il->heap[--il->heap_size];
+    if (il->heap_size)
+        heap_sift_down(s, 0);
+    return 1;
+}
+
+void ff_interleave_free(AVFormatContext *s)
+{
+    PacketInterleaver *il = s->interleaver;
+    int i, j;
+
+    if (!il)
+        return;
+    for (i = 0; i < il->nb_queues; i++) {
+        PacketQueue *q = &il->queues[i];
+        for (j = 0; j < q->count; j++)
+            av_free_packet(&q->pkts[(q->first + j) % q->size]);
+        av_free(q->pkts);
+    }
+    av_free(il->queues);
+    av_free(il->heap);
+    av_freep(&s->interleaver);
 }
 
 static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacket *pkt)
@@ -3187,29 +3366,18 @@ static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacke
 }
 
 int av_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush){
-    AVPacketList *pktl;
-    int stream_count=0;
-    int i;
+    int stream_count;
 
     if(pkt){
-        ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts);
+        int ret = ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts);
+        if (ret < 0)
+            return ret;
     }
 
-    for(i=0; i < s->nb_streams; i++)
-        stream_count+= !!s->streams[i]->last_in_packet_buffer;
+    stream_count = ff_interleave_queued_streams(s);
 
     if(stream_count && (s->nb_streams == stream_count || flush)){
-        pktl= s->packet_buffer;
-        *out= pktl->pkt;
-
-        s->packet_buffer= pktl->next;
-        if(!s->packet_buffer)
-            s->packet_buffer_end= NULL;
-
-        if(s->streams[out->stream_index]->last_in_packet_buffer == pktl)
-            s->streams[out->stream_index]->last_in_packet_buffer= NULL;
-        av_freep(&pktl);
-        return 1;
+        return ff_interleave_get_packet(s, out);
     }else{
         av_init_packet(out);
         return 0;
@@ -3297,6 +3465,7 @@ int av_write_trailer(AVFormatContext *s)
 fail:
     if(ret == 0)
        ret=url_ferror(s->pb);
+    ff_interleave_free(s);
     for(i=0;i<s->nb_streams;i++) {
         av_freep(&s->streams[i]->priv_data);
         av_freep(&s->streams[i]->index_entries);
@@ -61,6 +61,303 @@ void  free(void *ptr);
 
 #define ALIGN (HAVE_AVX ? 32 : 16)
 
+#if CONFIG_MEM_ARENA
+#include <pthread.h>
+
+/* Blocks up to 32 KiB are recycled through per thread free lists, one
+ * per size class, backed by shared lists. Every block is preceded by a
+ * header, large blocks get one too so that av_free() can tell them apart,
+ * and the arena can be turned on and off at any time. Blocks up to 1 KiB
+ * are carved out of slabs which are kept until the process exits, bigger
+ * ones are allocated one by one and given back to the system when the
+ * shared list of their class is full. */
+
+#define ARENA_HEADER    ALIGN           ///< room before each block, keeps it aligned
+#define NB_CLASSES      36
+#define LARGE           NB_CLASSES      ///< class of the blocks not in the arena
+#define MAX_SMALL       32768
+#define MAX_SLAB_BLOCK  1024
+#define SLAB_SIZE       (64 << 10)
+#define CACHE_BYTES     (64 << 10)      ///< free bytes per class kept by a thread
+#define SHARED_BYTES    (1 << 20)       ///< free bytes per class kept for all threads
+
+typedef struct ArenaHeader {
+    struct ArenaHeader *next;           ///< next free block of the class
+    int cls;
+    unsigned size;                      ///< requested size
+} ArenaHeader;
+
+typedef struct ArenaStats {
+    uint64_t nb_allocs;
+    uint64_t bytes;
+} ArenaStats;
+
+typedef struct ArenaCache {
+    ArenaHeader *free[NB_CLASSES];
+    int nb_free[NB_CLASSES];
+    ArenaStats stats[NB_CLASSES+1];
+    struct ArenaCache *prev, *next;
+} ArenaCache;
+
+static const unsigned class_size[NB_CLASSES] = {
+       32,    64,    96,   128,   160,   192,   224,   256,   320,   384,
+      448,   512,   640,   768,   896,  1024,  1280,  1536,  1792,  2048,
+     2560,  3072,  3584,  4096,  5120,  6144,  7168,  8192, 10240, 12288,
+    14336, 16384, 20480, 24576, 28672, 32768,
+};
+
+static int arena_enabled = 1;
+
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   arena_key;
+static ArenaHeader *arena_free[NB_CLASSES];    ///< blocks given back by the threads
+static int          arena_nb_free[NB_CLASSES];
+static ArenaCache  *arena_caches;              ///< caches of the running threads
+static ArenaStats   arena_stats[NB_CLASSES+1]; ///< stats of the exited threads
+static int64_t      arena_slab_bytes;
+
+static __thread ArenaCache *arena_cache;
+
+/**
+ * Class of the smallest blocks holding size bytes, 32 bytes steps up to
+ * 128 and quarter powers of two above, size must be at most MAX_SMALL.
+ */
+static inline int size_class(unsigned size)
+{
+    int k;
+    if (size <= 128)
+        return FFMAX((int)(size + 31) >> 5, 1) - 1;
+    k = av_log2(size - 1);
+    return 4*k - 24 + ((size - 1) >> (k - 2) & 3);
+}
+
+static inline ArenaHeader *block_header(void *ptr)
+{
+    return (ArenaHeader*)((uint8_t*)ptr - sizeof(ArenaHeader));
+}
+
+static inline void *block_base(ArenaHeader *h)
+{
+    return (uint8_t*)h + sizeof(*h) - ARENA_HEADER;
+}
+
+static uint8_t *alloc_aligned(size_t size)
+{
+    void *ptr;
+#if HAVE_POSIX_MEMALIGN
+    if (posix_memalign(&ptr, ALIGN, size))
+        ptr = NULL;
+#else
+    ptr = memalign(ALIGN, size);
+#endif
+    return ptr;
+}
+
+static int cache_max(int cls)
+{
+    return FFMAX(CACHE_BYTES / class_size[cls], 4);
+}
+
+/* give back the free blocks of a class above keep to the shared list */
+static void cache_drain(ArenaCache *c, int cls, int keep)
+{
+    ArenaHeader *first, *last, *h, *evicted = NULL;
+    int n = c->nb_free[cls] - keep, i;
+
+    if (n <= 0)
+        return;
+    first = last = c->free[cls];
+    for (i = 1; i < n; i++)
+        last = last->next;
+    c->free[cls]    = last->next;
+    c->nb_free[cls] = keep;
+
+    pthread_mutex_lock(&arena_lock);
+    last->next = arena_free[cls];
+    arena_free[cls] = first;
+    arena_nb_free[cls] += n;
+    if (class_size[cls] > MAX_SLAB_BLOCK) {
+        while (arena_nb_free[cls] > FFMAX(SHARED_BYTES / class_size[cls], 4)) {
+            h = arena_free[cls];
+            arena_free[cls] = h->next;
+            arena_nb_free[cls]--;
+            h->next = evicted;
+            evicted = h;
+        }
+    }
+    pthread_mutex_unlock(&arena_lock);
+
+    while ((h = evicted)) {
+        evicted = h->next;
+        free(block_base(h));
+    }
+}
+
+static void cache_destroy(void *opaque)
+{
+    ArenaCache *c = opaque;
+    int i;
+
+    for (i = 0; i < NB_CLASSES; i++)
+        cache_drain(c, i, 0);
+    pthread_mutex_lock(&arena_lock);
+    for (i = 0; i <= NB_CLASSES; i++) {
+        arena_stats[i].nb_allocs += c->stats[i].nb_allocs;
+        arena_stats[i].bytes     += c->stats[i].bytes;
+    }
+    if (c->prev) c->prev->next = c->next;
+    else         arena_caches  = c->next;
+    if (c->next) c->next->prev = c->prev;
+    pthread_mutex_unlock(&arena_lock);
+    arena_cache = NULL;
+    free(c);
+}
+
+static void arena_init(void)
+{
+    pthread_key_create(&arena_key, cache_destroy);
+}
+
+static ArenaCache *cache_create(void)
+{
+    ArenaCache *c;
+
+    pthread_once(&arena_once, arena_init);
+    c = calloc(1, sizeof(*c));
+    if (!c)
+        return NULL;
+    pthread_setspecific(arena_key, c);
+    pthread_mutex_lock(&arena_lock);
+    c->next = arena_caches;
+    if (arena_caches)
+        arena_caches->prev = c;
+    arena_caches = c;
+    pthread_mutex_unlock(&arena_lock);
+    return arena_cache = c;
+}
+
+/* take back up to half a cache of blocks, or allocate new ones */
+static ArenaHeader *cache_refill(ArenaCache *c, int cls)
+{
+    const int stride = ARENA_HEADER + class_size[cls];
+    int n = cache_max(cls) / 2;
+    ArenaHeader *h;
+    uint8_t *slab;
+    int i, nb;
+
+    pthread_mutex_lock(&arena_lock);
+    while (n-- && (h = arena_free[cls])) {
+        arena_free[cls] = h->next;
+        arena_nb_free[cls]--;
+        h->next = c->free[cls];
+        c->free[cls] = h;
+        c->nb_free[cls]++;
+    }
+    pthread_mutex_unlock(&arena_lock);
+    if (c->free[cls])
+        return c->free[cls];
+
+    nb = class_size[cls] > MAX_SLAB_BLOCK ? 1 : SLAB_SIZE / stride;
+    if (!(slab = alloc_aligned(nb * stride)))
+        return NULL;
+    for (i = nb - 1; i >= 0; i--) {
+        h = block_header(slab + i * stride + ARENA_HEADER);
+        h->cls  = cls;
+        h->next = c->free[cls];
+        c->free[cls] = h;
+    }
+    c->nb_free[cls] += nb;
+    if (nb > 1) {
+        pthread_mutex_lock(&arena_lock);
+        arena_slab_bytes += nb * stride;
+        pthread_mutex_unlock(&arena_lock);
+    }
+    return c->free[cls];
+}
+
+static void *arena_malloc(size_t size)
+{
+    ArenaCache *c = arena_cache;
+    ArenaHeader *h;
+    uint8_t *ptr;
+    int cls = size <= MAX_SMALL ? size_class(size) : LARGE;
+
+    if (!c)
+        c = cache_create();
+    if (arena_enabled && cls != LARGE && c) {
+        if (!(h = c->free[cls]) && !(h = cache_refill(c, cls)))
+            return NULL;
+        c->free[cls] = h->next;
+        c->nb_free[cls]--;
+        ptr = (uint8_t*)h + sizeof(*h);
+    } else {
+        if (!(ptr = alloc_aligned(size + ARENA_HEADER)))
+            return NULL;
+        ptr += ARENA_HEADER;
+        h = block_header(ptr);
+        h->cls = LARGE;
+    }
+    h->size = size;
+    /* counted in the class of the size even when not in the arena */
+    if (c) {
+        c->stats[cls].nb_allocs++;
+        c->stats[cls].bytes += size;
+    }
+    return ptr;
+}
+
+static void arena_free_block(void *ptr)
+{
+    ArenaHeader *h = block_header(ptr);
+    ArenaCache *c;
+    int cls = h->cls;
+
+    if (cls == LARGE) {
+        free(block_base(h));
+        return;
+    }
+    if (!(c = arena_cache) && !(c = cache_create())) {
+        pthread_mutex_lock(&arena_lock);
+        h->next = arena_free[cls];
+        arena_free[cls] = h;
+        arena_nb_free[cls]++;
+        pthread_mutex_unlock(&arena_lock);
+        return;
+    }
+    h->next = c->free[cls];
+    c->free[cls] = h;
+    if (++c->nb_free[cls] > cache_max(cls))
+        cache_drain(c, cls, cache_max(cls) / 2);
+}
+
+static void *arena_realloc(void *ptr, size_t size)
+{
+    ArenaHeader *h;
+    uint8_t *base;
+    void *new;
+
+    if (!ptr)
+        return arena_malloc(size);
+    h = block_header(ptr);
+    if (h->cls == LARGE) {
+        if (!(base = realloc(block_base(h), size + ARENA_HEADER)))
+            return NULL;
+        block_header(base + ARENA_HEADER)->size = size;
+        return base + ARENA_HEADER;
+    }
+    if (size <= class_size[h->cls]) {
+        h->size = size;
+        return ptr;
+    }
+    if (!(new = arena_malloc(size)))
+        return NULL;
+    memcpy(new, ptr, h->size);
+    arena_free_block(ptr);
+    return new;
+}
+#endif /* CONFIG_MEM_ARENA */
+
 /* You can redefine av_malloc and av_free in your project to use your
    memory allocator. You do not need to suppress this file because the
    linker will do it automatically. */
@@ -78,7 +375,9 @@ void *av_malloc(size_t size)
     if (size > (MAX_MALLOC_SIZE-32))
         return NULL;
 
-#if CONFIG_MEMALIGN_HACK
+#if CONFIG_MEM_ARENA
+    ptr = arena_malloc(size);
+#elif CONFIG_MEMALIGN_HACK
     ptr = malloc(size+ALIGN);
     if(!ptr)
         return ptr;
@@ -133,7 +432,9 @@ void *av_realloc(void *ptr, size_t size)
     if (size > (MAX_MALLOC_SIZE-16))
         return NULL;
 
-#if CONFIG_MEMALIGN_HACK
+#if CONFIG_MEM_ARENA
+    return arena_realloc(ptr, size + !size);
+#elif CONFIG_MEMALIGN_HACK
     //FIXME this isn't aligned correctly, though it probably isn't needed
     if(!ptr) return av_malloc(size);
     diff= ((char*)ptr)[-1];
@@ -145,7 +446,10 @@ void *av_realloc(void *ptr, size_t size)
 
 void av_free(void *ptr)
 {
-#if CONFIG_MEMALIGN_HACK
+#if CONFIG_MEM_ARENA
+    if (ptr)
+        arena_free_block(ptr);
+#elif CONFIG_MEMALIGN_HACK
     if (ptr)
         free((char*)ptr - ((char*)ptr)[-1]);
 #else
@@ -168,6 +472,51 @@ void *av_mallocz(size_t size)
     return ptr;
 }
 
+int av_mem_arena_enable(int enable)
+{
+#if CONFIG_MEM_ARENA
+    arena_enabled = !!enable;
+    return 0;
+#else
+    return enable ? AVERROR(ENOSYS) : 0;
+#endif
+}
+
+void av_mem_arena_log(void *avcl, int level)
+{
+#if CONFIG_MEM_ARENA
+    ArenaStats stats[NB_CLASSES+1];
+    ArenaCache *c;
+    int64_t slab_bytes;
+    int i;
+
+    pthread_mutex_lock(&arena_lock);
+    memcpy(stats, arena_stats, sizeof(stats));
+    for (c = arena_caches; c; c = c->next) {
+        for (i = 0; i <= NB_CLASSES; i++) {
+            stats[i].nb_allocs += c->stats[i].nb_allocs;
+            stats[i].bytes     += c->stats[i].bytes;
+        }
+    }
+    slab_bytes = arena_slab_bytes;
+    pthread_mutex_unlock(&arena_lock);
+
+    av_log(avcl, level, "arena: %s, %"PRId64" bytes of slabs\n",
+           arena_enabled ? "enabled" : "disabled", slab_bytes);
+    for (i = 0; i <= NB_CLASSES; i++) {
+        char name[16];
+        if (!stats[i].nb_allocs)
+            continue;
+        if (i < NB_CLASSES)
+            snprintf(name, sizeof(name), "%u", class_size[i]);
+        else
+            snprintf(name, sizeof(name), "large");
+        av_log(avcl, level, "arena: %6s %10"PRIu64" allocs %14"PRIu64" bytes\n",
+               name, stats[i].nb_allocs, stats[i].bytes);
+    }
+#endif
+}
+
 char *av_strdup(const char *s)
 {
     char *ptr= NULL;
@@ -123,6 +123,21 @@ char *av_strdup(const char *s) av_malloc_attrib;
  */
 void av_freep(void *ptr);
 
+/**
+ * Turn the size class arena used by av_malloc() on or off, it is on by
+ * default when libavutil is configured with --enable-mem-arena.
+ * Blocks allocated in either mode may be freed in the other one.
+ * @return 0 on success, AVERROR(ENOSYS) if enable is set and the arena
+ * is not compiled in.
+ */
+int av_mem_arena_enable(int enable);
+
+/**
+ * Log the number of allocations and the allocated bytes of each size
+ * class of the arena. Does nothing if the arena is not compiled in.
+ */
+void av_mem_arena_log(void *avcl, int level);
+
 /**
  * Add an element to a dynamic array.
  *
@@ -33,7 +33,7 @@
          "xchg %%"REG_b", %%"REG_S\
          : "=a" (eax), "=S" (ebx),\
            "=c" (ecx), "=d" (edx)\
-         : "0" (index));
+         : "0" (index), "2" (0));
 
 #define xgetbv(index,eax,edx)                                   \
     __asm__ (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c" (index))
@@ -101,8 +101,16 @@ int ff_get_cpu_flags_x86(void)
         if ((ecx & 0x18000000) == 0x18000000) {
             /* Check for OS support */
             xgetbv(0, eax, edx);
-            if ((eax & 0x6) == 0x6)
+            if ((eax & 0x6) == 0x6) {
                 rval |= AV_CPU_FLAG_AVX;
+#if HAVE_AVX2
+                if (max_std_level >= 7) {
+                    cpuid(7, eax, ebx, ecx, edx);
+                    if (ebx & 0x00000020)
+                        rval |= AV_CPU_FLAG_AVX2;
+                }
+#endif
+            }
         }
 #endif
 #endif
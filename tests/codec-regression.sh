@@ -56,6 +56,24 @@ do_video_encoding mpeg2threadivlc.mpg "-qscale 10 -vcodec mpeg2video -f mpeg1vid
 do_video_decoding
 fi
 
+if [ -n "$do_mpeg2framethread" ] ; then
+# interlaced B-frames with field prediction, the frame threaded decoding
+# must match the single threaded one, and keep the timestamp of the last
+# frame flushed out at the end
+do_video_encoding mpeg2framethread.mpg "-qscale 10 -vcodec mpeg2video -f mpeg2video -bf 2 -flags +ildct+ilme -tff"
+do_video_decoding
+do_video_decoding "-threads 4 -thread_type frame" "-vsync 1"
+fi
+
+if [ -n "$do_mpeg2bstrategy" ] ; then
+# B-frame decision by trial encodings, which run on the slice threads
+do_video_encoding mpeg2bstrategy.mpg "-qscale 10 -vcodec mpeg2video -f mpeg1video -bf 3 -b_strategy 2"
+do_video_decoding
+
+do_video_encoding mpeg2bstrategythread.mpg "-qscale 10 -vcodec mpeg2video -f mpeg1video -bf 3 -b_strategy 2 -threads 3"
+do_video_decoding
+fi
+
 if [ -n "$do_msmpeg4v2" ] ; then
 do_video_encoding msmpeg4v2.avi "-qscale 10 -an -vcodec msmpeg4v2"
 do_video_decoding
@@ -200,6 +218,11 @@ do_video_encoding snow53.avi "-strict -2 -an -vcodec snow -qscale .001 -pred 1 -
 do_video_decoding
 fi
 
+if [ -n "$do_j2k" ] ; then
+do_video_encoding j2k.avi "-strict -2 -an -vcodec j2k -dwt 97 -pix_fmt rgb24 -threads 2"
+do_video_decoding "-strict -2" "-pix_fmt yuv420p"
+fi
+
 if [ -n "$do_dv" ] ; then
 do_video_encoding dv.dv "-dct int -s pal -an"
 do_video_decoding "" "-s cif"
@@ -393,3 +416,20 @@ do_audio_enc_dec wav dbl pcm_f64le
 do_audio_enc_dec wav s16 pcm_zork
 do_audio_enc_dec 302 s16 pcm_s24daud "-ac 6 -ar 96000"
 fi
+
+if [ -n "$do_s302m" ] ; then
+# the samples are taken as 48kHz ones, 302M allows no other rate
+for bits in 16 20 24; do
+    fmt=s32
+    [ $bits = 16 ] && fmt=s16
+    file=${outfile}s302m_$bits.ts
+    do_ffmpeg $file $DEC_OPTS -ac 2 -ar 48000 -f s16le -i $pcm_src $ENC_OPTS -sample_fmt $fmt -acodec s302m -bits $bits -f mpegts
+    do_audio_decoding
+done
+fi
+
+if [ -n "$do_resample" ] ; then
+# float resampling path, to float at 48kHz and back to s16 at 44.1kHz
+do_audio_encoding resample.wav "-ar 48000 -sample_fmt flt -acodec pcm_f32le"
+do_ffmpeg $pcm_dst $DEC_OPTS -i $target_path/$file -ar 44100 -sample_fmt s16 -f wav
+fi
@@ -37,6 +37,10 @@ fate-ra-cook: REF = $(SAMPLES)/real/ra_cook.pcm
 FATE_TESTS += fate-mpeg2-field-enc
 fate-mpeg2-field-enc: CMD = framecrc -flags +bitexact -dct fastint -idct simple -i $(SAMPLES)/mpeg2/mpeg2_field_encoding.ts -an
 
+FATE_TESTS += fate-mpeg2-field-enc-frame-threads
+fate-mpeg2-field-enc-frame-threads: CMD = framecrc -flags +bitexact -dct fastint -idct simple -threads 4 -thread_type frame -i $(SAMPLES)/mpeg2/mpeg2_field_encoding.ts -an
+fate-mpeg2-field-enc-frame-threads: REF = $(SRC_PATH)/tests/ref/fate/mpeg2-field-enc
+
 FATE_TESTS += fate-qcelp
 fate-qcelp: CMD = pcm -i $(SAMPLES)/qcp/0036580847.QCP
 fate-qcelp: CMP = oneoff
@@ -222,3 +226,23 @@ fate-musepack7: FUZZ = 1
 FATE_TESTS += fate-iirfilter
 fate-iirfilter: libavcodec/iirfilter-test$(EXESUF)
 fate-iirfilter: CMD = run libavcodec/iirfilter-test
+
+FATE_TESTS += fate-yadif-10bit
+fate-yadif-10bit: libavfilter/vf_yadif-test$(EXESUF)
+fate-yadif-10bit: CMD = run libavfilter/vf_yadif-test
+
+FATE_TESTS += fate-w3fdif
+fate-w3fdif: libavfilter/vf_w3fdif-test$(EXESUF)
+fate-w3fdif: CMD = run libavfilter/vf_w3fdif-test
+
+FATE_TESTS += fate-dvdsp
+fate-dvdsp: libavcodec/dvdsp-test$(EXESUF)
+fate-dvdsp: CMD = run libavcodec/dvdsp-test
+
+FATE_TESTS += fate-trellis
+fate-trellis: libavcodec/trellis-test$(EXESUF)
+fate-trellis: CMD = run libavcodec/trellis-test
+
+FATE_TESTS += fate-framepool
+fate-framepool: libavcodec/framepool-test$(EXESUF)
+fate-framepool: CMD = run libavcodec/framepool-test
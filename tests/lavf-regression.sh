@@ -31,6 +31,18 @@ do_lavf_extra()
     do_ffmpeg_crc $file $DEC_OPTS -i $target_path/$file $3
 }
 
+# fast open must find the same stream parameters as normal probing
+do_fastopen()
+{
+    $ffmpeg -i $target_path/$file 2>&1 | grep "Stream #" > $file.probe
+    $ffmpeg -fflags fastopen -i $target_path/$file 2>&1 | grep "Stream #" > $file.fastopen
+    if cmp -s $file.probe $file.fastopen; then
+        echo "$file fast open: same stream parameters"
+    else
+        diff $file.probe $file.fastopen || true
+    fi
+}
+
 do_streamed_images()
 {
     file=${outfile}${1}pipe.$1
@@ -81,13 +93,17 @@ fi
 
 if [ -n "$do_mxf" ] ; then
 do_lavf mxf '-ar 48000 -bf 2 -timecode 02:56:14:13'
+do_fastopen
 do_lavf mxf '-ar 48000 -r 30000/1001 -timecode 02:56:14;13' '' 'lavf_ntsc_tc.mxf'
 do_lavf mxf '-ar 48000 -vcodec dnxhd -dct int -s 1920x1080 -b 120M' '' 'lavf_dnxhd.mxf'
+do_fastopen
 do_lavf_extra mxf '-ar 48k -pix_fmt yuv422p -dct int -vcodec dvvideo -s 1440x1080' '' 'lavf_dvhd.mxf' '-ar 48k -newaudio -newaudio -newaudio'
+do_fastopen
 fi
 
 if [ -n "$do_mxf_d10" ]; then
 do_lavf mxf_d10 "-ar 48000 -ac 2 -r 25 -target imx30 -f mxf_d10"
+do_fastopen
 do_lavf mxf_d10 "-ar 48000 -ac 2 -r 30000/1001 -target imx50" '' 'lavf_ntsc_d10.mxf'
 fi
 
@@ -95,6 +111,11 @@ if [ -n "$do_ts" ] ; then
 do_lavf ts
 fi
 
+if [ -n "$do_ts_cbr" ] ; then
+do_lavf ts "-maxrate 6000k -bufsize 1835k -muxrate 10000000" '' 'lavf_cbr.ts'
+$target_exec $target_path/tools/tscbrcheck $target_path/$file 10000000
+fi
+
 if [ -n "$do_swf" ] ; then
 do_lavf swf -an
 fi
@@ -120,6 +141,7 @@ fi
 
 if [ -n "$do_gxf" ] ; then
 do_lavf gxf "-ar 48000 -r 25 -s pal -ac 1"
+do_fastopen
 fi
 
 if [ -n "$do_nut" ] ; then
@@ -199,6 +221,11 @@ if [ -n "$do_pcx" ] ; then
 do_image_formats pcx
 fi
 
+if [ -n "$do_dpx" ] ; then
+do_image_formats dpx "-pix_fmt rgb48le -bits_per_raw_sample 10"
+do_ffmpeg_crc $file $DEC_OPTS -readahead 3 -direct 1 -i $target_path/$file
+fi
+
 # audio only
 
 if [ -n "$do_wav" ] ; then
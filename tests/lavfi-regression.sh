@@ -32,6 +32,7 @@ do_lavfi "crop"               "crop=iw-100:ih-100:100:100"
 do_lavfi "crop_scale"         "crop=iw-100:ih-100:100:100,scale=400:-1"
 do_lavfi "crop_scale_vflip"   "null,null,crop=iw-200:ih-200:200:200,crop=iw-20:ih-20:20:20,scale=200:200,scale=250:250,vflip,vflip,null,scale=200:200,crop=iw-100:ih-100:100:100,vflip,scale=200:200,null,vflip,crop=iw-100:ih-100:100:100,null"
 do_lavfi "crop_vflip"         "crop=iw-100:ih-100:100:100,vflip"
+do_lavfi "hqdn3d"             "hqdn3d"
 do_lavfi "null"               "null"
 do_lavfi "scale200"           "scale=200:200"
 do_lavfi "scale500"           "scale=500:500"
@@ -39,6 +40,59 @@ do_lavfi "vflip"              "vflip"
 do_lavfi "vflip_crop"         "vflip,crop=iw-100:ih-100:100:100"
 do_lavfi "vflip_vflip"        "vflip,vflip"
 
+# bottom-up slices of an odd height frame share a chroma row, the output
+# must not depend on the slicing
+if [ -n "$do_colormatrix" ]; then
+    do_video_filter frame   "scale=352:287,vflip,colormatrix=bt601:bt709,vflip"
+    do_video_filter slices  "scale=352:287,slicify=8,vflip,colormatrix=bt601:bt709,vflip"
+    do_video_filter random  "scale=352:287,slicify=random,vflip,colormatrix=bt601:bt709,vflip"
+fi
+
+if [ -n "$do_hqdn3d_10bit" ]; then
+    do_video_filter hqdn3d_10bit "slicify=random,format=yuv422p10le,hqdn3d=4:3:6:4.5:3" -pix_fmt yuv422p10le
+fi
+
+# the scene scores must not depend on the thread count
+if [ -n "$do_framerate" ]; then
+    do_video_filter scene      "framerate=50:scene=2:threads=1"
+    do_video_filter scene_mt   "framerate=50:scene=2:threads=3"
+    do_video_filter scene_sub  "framerate=50:scene=2:scene_sub=4:threads=1"
+    do_video_filter scene_sub_mt "framerate=50:scene=2:scene_sub=4:threads=3"
+fi
+
+# the motion search must not depend on the thread count either
+if [ -n "$do_framerate_mc" ]; then
+    do_video_filter mc       "framerate=fps=60:flags=scd+mc:threads=1" -r 60
+    do_video_filter mc_mt    "framerate=fps=60:flags=scd+mc:threads=3" -r 60
+fi
+
+# the displays must not depend on the slicing or the thread count
+if [ -n "$do_wfm_luma" ]; then
+    do_video_filter luma           "slicify=random,wfm_luma"
+    do_video_filter luma_mt        "slicify=random,wfm_luma=threads=3"
+    do_video_filter parade         "slicify=random,wfm_luma=mode=parade"
+    do_video_filter parade_mt      "slicify=random,wfm_luma=mode=parade:threads=3"
+    do_video_filter vectorscope    "slicify=random,wfm_luma=mode=vectorscope"
+    do_video_filter vectorscope_mt "slicify=random,wfm_luma=mode=vectorscope:threads=3"
+fi
+
+# the overlay fades in, so that it is skipped, blended, then copied
+if [ -n "$do_overlay" ]; then
+    overlay="color=0x2030C0:150x100,format=yuva420p,fade=in:5:30:alpha=1[over];[main][over]overlay=51:33"
+    do_video_filter yuv420p   "slicify=random[main];$overlay"
+    do_video_filter yuv422p   "slicify=random,format=yuv422p[main];$overlay" -pix_fmt yuv422p
+    do_video_filter yuv422p10 "slicify=random,format=yuv422p10le[main];$overlay" -pix_fmt yuv422p10le
+fi
+
+# qcstats passes the video through, test the statistics it logs; the
+# padding is found by the crop detection, the fade ends with frozen black
+# frames; colormatrix works in place and must not change what was measured
+if [ -n "$do_qcstats" ]; then
+    run_ffmpeg $DEC_OPTS -f image2 -vcodec pgmyuv -i $raw_src $ENC_OPTS -v 1 \
+        -vf "slicify=random,pad=400:320:30:18,fade=out:40:6,qcstats,colormatrix=bt709:bt601" -f null - 2>&1 |
+        sed -n 's/^\[qcstats @ [^]]*\] //p'
+fi
+
 do_lavfi_pixfmts(){
     test ${test%_[bl]e} = pixfmts_$1 || return 0
     filter=$1
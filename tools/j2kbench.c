@@ -0,0 +1,170 @@
+/*
+ * JPEG 2000 encoding and decoding benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the JPEG 2000 encoding and decoding speed on synthetic RGB24
+ * frames, 2K (2048x1080) and 4K (4096x2160) by default.
+ *
+ * To compile this program, start from the base directory from which you
+ * are building FFmbc and type:
+ *  make tools/j2kbench
+ * Invoke the program with:
+ *  j2kbench [threads] [frames] [WxH]
+ *
+ * The decoded frames are compared with the source; since the default
+ * encoding uses the reversible 5/3 wavelet, the program returns 1 if they
+ * differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "libavutil/mem.h"
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+
+static AVCodecContext *open_codec(int encoder, int width, int height, int threads)
+{
+    AVCodec *codec = encoder ? avcodec_find_encoder(CODEC_ID_JPEG2000) :
+                               avcodec_find_decoder(CODEC_ID_JPEG2000);
+    AVCodecContext *avctx = avcodec_alloc_context3(codec);
+
+    if (!avctx || !codec)
+        return NULL;
+    avctx->width   = width;
+    avctx->height  = height;
+    avctx->pix_fmt = PIX_FMT_RGB24;
+    avctx->time_base = (AVRational){1, 25};
+    avctx->thread_count = threads;
+    avctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+    if (avcodec_open2(avctx, codec, NULL) < 0) {
+        av_free(avctx);
+        return NULL;
+    }
+    return avctx;
+}
+
+static void fill_frame(AVPicture *pic, int width, int height, int n)
+{
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        uint8_t *p = pic->data[0] + y * pic->linesize[0];
+        for (x = 0; x < width; x++) {
+            *p++ = x + n;
+            *p++ = y + (x >> 3);
+            *p++ = ((x ^ y) & 0x10) ? 235 : 16 + ((x * y + n) & 15);
+        }
+    }
+}
+
+static int bench(int width, int height, int threads, int frames)
+{
+    AVCodecContext *enc = open_codec(1, width, height, threads);
+    AVCodecContext *dec = open_codec(0, width, height, threads);
+    AVPicture src;
+    AVFrame *frame = avcodec_alloc_frame(), out;
+    int buf_size = width * height * 6 + FF_MIN_BUFFER_SIZE;
+    uint8_t *buf = av_malloc(buf_size);
+    int64_t enc_time = 0, dec_time = 0, bytes = 0, t;
+    int i, y, got_picture, mismatch = 0;
+
+    if (!enc || !dec || !frame || !buf ||
+        avpicture_alloc(&src, PIX_FMT_RGB24, width, height) < 0) {
+        fprintf(stderr, "cannot initialize the codecs for %dx%d\n", width, height);
+        return -1;
+    }
+
+    for (i = 0; i < frames; i++) {
+        AVPacket pkt;
+        int size;
+
+        fill_frame(&src, width, height, i);
+        avcodec_get_frame_defaults(frame);
+        memcpy(frame->data, src.data, sizeof(src.data));
+        memcpy(frame->linesize, src.linesize, sizeof(src.linesize));
+
+        t = av_gettime();
+        size = avcodec_encode_video(enc, buf, buf_size, frame);
+        enc_time += av_gettime() - t;
+        if (size <= 0) {
+            fprintf(stderr, "encoding failed\n");
+            return -1;
+        }
+        bytes += size;
+
+        av_init_packet(&pkt);
+        pkt.data = buf;
+        pkt.size = size;
+        t = av_gettime();
+        if (avcodec_decode_video2(dec, &out, &got_picture, &pkt) < 0 || !got_picture) {
+            fprintf(stderr, "decoding failed\n");
+            return -1;
+        }
+        dec_time += av_gettime() - t;
+
+        for (y = 0; y < height; y++)
+            if (memcmp(out.data[0] + y * out.linesize[0],
+                       src.data[0] + y * src.linesize[0], width * 3))
+                mismatch++;
+    }
+
+    printf("%dx%d threads %d: encode %.2f fps, decode %.2f fps, %"PRId64" bytes/frame%s\n",
+           width, height, threads,
+           frames * 1000000.0 / FFMAX(enc_time, 1),
+           frames * 1000000.0 / FFMAX(dec_time, 1),
+           bytes / frames, mismatch ? ", MISMATCH" : "");
+
+    avpicture_free(&src);
+    av_free(buf);
+    av_free(frame);
+    avcodec_close(enc);
+    avcodec_close(dec);
+    av_free(enc);
+    av_free(dec);
+    return !!mismatch;
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 1;
+    int frames  = argc > 2 ? atoi(argv[2]) : 4;
+    int width, height, ret = 0;
+
+    avcodec_register_all();
+
+    if (threads < 1 || frames < 1) {
+        fprintf(stderr, "usage: %s [threads] [frames] [WxH]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 3) {
+        if (sscanf(argv[3], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+            fprintf(stderr, "invalid size %s\n", argv[3]);
+            return 1;
+        }
+        ret = bench(width, height, threads, frames);
+    } else {
+        ret  = bench(2048, 1080, threads, frames);
+        ret |= bench(4096, 2160, threads, frames);
+    }
+    return ret ? 1 : 0;
+}
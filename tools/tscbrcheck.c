@@ -0,0 +1,169 @@
+/*
+ * MPEG transport stream CBR / PCR checker
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the PCR accuracy and the bitrate of a constant bitrate transport
+ * stream, as written by the mpegts muxer with -muxrate.
+ *
+ * To compile this program, start from the base directory from which you
+ * are building FFmbc and type:
+ *  make tools/tscbrcheck
+ * Invoke the program with:
+ *  tscbrcheck <infile.ts> [muxrate]
+ *
+ * The PCR of each packet is compared with the time at which its byte 11
+ * arrives at the nominal rate, which is the convention used by the muxer.
+ * If no rate is given, the average rate between the first and the last PCR
+ * is used as the nominal rate. The program returns 1 if the PCR accuracy
+ * exceeds +-500ns (ISO 13818-1 2.4.2.2) or if the PCR interval exceeds 40ms
+ * (ETSI TR 101 290).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#define TS_PACKET_SIZE 188
+#define PCR_TIME_BASE 27000000LL
+#define MAX_PCR_ACCURACY_NS 500
+#define MAX_PCR_INTERVAL_MS 40
+
+typedef struct PCRSample {
+    int64_t pos;
+    int64_t pcr;
+} PCRSample;
+
+static int read_pcr(const uint8_t *pkt, int64_t *pcr)
+{
+    int64_t base;
+
+    if (!(pkt[3] & 0x20) || pkt[4] < 7 || !(pkt[5] & 0x10))
+        return 0;
+    base = ((int64_t)pkt[6] << 25) | (pkt[7] << 17) | (pkt[8] << 9) |
+           (pkt[9] << 1) | (pkt[10] >> 7);
+    *pcr = base * 300 + (((pkt[10] & 1) << 8) | pkt[11]);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *f;
+    uint8_t pkt[TS_PACKET_SIZE];
+    PCRSample *samples = NULL;
+    int nb_samples = 0, max_samples = 0;
+    int pcr_pid = -1, i, ret = 0;
+    int64_t pos = 0, nb_packets = 0, nb_null = 0;
+    int64_t max_interval = 0, max_jitter = 0, elapsed;
+    double rate, nominal_rate = 0, sum_jitter = 0;
+
+    if (argc < 2) {
+        printf("usage: tscbrcheck <infile.ts> [muxrate]\n");
+        return 0;
+    }
+    if (argc > 2)
+        nominal_rate = atof(argv[2]);
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    while (fread(pkt, TS_PACKET_SIZE, 1, f) == 1) {
+        int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+        int64_t pcr;
+
+        if (pkt[0] != 0x47) {
+            fprintf(stderr, "lost sync at offset %"PRId64"\n", pos);
+            ret = 1;
+            break;
+        }
+        nb_packets++;
+        if (pid == 0x1fff)
+            nb_null++;
+        if (read_pcr(pkt, &pcr) && (pcr_pid < 0 || pid == pcr_pid)) {
+            pcr_pid = pid;
+            if (nb_samples == max_samples) {
+                PCRSample *tmp;
+                max_samples = 2 * max_samples + 1024;
+                tmp = realloc(samples, max_samples * sizeof(*samples));
+                if (!tmp) {
+                    fprintf(stderr, "out of memory\n");
+                    ret = 1;
+                    break;
+                }
+                samples = tmp;
+            }
+            samples[nb_samples].pos = pos + 11;
+            samples[nb_samples].pcr = pcr;
+            nb_samples++;
+        }
+        pos += TS_PACKET_SIZE;
+    }
+    fclose(f);
+
+    if (nb_samples < 2) {
+        fprintf(stderr, "not enough PCRs found\n");
+        free(samples);
+        return 1;
+    }
+
+    elapsed = samples[nb_samples - 1].pcr - samples[0].pcr;
+    if (elapsed <= 0) {
+        fprintf(stderr, "PCR does not increase\n");
+        free(samples);
+        return 1;
+    }
+    rate = (samples[nb_samples - 1].pos - samples[0].pos) * 8.0 *
+           PCR_TIME_BASE / elapsed;
+    if (!nominal_rate)
+        nominal_rate = rate;
+
+    for (i = 0; i < nb_samples; i++) {
+        double expected = samples[0].pcr + (samples[i].pos - samples[0].pos) *
+                          8.0 * PCR_TIME_BASE / nominal_rate;
+        int64_t jitter = llabs((int64_t)((samples[i].pcr - expected) *
+                                         1000000000.0 / PCR_TIME_BASE));
+        if (jitter > max_jitter)
+            max_jitter = jitter;
+        sum_jitter += jitter;
+        if (i > 0 && samples[i].pcr - samples[i - 1].pcr > max_interval)
+            max_interval = samples[i].pcr - samples[i - 1].pcr;
+    }
+
+    printf("packets:          %"PRId64" (%"PRId64" null, %.2f%%)\n",
+           nb_packets, nb_null, 100.0 * nb_null / nb_packets);
+    printf("pcr pid:          0x%04x, %d pcrs\n", pcr_pid, nb_samples);
+    printf("nominal rate:     %.0f bit/s\n", nominal_rate);
+    printf("measured rate:    %.0f bit/s (%+.3f ppm)\n", rate,
+           (rate - nominal_rate) * 1000000.0 / nominal_rate);
+    printf("pcr accuracy:     max %"PRId64" ns, avg %.1f ns\n",
+           max_jitter, sum_jitter / nb_samples);
+    printf("max pcr interval: %.3f ms\n", max_interval * 1000.0 / PCR_TIME_BASE);
+
+    if (max_jitter > MAX_PCR_ACCURACY_NS ||
+        max_interval > MAX_PCR_INTERVAL_MS * PCR_TIME_BASE / 1000)
+        ret = 1;
+    printf("%s\n", ret ? "FAILED" : "OK");
+
+    free(samples);
+    return ret;
+}